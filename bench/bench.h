@@ -0,0 +1,144 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+// Minimal benchmark harness for keyboard_checker_bench.
+// A benchmark does its setup, then times Iterations() runs of the measured
+// code between StartTiming() and StopTiming(). The harness raises the
+// iteration count until a run is long enough to measure.
+
+// Heap allocations made by the calling thread so far (bench_alloc.cpp
+// replaces the global operator new to count them)
+uint64_t BenchAllocationCount();
+
+const size_t BENCH_MAX_ARGS = 2;
+
+class BenchState
+{
+public:
+    BenchState(uint64_t iterations, int64_t arg0, int64_t arg1 = 0)
+        : m_args{arg0, arg1}, m_iterations(iterations), m_itemsPerIteration(1), m_elapsedNs(0),
+          m_allocations(0), m_skipped(false)
+    {
+    }
+
+    uint64_t Iterations() const { return m_iterations; }
+    int64_t Arg(size_t index = 0) const { return m_args[index]; }
+
+    // Work units per iteration (e.g. keystrokes), used for the per-item cost
+    void SetItemsPerIteration(uint64_t items) { m_itemsPerIteration = items; }
+    uint64_t ItemsPerIteration() const { return m_itemsPerIteration; }
+
+    void StartTiming()
+    {
+        m_startAllocations = BenchAllocationCount();
+        m_start = std::chrono::steady_clock::now();
+    }
+
+    void StopTiming()
+    {
+        m_elapsedNs += std::chrono::duration_cast<std::chrono::nanoseconds>(
+                           std::chrono::steady_clock::now() - m_start).count();
+        m_allocations += BenchAllocationCount() - m_startAllocations;
+    }
+
+    int64_t ElapsedNs() const { return m_elapsedNs; }
+
+    // Allocations by the benchmark thread while timing
+    uint64_t Allocations() const { return m_allocations; }
+
+    // Marks the benchmark as not runnable here, e.g. a missing CPU feature
+    void Skip() { m_skipped = true; }
+    bool Skipped() const { return m_skipped; }
+
+private:
+    int64_t m_args[BENCH_MAX_ARGS];
+    uint64_t m_iterations;
+    uint64_t m_itemsPerIteration;
+    int64_t m_elapsedNs;
+    uint64_t m_allocations;
+    uint64_t m_startAllocations;
+    bool m_skipped;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+typedef void (*BenchFunction)(BenchState &state);
+
+struct BenchDefinition
+{
+    std::string name;
+    BenchFunction function;
+    int64_t args[BENCH_MAX_ARGS];
+    const char *argNames[BENCH_MAX_ARGS];  // nullptr for unnamed arguments
+};
+
+inline std::vector<BenchDefinition> &BenchRegistry()
+{
+    static std::vector<BenchDefinition> registry;
+    return registry;
+}
+
+struct BenchRegistrar
+{
+    BenchRegistrar(const char *name, BenchFunction function, int64_t arg)
+    {
+        BenchRegistry().push_back({name, function, {arg, 0}, {nullptr, nullptr}});
+    }
+
+    // One benchmark per combination, named <name>/<arg0Name>:<v0>/<arg1Name>:<v1>.
+    // A null arg1Name registers one benchmark per arg0 value.
+    BenchRegistrar(const char *name, BenchFunction function, const char *arg0Name,
+                   std::initializer_list<int64_t> arg0Values, const char *arg1Name,
+                   std::initializer_list<int64_t> arg1Values)
+    {
+        for (int64_t arg0 : arg0Values)
+        {
+            for (int64_t arg1 : arg1Values)
+            {
+                std::string fullName = std::string(name) + "/" + arg0Name + ":" + std::to_string(arg0);
+                if (arg1Name)
+                {
+                    fullName += std::string("/") + arg1Name + ":" + std::to_string(arg1);
+                }
+                BenchRegistry().push_back({fullName, function, {arg0, arg1}, {arg0Name, arg1Name}});
+            }
+        }
+    }
+};
+
+// Keeps the compiler from discarding a computed value
+template <typename T>
+inline void DoNotOptimize(const T &value)
+{
+#if defined(__GNUC__) || defined(__clang__)
+    asm volatile("" : : "r,m"(value) : "memory");
+#else
+    const volatile char *sink = reinterpret_cast<const volatile char *>(&value);
+    (void)*sink;
+#endif
+}
+
+#define BENCH_CONCAT_INNER(a, b) a##b
+#define BENCH_CONCAT(a, b) BENCH_CONCAT_INNER(a, b)
+
+// Registers function under name, called with state.Arg() == arg
+#define BENCHMARK(name, function, arg) \
+    static BenchRegistrar BENCH_CONCAT(s_benchRegistrar, __LINE__)(name, function, arg)
+
+// Argument list for BENCHMARK_GRID
+#define BENCH_ARGS(...) std::initializer_list<int64_t>{__VA_ARGS__}
+
+// Registers function for every (arg0, arg1) pair, e.g.
+// BENCHMARK_GRID("compose", BenchCompose, "len", BENCH_ARGS(8, 64), "layouts", BENCH_ARGS(2, 4))
+#define BENCHMARK_GRID(name, function, arg0Name, arg0Values, arg1Name, arg1Values)           \
+    static BenchRegistrar BENCH_CONCAT(s_benchRegistrar, __LINE__)(name, function, arg0Name, \
+                                                                   arg0Values, arg1Name, arg1Values)
+
+// Registers function for every value of one named argument
+#define BENCHMARK_RANGE(name, function, argName, values)                                               \
+    static BenchRegistrar BENCH_CONCAT(s_benchRegistrar, __LINE__)(name, function, argName, values, nullptr, \
+                                                                   BENCH_ARGS(0))
@@ -0,0 +1,49 @@
+// Counts heap allocations so benchmarks can report allocations per operation.
+// Only the plain and array forms are replaced; the default nothrow forms call
+// them. Over-aligned allocations are not counted.
+#include "bench.h"
+#include <cstdlib>
+#include <new>
+
+static thread_local uint64_t t_allocations = 0;
+
+uint64_t BenchAllocationCount()
+{
+    return t_allocations;
+}
+
+void *operator new(std::size_t size)
+{
+    t_allocations++;
+    void *memory = std::malloc(size > 0 ? size : 1);
+    if (!memory)
+    {
+        throw std::bad_alloc();
+    }
+    return memory;
+}
+
+void *operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
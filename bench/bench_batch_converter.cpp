@@ -0,0 +1,52 @@
+#include "bench.h"
+#include "batch_converter.h"
+#include <cstdlib>
+
+// Keystrokes converted per iteration, about one line of typing
+const size_t BENCH_SEQUENCE_LENGTH = 64;
+
+static std::vector<KeyPressInfo> MakeKeySequence(size_t length)
+{
+    static const uint32_t keys[] = {'A', 'K', 'U', 'O', 'X', 'T', 'E', 'S', 'Q', 'L',
+                                    KC_OEM_1, KC_OEM_COMMA, KC_OEM_PERIOD, '4', '7', KC_SPACE};
+
+    std::vector<KeyPressInfo> sequence;
+    srand(1);
+    for (size_t i = 0; i < length; i++)
+    {
+        ModifierFlags modifiers;
+        modifiers.shift = (rand() % 8) == 0;
+        sequence.push_back(KeyPressInfo(keys[rand() % (sizeof(keys) / sizeof(keys[0]))], modifiers));
+    }
+    return sequence;
+}
+
+// Renders the sequence in Arg() layouts, cycling the built-in tables
+static void BenchBatchConvert(BenchState &state)
+{
+    static const LayoutTable us = LayoutTable::UsQwerty();
+    static const LayoutTable hebrew = LayoutTable::HebrewSi1452();
+
+    std::vector<const LayoutTable *> layouts;
+    for (int64_t i = 0; i < state.Arg(); i++)
+    {
+        layouts.push_back(i % 2 == 0 ? &us : &hebrew);
+    }
+
+    BatchConverter converter;
+    converter.SetLayouts(layouts);
+    std::vector<KeyPressInfo> keys = MakeKeySequence(BENCH_SEQUENCE_LENGTH);
+    state.SetItemsPerIteration(keys.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        converter.Convert(keys);
+        DoNotOptimize(converter.Lane(0).size());
+    }
+    state.StopTiming();
+}
+
+BENCHMARK("batch_convert/layouts:2", BenchBatchConvert, 2);
+BENCHMARK("batch_convert/layouts:4", BenchBatchConvert, 4);
+BENCHMARK("batch_convert/layouts:8", BenchBatchConvert, 8);
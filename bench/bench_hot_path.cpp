@@ -0,0 +1,409 @@
+// Per-keystroke stages of the detection pipeline, one benchmark each
+#include "bench.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <string>
+#include "detection_engine.h"
+#include "latency_histogram.h"
+#include "logger.h"
+#include "ngram_model.h"
+#include "text_composer.h"
+#include "word_dictionary.h"
+
+// Text keys only, so composing never hits a word boundary
+static std::vector<KeyPressInfo> MakeWordKeys(size_t length)
+{
+    static const uint32_t keys[] = {'A', 'K', 'U', 'O', 'X', 'T', 'E', 'S', 'Q', 'L', KC_OEM_1, KC_OEM_PERIOD};
+
+    std::vector<KeyPressInfo> sequence;
+    srand(1);
+    for (size_t i = 0; i < length; i++)
+    {
+        ModifierFlags modifiers;
+        modifiers.shift = (rand() % 8) == 0;
+        sequence.push_back(KeyPressInfo(keys[rand() % (sizeof(keys) / sizeof(keys[0]))], modifiers));
+    }
+    return sequence;
+}
+
+// Arg(0) layouts, alternating the built-in tables
+static std::vector<LayoutTable> MakeLayouts(int64_t count)
+{
+    std::vector<LayoutTable> layouts;
+    for (int64_t i = 0; i < count; i++)
+    {
+        layouts.push_back(i % 2 == 0 ? LayoutTable::UsQwerty() : LayoutTable::HebrewSi1452());
+    }
+    return layouts;
+}
+
+// ModifierFlags::UpdateFromKey over Arg(0) keys, a quarter of them modifiers
+static void BenchModifierUpdate(BenchState &state)
+{
+    static const uint32_t keys[] = {KC_LSHIFT, 'A', 'B', 'C', KC_RCONTROL, 'D', 'E', 'F',
+                                    KC_LMENU, 'G', 'H', 'I', KC_SHIFT, 'J', 'K', 'L'};
+
+    std::vector<uint32_t> sequence;
+    std::vector<bool> down;
+    srand(1);
+    for (int64_t i = 0; i < state.Arg(); i++)
+    {
+        sequence.push_back(keys[rand() % (sizeof(keys) / sizeof(keys[0]))]);
+        down.push_back(rand() % 2 == 0);
+    }
+    state.SetItemsPerIteration(sequence.size());
+
+    ModifierFlags modifiers;
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        for (size_t k = 0; k < sequence.size(); k++)
+        {
+            modifiers.UpdateFromKey(sequence[k], down[k]);
+        }
+        DoNotOptimize(modifiers);
+    }
+    state.StopTiming();
+}
+
+// Auto-repeat of a key while Arg(0) keys are held: the engine's pressed-key
+// lookup and dedup, the most frequent event while a key is held down
+static void BenchPressedKeys(BenchState &state)
+{
+    DetectionEngine engine;
+    engine.SetLayouts(MakeLayouts(2));
+    engine.SetActiveLayoutFunction([]() { return 0; });
+
+    std::vector<uint32_t> held;
+    for (int64_t i = 0; i < state.Arg(); i++)
+    {
+        held.push_back(static_cast<uint32_t>(KC_F1 + i % 24));
+        engine.OnKeyDown(held.back());
+    }
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        engine.OnKeyDown(held.back());
+    }
+    state.StopTiming();
+    DoNotOptimize(engine.KeysProcessed());
+}
+
+// Composes Arg(0) keys in Arg(1) layouts from an empty word
+static void BenchCompose(BenchState &state)
+{
+    std::vector<LayoutTable> layouts = MakeLayouts(state.Arg(1));
+    std::vector<const LayoutTable *> tables;
+    for (const LayoutTable &layout : layouts)
+    {
+        tables.push_back(&layout);
+    }
+
+    TextComposer composer;
+    composer.SetLayouts(tables);
+    std::vector<KeyPressInfo> keys = MakeWordKeys(state.Arg(0));
+    state.SetItemsPerIteration(keys.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        composer.Reset();
+        for (const KeyPressInfo &key : keys)
+        {
+            composer.OnKey(key);
+        }
+        DoNotOptimize(composer.Text(0).size());
+    }
+    state.StopTiming();
+}
+
+// Validates an Arg(0)-character word in each of Arg(1) layouts
+static void BenchValidate(BenchState &state)
+{
+    DetectionEngine engine;
+    engine.SetLayouts(MakeLayouts(state.Arg(1)));
+
+    std::wstring english;
+    std::wstring hebrew;
+    for (int64_t i = 0; i < state.Arg(0); i++)
+    {
+        english += static_cast<wchar_t>(L'a' + i % 26);
+        hebrew += static_cast<wchar_t>(0x05D0 + i % 27);
+    }
+    state.SetItemsPerIteration(state.Arg(0) * state.Arg(1));
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        for (size_t layout = 0; layout < engine.LayoutCount(); layout++)
+        {
+            const std::wstring &text = engine.Layout(layout).LanguageId() == LAYOUT_LANG_HEBREW ? hebrew : english;
+            DoNotOptimize(engine.IsValidInLayout(text, layout));
+        }
+    }
+    state.StopTiming();
+}
+
+// Log file under the temp directory, shared by every log benchmark run
+static void InitializeBenchLogger()
+{
+    static bool initialized = false;
+    if (!initialized)
+    {
+        std::filesystem::path path = std::filesystem::temp_directory_path() / "keyboard_checker_bench" / "bench.log";
+        Logger::Instance().Initialize(path.wstring(), 64 * 1024 * 1024, 2, true, LOG_OVERFLOW_BLOCK);
+        initialized = true;
+    }
+}
+
+// One log call with an Arg(1)-character message at level Arg(0). DBG is
+// compiled out by MIN_LOG_LEVEL, so it measures the empty statement. The
+// writer is set to block, so the cost includes keeping up with the disk.
+// Rate limits are lifted so every line is written.
+static void BenchLog(BenchState &state)
+{
+    InitializeBenchLogger();
+    Logger::SetLevel(DBG);
+    LogLevel level = static_cast<LogLevel>(state.Arg(0));
+    LogRateLimit limit = LogRateLimiter::Limit(level);
+    Logger::SetRateLimit(level, {limit.burst, 0, limit.summaryMs});
+    std::wstring message(static_cast<size_t>(state.Arg(1)), L'x');
+    const wchar_t *text = message.c_str();
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        switch (state.Arg(0))
+        {
+        case DBG:
+            LOG(DBG, text);
+            break;
+        case INF:
+            LOG(INF, text);
+            break;
+        case WRN:
+            LOG(WRN, text);
+            break;
+        default:
+            LOG(ERR, text);
+            break;
+        }
+    }
+    state.StopTiming();
+    Logger::SetRateLimit(level, limit);
+}
+
+// A call site far over its rate limit, as in a message storm: the line is
+// counted for the next summary and the message is never built
+static void BenchLogSuppressed(BenchState &state)
+{
+    InitializeBenchLogger();
+    Logger::SetLevel(DBG);
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        LOG(INF, L"Window procedure " + std::to_wstring(i));
+    }
+    state.StopTiming();
+}
+
+// An enabled level turned off at runtime: one relaxed load per call
+static void BenchLogFiltered(BenchState &state)
+{
+    InitializeBenchLogger();
+    Logger::SetLevel(ERR);
+    std::wstring message(static_cast<size_t>(state.Arg(0)), L'x');
+    const wchar_t *text = message.c_str();
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        LOG(INF, text);
+    }
+    state.StopTiming();
+    Logger::SetLevel(DBG);
+}
+
+// Recording one latency sample, as done up to three times per keystroke
+static void BenchLatencyRecord(BenchState &state)
+{
+    static LatencyHistogram histogram;
+    uint64_t value = 1000;
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        histogram.Record(value);
+        value = value * 7 % 1000003;
+    }
+    state.StopTiming();
+    DoNotOptimize(histogram.Snapshot().count);
+}
+
+// Writes data under the bench temp directory and returns the path
+static std::filesystem::path WriteBenchFile(const char *name, const std::vector<uint8_t> &data)
+{
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "keyboard_checker_bench" / name;
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(), ec);
+    FILE *file = fopen(path.string().c_str(), "wb");
+    if (file)
+    {
+        fwrite(data.data(), 1, data.size(), file);
+        fclose(file);
+    }
+    return path;
+}
+
+// Key events typing words in the US layout: half English, half Hebrew typed
+// in the wrong layout, with shifted letters, backspaces, caret moves and
+// pauses long enough for idle checks. Timestamps step 80 ms per event.
+static std::vector<KeyEvent> MakeTypingStream(const LayoutTable &us, const LayoutTable &hebrew,
+                                              WordDictionaryBuilder &dictionary, NgramModelBuilder &model)
+{
+    static const char *words[] = {"HELLO", "AKUO", "WORLD", "TNUI", "THERE", "DKJ", "KEYBOARD", "EUPV",
+                                  "LAYOUT", "SCHO", "CHECK", "ANRI", "TYPING", "XCUI", "WORDS", "RTPE"};
+
+    std::vector<KeyEvent> events;
+    int64_t timestampUs = 1;
+    auto press = [&](uint32_t vkCode)
+    {
+        KeyEvent event = {};
+        event.vkCode = static_cast<uint16_t>(vkCode);
+        event.timestampUs = timestampUs;
+        events.push_back(event);
+        event.flags = KEY_EVENT_UP;
+        event.timestampUs = timestampUs + 40000;
+        events.push_back(event);
+        timestampUs += 80000;
+    };
+
+    std::wstring englishText;
+    std::wstring hebrewText;
+    for (size_t w = 0; w < sizeof(words) / sizeof(words[0]); w++)
+    {
+        std::wstring english;
+        std::wstring translated;
+        for (const char *key = words[w]; *key; key++)
+        {
+            english += us.Lookup(static_cast<uint32_t>(*key), ModifierFlags());
+            translated += hebrew.Lookup(static_cast<uint32_t>(*key), ModifierFlags());
+        }
+        if (w % 2 == 0)
+        {
+            dictionary.AddWord(LAYOUT_LANG_ENGLISH, english);
+            englishText += english + L" ";
+        }
+        else
+        {
+            dictionary.AddWord(LAYOUT_LANG_HEBREW, translated);
+            hebrewText += translated + L" ";
+        }
+
+        for (size_t i = 0; words[w][i]; i++)
+        {
+            if (i == 0 && w % 3 == 0)
+            {
+                KeyEvent shift = {};
+                shift.vkCode = static_cast<uint16_t>(KC_LSHIFT);
+                shift.timestampUs = timestampUs;
+                events.push_back(shift);
+                press(static_cast<uint32_t>(words[w][i]));
+                shift.flags = KEY_EVENT_UP;
+                shift.timestampUs = timestampUs;
+                events.push_back(shift);
+                continue;
+            }
+            press(static_cast<uint32_t>(words[w][i]));
+        }
+        if (w % 4 == 1)
+        {
+            press(KC_BACK);
+            press(static_cast<uint32_t>(words[w][strlen(words[w]) - 1]));
+        }
+        if (w % 5 == 2)
+        {
+            timestampUs += DEFAULT_IDLE_CHECK_US + 100000;
+        }
+        press(w % 7 == 6 ? KC_RETURN : KC_SPACE);
+        if (w % 8 == 7)
+        {
+            press(KC_LEFT);
+        }
+    }
+    model.AddText(LAYOUT_LANG_ENGLISH, englishText);
+    model.AddText(LAYOUT_LANG_HEBREW, hebrewText);
+    return events;
+}
+
+// The whole per-keystroke path, ProcessEvents through the report handlers,
+// with a model, a dictionary and an enabled log. After one warm-up pass it
+// must not allocate: the run fails if a timed pass does.
+static void BenchSteadyState(BenchState &state)
+{
+    InitializeBenchLogger();
+    Logger::SetLevel(DBG);
+
+    LayoutTable us = LayoutTable::UsQwerty();
+    LayoutTable hebrew = LayoutTable::HebrewSi1452();
+    WordDictionaryBuilder dictionary;
+    NgramModelBuilder model;
+    std::vector<KeyEvent> events = MakeTypingStream(us, hebrew, dictionary, model);
+
+    DetectionEngine engine;
+    engine.SetLayouts({us, hebrew});
+    engine.LoadModel(WriteBenchFile("steady_state.kbng", model.Build()));
+    engine.LoadDictionary(WriteBenchFile("steady_state.kbdw", dictionary.Build()));
+    engine.SetActiveLayoutFunction([]() { return 0; });
+
+    size_t textLength = 0;
+    size_t reported = 0;
+    engine.SetTextHandler([&textLength](std::wstring_view text) { textLength += text.size(); });
+    engine.SetWrongLayoutHandler([&reported](const WrongLayoutReport &report)
+    {
+        reported += report.conversions[report.bestAlternative].size();
+    });
+
+    // Each pass continues the timeline, so pending idle checks come due the same way
+    int64_t passUs = events.back().timestampUs + DEFAULT_IDLE_CHECK_US;
+    auto runPass = [&](int64_t offsetUs)
+    {
+        for (KeyEvent event : events)
+        {
+            event.timestampUs += offsetUs;
+            engine.ProcessEvents(&event, 1);
+        }
+    };
+    runPass(0);
+    state.SetItemsPerIteration(events.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        runPass(static_cast<int64_t>(i + 1) * passUs);
+    }
+    state.StopTiming();
+    DoNotOptimize(textLength + reported);
+
+    if (state.Allocations() != 0 || engine.WrongLayoutCount() == 0)
+    {
+        fprintf(stderr, "steady_state: %llu allocations in %llu passes after warm-up, %llu wrong-layout words\n",
+                static_cast<unsigned long long>(state.Allocations()),
+                static_cast<unsigned long long>(state.Iterations()),
+                static_cast<unsigned long long>(engine.WrongLayoutCount()));
+        exit(1);
+    }
+}
+
+BENCHMARK("steady_state", BenchSteadyState, 0);
+BENCHMARK("latency_record", BenchLatencyRecord, 0);
+BENCHMARK_RANGE("modifier_update", BenchModifierUpdate, "len", BENCH_ARGS(16, 256));
+BENCHMARK_RANGE("pressed_keys", BenchPressedKeys, "held", BENCH_ARGS(1, 4, 16));
+BENCHMARK_GRID("compose", BenchCompose, "len", BENCH_ARGS(8, 32), "layouts", BENCH_ARGS(2, 4, 8));
+BENCHMARK_GRID("validate", BenchValidate, "len", BENCH_ARGS(8, 64, 512), "layouts", BENCH_ARGS(2, 4));
+BENCHMARK_GRID("log", BenchLog, "level", BENCH_ARGS(DBG, INF, WRN, ERR), "len", BENCH_ARGS(16, 128));
+BENCHMARK_RANGE("log_filtered", BenchLogFiltered, "len", BENCH_ARGS(16, 128));
+BENCHMARK("log_suppressed", BenchLogSuppressed, 0);
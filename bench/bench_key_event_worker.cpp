@@ -0,0 +1,56 @@
+#include "bench.h"
+#include "key_event_worker.h"
+#include <cstdio>
+#include <cstdlib>
+
+// Synthetic events posted per iteration
+const uint64_t BENCH_EVENTS_PER_ITERATION = 1024;
+
+// Posts millions of events through a worker with a queue of Arg() slots,
+// retrying when full, and checks every event arrives once and in order
+static void BenchKeyEventWorker(BenchState &state)
+{
+    KeyEventWorker worker(static_cast<size_t>(state.Arg()));
+    uint64_t expected = 0;
+    uint64_t outOfOrder = 0;
+    worker.Start([&](const KeyEvent *events, size_t count)
+                 {
+                     for (size_t i = 0; i < count; i++)
+                     {
+                         if (static_cast<uint64_t>(events[i].timestampUs) != expected)
+                         {
+                             outOfOrder++;
+                         }
+                         expected = static_cast<uint64_t>(events[i].timestampUs) + 1;
+                     }
+                 });
+
+    const uint64_t total = state.Iterations() * BENCH_EVENTS_PER_ITERATION;
+    state.SetItemsPerIteration(BENCH_EVENTS_PER_ITERATION);
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < total; i++)
+    {
+        KeyEvent event = {};
+        event.vkCode = static_cast<uint16_t>('A' + i % 26);
+        event.flags = (i & 1) ? KEY_EVENT_UP : 0;
+        event.timestampUs = static_cast<int64_t>(i);  // Sequence number, to check ordering
+        while (!worker.Post(event))
+        {
+            std::this_thread::yield();
+        }
+    }
+    worker.Stop();
+    state.StopTiming();
+
+    if (outOfOrder != 0 || expected != total || worker.ProcessedCount() != total)
+    {
+        fprintf(stderr, "key_event_worker: %llu of %llu events processed, %llu out of order\n",
+                static_cast<unsigned long long>(worker.ProcessedCount()), static_cast<unsigned long long>(total),
+                static_cast<unsigned long long>(outOfOrder));
+        exit(1);
+    }
+}
+
+BENCHMARK("key_event_worker/queue:64", BenchKeyEventWorker, 64);
+BENCHMARK("key_event_worker/queue:4096", BenchKeyEventWorker, 4096);
@@ -0,0 +1,103 @@
+#include "bench.h"
+#include "layout_pack.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <vector>
+
+static bool SameTable(const LayoutTable &a, const LayoutTable &b)
+{
+    if (a.LanguageId() != b.LanguageId() || a.Name() != b.Name() ||
+        a.DeadKeyCombos().size() != b.DeadKeyCombos().size())
+    {
+        return false;
+    }
+    for (uint32_t vk = 0; vk < LayoutTable::KEY_COUNT; vk++)
+    {
+        for (uint8_t s = 0; s < LSS_COUNT; s++)
+        {
+            const LayoutEntry &x = a.Entry(vk, static_cast<LayoutShiftState>(s));
+            const LayoutEntry &y = b.Entry(vk, static_cast<LayoutShiftState>(s));
+            if (x.ch != y.ch || x.flags != y.flags)
+            {
+                return false;
+            }
+        }
+    }
+    for (size_t i = 0; i < a.DeadKeyCombos().size(); i++)
+    {
+        const DeadKeyCombo &x = a.DeadKeyCombos()[i];
+        const DeadKeyCombo &y = b.DeadKeyCombos()[i];
+        if (x.dead != y.dead || x.base != y.base || x.result != y.result)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Startup from a pack of Arg() layouts: map, verify the checksum and copy
+// every table out. Fails the run if a table comes back different.
+static void BenchLayoutPackLoad(BenchState &state)
+{
+    // Dead keys on one layout so combos are part of the round trip
+    LayoutTable withDeadKeys = LayoutTable::UsQwerty();
+    withDeadKeys.Set(KC_OEM_7, LSS_ALTGR, L'\'', LAYOUT_ENTRY_DEAD);
+    const wchar_t acute[][2] = {{L'a', 0xE1}, {L'e', 0xE9}, {L'i', 0xED}, {L'o', 0xF3}, {L'u', 0xFA}};
+    for (const auto &combo : acute)
+    {
+        withDeadKeys.AddDeadKeyCombo(L'\'', combo[0], combo[1]);
+    }
+
+    std::vector<LayoutTable> tables;
+    std::vector<uintptr_t> systemIds;
+    LayoutPackBuilder builder;
+    for (int64_t i = 0; i < state.Arg(); i++)
+    {
+        tables.push_back(i % 3 == 0 ? withDeadKeys : i % 3 == 1 ? LayoutTable::HebrewSi1452() : LayoutTable::UsQwerty());
+        systemIds.push_back(static_cast<uintptr_t>(0x04090409 + i));
+        builder.Add(tables.back(), systemIds.back());
+    }
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "keyboard_checker_bench.kblp";
+    if (!builder.Write(path))
+    {
+        state.Skip();
+        return;
+    }
+
+    std::vector<LayoutTable> loaded;
+    bool matched = true;
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        LayoutPack pack;
+        loaded.clear();
+        if (!pack.Load(path) || !pack.Matches(systemIds))
+        {
+            matched = false;
+            break;
+        }
+        for (size_t l = 0; l < pack.LayoutCount(); l++)
+        {
+            loaded.push_back(pack.Layout(l));
+        }
+        DoNotOptimize(loaded.data());
+    }
+    state.StopTiming();
+    state.SetItemsPerIteration(static_cast<uint64_t>(state.Arg()));
+
+    for (size_t i = 0; matched && i < tables.size(); i++)
+    {
+        matched = i < loaded.size() && SameTable(tables[i], loaded[i]);
+    }
+    std::error_code ec;
+    std::filesystem::remove(path, ec);
+    if (!matched)
+    {
+        fprintf(stderr, "layout_pack_load: pack did not load back the tables it was built from\n");
+        exit(1);
+    }
+}
+
+BENCHMARK_RANGE("layout_pack_load", BenchLayoutPackLoad, "layouts", BENCH_ARGS(2, 8));
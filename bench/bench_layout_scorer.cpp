@@ -0,0 +1,64 @@
+#include "bench.h"
+#include "layout_scorer.h"
+#include <cstdlib>
+
+// Keystrokes scored per iteration
+const size_t BENCH_SCORE_KEYS = 256;
+
+// Small sample model, enough to fill the tables the way a real one does
+static const NgramModel &SampleModel()
+{
+    static std::vector<uint8_t> data;
+    static NgramModel model;
+    if (data.empty())
+    {
+        NgramModelBuilder builder;
+        builder.AddText(LAYOUT_LANG_ENGLISH, L"the quick brown fox jumps over the lazy dog while "
+                                             L"keyboard layouts switch and people keep typing words");
+        builder.AddText(LAYOUT_LANG_HEBREW, L"שלום עולם הטקסט הזה נכתב בעברית כדי לבדוק את "
+                                            L"המודל של פריסות המקלדת השונות");
+        data = builder.Build();
+        model.LoadFromMemory(data.data(), data.size());
+    }
+    return model;
+}
+
+// Feeds keys to a scorer over Arg() layouts, cycling the built-in tables
+static void BenchLayoutScore(BenchState &state)
+{
+    static const LayoutTable us = LayoutTable::UsQwerty();
+    static const LayoutTable hebrew = LayoutTable::HebrewSi1452();
+    static const uint32_t keys[] = {'A', 'K', 'U', 'O', 'X', 'T', 'E', 'S', 'Q', 'L', 'H', 'N', KC_SPACE};
+
+    std::vector<const LayoutTable *> layouts;
+    for (int64_t i = 0; i < state.Arg(); i++)
+    {
+        layouts.push_back(i % 2 == 0 ? &us : &hebrew);
+    }
+
+    LayoutScorer scorer;
+    scorer.SetLayouts(layouts, SampleModel());
+
+    std::vector<KeyPressInfo> sequence;
+    srand(1);
+    for (size_t i = 0; i < BENCH_SCORE_KEYS; i++)
+    {
+        sequence.push_back(KeyPressInfo(keys[rand() % (sizeof(keys) / sizeof(keys[0]))], ModifierFlags()));
+    }
+    state.SetItemsPerIteration(sequence.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        for (const KeyPressInfo &key : sequence)
+        {
+            scorer.OnKey(key);
+        }
+        DoNotOptimize(scorer.Cost(0));
+    }
+    state.StopTiming();
+}
+
+BENCHMARK("layout_score/layouts:2", BenchLayoutScore, 2);
+BENCHMARK("layout_score/layouts:4", BenchLayoutScore, 4);
+BENCHMARK("layout_score/layouts:8", BenchLayoutScore, 8);
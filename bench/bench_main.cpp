@@ -0,0 +1,148 @@
+#include "bench.h"
+#include <cstdio>
+#include <cstring>
+
+// Shortest timed run that counts as a measurement
+const int64_t BENCH_MIN_TIME_NS = 200000000;
+
+const uint64_t BENCH_MAX_ITERATIONS = 1000000000;
+
+struct BenchResult
+{
+    const BenchDefinition *bench;
+    bool skipped;
+    uint64_t iterations;
+    double nsPerIteration;
+    double nsPerItem;
+    double allocationsPerIteration;
+};
+
+static BenchResult RunBenchmark(const BenchDefinition &bench)
+{
+    uint64_t iterations = 1;
+    for (;;)
+    {
+        BenchState state(iterations, bench.args[0], bench.args[1]);
+        bench.function(state);
+        if (state.Skipped())
+        {
+            return {&bench, true, 0, 0.0, 0.0, 0.0};
+        }
+
+        int64_t elapsed = state.ElapsedNs();
+        if (elapsed >= BENCH_MIN_TIME_NS || iterations >= BENCH_MAX_ITERATIONS)
+        {
+            double nsPerIteration = static_cast<double>(elapsed) / static_cast<double>(iterations);
+            return {&bench, false, iterations, nsPerIteration,
+                    nsPerIteration / static_cast<double>(state.ItemsPerIteration()),
+                    static_cast<double>(state.Allocations()) / static_cast<double>(iterations)};
+        }
+
+        // Aim past the minimum time, growing at most 10x per round
+        uint64_t next = elapsed > 0 ? static_cast<uint64_t>(iterations * 1.4 * BENCH_MIN_TIME_NS / elapsed)
+                                    : iterations * 10;
+        if (next > iterations * 10)
+        {
+            next = iterations * 10;
+        }
+        iterations = next > iterations ? next : iterations + 1;
+    }
+}
+
+static void PrintTableRow(const BenchResult &result)
+{
+    if (result.skipped)
+    {
+        printf("%-48s %12s\n", result.bench->name.c_str(), "skipped");
+        return;
+    }
+    printf("%-48s %12llu %14.1f %12.2f %12.2f\n", result.bench->name.c_str(),
+           static_cast<unsigned long long>(result.iterations), result.nsPerIteration, result.nsPerItem,
+           result.allocationsPerIteration);
+    fflush(stdout);
+}
+
+// One object per benchmark; names only contain [A-Za-z0-9_/:.-], so no escaping
+static void PrintJsonResult(const BenchResult &result, bool last)
+{
+    const BenchDefinition &bench = *result.bench;
+    printf("    {\"name\": \"%s\", \"args\": {", bench.name.c_str());
+    bool first = true;
+    for (size_t i = 0; i < BENCH_MAX_ARGS; i++)
+    {
+        if (bench.argNames[i])
+        {
+            printf("%s\"%s\": %lld", first ? "" : ", ", bench.argNames[i], static_cast<long long>(bench.args[i]));
+            first = false;
+        }
+    }
+    if (result.skipped)
+    {
+        printf("}, \"skipped\": true}");
+    }
+    else
+    {
+        printf("}, \"skipped\": false, \"iterations\": %llu, \"ns_per_iteration\": %.3f, \"ns_per_item\": %.3f, "
+               "\"allocs_per_iteration\": %.3f}",
+               static_cast<unsigned long long>(result.iterations), result.nsPerIteration, result.nsPerItem,
+               result.allocationsPerIteration);
+    }
+    printf("%s\n", last ? "" : ",");
+}
+
+int main(int argc, char **argv)
+{
+    // --json writes machine-readable results; any other argument is a filter
+    // that only runs benchmarks whose name contains it
+    bool json = false;
+    const char *filter = nullptr;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--json") == 0)
+        {
+            json = true;
+        }
+        else
+        {
+            filter = argv[i];
+        }
+    }
+
+    if (!json)
+    {
+        printf("%-48s %12s %14s %12s %12s\n", "benchmark", "iterations", "ns/iteration", "ns/item", "allocs/iter");
+    }
+
+    std::vector<BenchResult> results;
+    for (const BenchDefinition &bench : BenchRegistry())
+    {
+        if (filter && !strstr(bench.name.c_str(), filter))
+        {
+            continue;
+        }
+        results.push_back(RunBenchmark(bench));
+        if (!json)
+        {
+            PrintTableRow(results.back());
+        }
+    }
+
+    if (json)
+    {
+        printf("{\n  \"benchmarks\": [\n");
+        for (size_t i = 0; i < results.size(); i++)
+        {
+            PrintJsonResult(results[i], i + 1 == results.size());
+        }
+        printf("  ]\n}\n");
+    }
+
+    // ctest runs benchmarks that check themselves by name, so a filter that
+    // matches nothing must not pass
+    if (results.empty())
+    {
+        fprintf(stderr, "No benchmark matches %s\n", filter ? filter : "");
+        return 1;
+    }
+    return 0;
+}
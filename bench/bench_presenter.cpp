@@ -0,0 +1,107 @@
+#include "bench.h"
+#include "presenter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+// Counts flushes the way the text window would see them, without keeping them
+class CountingBackend : public PresenterBackend
+{
+public:
+    CountingBackend() : m_frames(0), m_length(0) {}
+
+    void Present(const PresenterView &view, int64_t) override
+    {
+        m_frames++;
+        m_length = view.text.size();
+    }
+
+    uint64_t m_frames;
+    size_t m_length;
+};
+
+// A typing burst with Arg() microseconds between keys, presented in
+// simulated time the way the UI thread does it: a wake on the first change,
+// then the frame timer. Fails the run if a pass after warm-up allocates, if
+// two flushes share a frame, if keys slower than the frame rate are not
+// each shown, or if the last text is not shown.
+static void BenchPresenterBurst(BenchState &state)
+{
+    const size_t KEYS = 1000;
+    const size_t WORD = 12;
+    int64_t intervalUs = state.Arg();
+
+    CountingBackend backend;
+    Presenter presenter(backend);
+    int64_t frameUs = presenter.Policy().frameUs;
+    std::wstring text;
+    text.reserve(WORD);
+    int64_t nowUs = 1;
+    int64_t dueUs = -1;
+    int64_t lastFlushUs = -frameUs;
+    uint64_t frames = 0;
+    uint64_t sameFrame = 0;
+
+    // Runs the frame timer up to limitUs
+    auto presentUntil = [&](int64_t limitUs)
+    {
+        while (dueUs >= 0 && dueUs <= limitUs)
+        {
+            int64_t delayUs = presenter.Tick(dueUs);
+            if (backend.m_frames != frames)
+            {
+                sameFrame += dueUs - lastFlushUs < frameUs;
+                frames = backend.m_frames;
+                lastFlushUs = dueUs;
+            }
+            dueUs = delayUs >= 0 ? dueUs + delayUs : -1;
+        }
+    };
+    auto runPass = [&]()
+    {
+        for (size_t i = 0; i < KEYS; i++)
+        {
+            presentUntil(nowUs);
+
+            // Words grow a key at a time, then start over
+            if (text.size() == WORD)
+            {
+                text.clear();
+            }
+            text.push_back(static_cast<wchar_t>(L'a' + i % 26));
+            if (presenter.SetText(text, nowUs) && dueUs < 0)
+            {
+                dueUs = nowUs;
+            }
+            nowUs += intervalUs;
+        }
+        presentUntil(nowUs + frameUs);
+    };
+
+    runPass();
+    uint64_t warmUpFrames = frames;
+    state.SetItemsPerIteration(KEYS);
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        runPass();
+    }
+    state.StopTiming();
+    DoNotOptimize(backend.m_length);
+
+    uint64_t shown = frames - warmUpFrames;
+    uint64_t expected = intervalUs >= frameUs ? KEYS * state.Iterations() : 0;
+    if (state.Allocations() != 0 || sameFrame != 0 || (expected != 0 && shown != expected) ||
+        presenter.Shown().text != text)
+    {
+        fprintf(stderr, "presenter_burst: %llu allocations, %llu flushes in one frame, %llu of %llu keys shown, "
+                        "last text %s\n",
+                static_cast<unsigned long long>(state.Allocations()), static_cast<unsigned long long>(sameFrame),
+                static_cast<unsigned long long>(shown), static_cast<unsigned long long>(KEYS * state.Iterations()),
+                presenter.Shown().text == text ? "shown" : "not shown");
+        exit(1);
+    }
+}
+
+BENCHMARK_RANGE("presenter_burst", BenchPresenterBurst, "key_us", BENCH_ARGS(2000, 10000, 50000));
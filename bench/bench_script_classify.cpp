@@ -0,0 +1,62 @@
+#include "bench.h"
+#include "script_classify.h"
+#include <string>
+
+// Mixed Hebrew and ASCII text that is valid throughout, so the whole buffer is scanned
+static std::wstring MakeValidText(size_t bytes)
+{
+    static const wchar_t sample[] = L"שלום world, זהו טקסט לדוגמה\r\nmixed text 123 ";
+    std::wstring text;
+    size_t units = bytes / sizeof(wchar_t);
+    while (text.size() < units)
+    {
+        text += sample;
+    }
+    text.resize(units);
+    return text;
+}
+
+static void BenchClassify(BenchState &state, ScriptKernel kernel)
+{
+    if (!IsScriptKernelSupported(kernel))
+    {
+        state.Skip();
+        return;
+    }
+
+    std::wstring text = MakeValidText(static_cast<size_t>(state.Arg()));
+    const unsigned allowed = SCRIPT_CLASS_WHITESPACE | SCRIPT_CLASS_ASCII | SCRIPT_CLASS_HEBREW;
+    state.SetItemsPerIteration(text.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        DoNotOptimize(FindFirstOutsideClasses(text.data(), text.size(), allowed, kernel));
+    }
+    state.StopTiming();
+}
+
+static void BenchClassifyScalar(BenchState &state)
+{
+    BenchClassify(state, SCRIPT_KERNEL_SCALAR);
+}
+
+static void BenchClassifySse2(BenchState &state)
+{
+    BenchClassify(state, SCRIPT_KERNEL_SSE2);
+}
+
+static void BenchClassifyAvx2(BenchState &state)
+{
+    BenchClassify(state, SCRIPT_KERNEL_AVX2);
+}
+
+BENCHMARK("script_classify/scalar/bytes:1K", BenchClassifyScalar, 1 << 10);
+BENCHMARK("script_classify/scalar/bytes:64K", BenchClassifyScalar, 64 << 10);
+BENCHMARK("script_classify/scalar/bytes:1M", BenchClassifyScalar, 1 << 20);
+BENCHMARK("script_classify/sse2/bytes:1K", BenchClassifySse2, 1 << 10);
+BENCHMARK("script_classify/sse2/bytes:64K", BenchClassifySse2, 64 << 10);
+BENCHMARK("script_classify/sse2/bytes:1M", BenchClassifySse2, 1 << 20);
+BENCHMARK("script_classify/avx2/bytes:1K", BenchClassifyAvx2, 1 << 10);
+BENCHMARK("script_classify/avx2/bytes:64K", BenchClassifyAvx2, 64 << 10);
+BENCHMARK("script_classify/avx2/bytes:1M", BenchClassifyAvx2, 1 << 20);
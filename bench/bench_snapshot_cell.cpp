@@ -0,0 +1,131 @@
+#include "bench.h"
+#include "snapshot_cell.h"
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+// Values per published version, enough that a torn or freed read shows
+const size_t BENCH_SNAPSHOT_VALUES = 64;
+
+static std::atomic<int64_t> s_liveVersions(0);
+
+// Every value derives from the version; the destructor overwrites them, so
+// a reader that gets a freed version sees a mismatch
+struct BenchVersion
+{
+    explicit BenchVersion(uint64_t number)
+        : version(number), values(BENCH_SNAPSHOT_VALUES)
+    {
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            values[i] = number * 31 + i;
+        }
+        s_liveVersions.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    ~BenchVersion()
+    {
+        for (uint64_t &value : values)
+        {
+            value = 0xDEADDEADDEADDEADull;
+        }
+        version = 0;
+        s_liveVersions.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool IsIntact() const
+    {
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            if (values[i] != version * 31 + i)
+            {
+                return false;
+            }
+        }
+        return version != 0;
+    }
+
+    uint64_t version;
+    std::vector<uint64_t> values;
+};
+
+// One reader taking and dropping the current version, as the key worker
+// does once per batch
+static void BenchSnapshotRead(BenchState &state)
+{
+    SnapshotCell<BenchVersion> cell;
+    cell.Publish(std::unique_ptr<BenchVersion>(new BenchVersion(1)));
+    SnapshotCell<BenchVersion>::Reader reader(cell);
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        SnapshotCell<BenchVersion>::ReadLock lock(reader);
+        DoNotOptimize(lock->version);
+    }
+    state.StopTiming();
+}
+
+// Publishes a new version per iteration while Arg() threads read and check
+// versions nonstop. Fails the run if a reader ever sees a freed or torn
+// version, if versions go backwards for a reader, or if anything leaks.
+static void BenchSnapshotPublish(BenchState &state)
+{
+    SnapshotCell<BenchVersion> cell;
+    cell.Publish(std::unique_ptr<BenchVersion>(new BenchVersion(1)));
+
+    std::atomic<bool> stop(false);
+    std::atomic<uint64_t> reads(0);
+    std::atomic<uint64_t> failures(0);
+    std::vector<std::thread> readers;
+    for (int64_t r = 0; r < state.Arg(); r++)
+    {
+        readers.emplace_back([&]()
+        {
+            SnapshotCell<BenchVersion>::Reader reader(cell);
+            uint64_t lastVersion = 0;
+            uint64_t count = 0;
+            while (!stop.load(std::memory_order_relaxed))
+            {
+                SnapshotCell<BenchVersion>::ReadLock lock(reader);
+                if (!lock || !lock->IsIntact() || lock->version < lastVersion)
+                {
+                    failures.fetch_add(1, std::memory_order_relaxed);
+                }
+                else
+                {
+                    lastVersion = lock->version;
+                }
+                count++;
+            }
+            reads.fetch_add(count, std::memory_order_relaxed);
+        });
+    }
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        cell.Publish(std::unique_ptr<BenchVersion>(new BenchVersion(i + 2)));
+    }
+    state.StopTiming();
+
+    stop.store(true, std::memory_order_relaxed);
+    for (std::thread &reader : readers)
+    {
+        reader.join();
+    }
+    cell.Reclaim();
+
+    if (failures.load() != 0 || cell.RetiredCount() != 0 || s_liveVersions.load() != 1)
+    {
+        fprintf(stderr, "snapshot_publish: %llu bad reads of %llu, %zu versions not reclaimed, %lld live\n",
+                static_cast<unsigned long long>(failures.load()), static_cast<unsigned long long>(reads.load()),
+                cell.RetiredCount(), static_cast<long long>(s_liveVersions.load()));
+        exit(1);
+    }
+}
+
+BENCHMARK("snapshot_read", BenchSnapshotRead, 0);
+BENCHMARK_RANGE("snapshot_publish", BenchSnapshotPublish, "readers", BENCH_ARGS(1, 4, 16));
@@ -0,0 +1,77 @@
+#include "bench.h"
+#include "span_trace.h"
+#include <cstdio>
+#include <cstdlib>
+
+static uint64_t s_spanWork = 0;
+
+static void SpannedFunction()
+{
+    TRACE_SPAN("bench");
+    s_spanWork++;
+}
+
+static void NestedSpans()
+{
+    TRACE_SPAN_NAMED("outer", "bench");
+    SpannedFunction();
+}
+
+// A span while tracing is off: the cost every instrumented function pays
+static void BenchSpanDisabled(BenchState &state)
+{
+    SpanTrace::Instance().Disable();
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        SpannedFunction();
+    }
+    state.StopTiming();
+    DoNotOptimize(s_spanWork);
+}
+
+// Two nested spans while tracing. Buffers are emptied outside the timed
+// part before they fill; fails the run if a span is lost or nests wrongly.
+static void BenchSpanEnabled(BenchState &state)
+{
+    SpanTrace &trace = SpanTrace::Instance();
+    trace.Enable();
+    trace.Clear();
+    SpanBuffer &buffer = trace.ThreadBuffer();
+    bool nested = true;
+
+    state.SetItemsPerIteration(2);
+    uint64_t done = 0;
+    while (done < state.Iterations())
+    {
+        uint64_t batch = std::min<uint64_t>(state.Iterations() - done, SPAN_BUFFER_EVENTS / 2);
+        state.StartTiming();
+        for (uint64_t i = 0; i < batch; i++)
+        {
+            NestedSpans();
+        }
+        state.StopTiming();
+
+        // Inner span closes first, one level deeper
+        for (size_t e = 0; nested && e < buffer.Count(); e += 2)
+        {
+            nested = buffer.Event(e).depth == 1 && buffer.Event(e + 1).depth == 0 &&
+                     buffer.Event(e).beginTicks >= buffer.Event(e + 1).beginTicks &&
+                     buffer.Event(e).endTicks <= buffer.Event(e + 1).endTicks;
+        }
+        if (!nested || buffer.Count() != batch * 2 || buffer.Dropped() != 0)
+        {
+            fprintf(stderr, "span_enabled: %zu spans for %llu calls, %llu dropped, nesting %s\n", buffer.Count(),
+                    static_cast<unsigned long long>(batch), static_cast<unsigned long long>(buffer.Dropped()),
+                    nested ? "ok" : "wrong");
+            exit(1);
+        }
+        trace.Clear();
+        done += batch;
+    }
+    trace.Disable();
+    DoNotOptimize(s_spanWork);
+}
+
+BENCHMARK("span_disabled", BenchSpanDisabled, 0);
+BENCHMARK("span_enabled", BenchSpanEnabled, 0);
@@ -0,0 +1,117 @@
+#include "bench.h"
+#include "layout_table.h"
+#include "word_dictionary.h"
+#include <cstdlib>
+#include <map>
+
+// Lookups per iteration
+const size_t BENCH_LOOKUP_WORDS = 1024;
+
+// Arg() random lowercase words of 3 to 10 letters, the same list on every call
+static const std::vector<std::wstring> &SampleWords(int64_t count)
+{
+    static std::map<int64_t, std::vector<std::wstring>> cache;
+    std::vector<std::wstring> &words = cache[count];
+    if (words.empty())
+    {
+        srand(1);
+        for (int64_t i = 0; i < count; i++)
+        {
+            std::wstring word(3 + rand() % 8, L'a');
+            for (wchar_t &ch : word)
+            {
+                ch = static_cast<wchar_t>(L'a' + rand() % 26);
+            }
+            words.push_back(word);
+        }
+    }
+    return words;
+}
+
+// Dictionary file built from SampleWords, kept for the whole run since
+// building the larger ones takes a while
+static const std::vector<uint8_t> &SampleDictionary(int64_t count)
+{
+    static std::map<int64_t, std::vector<uint8_t>> cache;
+    std::vector<uint8_t> &data = cache[count];
+    if (data.empty())
+    {
+        WordDictionaryBuilder builder;
+        for (const std::wstring &word : SampleWords(count))
+        {
+            builder.AddWord(LAYOUT_LANG_ENGLISH, word);
+        }
+        data = builder.Build();
+    }
+    return data;
+}
+
+static void RunLookups(BenchState &state, const std::vector<std::wstring> &queries)
+{
+    const std::vector<uint8_t> &data = SampleDictionary(state.Arg());
+    WordDictionary dictionary;
+    if (!dictionary.LoadFromMemory(data.data(), data.size()))
+    {
+        state.Skip();
+        return;
+    }
+    const WordDictionaryLanguage *language = dictionary.FindLanguage(LAYOUT_LANG_ENGLISH);
+    state.SetItemsPerIteration(queries.size());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        size_t found = 0;
+        for (const std::wstring &query : queries)
+        {
+            found += language->Contains(query);
+        }
+        DoNotOptimize(found);
+    }
+    state.StopTiming();
+}
+
+// Words from a dictionary of Arg() words, spread over the whole list
+static void BenchDictionaryHit(BenchState &state)
+{
+    const std::vector<std::wstring> &words = SampleWords(state.Arg());
+    std::vector<std::wstring> queries;
+    for (size_t i = 0; i < BENCH_LOOKUP_WORDS; i++)
+    {
+        queries.push_back(words[(i * 7919) % words.size()]);
+    }
+    RunLookups(state, queries);
+}
+
+// Near misses: dictionary words with the last letter changed, so most of the
+// path is walked before the lookup fails
+static void BenchDictionaryMiss(BenchState &state)
+{
+    const std::vector<std::wstring> &words = SampleWords(state.Arg());
+    std::vector<std::wstring> queries;
+    for (size_t i = 0; i < BENCH_LOOKUP_WORDS; i++)
+    {
+        std::wstring word = words[(i * 7919) % words.size()];
+        word.back() = word.back() == L'z' ? L'a' : static_cast<wchar_t>(word.back() + 1);
+        queries.push_back(word);
+    }
+    RunLookups(state, queries);
+}
+
+// Opening a dictionary already in memory: header checks only, nothing is parsed
+static void BenchDictionaryLoad(BenchState &state)
+{
+    const std::vector<uint8_t> &data = SampleDictionary(state.Arg());
+
+    state.StartTiming();
+    for (uint64_t i = 0; i < state.Iterations(); i++)
+    {
+        WordDictionary dictionary;
+        DoNotOptimize(dictionary.LoadFromMemory(data.data(), data.size()));
+    }
+    state.StopTiming();
+}
+
+BENCHMARK_RANGE("dict_hit", BenchDictionaryHit, "words", BENCH_ARGS(10000, 500000));
+BENCHMARK_RANGE("dict_miss", BenchDictionaryMiss, "words", BENCH_ARGS(10000, 500000));
+BENCHMARK_RANGE("dict_load", BenchDictionaryLoad, "words", BENCH_ARGS(10000, 500000));
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+#include <vector>
+#include "key_event.h"
+#include "layout_table.h"
+
+// Renders one keystroke sequence in every layout in a single pass.
+// Output is structure-of-arrays: one contiguous lane per layout, all sized
+// for the whole sequence up front, so a key costs one table lookup per layout
+// with no hashing and no per-layout string growth.
+class BatchConverter
+{
+public:
+    BatchConverter();
+
+    // Layouts must outlive the converter
+    void SetLayouts(const std::vector<const LayoutTable *> &layouts);
+    size_t LayoutCount() const { return m_layouts.size(); }
+
+    // Converts keys; afterwards Lane(i) holds the rendering in layout i.
+    // Keys that produce no text in a layout are skipped in that lane, and a
+    // dead key combines with the key after it.
+    void Convert(const KeyPressInfo *keys, size_t count);
+
+    void Convert(const std::vector<KeyPressInfo> &keys)
+    {
+        Convert(keys.data(), keys.size());
+    }
+
+    std::wstring_view Lane(size_t layoutIndex) const
+    {
+        return std::wstring_view(m_lanes.data() + layoutIndex * m_stride, m_lengths[layoutIndex]);
+    }
+
+private:
+    std::vector<const LayoutTable *> m_layouts;
+    std::vector<wchar_t> m_lanes;    // LayoutCount() lanes of m_stride characters
+    std::vector<size_t> m_lengths;
+    std::vector<wchar_t> m_pendingDead;
+    size_t m_stride;
+};
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "key_event.h"
+#include "layout_table.h"
+#include "text_composer.h"
+#include "batch_converter.h"
+#include "ngram_model.h"
+#include "layout_scorer.h"
+#include "key_trace.h"
+#include "word_dictionary.h"
+#include "detection_scheduler.h"
+#include "event_arena.h"
+
+// Shortest word, in keys, that is checked at a word boundary
+const size_t DEFAULT_MIN_TEXT_LENGTH = 3;
+
+// A finished word that does not fit the layout it was typed in. The text
+// points into the engine and is valid only during the handler call.
+struct WrongLayoutReport
+{
+    size_t currentLayout;
+    std::wstring_view currentText;          // The word as typed
+    const std::wstring_view *conversions;   // The word in every layout, by layout index
+    size_t layoutCount;
+    size_t bestAlternative;
+    double margin;                          // Bits per key, see LayoutScorer::ConfidenceMargin
+};
+
+// The platform-neutral detection pipeline: turns raw key events into the
+// text typed so far and wrong-layout reports. Platform code supplies the
+// layouts, the active layout and what to do with the results. Not thread
+// safe; feed it from one thread, normally the KeyEventWorker. Once the
+// buffers have grown to the longest word, handling a key allocates nothing.
+class DetectionEngine
+{
+public:
+    typedef std::function<void(std::wstring_view text)> TextHandler;  // Valid during the call
+    typedef std::function<void(const WrongLayoutReport &report)> WrongLayoutHandler;
+    typedef std::function<int()> ActiveLayoutFunction;  // Layout index, or -1 if unknown
+
+    DetectionEngine();
+
+    // Clears any typed text
+    void SetLayouts(const std::vector<LayoutTable> &layouts);
+    size_t LayoutCount() const { return m_layouts.size(); }
+    const LayoutTable &Layout(size_t index) const { return m_layouts[index]; }
+    int FindLayoutByLanguage(uint16_t langId) const;
+
+    // Without a model only character ranges are checked
+    bool LoadModel(const std::filesystem::path &path);
+    bool HasModel() const { return m_model.IsLoaded(); }
+
+    // A word found in the dictionary settles the check before the model does
+    bool LoadDictionary(const std::filesystem::path &path);
+    bool HasDictionary() const { return m_dictionary.IsLoaded(); }
+
+    void SetMinTextLength(size_t length) { m_minTextLength = length; }
+
+    // Pause after which an unfinished word is checked; 0 checks at word boundaries only
+    void SetIdleCheckDelay(int64_t delayUs) { m_scheduler.SetIdleDelay(delayUs); }
+    void SetActiveLayoutFunction(ActiveLayoutFunction function) { m_activeLayout = std::move(function); }
+    void SetTextHandler(TextHandler handler) { m_textHandler = std::move(handler); }
+    void SetWrongLayoutHandler(WrongLayoutHandler handler) { m_wrongLayoutHandler = std::move(handler); }
+
+    // Records every event passed to ProcessEvents; nullptr stops recording.
+    // The writer is used on the engine's thread and must outlive the engine's use of it.
+    void SetTraceWriter(KeyTraceWriter *writer) { m_trace = writer; }
+
+    // Timestamps are KeyEventClockUs; 0 means now
+    void ProcessEvents(const KeyEvent *events, size_t count);
+    void OnKeyDown(uint32_t vkCode, int64_t timestampUs = 0);
+    void OnKeyUp(uint32_t vkCode);
+
+    // Runs a check that fell due while no keys came; call when the input goes quiet
+    void OnIdle(int64_t nowUs = 0);
+
+    // Checks a finished word, given as the keys that typed it in layout
+    // current, outside the live key stream. Resets the scoring of any word
+    // being typed, so give it an engine of its own. Returns the layout the
+    // word should have been typed in, or -1 if it fits where it was typed.
+    // Either way WordInLayout has it in every layout until the next check.
+    // margin, if given, gets the model's margin (0 without a model).
+    int CheckKeys(const KeyPressInfo *keys, size_t count, size_t current, double *margin = nullptr);
+    std::wstring_view WordInLayout(size_t layoutIndex) const { return m_converter.Lane(layoutIndex); }
+
+    bool IsValidInLayout(std::wstring_view text, size_t layoutIndex) const;
+
+    // Whether the text, without leading and trailing punctuation, is a word in
+    // the layout's language. False if the dictionary lacks that language.
+    bool IsDictionaryWord(std::wstring_view text, size_t layoutIndex) const;
+
+    static bool IsModifierKey(uint32_t vkCode);
+
+    uint64_t KeysProcessed() const { return m_keysProcessed; }
+    uint64_t WordsChecked() const { return m_wordsChecked; }
+    uint64_t WrongLayoutCount() const { return m_wrongLayoutCount; }
+    uint64_t DictionaryHits() const { return m_dictionaryHits; }
+    const EventArena &Arena() const { return m_arena; }
+    const DetectionScheduler &Scheduler() const { return m_scheduler; }
+
+private:
+    bool CheckWord();
+    bool IsWrongLayout(size_t current, size_t &alternative, double &margin);  // On the word in m_converter
+    void RecordEvent(const KeyEvent &event);
+    int ActiveLayout() const { return m_activeLayout ? m_activeLayout() : -1; }
+
+    std::vector<LayoutTable> m_layouts;
+    NgramModel m_model;
+    WordDictionary m_dictionary;
+    TextComposer m_composer;    // Typed text rendered in every layout
+    BatchConverter m_converter;
+    LayoutScorer m_scorer;      // Per-layout likelihood of the word being typed
+    DetectionScheduler m_scheduler;
+    EventArena m_arena;         // Scratch for the event being handled
+    ModifierFlags m_modifiers;
+    std::vector<uint32_t> m_pressedKeys;      // Held keys, to ignore auto-repeat
+    std::vector<KeyPressInfo> m_wordKeys;     // Keys of the word being typed
+    size_t m_minTextLength;
+    ActiveLayoutFunction m_activeLayout;
+    TextHandler m_textHandler;
+    WrongLayoutHandler m_wrongLayoutHandler;
+    KeyTraceWriter *m_trace;
+    uint64_t m_keysProcessed;
+    uint64_t m_wordsChecked;
+    uint64_t m_wrongLayoutCount;
+    uint64_t m_dictionaryHits;  // Words settled by the dictionary
+};
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "key_event.h"
+#include "layout_table.h"
+
+// Pause after the last key of an unfinished word before it is checked anyway
+const int64_t DEFAULT_IDLE_CHECK_US = 500 * 1000;
+
+// What a key press does to the word being typed
+enum KeyClass
+{
+    KEY_CLASS_WORD,      // Adds to the word
+    KEY_CLASS_BOUNDARY,  // Ends the word: space, Enter, Tab, punctuation in every layout
+    KEY_CLASS_EDIT,      // Changes the word in place (Backspace)
+    KEY_CLASS_MOVE,      // Moves the caret or deletes ahead; the word is abandoned
+    KEY_CLASS_OTHER      // Modifiers, shortcuts, function keys: no effect on the word
+};
+
+// Decides when the word being typed is checked: at a word boundary, or once
+// typing has paused for the idle delay. A check that is still pending when
+// the word changes or ends is replaced, so each version of a word is checked
+// at most once. Not thread safe; used on the engine's thread.
+class DetectionScheduler
+{
+public:
+    DetectionScheduler();
+
+    // Punctuation ends a word only if it is punctuation in every layout,
+    // since a key typed in the wrong layout may be a letter in the right one
+    void SetLayouts(const std::vector<const LayoutTable *> &layouts);
+
+    // 0 checks at word boundaries only
+    void SetIdleDelay(int64_t delayUs) { m_idleDelayUs = delayUs; }
+    int64_t IdleDelay() const { return m_idleDelayUs; }
+
+    KeyClass Classify(uint32_t vkCode, const ModifierFlags &modifiers) const;
+
+    // Any key event, down or up; each one used to trigger an evaluation
+    void OnKeyEvent() { m_keyEvents++; }
+
+    // A key press, after Classify. Returns true if the word is to be checked now.
+    bool OnKey(KeyClass keyClass, int64_t timestampUs);
+
+    // Returns true once the pending check is due at nowUs
+    bool OnIdle(int64_t nowUs);
+
+    bool HasPending() const { return m_deadlineUs != 0; }
+    int64_t Deadline() const { return m_deadlineUs; }
+
+    uint64_t KeyEvents() const { return m_keyEvents; }
+    uint64_t Evaluations() const { return m_boundaryChecks + m_idleChecks; }
+    uint64_t BoundaryChecks() const { return m_boundaryChecks; }
+    uint64_t IdleChecks() const { return m_idleChecks; }
+    uint64_t CancelledChecks() const { return m_cancelledChecks; }
+    uint64_t EvaluationsAvoided() const { return m_keyEvents > Evaluations() ? m_keyEvents - Evaluations() : 0; }
+
+private:
+    void Schedule(int64_t timestampUs);
+    void Cancel();
+    static bool IsWordChar(wchar_t ch);
+
+    uint8_t m_classes[LayoutTable::KEY_COUNT][LSS_COUNT];  // KeyClass per key and shift state
+    int64_t m_idleDelayUs;
+    int64_t m_deadlineUs;  // When the pending check is due, 0 if none
+    bool m_wordChanged;    // Keys changed the word since it was last checked
+    uint64_t m_keyEvents;
+    uint64_t m_boundaryChecks;
+    uint64_t m_idleChecks;
+    uint64_t m_cancelledChecks;
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "detection_engine.h"
+#include "layout_table.h"
+
+// Setup shared by the command-line front ends (headless mode, kbconvert,
+// kbserve). Problems are reported on stderr.
+
+// The layouts saved in a pack, or the built-in en and he tables if packPath
+// is empty. False if the pack cannot be read.
+bool LoadLayouts(const std::string &packPath, std::vector<LayoutTable> &layouts);
+
+// Gives an engine its layouts, shortest checked word, model and dictionary.
+// Empty paths mean the default files, which may be missing; a path given
+// explicitly must load. report prints problems and the warning about having
+// neither, so set it for the first of several identical engines only.
+bool ConfigureEngine(DetectionEngine &engine, const std::vector<LayoutTable> &layouts, const std::string &modelPath,
+                     const std::string &dictionaryPath, size_t minLength, bool report);
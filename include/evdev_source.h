@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <thread>
+#include <vector>
+#include "input_source.h"
+
+// input_event records read per read() call
+const size_t EVDEV_READ_BATCH = 64;
+
+// Reads keyboards through Linux evdev (/dev/input/event*, or a uinput
+// virtual device). One reader thread waits on every device with epoll and
+// drains each ready device EVDEV_READ_BATCH records per syscall. Needs read
+// access to the device nodes, usually membership of the input group.
+class EvdevSource : public InputSource
+{
+public:
+    // Empty devicePaths means every keyboard found under /dev/input
+    explicit EvdevSource(std::vector<std::string> devicePaths = std::vector<std::string>());
+    ~EvdevSource() override;
+
+    bool Start(KeyEventWorker &worker) override;
+    void Stop() override;
+    const wchar_t *Name() const override { return L"Linux evdev"; }
+
+    // Event devices that report letter and space keys
+    static std::vector<std::string> FindKeyboards();
+
+    // Virtual-key code (KC_*) for a Linux KEY_* code, 0 if it has none
+    static uint16_t VirtualKeyFor(uint16_t linuxKeyCode);
+
+private:
+    bool OpenDevice(const std::string &path);
+    void Run();
+    void CloseAll();
+
+    std::vector<std::string> m_devicePaths;
+    std::vector<int> m_devices;
+    int m_epoll;
+    int m_stopEvent;  // eventfd that wakes the reader to exit
+    std::thread m_reader;
+    KeyEventWorker *m_worker;
+};
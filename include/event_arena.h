@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string_view>
+#include <type_traits>
+
+// Scratch space for one key event
+const size_t EVENT_ARENA_BYTES = 4096;
+
+// Bump allocator over inline storage for data that lives only while one key
+// event is handled. Reset after every event; nothing is freed one by one, so
+// only trivially destructible types go in. Never touches the heap.
+class EventArena
+{
+public:
+    EventArena()
+        : m_used(0), m_highWater(0), m_overflows(0)
+    {
+    }
+
+    EventArena(const EventArena &) = delete;
+    EventArena &operator=(const EventArena &) = delete;
+
+    // count default-initialized items, or nullptr if the arena is full
+    template <typename T>
+    T *Allocate(size_t count)
+    {
+        static_assert(std::is_trivially_destructible<T>::value, "Arena memory is released without destructors");
+
+        size_t offset = (m_used + alignof(T) - 1) & ~(alignof(T) - 1);
+        if (count > (EVENT_ARENA_BYTES - offset) / sizeof(T) || offset > EVENT_ARENA_BYTES)
+        {
+            m_overflows++;
+            return nullptr;
+        }
+        m_used = offset + count * sizeof(T);
+        m_highWater = m_used > m_highWater ? m_used : m_highWater;
+
+        T *items = reinterpret_cast<T *>(m_storage + offset);
+        for (size_t i = 0; i < count; i++)
+        {
+            new (items + i) T();
+        }
+        return items;
+    }
+
+    // Copy of text in the arena; empty if it does not fit
+    std::wstring_view Copy(std::wstring_view text)
+    {
+        wchar_t *copy = Allocate<wchar_t>(text.size());
+        if (!copy)
+        {
+            return std::wstring_view();
+        }
+        text.copy(copy, text.size());
+        return std::wstring_view(copy, text.size());
+    }
+
+    void Reset() { m_used = 0; }
+
+    size_t Used() const { return m_used; }
+    size_t HighWater() const { return m_highWater; }  // Most bytes used by one event
+    uint64_t Overflows() const { return m_overflows; }
+
+private:
+    alignas(16) unsigned char m_storage[EVENT_ARENA_BYTES];
+    size_t m_used;
+    size_t m_highWater;
+    uint64_t m_overflows;
+};
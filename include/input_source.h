@@ -0,0 +1,20 @@
+#pragma once
+
+#include "key_event_worker.h"
+
+// Where key events come from. A source captures raw key transitions on its
+// own context (a hook callback, a reader thread) and posts them to the worker,
+// which feeds the DetectionEngine. A source is the worker's single producer.
+class InputSource
+{
+public:
+    virtual ~InputSource() = default;
+
+    // Starts posting events to worker. Returns false if capture could not start.
+    virtual bool Start(KeyEventWorker &worker) = 0;
+
+    // Stops capture; no events are posted once this returns
+    virtual void Stop() = 0;
+
+    virtual const wchar_t *Name() const = 0;
+};
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+
+// Virtual-key codes used by the portable detection core. The values are the
+// Win32 VK_* values, so they can be compared directly with a hook's vkCode.
+const uint32_t KC_BACK = 0x08;
+const uint32_t KC_TAB = 0x09;
+const uint32_t KC_RETURN = 0x0D;
+const uint32_t KC_SHIFT = 0x10;
+const uint32_t KC_CONTROL = 0x11;
+const uint32_t KC_MENU = 0x12;
+const uint32_t KC_ESCAPE = 0x1B;
+const uint32_t KC_SPACE = 0x20;
+const uint32_t KC_END = 0x23;
+const uint32_t KC_HOME = 0x24;
+const uint32_t KC_LEFT = 0x25;
+const uint32_t KC_UP = 0x26;
+const uint32_t KC_RIGHT = 0x27;
+const uint32_t KC_DOWN = 0x28;
+const uint32_t KC_DELETE = 0x2E;
+const uint32_t KC_LWIN = 0x5B;
+const uint32_t KC_RWIN = 0x5C;
+const uint32_t KC_NUMPAD0 = 0x60;
+const uint32_t KC_MULTIPLY = 0x6A;
+const uint32_t KC_ADD = 0x6B;
+const uint32_t KC_SUBTRACT = 0x6D;
+const uint32_t KC_DECIMAL = 0x6E;
+const uint32_t KC_DIVIDE = 0x6F;
+const uint32_t KC_F1 = 0x70;
+const uint32_t KC_F24 = 0x87;
+const uint32_t KC_LSHIFT = 0xA0;
+const uint32_t KC_RSHIFT = 0xA1;
+const uint32_t KC_LCONTROL = 0xA2;
+const uint32_t KC_RCONTROL = 0xA3;
+const uint32_t KC_LMENU = 0xA4;
+const uint32_t KC_RMENU = 0xA5;
+const uint32_t KC_OEM_1 = 0xBA;       // ;:
+const uint32_t KC_OEM_PLUS = 0xBB;    // =+
+const uint32_t KC_OEM_COMMA = 0xBC;   // ,<
+const uint32_t KC_OEM_MINUS = 0xBD;   // -_
+const uint32_t KC_OEM_PERIOD = 0xBE;  // .>
+const uint32_t KC_OEM_2 = 0xBF;       // /?
+const uint32_t KC_OEM_3 = 0xC0;       // `~
+const uint32_t KC_OEM_4 = 0xDB;       // [{
+const uint32_t KC_OEM_5 = 0xDC;       // \|
+const uint32_t KC_OEM_6 = 0xDD;       // ]}
+const uint32_t KC_OEM_7 = 0xDE;       // '"
+const uint32_t KC_OEM_102 = 0xE2;     // Extra key left of Z on ISO keyboards
+
+struct ModifierFlags {
+    bool shift : 1;
+    bool ctrl : 1;
+    bool alt : 1;
+
+    ModifierFlags() : shift(false), ctrl(false), alt(false) {}
+
+    void UpdateFromKey(uint32_t vkCode, bool keyDown) {
+        switch (vkCode) {
+            case KC_SHIFT:
+            case KC_LSHIFT:
+            case KC_RSHIFT:
+                shift = keyDown;
+                break;
+            case KC_CONTROL:
+            case KC_LCONTROL:
+            case KC_RCONTROL:
+                ctrl = keyDown;
+                break;
+            case KC_MENU:
+            case KC_LMENU:
+            case KC_RMENU:
+                alt = keyDown;
+                break;
+        }
+    }
+};
+
+struct KeyPressInfo {
+    uint32_t vkCode;
+    ModifierFlags modifiers;
+
+    KeyPressInfo(uint32_t code, const ModifierFlags& mods)
+        : vkCode(code), modifiers(mods) {}
+
+    bool operator==(const KeyPressInfo& other) const {
+        return vkCode == other.vkCode &&
+               modifiers.shift == other.modifiers.shift &&
+               modifiers.ctrl == other.modifiers.ctrl &&
+               modifiers.alt == other.modifiers.alt;
+    }
+};
+
+// KeyEvent flags
+const uint16_t KEY_EVENT_UP = 0x01;
+const uint16_t KEY_EVENT_EXTENDED = 0x02;
+const uint16_t KEY_EVENT_INJECTED = 0x04;
+const uint16_t KEY_EVENT_ALT_DOWN = 0x08;
+
+// One raw key transition as captured by an input hook, packed to 16 bytes so
+// the hook only copies a few words into the event queue
+struct KeyEvent {
+    uint16_t vkCode;
+    uint16_t scanCode;
+    uint16_t flags;
+    uint16_t reserved;
+    int64_t timestampUs;   // KeyEventClockUs() when the event was captured
+};
+
+static_assert(sizeof(KeyEvent) == 16, "KeyEvent must stay packed");
+
+// Monotonic clock for key event timestamps
+inline int64_t KeyEventClockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include "key_event.h"
+#include "spsc_queue.h"
+
+// Key events the hook can get ahead of the worker by
+const size_t DEFAULT_KEY_QUEUE_CAPACITY = 4096;
+
+// Most events handed to the handler at once
+const size_t KEY_WORKER_BATCH = 64;
+
+// Times the worker yields on an empty queue before going to sleep
+const int KEY_WORKER_SPINS = 64;
+
+// Longest the worker sleeps before looking at the queue again
+const int KEY_WORKER_IDLE_MS = 50;
+
+// Runs key processing on its own thread. One producer (the input hook) posts
+// events without blocking; the worker drains them in order, in batches.
+class KeyEventWorker
+{
+public:
+    typedef std::function<void(const KeyEvent *events, size_t count)> BatchHandler;
+    typedef std::function<void()> IdleHandler;
+
+    explicit KeyEventWorker(size_t capacity = DEFAULT_KEY_QUEUE_CAPACITY);
+    ~KeyEventWorker();
+
+    KeyEventWorker(const KeyEventWorker &) = delete;
+    KeyEventWorker &operator=(const KeyEventWorker &) = delete;
+
+    // The idle handler, if any, runs on the worker each time it is about to
+    // sleep and at least every KEY_WORKER_IDLE_MS while the queue stays empty
+    void Start(BatchHandler handler, IdleHandler idleHandler = IdleHandler());
+
+    // Handles every event posted so far, then stops the thread
+    void Stop();
+
+    bool IsRunning() const { return m_thread.joinable(); }
+
+    // Producer side, one thread only. Never waits for the worker; returns
+    // false and counts a drop if the queue is full.
+    bool Post(const KeyEvent &event);
+
+    uint64_t DroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+    uint64_t ProcessedCount() const { return m_processed.load(std::memory_order_relaxed); }
+
+private:
+    void Run();
+    bool DrainBatch(KeyEvent *batch);
+
+    SpscQueue<KeyEvent> m_queue;
+    BatchHandler m_handler;
+    IdleHandler m_idleHandler;
+    std::thread m_thread;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_sleeping;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_dropped;
+    std::atomic<uint64_t> m_processed;
+};
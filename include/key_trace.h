@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include "key_event.h"
+#include "mapped_file.h"
+
+// Keystroke traces: the events the DetectionEngine processed, with the
+// modifier state and active layout at the time, so a session can be replayed
+// through the engine on identical input.
+//
+// File layout (little-endian): KeyTraceHeader, then KeyTraceRecord until the
+// end of the file. Recording only appends whole records, so a trace cut short
+// by a crash loses at most the record being written.
+
+#define KEY_TRACE_EXTENSION L".kbtrace"
+
+const uint16_t KEY_TRACE_VERSION = 1;
+
+// KeyTraceRecord modifier bits
+const uint8_t KEY_TRACE_SHIFT = 0x01;
+const uint8_t KEY_TRACE_CTRL = 0x02;
+const uint8_t KEY_TRACE_ALT = 0x04;
+
+// Language ID for a record taken while the active layout was unknown
+const uint16_t KEY_TRACE_NO_LAYOUT = 0;
+
+struct KeyTraceHeader
+{
+    char magic[4];  // "KBTR"
+    uint16_t version;
+    uint16_t recordSize;
+};
+
+struct KeyTraceRecord
+{
+    int64_t timestampUs;  // KeyEvent::timestampUs
+    uint16_t vkCode;
+    uint16_t flags;       // KEY_EVENT_* bits
+    uint16_t langId;      // Primary language ID of the active layout
+    uint8_t modifiers;    // KEY_TRACE_* bits held before this event
+    uint8_t reserved;
+};
+
+static_assert(sizeof(KeyTraceHeader) == 8, "KeyTraceHeader must stay packed");
+static_assert(sizeof(KeyTraceRecord) == 16, "KeyTraceRecord must stay packed");
+
+inline uint8_t KeyTraceModifiers(const ModifierFlags &modifiers)
+{
+    return static_cast<uint8_t>((modifiers.shift ? KEY_TRACE_SHIFT : 0) | (modifiers.ctrl ? KEY_TRACE_CTRL : 0) |
+                                (modifiers.alt ? KEY_TRACE_ALT : 0));
+}
+
+// Appends records to a trace file, creating it if needed. Not thread safe.
+class KeyTraceWriter
+{
+public:
+    KeyTraceWriter();
+    ~KeyTraceWriter();
+
+    KeyTraceWriter(const KeyTraceWriter &) = delete;
+    KeyTraceWriter &operator=(const KeyTraceWriter &) = delete;
+
+    // Continues an existing trace, dropping a partial last record
+    bool Open(const std::filesystem::path &path);
+    void Close();
+    bool IsOpen() const { return m_file != nullptr; }
+
+    void Append(const KeyTraceRecord &record);
+
+    // Hands buffered records to the OS; called once per event batch
+    void Flush();
+
+    uint64_t RecordCount() const { return m_records; }
+
+private:
+    FILE *m_file;
+    uint64_t m_records;  // Appended since Open
+};
+
+// Memory-mapped trace
+class KeyTraceReader
+{
+public:
+    bool Open(const std::filesystem::path &path);
+    void Close() { m_file.Close(); m_records = nullptr; m_count = 0; }
+
+    size_t Count() const { return m_count; }
+    const KeyTraceRecord *Records() const { return m_records; }
+
+private:
+    MappedFile m_file;
+    const KeyTraceRecord *m_records = nullptr;
+    size_t m_count = 0;
+};
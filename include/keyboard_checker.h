@@ -2,97 +2,80 @@
 
 #include <windows.h>
 #include <string>
+#include <string_view>
 #include <vector>
-#include <unordered_map>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
 #include "logger.h"
+#include "detection_engine.h"
+#include "input_source.h"
+#include "key_event_worker.h"
+#include "latency_histogram.h"
+#include "layout_snapshot.h"
+#include "presenter.h"
 
 // Constants
 const UINT WM_TRAYICON = WM_USER + 1;
+const UINT WM_KEYCHECKER_TEXT = WM_USER + 2;  // m_presenter has a view to show
 const UINT ID_TRAYMENU_EXIT = 1001;
+const UINT ID_TRAYMENU_STATS = 1002;
+const UINT_PTR ID_TIMER_ACTIVE_LAYOUT = 1;
+const UINT_PTR ID_TIMER_LAYOUT_LIST = 2;
+const UINT_PTR ID_TIMER_PRESENT = 3;
 
-struct ModifierFlags {
-    bool shift : 1;
-    bool ctrl : 1;
-    bool alt : 1;
+// How often the foreground window's layout is read, so keystrokes never ask the OS
+const UINT ACTIVE_LAYOUT_POLL_MS = 50;
 
-    ModifierFlags() : shift(false), ctrl(false), alt(false) {}
+// How often the installed input languages are compared with the snapshot
+const UINT LAYOUT_LIST_POLL_MS = 1000;
 
-    void UpdateFromKey(DWORD vkCode, bool keyDown) {
-        switch (vkCode) {
-            case VK_SHIFT:
-            case VK_LSHIFT:
-            case VK_RSHIFT:
-                shift = keyDown;
-                break;
-            case VK_CONTROL:
-            case VK_LCONTROL:
-            case VK_RCONTROL:
-                ctrl = keyDown;
-                break;
-            case VK_MENU:
-            case VK_LMENU:
-            case VK_RMENU:
-                alt = keyDown;
-                break;
-        }
-    }
-};
-
-struct KeyPressInfo {
-    DWORD vkCode;
-    ModifierFlags modifiers;
-
-    KeyPressInfo(DWORD code, const ModifierFlags& mods)
-        : vkCode(code), modifiers(mods) {}
-
-    bool operator==(const KeyPressInfo& other) const {
-        return vkCode == other.vkCode &&
-               modifiers.shift == other.modifiers.shift &&
-               modifiers.ctrl == other.modifiers.ctrl &&
-               modifiers.alt == other.modifiers.alt;
-    }
-};
-
-class KeyboardChecker {
+class KeyboardChecker : private PresenterBackend {
 protected:
     KeyboardChecker();
     
 private:
     static KeyboardChecker* s_instance;
-    HHOOK m_keyboardHook;
     HWND m_hwnd;
     HWND m_textWindow;
     HWND m_popup;
     NOTIFYICONDATA m_notifyIconData;
-    std::vector<KeyPressInfo> m_pressedKeys;
-    std::wstring m_currentText;
-    size_t m_minTextLength;
-    std::vector<HKL> m_availableLayouts;
-    ModifierFlags m_currentModifiers;
-    bool m_isShiftPressed;
-    bool m_isCtrlPressed;
-    bool m_isAltPressed;
+    LayoutSnapshotCell m_layouts;
+    LayoutSnapshotCell::Reader m_uiLayoutReader;
+    LayoutSnapshotCell::Reader m_workerLayoutReader;
+    std::atomic<uintptr_t> m_activeLayout;   // Foreground window's HKL, written by the UI thread
+    uint64_t m_engineLayoutVersion;          // Snapshot the engine's layouts came from; key worker only
+    std::vector<uintptr_t> m_engineLayoutIds;  // HKL per engine layout; key worker only
+    std::thread m_layoutBuilder;
+    std::atomic<bool> m_rebuildingLayouts;
+    DetectionEngine m_engine;
+    KeyTraceWriter m_traceWriter;
     bool m_isRunning;
+    Presenter m_presenter;     // Updated on the key worker, flushed on the UI thread
+    std::wstring m_windowText;  // Built on the UI thread, reused between frames
+    KeyEventWorker m_keyWorker;  // After the engine, so it stops before the engine goes away
+    std::unique_ptr<InputSource> m_inputSource;
 
     ~KeyboardChecker();
     
-    static LRESULT CALLBACK KeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
     static LRESULT CALLBACK WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam);
-    static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
     
-    void OnKeyDown(DWORD vkCode);
-    void OnKeyUp(DWORD vkCode);
-    void UpdateText(const std::wstring& text);
-    void UpdateModifierState(DWORD vkCode, bool isKeyDown);
-    bool IsModifierKey(DWORD vkCode);
-    std::wstring GetTextFromKeys(const std::vector<KeyPressInfo>& keys, HKL layout);
-    wchar_t GetCharForKey(DWORD vkCode, HKL layout);
-    std::wstring GetLayoutName(HKL layout);
+    void UpdateText(std::wstring_view text);
+    void PresentPending();
+    void Present(const PresenterView &view, int64_t nowUs) override;
+    int FindLayoutIndex(uintptr_t layout) const;
+    HKL GetActiveLayout() const;
+    static std::wstring GetLayoutName(HKL layout);
+    static std::unique_ptr<LayoutSnapshot> BuildLayoutSnapshot(uint64_t version);
     void ShowTrayMenu();
-    void UpdatePopup(const std::wstring& currentText, const std::unordered_map<HKL, std::wstring>& conversions);
+    void ShowLatencyStats();
+    void UpdatePopup(const WrongLayoutReport& report);
     void InitializeLayouts();
-    void CleanupKeyboardHook();
-    bool IsValidInLayout(const std::wstring& text, HKL layout);
+    void RefreshActiveLayout();
+    void CheckLayoutList();
+    void SyncEngineLayouts();
+    void StopInput();
     
     bool InitializeWindow();
 
@@ -100,6 +83,9 @@ public:
     static KeyboardChecker* GetInstance();
     static void DeleteInstance();
     
+    // Records every key event to a trace for kbtrace-replay; call before Start
+    bool RecordTrace(const std::wstring& path);
+
     bool Start();
     void Stop();
 };
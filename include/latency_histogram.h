@@ -0,0 +1,141 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+// Log-bucketed latency histograms in the style of HdrHistogram: every power
+// of two is split into 16 linear sub-buckets, so a recorded value is kept to
+// within 1/16 of itself over the whole uint64 range with 976 counters.
+//
+// Each recording thread gets its own shard, found through a thread-local
+// slot, so recording is two uncontended relaxed increments and never locks.
+// Snapshots merge the shards while recording continues.
+
+const unsigned LATENCY_SUB_BUCKET_BITS = 5;
+const size_t LATENCY_SUB_BUCKET_HALF = size_t(1) << (LATENCY_SUB_BUCKET_BITS - 1);
+const size_t LATENCY_BUCKET_COUNT = (64 - LATENCY_SUB_BUCKET_BITS + 2) * LATENCY_SUB_BUCKET_HALF;
+
+// Threads beyond this many share the last shard, which stays correct but contended
+const size_t LATENCY_MAX_THREADS = 8;
+
+#define DEFAULT_LATENCY_STATS_PATH L"logs/latency_stats.json"
+
+// What each histogram measures
+enum LatencyMetric
+{
+    LATENCY_HOOK,       // Input source entry to exit, per event (for the Win32 hook: until CallNextHookEx)
+    LATENCY_DETECTION,  // Event capture to the engine's verdict on it, including the queue wait
+    LATENCY_UI,         // Engine output to the UI showing it
+    LATENCY_METRIC_COUNT
+};
+
+struct LatencySnapshot
+{
+    uint64_t count;
+    uint64_t meanNs;
+    uint64_t p50Ns;
+    uint64_t p99Ns;
+    uint64_t p999Ns;
+    uint64_t maxNs;
+};
+
+// Monotonic nanoseconds for latency measurements
+inline uint64_t LatencyClockNs()
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                     std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+class LatencyHistogram
+{
+public:
+    LatencyHistogram();
+
+    LatencyHistogram(const LatencyHistogram &) = delete;
+    LatencyHistogram &operator=(const LatencyHistogram &) = delete;
+
+    void Record(uint64_t valueNs)
+    {
+        Shard &shard = m_shards[ThreadSlot()];
+        shard.counts[BucketIndex(valueNs)].fetch_add(1, std::memory_order_relaxed);
+        shard.sumNs.fetch_add(valueNs, std::memory_order_relaxed);
+        uint64_t max = shard.maxNs.load(std::memory_order_relaxed);
+        while (valueNs > max && !shard.maxNs.compare_exchange_weak(max, valueNs, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    // Percentiles are the highest value of the bucket they fall in
+    LatencySnapshot Snapshot() const;
+
+    static size_t BucketIndex(uint64_t valueNs)
+    {
+        if (valueNs < 2 * LATENCY_SUB_BUCKET_HALF)
+        {
+            return static_cast<size_t>(valueNs);
+        }
+        unsigned shift = HighestBit(valueNs) - (LATENCY_SUB_BUCKET_BITS - 1);
+        return shift * LATENCY_SUB_BUCKET_HALF + static_cast<size_t>(valueNs >> shift);
+    }
+
+    // Highest value that falls in a bucket
+    static uint64_t BucketHighest(size_t index);
+
+private:
+    struct alignas(64) Shard
+    {
+        std::atomic<uint64_t> counts[LATENCY_BUCKET_COUNT];
+        std::atomic<uint64_t> sumNs;
+        std::atomic<uint64_t> maxNs;
+    };
+
+    static unsigned HighestBit(uint64_t value)
+    {
+#if defined(__GNUC__) || defined(__clang__)
+        return 63 - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned bit = 0;
+        while (value >>= 1)
+        {
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+    static size_t ThreadSlot();
+
+    Shard m_shards[LATENCY_MAX_THREADS];
+};
+
+// The process-wide histograms, one per LatencyMetric
+class LatencyStats
+{
+public:
+    static LatencyStats &Instance()
+    {
+        static LatencyStats instance;
+        return instance;
+    }
+
+    void Record(LatencyMetric metric, uint64_t valueNs) { m_histograms[metric].Record(valueNs); }
+    LatencySnapshot Snapshot(LatencyMetric metric) const { return m_histograms[metric].Snapshot(); }
+
+    static const wchar_t *MetricName(LatencyMetric metric);
+
+    // Every metric, one line each, for logs and message boxes
+    std::wstring Summary() const;
+
+    std::string ToJson() const;
+    bool WriteJson(const std::filesystem::path &path) const;
+
+private:
+    LatencyStats();
+
+    LatencyHistogram m_histograms[LATENCY_METRIC_COUNT];
+    uint64_t m_startNs;
+};
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <vector>
+#include "layout_table.h"
+#include "mapped_file.h"
+
+// Translation tables of a set of keyboard layouts, saved so they can be
+// loaded at startup instead of asking the OS for every key again.
+//
+// File layout (little-endian, every section 4-byte aligned so a mapped file
+// is used in place):
+//   LayoutPackHeader
+//   LayoutPackEntry[layoutCount]
+//   per layout: uint16 name[nameLength], padded to 4 bytes,
+//               LayoutPackKey keys[KEY_COUNT * LSS_COUNT],
+//               LayoutPackCombo combos[comboCount] sorted by (dead, base)
+// The checksum is FNV-1a over everything after the header. A pack belongs to
+// the layout set whose system IDs it lists, in order; any other set rebuilds it.
+
+#define LAYOUT_PACK_EXTENSION L".kblp"
+#define DEFAULT_LAYOUT_PACK_PATH L"keyboard_checker.kblp"
+
+const uint16_t LAYOUT_PACK_VERSION = 1;
+
+// Longest layout name stored, in UTF-16 units
+const size_t LAYOUT_PACK_MAX_NAME = 256;
+
+struct LayoutPackHeader
+{
+    char magic[4];  // "KBLP"
+    uint16_t version;
+    uint16_t layoutCount;
+    uint32_t payloadSize;  // Bytes after the header
+    uint32_t checksum;
+};
+
+struct LayoutPackEntry
+{
+    uint64_t systemId;  // Platform handle (HKL on Windows), 0 for built-in tables
+    uint16_t langId;
+    uint16_t nameLength;
+    uint32_t nameOffset;
+    uint32_t keyOffset;
+    uint32_t comboOffset;
+    uint32_t comboCount;
+    uint32_t reserved;
+};
+
+struct LayoutPackKey
+{
+    uint16_t ch;
+    uint8_t flags;
+    uint8_t reserved;
+};
+
+struct LayoutPackCombo
+{
+    uint16_t dead;
+    uint16_t base;
+    uint16_t result;
+    uint16_t reserved;
+};
+
+class LayoutPack
+{
+public:
+    LayoutPack() = default;
+    LayoutPack(const LayoutPack &) = delete;
+    LayoutPack &operator=(const LayoutPack &) = delete;
+
+    // Maps a pack file. Returns false if it is missing, malformed or corrupt.
+    bool Load(const std::filesystem::path &path);
+
+    // Uses a pack already in memory; data must stay valid and 4-byte aligned
+    bool LoadFromMemory(const uint8_t *data, size_t size);
+
+    // Unmaps the file, e.g. before it is replaced
+    void Close();
+
+    bool IsLoaded() const { return m_data != nullptr; }
+    size_t LayoutCount() const { return m_entries.size(); }
+    uint64_t SystemId(size_t index) const { return m_entries[index].systemId; }
+
+    // Whether the pack was made for exactly these layouts, in this order
+    bool Matches(const std::vector<uintptr_t> &systemIds) const;
+
+    // Copies one layout out of the pack
+    LayoutTable Layout(size_t index) const;
+
+private:
+    MappedFile m_file;
+    const uint8_t *m_data = nullptr;
+    std::vector<LayoutPackEntry> m_entries;
+};
+
+// Serializes translation tables into a pack
+class LayoutPackBuilder
+{
+public:
+    void Add(const LayoutTable &table, uintptr_t systemId = 0);
+
+    // Serialized pack, or an empty vector if a table holds characters
+    // outside the Basic Multilingual Plane
+    std::vector<uint8_t> Build() const;
+
+    // Builds and writes the pack in one go
+    bool Write(const std::filesystem::path &path) const;
+
+private:
+    std::vector<LayoutTable> m_tables;
+    std::vector<uintptr_t> m_systemIds;
+};
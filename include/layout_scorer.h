@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "key_event.h"
+#include "layout_table.h"
+#include "ngram_model.h"
+
+// Default number of keystrokes a score covers
+const size_t DEFAULT_SCORE_WINDOW = 32;
+
+// Cost per key charged to layouts whose language has no model
+const uint32_t NGRAM_NO_MODEL_COST = 12 * NGRAM_COST_SCALE;
+
+// Bits per key another layout must win by before the word counts as typed in
+// the wrong layout
+const double NGRAM_WRONG_LAYOUT_MARGIN = 1.5;
+
+// Keeps a running n-gram cost (negative log-probability) of the current word
+// for every layout. Each key's symbol per layout is precomputed from the
+// layout tables, so a keystroke is one trigram lookup per layout.
+class LayoutScorer
+{
+public:
+    explicit LayoutScorer(size_t window = DEFAULT_SCORE_WINDOW);
+
+    // Layouts and model must outlive the scorer. Clears the scores.
+    void SetLayouts(const std::vector<const LayoutTable *> &layouts, const NgramModel &model);
+    size_t LayoutCount() const { return m_models.size(); }
+    bool HasModel(size_t layoutIndex) const { return m_models[layoutIndex] != nullptr; }
+
+    // Feeds one key press. Backspace takes back the last key and word
+    // boundaries start a new word.
+    void OnKey(const KeyPressInfo &key);
+
+    void Reset();
+
+    // Keystrokes currently scored, at most the window
+    size_t KeyCount() const { return m_keyCount; }
+
+    // Cost of the scored keys in a layout, in NGRAM_COST_SCALE units per bit
+    int64_t Cost(size_t layoutIndex) const { return m_costs[layoutIndex]; }
+
+    size_t BestLayout() const;
+
+    // Average bits per key by which the best other layout beats the current
+    // one. Positive means the keys read better in another layout.
+    double ConfidenceMargin(size_t current, size_t *bestAlternative = nullptr) const;
+
+private:
+    static constexpr uint8_t SYMBOL_NONE = 0xFF;  // Key gives no text in the layout
+    static constexpr size_t KEY_STRIDE = LayoutTable::KEY_COUNT * LSS_COUNT;
+
+    size_t Slot(size_t key) const { return (m_keyHead + key) % m_window; }
+    void DropOldestKey();
+    void RemoveLastKey();
+
+    std::vector<const NgramLanguageModel *> m_models;
+    std::vector<uint8_t> m_keySymbols;     // Per layout, symbol of every key and shift state
+    std::vector<int64_t> m_costs;
+    std::vector<uint8_t> m_prev1;          // Context symbols per layout
+    std::vector<uint8_t> m_prev2;
+    std::vector<uint16_t> m_historyCost;   // Ring of keys, one entry per layout each
+    std::vector<uint8_t> m_historySymbol;
+    size_t m_window;
+    size_t m_keyHead;
+    size_t m_keyCount;
+};
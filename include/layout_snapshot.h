@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "layout_table.h"
+#include "snapshot_cell.h"
+
+// The input languages installed at one point in time, with their
+// translation tables. Built whole, published through a LayoutSnapshotCell
+// and never changed afterwards, so readers need no lock.
+struct LayoutSnapshot
+{
+    uint64_t version;                  // Increases with every rebuild
+    std::vector<LayoutTable> layouts;  // Tables, named for display
+    std::vector<uintptr_t> systemIds;  // Platform handle per layout (HKL on Windows)
+
+    // Index of the layout with this handle, or -1
+    int FindSystemLayout(uintptr_t systemId) const
+    {
+        for (size_t i = 0; i < systemIds.size(); i++)
+        {
+            if (systemIds[i] == systemId)
+            {
+                return static_cast<int>(i);
+            }
+        }
+        return -1;
+    }
+};
+
+typedef SnapshotCell<LayoutSnapshot> LayoutSnapshotCell;
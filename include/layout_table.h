@@ -0,0 +1,112 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "key_event.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+// Primary language IDs (PRIMARYLANGID of an HKL) for the built-in layouts
+const uint16_t LAYOUT_LANG_ENGLISH = 0x09;
+const uint16_t LAYOUT_LANG_HEBREW = 0x0D;
+
+// Modifier combinations a translation table is indexed by.
+// Ctrl+Alt is treated as AltGr, as Windows does.
+enum LayoutShiftState : uint8_t
+{
+    LSS_BASE = 0,
+    LSS_SHIFT = 1,
+    LSS_ALTGR = 2,
+    LSS_SHIFT_ALTGR = 3,
+    LSS_COUNT = 4
+};
+
+// Entry flags
+const uint8_t LAYOUT_ENTRY_DEAD = 0x01;  // Key starts a dead-key sequence
+
+struct LayoutEntry
+{
+    wchar_t ch;     // Character produced, or 0 if the key produces no text
+    uint8_t flags;  // LAYOUT_ENTRY_* bits
+};
+
+// Result of pressing a dead key followed by a base character
+struct DeadKeyCombo
+{
+    wchar_t dead;
+    wchar_t base;
+    wchar_t result;
+};
+
+// Dense (vkCode x shift state) -> character table for one keyboard layout.
+// Built once per layout so translating a keystroke is a single array lookup
+// instead of GetKeyboardState/MapVirtualKeyEx/ToUnicodeEx.
+class LayoutTable
+{
+public:
+    static const size_t KEY_COUNT = 256;
+
+    LayoutTable();
+    LayoutTable(uint16_t langId, const std::wstring &name);
+
+    // Built-in tables, available on every platform
+    static LayoutTable UsQwerty();
+    static LayoutTable HebrewSi1452();
+
+#ifdef _WIN32
+    // Queries the OS for every key of the layout. Slow, call once per layout.
+    static LayoutTable FromSystemLayout(HKL layout, const std::wstring &name);
+#endif
+
+    static LayoutShiftState ShiftStateFor(const ModifierFlags &modifiers)
+    {
+        return static_cast<LayoutShiftState>((modifiers.shift ? LSS_SHIFT : 0) |
+                                             (modifiers.ctrl && modifiers.alt ? LSS_ALTGR : 0));
+    }
+
+    const LayoutEntry &Entry(uint32_t vkCode, LayoutShiftState state) const
+    {
+        return m_entries[(vkCode & 0xFF) * LSS_COUNT + state];
+    }
+
+    // Character for a key, or 0 for non-text keys and dead keys
+    wchar_t Lookup(uint32_t vkCode, LayoutShiftState state) const
+    {
+        if (vkCode >= KEY_COUNT)
+        {
+            return 0;
+        }
+        const LayoutEntry &entry = Entry(vkCode, state);
+        return (entry.flags & LAYOUT_ENTRY_DEAD) ? 0 : entry.ch;
+    }
+
+    wchar_t Lookup(uint32_t vkCode, const ModifierFlags &modifiers) const
+    {
+        return Lookup(vkCode, ShiftStateFor(modifiers));
+    }
+
+    bool IsDeadKey(uint32_t vkCode, const ModifierFlags &modifiers) const
+    {
+        return vkCode < KEY_COUNT && (Entry(vkCode, ShiftStateFor(modifiers)).flags & LAYOUT_ENTRY_DEAD) != 0;
+    }
+
+    // Character produced by a dead key followed by base, or 0 if they don't combine
+    wchar_t Compose(wchar_t dead, wchar_t base) const;
+
+    void Set(uint32_t vkCode, LayoutShiftState state, wchar_t ch, uint8_t flags = 0);
+    void AddDeadKeyCombo(wchar_t dead, wchar_t base, wchar_t result);
+
+    uint16_t LanguageId() const { return m_langId; }
+    const std::wstring &Name() const { return m_name; }
+    const std::vector<DeadKeyCombo> &DeadKeyCombos() const { return m_deadKeyCombos; }
+
+private:
+    LayoutEntry m_entries[KEY_COUNT * LSS_COUNT];
+    std::vector<DeadKeyCombo> m_deadKeyCombos;  // Sorted by (dead, base)
+    uint16_t m_langId;
+    std::wstring m_name;
+};
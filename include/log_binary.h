@@ -0,0 +1,225 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+// Binary log format. Every segment file is self-contained:
+//
+//   header   "KBLG" | u16 version | u16 reserved | i64 base timestamp (us, LE)
+//   records  u8 tag followed by
+//     BINLOG_TAG_SITE     varint id, varint line, string file, string function
+//     BINLOG_TAG_EVENT    svarint timestamp delta (us), varint site id, u8 level + 1, string message
+//     BINLOG_TAG_SESSION  svarint timestamp delta (us)
+//
+// Strings are a varint byte length followed by UTF-8. A site is defined once
+// per segment, before its first event, so events only carry its id. Timestamp
+// deltas are relative to the previous record (or the header base).
+
+// Log files with this extension are written in the binary format
+#define BINARY_LOG_EXTENSION L".kblog"
+
+const char BINLOG_MAGIC[4] = {'K', 'B', 'L', 'G'};
+const uint16_t BINLOG_VERSION = 1;
+const size_t BINLOG_HEADER_SIZE = 16;
+const size_t BINLOG_MAX_VARINT = 10;
+
+enum BinaryLogTag : uint8_t
+{
+    BINLOG_TAG_SITE = 1,
+    BINLOG_TAG_EVENT = 2,
+    BINLOG_TAG_SESSION = 3
+};
+
+inline size_t WriteVarint(uint8_t *dst, uint64_t value)
+{
+    size_t n = 0;
+    while (value >= 0x80)
+    {
+        dst[n++] = static_cast<uint8_t>(value | 0x80);
+        value >>= 7;
+    }
+    dst[n++] = static_cast<uint8_t>(value);
+    return n;
+}
+
+// Zigzag encoding keeps small negative deltas (clock adjustments) short
+inline size_t WriteSignedVarint(uint8_t *dst, int64_t value)
+{
+    return WriteVarint(dst, (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63));
+}
+
+inline bool ReadVarint(const uint8_t *&pos, const uint8_t *end, uint64_t &value)
+{
+    value = 0;
+    for (int shift = 0; pos < end && shift < 64; shift += 7)
+    {
+        uint8_t byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+inline bool ReadSignedVarint(const uint8_t *&pos, const uint8_t *end, int64_t &value)
+{
+    uint64_t raw;
+    if (!ReadVarint(pos, end, raw))
+    {
+        return false;
+    }
+    value = static_cast<int64_t>(raw >> 1) ^ -static_cast<int64_t>(raw & 1);
+    return true;
+}
+
+inline void WriteBinaryLogHeader(uint8_t *dst, int64_t baseTimestampUs)
+{
+    memcpy(dst, BINLOG_MAGIC, 4);
+    dst[4] = static_cast<uint8_t>(BINLOG_VERSION);
+    dst[5] = static_cast<uint8_t>(BINLOG_VERSION >> 8);
+    dst[6] = 0;
+    dst[7] = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        dst[8 + i] = static_cast<uint8_t>(static_cast<uint64_t>(baseTimestampUs) >> (8 * i));
+    }
+}
+
+// Site definition as read back from a segment
+struct BinaryLogSite
+{
+    uint32_t line;
+    const char *file;
+    size_t fileLength;
+    const char *function;
+    size_t functionLength;
+};
+
+// One decoded record. Pointers refer into the segment buffer.
+struct BinaryLogEvent
+{
+    BinaryLogTag tag;               // BINLOG_TAG_EVENT or BINLOG_TAG_SESSION
+    int64_t timestampUs;
+    const BinaryLogSite *site;      // Events only
+    int level;
+    const char *message;
+    size_t messageLength;
+};
+
+// Sequential decoder over one segment held in memory
+class BinaryLogReader
+{
+public:
+    BinaryLogReader(const uint8_t *data, size_t size)
+        : m_pos(data),
+          m_end(data + size),
+          m_timestampUs(0),
+          m_valid(false)
+    {
+        if (size >= BINLOG_HEADER_SIZE && memcmp(data, BINLOG_MAGIC, 4) == 0 &&
+            (data[4] | (data[5] << 8)) == BINLOG_VERSION)
+        {
+            uint64_t base = 0;
+            for (int i = 0; i < 8; i++)
+            {
+                base |= static_cast<uint64_t>(data[8 + i]) << (8 * i);
+            }
+            m_timestampUs = static_cast<int64_t>(base);
+            m_pos += BINLOG_HEADER_SIZE;
+            m_valid = true;
+        }
+    }
+
+    bool IsValid() const { return m_valid; }
+
+    // Returns false at the end of the segment or on a truncated/corrupt record
+    bool Next(BinaryLogEvent &event)
+    {
+        while (m_valid && m_pos < m_end)
+        {
+            uint8_t tag = *m_pos++;
+            if (tag == BINLOG_TAG_SITE)
+            {
+                uint64_t id, line;
+                BinaryLogSite site;
+                if (!ReadVarint(m_pos, m_end, id) || !ReadVarint(m_pos, m_end, line) ||
+                    !ReadString(site.file, site.fileLength) || !ReadString(site.function, site.functionLength) ||
+                    id > 0xFFFFFF)
+                {
+                    return Fail();
+                }
+                site.line = static_cast<uint32_t>(line);
+                if (id >= m_sites.size())
+                {
+                    m_sites.resize(id + 1);
+                }
+                m_sites[id] = site;
+                continue;
+            }
+
+            int64_t delta;
+            if (!ReadSignedVarint(m_pos, m_end, delta))
+            {
+                return Fail();
+            }
+            m_timestampUs += delta;
+            event.timestampUs = m_timestampUs;
+
+            if (tag == BINLOG_TAG_SESSION)
+            {
+                event.tag = BINLOG_TAG_SESSION;
+                event.site = nullptr;
+                event.level = 0;
+                event.message = nullptr;
+                event.messageLength = 0;
+                return true;
+            }
+
+            uint64_t siteId;
+            if (tag != BINLOG_TAG_EVENT || !ReadVarint(m_pos, m_end, siteId) ||
+                siteId >= m_sites.size() || m_pos >= m_end)
+            {
+                return Fail();
+            }
+            event.tag = BINLOG_TAG_EVENT;
+            event.site = &m_sites[siteId];
+            event.level = static_cast<int>(*m_pos++) - 1;
+            if (!ReadString(event.message, event.messageLength))
+            {
+                return Fail();
+            }
+            return true;
+        }
+        return false;
+    }
+
+private:
+    bool ReadString(const char *&text, size_t &length)
+    {
+        uint64_t n;
+        if (!ReadVarint(m_pos, m_end, n) || n > static_cast<uint64_t>(m_end - m_pos))
+        {
+            return false;
+        }
+        text = reinterpret_cast<const char *>(m_pos);
+        length = static_cast<size_t>(n);
+        m_pos += n;
+        return true;
+    }
+
+    bool Fail()
+    {
+        m_valid = false;
+        return false;
+    }
+
+    const uint8_t *m_pos;
+    const uint8_t *m_end;
+    int64_t m_timestampUs;
+    bool m_valid;
+    std::vector<BinaryLogSite> m_sites;
+};
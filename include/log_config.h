@@ -7,13 +7,40 @@ enum LogLevel
     ERR        // Error - actual problems
 };
 
-// Minimum log level to output
+// Minimum log level compiled in; lower levels compile to nothing
 #define MIN_LOG_LEVEL INF
 
-// Default log file path and size
+// Default log file path and size. The log is written as numbered segments
+// (keyboard_checker.1.log, keyboard_checker.2.log, ...) and the total size is
+// capped by keeping at most DEFAULT_MAX_LOG_SEGMENTS of them.
 #define DEFAULT_LOG_PATH L"logs/keyboard_checker.log"
 #define DEFAULT_MAX_LOG_SIZE (1 * 1024 * 1024)  // 1MB
+#define DEFAULT_MAX_LOG_SEGMENTS 5
+
+// Separator line written at the start of every session
+#define LOG_SESSION_MARKER "=== New Session Started ==="
 
 // Output configuration
 #define LOG_TO_CONSOLE false  // Disable console logging
 #define LOG_TO_FILE true     // Keep file logging
+
+// What a producer does when the async log ring is full
+enum LogOverflowPolicy
+{
+    LOG_OVERFLOW_DROP,   // Discard the record silently
+    LOG_OVERFLOW_BLOCK,  // Wait for the writer thread to make room
+    LOG_OVERFLOW_COUNT   // Discard the record and log how many were dropped
+};
+
+// Asynchronous logging: records are formatted by the caller and written to
+// disk in batches by a background thread that keeps the log file open
+#define LOG_ASYNC true
+#define LOG_RING_CAPACITY 4096  // Records, rounded up to a power of two
+#define LOG_WRITER_BATCH 256    // Records written between flushes
+#define LOG_WRITER_IDLE_MS 50   // Writer wake-up interval when idle
+#define LOG_OVERFLOW_POLICY LOG_OVERFLOW_COUNT
+
+// Rate limits per LOG call site, for DBG, INF, WRN and ERR: {burst lines,
+// sustained lines per second (0 = unlimited), summary interval in ms}.
+// Lines over the limit are counted and reported in one summary line per interval.
+#define LOG_RATE_LIMITS {{20, 5, 10000}, {50, 10, 10000}, {50, 10, 10000}, {100, 20, 10000}}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "log_config.h"
+
+struct LogSite;
+
+// Per-level limits for each LOG call site
+struct LogRateLimit
+{
+    uint32_t burst;      // Lines a quiet site may write back to back
+    uint32_t perSecond;  // Sustained lines per second; 0 means unlimited
+    uint32_t summaryMs;  // How long suppressed lines are counted before one summary line
+};
+
+inline int64_t LogRateClockUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Token bucket for one call site, kept as the time the bucket is next full
+// (GCRA), so admitting a line is one compare-and-swap on one atomic.
+// Suppressed lines are counted; the first one registers the site so the log
+// writer can report the count once the summary interval has passed.
+// Constant-initialized, so a function-local static costs no guard.
+class LogRateLimiter
+{
+public:
+    constexpr LogRateLimiter()
+        : m_nextUs(0), m_suppressed(0), m_windowStartUs(0), m_site(nullptr), m_level(INF), m_registered(false),
+          m_next(nullptr)
+    {
+    }
+
+    LogRateLimiter(const LogRateLimiter &) = delete;
+    LogRateLimiter &operator=(const LogRateLimiter &) = delete;
+
+    static const LogRateLimit &Limit(LogLevel level) { return s_limits[level - DBG]; }
+
+    // Like Logger::Initialize, call before other threads log
+    static void SetLimit(LogLevel level, const LogRateLimit &limit)
+    {
+        s_limits[level - DBG] = limit;
+        s_limits[level - DBG].burst = limit.burst > 0 ? limit.burst : 1;
+    }
+
+    // Whether the site may write a line now
+    bool Admit(LogLevel level, const LogSite &site)
+    {
+        const LogRateLimit &limit = Limit(level);
+        if (limit.perSecond == 0)
+        {
+            return true;
+        }
+
+        int64_t now = LogRateClockUs();
+        int64_t interval = 1000000 / limit.perSecond;
+        int64_t tolerance = interval * (limit.burst - 1);
+        int64_t next = m_nextUs.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            int64_t start = next > now ? next : now;
+            if (start - now > tolerance)
+            {
+                Suppress(level, site, now);
+                return false;
+            }
+            if (m_nextUs.compare_exchange_weak(next, start + interval, std::memory_order_relaxed))
+            {
+                return true;
+            }
+        }
+    }
+
+    // Calls report(site, level, count, windowUs) for every site whose
+    // suppressed lines are due for a summary, or for all of them if flush
+    template <typename Report>
+    static void ReportSuppressed(bool flush, Report report)
+    {
+        int64_t now = LogRateClockUs();
+        for (LogRateLimiter *limiter = s_head.load(std::memory_order_acquire); limiter; limiter = limiter->m_next)
+        {
+            if (limiter->m_suppressed.load(std::memory_order_relaxed) == 0)
+            {
+                continue;
+            }
+            int64_t windowUs = now - limiter->m_windowStartUs.load(std::memory_order_relaxed);
+            if (!flush && windowUs < static_cast<int64_t>(Limit(limiter->m_level).summaryMs) * 1000)
+            {
+                continue;
+            }
+            uint64_t count = limiter->m_suppressed.exchange(0, std::memory_order_relaxed);
+            if (count > 0)
+            {
+                report(*limiter->m_site, limiter->m_level, count, windowUs);
+            }
+        }
+    }
+
+private:
+    void Suppress(LogLevel level, const LogSite &site, int64_t now)
+    {
+        if (m_suppressed.fetch_add(1, std::memory_order_relaxed) == 0)
+        {
+            m_windowStartUs.store(now, std::memory_order_relaxed);
+        }
+        if (!m_registered.exchange(true, std::memory_order_relaxed))
+        {
+            m_site = &site;
+            m_level = level;
+            LogRateLimiter *head = s_head.load(std::memory_order_relaxed);
+            do
+            {
+                m_next = head;
+            } while (!s_head.compare_exchange_weak(head, this, std::memory_order_release, std::memory_order_relaxed));
+        }
+    }
+
+    std::atomic<int64_t> m_nextUs;       // When the bucket is full again
+    std::atomic<uint64_t> m_suppressed;  // Since the last summary
+    std::atomic<int64_t> m_windowStartUs;
+    const LogSite *m_site;               // Set once, before the site is registered
+    LogLevel m_level;
+    std::atomic<bool> m_registered;
+    LogRateLimiter *m_next;
+
+    static inline std::atomic<LogRateLimiter *> s_head{nullptr};
+    static inline LogRateLimit s_limits[ERR - DBG + 1] = LOG_RATE_LIMITS;
+};
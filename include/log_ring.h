@@ -0,0 +1,117 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+
+struct LogSite;
+
+// Size of one log record, including its header
+const size_t LOG_RECORD_SIZE = 512;
+
+// One log event as captured by the calling thread. The message is already
+// rendered to UTF-8; the line prefix is formatted by whichever sink writes it.
+struct LogRecord
+{
+    int64_t timestampUs;   // Microseconds since the Unix epoch
+    const LogSite *site;   // Static per call site
+    int16_t level;
+    uint16_t length;       // Bytes used in text
+    char text[LOG_RECORD_SIZE - 2 * sizeof(int64_t) - 2 * sizeof(uint16_t)];
+};
+
+const size_t LOG_RECORD_HEADER_SIZE = offsetof(LogRecord, text);
+
+// Bounded lock-free multi-producer/single-consumer ring of log records.
+// Each slot carries a sequence number (Vyukov's bounded queue), so producers
+// claim a slot with one CAS and never wait on each other or on the consumer.
+class LogRing
+{
+public:
+    explicit LogRing(size_t capacity)
+        : m_capacity(RoundUpToPowerOfTwo(capacity)),
+          m_mask(m_capacity - 1),
+          m_slots(new Slot[m_capacity]),
+          m_head(0),
+          m_tail(0)
+    {
+        for (size_t i = 0; i < m_capacity; i++)
+        {
+            m_slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    LogRing(const LogRing &) = delete;
+    LogRing &operator=(const LogRing &) = delete;
+
+    // Returns false if the ring is full
+    bool TryPush(const LogRecord &record)
+    {
+        size_t pos = m_tail.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Slot &slot = m_slots[pos & m_mask];
+            size_t seq = slot.sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(seq) - static_cast<intptr_t>(pos);
+            if (diff == 0)
+            {
+                if (m_tail.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    memcpy(&slot.record, &record, LOG_RECORD_HEADER_SIZE + record.length);
+                    slot.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                pos = m_tail.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer side only. Returns false if the ring is empty.
+    bool TryPop(LogRecord &record)
+    {
+        Slot &slot = m_slots[m_head & m_mask];
+        size_t seq = slot.sequence.load(std::memory_order_acquire);
+        if (seq != m_head + 1)
+        {
+            return false;
+        }
+        memcpy(&record, &slot.record, LOG_RECORD_HEADER_SIZE + slot.record.length);
+        slot.sequence.store(m_head + m_capacity, std::memory_order_release);
+        m_head++;
+        return true;
+    }
+
+    size_t Capacity() const { return m_capacity; }
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence;
+        LogRecord record;
+    };
+
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) size_t m_head;  // Owned by the consumer
+    alignas(64) std::atomic<size_t> m_tail;
+};
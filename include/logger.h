@@ -2,31 +2,193 @@
 
 #include <string>
 #include <fstream>
-#include <sstream>
 #include <chrono>
-#include <iomanip>
+#include <ctime>
+#include <cstdio>
+#include <cstring>
+#include <cwchar>
 #include <filesystem>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <vector>
+#include <algorithm>
+#include <unordered_map>
 #include "log_config.h"
-#include <iostream>
+#include "log_ring.h"
+#include "log_binary.h"
+#include "log_rate_limit.h"
+#include "span_trace.h"
 
-inline std::wstring LogLevelToString(LogLevel level)
+#ifdef _WIN32
+#define LOG_LINE_END "\r\n"
+#else
+#define LOG_LINE_END "\n"
+#endif
+
+// Block written to text logs at the start of every session
+#define LOG_SESSION_SEPARATOR                        \
+    LOG_LINE_END LOG_LINE_END                        \
+    "=====================================" LOG_LINE_END \
+    LOG_SESSION_MARKER LOG_LINE_END                  \
+    "=====================================" LOG_LINE_END LOG_LINE_END
+
+inline const char *LogLevelToString(LogLevel level)
 {
     switch (level)
     {
     case DBG:
-        return L"DBG";
+        return "DBG";
     case INF:
-        return L"INF";
+        return "INF";
     case WRN:
-        return L"WRN";
+        return "WRN";
     case ERR:
-        return L"ERR";
+        return "ERR";
     default:
-        return L"UNK";
+        return "UNK";
+    }
+}
+
+// Appends src to dst as UTF-8 starting at pos, stopping before capacity.
+// Returns the new position.
+inline size_t AppendUtf8(char *dst, size_t pos, size_t capacity, const wchar_t *src)
+{
+    for (; *src; src++)
+    {
+        uint32_t cp = static_cast<uint32_t>(*src);
+        if (cp >= 0xD800 && cp <= 0xDBFF && src[1] >= 0xDC00 && src[1] <= 0xDFFF)
+        {
+            cp = 0x10000 + ((cp - 0xD800) << 10) + (static_cast<uint32_t>(src[1]) - 0xDC00);
+            src++;
+        }
+
+        size_t needed = cp < 0x80 ? 1 : cp < 0x800 ? 2 : cp < 0x10000 ? 3 : 4;
+        if (pos + needed > capacity)
+        {
+            break;
+        }
+
+        if (needed == 1)
+        {
+            dst[pos++] = static_cast<char>(cp);
+        }
+        else if (needed == 2)
+        {
+            dst[pos++] = static_cast<char>(0xC0 | (cp >> 6));
+            dst[pos++] = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else if (needed == 3)
+        {
+            dst[pos++] = static_cast<char>(0xE0 | (cp >> 12));
+            dst[pos++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            dst[pos++] = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+        else
+        {
+            dst[pos++] = static_cast<char>(0xF0 | (cp >> 18));
+            dst[pos++] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+            dst[pos++] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            dst[pos++] = static_cast<char>(0x80 | (cp & 0x3F));
+        }
+    }
+    return pos;
+}
+
+inline FILE *OpenLogFile(const std::wstring &path, const wchar_t *mode)
+{
+#ifdef _WIN32
+    return _wfopen(path.c_str(), mode);
+#else
+    std::string narrowMode(mode, mode + wcslen(mode));
+    return fopen(std::filesystem::path(path).string().c_str(), narrowMode.c_str());
+#endif
+}
+
+inline void ToLocalTime(time_t time, std::tm &tm)
+{
+#ifdef _WIN32
+    localtime_s(&tm, &time);
+#else
+    localtime_r(&time, &tm);
+#endif
+}
+
+inline int64_t CurrentTimestampUs()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+}
+
+// Writes "YYYY-mm-dd HH:MM:SS.mmm" in local time. Returns its length.
+inline size_t FormatLogTime(char *dst, size_t capacity, int64_t timestampUs)
+{
+    std::tm tm;
+    ToLocalTime(static_cast<time_t>(timestampUs / 1000000), tm);
+    int millis = static_cast<int>((timestampUs / 1000) % 1000);
+
+    int written = snprintf(dst, capacity, "%04d-%02d-%02d %02d:%02d:%02d.%03d",
+                           tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday,
+                           tm.tm_hour, tm.tm_min, tm.tm_sec, millis);
+    return written > 0 ? std::min(static_cast<size_t>(written), capacity - 1) : 0;
+}
+
+// Writes the "<time> [LVL] " prefix of a text log line. Returns its length.
+inline size_t FormatLogPrefix(char *dst, size_t capacity, int64_t timestampUs, LogLevel level)
+{
+    size_t pos = FormatLogTime(dst, capacity, timestampUs);
+    int written = snprintf(dst + pos, capacity - pos, " [%s] ", LogLevelToString(level));
+    return written > 0 ? std::min(pos + static_cast<size_t>(written), capacity - 1) : pos;
+}
+
+// Compile-time wide copy of a narrow string literal, starting at offset
+template <size_t N>
+struct WideLiteral
+{
+    wchar_t text[N];
+
+    constexpr WideLiteral(const char (&str)[N], size_t offset = 0)
+        : text{}
+    {
+        for (size_t i = 0; offset + i < N; i++)
+        {
+            text[i] = static_cast<wchar_t>(static_cast<unsigned char>(str[offset + i]));
+        }
     }
+};
+
+// Offset of the file name within a path
+constexpr size_t BaseNameOffset(const char *path)
+{
+    size_t offset = 0;
+    for (size_t i = 0; path[i]; i++)
+    {
+        if (path[i] == '/' || path[i] == '\\')
+        {
+            offset = i + 1;
+        }
+    }
+    return offset;
 }
 
+// Where a log statement lives. One static constant per call site.
+struct LogSite
+{
+    const wchar_t *file;  // File name only
+    const wchar_t *function;
+    int line;
+};
+
+// Start of a logging session within the segmented log
+struct LogSessionEntry
+{
+    uint32_t segment;  // N in <stem>.N<ext>
+    uint64_t offset;   // Byte offset of the session separator in that segment
+    time_t started;
+};
+
 class Logger
 {
 public:
@@ -36,145 +198,640 @@ public:
         return instance;
     }
 
-    void Initialize(const std::wstring &logFile = DEFAULT_LOG_PATH, size_t maxSizeBytes = DEFAULT_MAX_LOG_SIZE)
+    // maxSizeBytes bounds the whole log; it is split evenly over maxSegments
+    // files named <stem>.N<ext>, and the oldest segment is deleted on roll-over.
+    // A log file ending in BINARY_LOG_EXTENSION is written in the compact
+    // binary format (see log_binary.h) instead of text.
+    void Initialize(const std::wstring &logFile = DEFAULT_LOG_PATH, size_t maxSizeBytes = DEFAULT_MAX_LOG_SIZE,
+                    size_t maxSegments = DEFAULT_MAX_LOG_SEGMENTS,
+                    bool async = LOG_ASYNC, LogOverflowPolicy overflowPolicy = LOG_OVERFLOW_POLICY)
     {
+        Shutdown();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
         m_logFile = logFile;
-        m_maxSizeBytes = maxSizeBytes;
+        m_maxSegments = maxSegments > 0 ? maxSegments : 1;
+        m_segmentBytes = std::max<size_t>(maxSizeBytes / m_maxSegments, 1);
+        m_overflowPolicy = overflowPolicy;
+        m_async = async;
+        m_binary = std::filesystem::path(logFile).extension() == BINARY_LOG_EXTENSION;
 
         // Create logs directory if it doesn't exist
-        std::filesystem::create_directories(std::filesystem::path(logFile).parent_path());
+        std::error_code ec;
+        std::filesystem::create_directories(std::filesystem::path(logFile).parent_path(), ec);
 
-        // Add session separator
-        std::wofstream logStream(m_logFile.c_str(), std::ios::app);
-        if (logStream.is_open())
+        // Continue the newest existing segment
+        m_segment = FindNewestSegment();
+        OpenSegment();
+        if (m_segmentWritten >= m_segmentBytes)
         {
-            logStream << L"\n\n";
-            logStream << L"=====================================\n";
-            logStream << L"=== New Session Started ===\n";
-            logStream << L"=====================================\n\n";
-            logStream.close();
+            RollSegment();
         }
 
-        CheckAndRotateLog();
+        if (m_file)
+        {
+            AppendSessionIndex(m_segment, m_segmentWritten);
+
+            // Add session separator
+            if (m_binary)
+            {
+                uint8_t record[1 + BINLOG_MAX_VARINT];
+                int64_t now = CurrentTimestampUs();
+                record[0] = BINLOG_TAG_SESSION;
+                size_t length = 1 + WriteSignedVarint(record + 1, now - m_lastTimestampUs);
+                m_lastTimestampUs = now;
+                WriteBytes(record, length);
+            }
+            else
+            {
+                const char separator[] = LOG_SESSION_SEPARATOR;
+                WriteBytes(separator, sizeof(separator) - 1);
+            }
+            fflush(m_file);
+        }
+
+        if (m_async)
+        {
+            m_stopWriter.store(false, std::memory_order_relaxed);
+            m_writer = std::thread(&Logger::WriterLoop, this);
+        }
+        m_accepting.store(true, std::memory_order_release);
     }
 
-    void Log(LogLevel level, const std::wstring &message, const wchar_t *file, int line, const wchar_t *funcName)
+    // Session start positions from the session index, oldest first.
+    // Entries whose segment has been deleted are skipped.
+    std::vector<LogSessionEntry> Sessions()
     {
         std::lock_guard<std::mutex> lock(m_mutex);
+        std::vector<LogSessionEntry> sessions = ReadSessionIndex();
+        sessions.erase(std::remove_if(sessions.begin(), sessions.end(),
+                                      [this](const LogSessionEntry &entry)
+                                      { return !IsLiveSegment(entry.segment); }),
+                       sessions.end());
+        return sessions;
+    }
 
-        auto now = std::chrono::system_clock::now();
-        auto time = std::chrono::system_clock::to_time_t(now);
+    std::wstring SegmentPath(uint32_t segment) const
+    {
+        std::filesystem::path path(m_logFile);
+        std::filesystem::path name = path.stem();
+        name += L"." + std::to_wstring(segment);
+        name += path.extension();
+        return (path.parent_path() / name).wstring();
+    }
 
-        std::wstringstream ss;
-        std::tm tm;
-        localtime_s(&tm, &time);
+    // Runtime filter on top of MIN_LOG_LEVEL, checked by the LOG macros
+    static bool IsEnabled(LogLevel level)
+    {
+        return level >= s_runtimeLevel.load(std::memory_order_relaxed);
+    }
 
-        ss << std::put_time(&tm, L"%Y-%m-%d %H:%M:%S.")
-           << std::setfill(L'0') << std::setw(3)
-           << std::chrono::duration_cast<std::chrono::milliseconds>(
-                  now.time_since_epoch())
-                      .count() %
-                  1000;
+    static void SetLevel(LogLevel level)
+    {
+        s_runtimeLevel.store(level, std::memory_order_relaxed);
+    }
 
-        ss << L" [" << LogLevelToString(level) << L"] ";
+    // Per-call-site rate limit for a level, checked by the LOG macros.
+    // Call before other threads log.
+    static void SetRateLimit(LogLevel level, const LogRateLimit &limit)
+    {
+        LogRateLimiter::SetLimit(level, limit);
+    }
 
-        // Convert file path to wstring and get filename only
-        std::filesystem::path filePath(file);
-        std::wstring fileName = filePath.filename().wstring();
-        ss << L"[" << fileName << L":" << funcName << L"] [" << line << L"] " << message;
+    void Log(LogLevel level, const std::wstring &message, const LogSite &site)
+    {
+        Log(level, message.c_str(), site);
+    }
 
-        if (LOG_TO_CONSOLE)
+    void Log(LogLevel level, const wchar_t *message, const LogSite &site)
+    {
+        // Each side of the handshake with Shutdown stores and then loads, so
+        // both need seq_cst; with acquire/release a store can still sit in
+        // the store buffer when the other side's load runs
+        m_activeProducers.fetch_add(1, std::memory_order_seq_cst);
+        if (m_accepting.load(std::memory_order_seq_cst))
         {
-            std::wcout << ss.str() << std::endl;
+            LogRecord record;
+            CaptureRecord(record, level, message, site);
+
+            if (LOG_TO_FILE || LOG_TO_CONSOLE)
+            {
+                if (m_async)
+                {
+                    Enqueue(record);
+                }
+                else
+                {
+                    std::lock_guard<std::mutex> lock(m_mutex);
+                    WriteRecord(record);
+                    ReportSuppressed(false);
+                    if (m_file)
+                    {
+                        fflush(m_file);
+                    }
+                }
+            }
         }
+        m_activeProducers.fetch_sub(1, std::memory_order_release);
+    }
 
-        if (LOG_TO_FILE)
+    // Blocks until every record logged so far is on disk
+    void Flush()
+    {
+        if (!m_async)
         {
-            std::wofstream logStream(m_logFile.c_str(), std::ios::app);
-            if (logStream.is_open())
-            {
-                logStream << ss.str() << std::endl;
-                logStream.close();
+            return;
+        }
+        uint64_t target = m_enqueued.load(std::memory_order_acquire);
+        while (m_written.load(std::memory_order_acquire) < target && m_writer.joinable())
+        {
+            m_wake.notify_one();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    }
 
-                CheckAndRotateLog();
-            }
+    // Stops accepting records, writes everything still queued and closes the file
+    void Shutdown()
+    {
+        m_accepting.store(false, std::memory_order_seq_cst);
+        while (m_activeProducers.load(std::memory_order_seq_cst) != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        if (m_writer.joinable())
+        {
+            m_stopWriter.store(true, std::memory_order_release);
+            m_wake.notify_one();
+            m_writer.join();
+        }
+
+        // Nothing can be queued any more; write whatever the writer's last
+        // pass did not see
+        std::lock_guard<std::mutex> lock(m_mutex);
+        LogRecord record;
+        uint64_t drained = 0;
+        while (m_ring.TryPop(record))
+        {
+            WriteRecord(record);
+            drained++;
+        }
+        m_written.fetch_add(drained, std::memory_order_release);
+        if (m_file)
+        {
+            ReportSuppressed(true);
+            fclose(m_file);
+            m_file = nullptr;
         }
     }
 
+    uint64_t DroppedCount() const { return m_dropped.load(std::memory_order_relaxed); }
+
 private:
-    Logger() = default;
-    ~Logger() = default;
+    Logger()
+        : m_segmentBytes(DEFAULT_MAX_LOG_SIZE / DEFAULT_MAX_LOG_SEGMENTS),
+          m_maxSegments(DEFAULT_MAX_LOG_SEGMENTS),
+          m_segment(1),
+          m_segmentWritten(0),
+          m_file(nullptr),
+          m_async(false),
+          m_binary(false),
+          m_overflowPolicy(LOG_OVERFLOW_POLICY),
+          m_lastTimestampUs(0),
+          m_ring(LOG_RING_CAPACITY),
+          m_accepting(false),
+          m_activeProducers(0),
+          m_stopWriter(false),
+          m_writerSleeping(false),
+          m_enqueued(0),
+          m_written(0),
+          m_dropped(0),
+          m_reportedDrops(0)
+    {
+    }
+
+    ~Logger()
+    {
+        Shutdown();
+    }
+
     Logger(const Logger &) = delete;
     Logger &operator=(const Logger &) = delete;
 
-    void CheckAndRotateLog()
+    // Fills a record on the calling thread: timestamp, site and the message
+    // as UTF-8, truncated to the record size
+    static void CaptureRecord(LogRecord &record, LogLevel level, const wchar_t *message, const LogSite &site)
+    {
+        record.timestampUs = CurrentTimestampUs();
+        record.site = &site;
+        record.level = static_cast<int16_t>(level);
+        record.length = static_cast<uint16_t>(AppendUtf8(record.text, 0, sizeof(record.text), message));
+    }
+
+    // Formats a complete text log line for a record. Returns its length.
+    static size_t FormatTextLine(char *line, size_t capacity, const LogRecord &record)
     {
-        try
+        const size_t lineCapacity = capacity - (sizeof(LOG_LINE_END) - 1);
+        size_t pos = FormatLogPrefix(line, lineCapacity, record.timestampUs, static_cast<LogLevel>(record.level));
+
+        pos = AppendUtf8(line, pos, lineCapacity, L"[");
+        pos = AppendUtf8(line, pos, lineCapacity, record.site->file);
+        pos = AppendUtf8(line, pos, lineCapacity, L":");
+        pos = AppendUtf8(line, pos, lineCapacity, record.site->function);
+
+        char lineText[24];
+        snprintf(lineText, sizeof(lineText), "] [%d] ", record.site->line);
+        size_t lineLength = strlen(lineText);
+        if (pos + lineLength <= lineCapacity)
+        {
+            memcpy(line + pos, lineText, lineLength);
+            pos += lineLength;
+        }
+        size_t messageLength = std::min<size_t>(record.length, lineCapacity - pos);
+        memcpy(line + pos, record.text, messageLength);
+        pos += messageLength;
+
+        memcpy(line + pos, LOG_LINE_END, sizeof(LOG_LINE_END) - 1);
+        return pos + sizeof(LOG_LINE_END) - 1;
+    }
+
+    void Enqueue(const LogRecord &record)
+    {
+        while (!m_ring.TryPush(record))
         {
-            std::filesystem::path logPath(m_logFile);
-            if (!std::filesystem::exists(logPath))
+            if (m_overflowPolicy != LOG_OVERFLOW_BLOCK)
             {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
                 return;
             }
+            m_wake.notify_one();
+            std::this_thread::yield();
+        }
+
+        m_enqueued.fetch_add(1, std::memory_order_release);
+        if (m_writerSleeping.load(std::memory_order_relaxed))
+        {
+            m_wake.notify_one();
+        }
+    }
+
+    // Called with m_mutex held
+    void WriteRecord(const LogRecord &record)
+    {
+        char line[LOG_RECORD_SIZE + 256];
+        size_t lineLength = 0;
+        if (!m_binary || LOG_TO_CONSOLE)
+        {
+            lineLength = FormatTextLine(line, sizeof(line), record);
+        }
+
+        if (LOG_TO_CONSOLE)
+        {
+            fwrite(line, 1, lineLength, stdout);
+        }
 
-            size_t currentSize = std::filesystem::file_size(logPath);
-            if (currentSize > m_maxSizeBytes)
+        if (!LOG_TO_FILE || !m_file)
+        {
+            return;
+        }
+
+        if (m_binary)
+        {
+            WriteBinaryRecord(record);
+        }
+        else
+        {
+            WriteBytes(line, lineLength);
+        }
+
+        if (m_segmentWritten >= m_segmentBytes)
+        {
+            RollSegment();
+        }
+    }
+
+    // Called with m_mutex held
+    void WriteBinaryRecord(const LogRecord &record)
+    {
+        uint8_t buffer[LOG_RECORD_SIZE + 4 * BINLOG_MAX_VARINT];
+
+        // Define the site the first time this segment sees it
+        auto it = m_siteIds.find(record.site);
+        if (it == m_siteIds.end())
+        {
+            uint32_t id = static_cast<uint32_t>(m_siteIds.size());
+            it = m_siteIds.emplace(record.site, id).first;
+
+            char file[256];
+            char function[256];
+            size_t fileLength = AppendUtf8(file, 0, sizeof(file), record.site->file);
+            size_t functionLength = AppendUtf8(function, 0, sizeof(function), record.site->function);
+
+            size_t n = 0;
+            buffer[n++] = BINLOG_TAG_SITE;
+            n += WriteVarint(buffer + n, id);
+            n += WriteVarint(buffer + n, static_cast<uint64_t>(record.site->line));
+            n += WriteVarint(buffer + n, fileLength);
+            memcpy(buffer + n, file, fileLength);
+            n += fileLength;
+            n += WriteVarint(buffer + n, functionLength);
+            memcpy(buffer + n, function, functionLength);
+            n += functionLength;
+            WriteBytes(buffer, n);
+        }
+
+        size_t n = 0;
+        buffer[n++] = BINLOG_TAG_EVENT;
+        n += WriteSignedVarint(buffer + n, record.timestampUs - m_lastTimestampUs);
+        n += WriteVarint(buffer + n, it->second);
+        buffer[n++] = static_cast<uint8_t>(record.level + 1);
+        n += WriteVarint(buffer + n, record.length);
+        memcpy(buffer + n, record.text, record.length);
+        n += record.length;
+        WriteBytes(buffer, n);
+        m_lastTimestampUs = record.timestampUs;
+    }
+
+    // Called with m_mutex held
+    void WriteBytes(const void *data, size_t length)
+    {
+        fwrite(data, 1, length, m_file);
+        m_segmentWritten += length;
+    }
+
+    void ReportDrops()
+    {
+        uint64_t dropped = m_dropped.load(std::memory_order_relaxed);
+        if (m_overflowPolicy != LOG_OVERFLOW_COUNT || dropped == m_reportedDrops)
+        {
+            return;
+        }
+
+        static const LogSite site = {L"logger.h", L"Logger::WriterLoop", __LINE__};
+        LogRecord record;
+        std::wstring message = std::to_wstring(dropped - m_reportedDrops) + L" log records dropped, ring full";
+        CaptureRecord(record, WRN, message.c_str(), site);
+        WriteRecord(record);
+        m_reportedDrops = dropped;
+    }
+
+    // Writes one line per call site whose suppressed lines are due for a
+    // summary, or for every one when flushing. Called with m_mutex held.
+    void ReportSuppressed(bool flush)
+    {
+        LogRateLimiter::ReportSuppressed(flush, [this](const LogSite &site, LogLevel level, uint64_t count, int64_t windowUs)
+        {
+            wchar_t message[128];
+            swprintf(message, sizeof(message) / sizeof(message[0]), L"%llu lines suppressed in the last %.1f s",
+                     static_cast<unsigned long long>(count), static_cast<double>(windowUs) / 1e6);
+            LogRecord record;
+            CaptureRecord(record, level, message, site);
+            WriteRecord(record);
+        });
+    }
+
+    // Background thread: drains the ring in batches into the open file
+    void WriterLoop()
+    {
+        LogRecord record;
+        for (;;)
+        {
+            bool stopping = m_stopWriter.load(std::memory_order_acquire);
+
+            size_t batch = 0;
             {
-                // Read the entire file
-                std::wifstream inFile(m_logFile.c_str());
-                std::wstring content((std::istreambuf_iterator<wchar_t>(inFile)),
-                                     std::istreambuf_iterator<wchar_t>());
-                inFile.close();
-
-                // Find the position after the second newest session marker
-                size_t lastSession = content.rfind(L"=== New Session Started ===");
-                if (lastSession != std::wstring::npos)
+                std::lock_guard<std::mutex> lock(m_mutex);
+                while (batch < LOG_WRITER_BATCH && m_ring.TryPop(record))
                 {
-                    lastSession = content.rfind(L"=== New Session Started ===", lastSession - 1);
+                    WriteRecord(record);
+                    batch++;
                 }
-
-                // If we found at least two sessions, truncate to keep only the newest
-                if (lastSession != std::wstring::npos)
+                ReportDrops();
+                ReportSuppressed(false);
+                if (batch > 0 && m_file)
                 {
-                    content = content.substr(lastSession);
-                    std::wofstream outFile(m_logFile.c_str(), std::ios::trunc);
-                    outFile << content;
-                    outFile.close();
+                    fflush(m_file);
                 }
             }
+            m_written.fetch_add(batch, std::memory_order_release);
+
+            if (batch == LOG_WRITER_BATCH)
+            {
+                continue;
+            }
+            if (stopping && batch == 0)
+            {
+                return;
+            }
+            if (batch == 0)
+            {
+                std::unique_lock<std::mutex> lock(m_wakeMutex);
+                m_writerSleeping.store(true, std::memory_order_relaxed);
+                m_wake.wait_for(lock, std::chrono::milliseconds(LOG_WRITER_IDLE_MS));
+                m_writerSleeping.store(false, std::memory_order_relaxed);
+            }
         }
-        catch (const std::exception &)
+    }
+
+    std::wstring SessionIndexPath() const
+    {
+        return std::filesystem::path(m_logFile).replace_extension(L".sessions").wstring();
+    }
+
+    bool IsLiveSegment(uint32_t segment) const
+    {
+        return segment <= m_segment && segment + m_maxSegments > m_segment;
+    }
+
+    // Highest N among existing <stem>.N<ext> files, or 1. Startup only.
+    uint32_t FindNewestSegment() const
+    {
+        std::filesystem::path path(m_logFile);
+        std::wstring prefix = path.stem().wstring() + L".";
+        std::wstring extension = path.extension().wstring();
+        uint32_t newest = 1;
+
+        std::error_code ec;
+        for (const auto &entry : std::filesystem::directory_iterator(path.parent_path(), ec))
         {
-            // Log rotation failed, but we'll continue anyway
+            std::wstring name = entry.path().filename().wstring();
+            if (name.size() <= prefix.size() + extension.size() ||
+                name.compare(0, prefix.size(), prefix) != 0 ||
+                name.compare(name.size() - extension.size(), extension.size(), extension) != 0)
+            {
+                continue;
+            }
+
+            std::wstring number = name.substr(prefix.size(), name.size() - prefix.size() - extension.size());
+            if (number.find_first_not_of(L"0123456789") == std::wstring::npos && number.size() < 10)
+            {
+                newest = std::max(newest, static_cast<uint32_t>(std::stoul(number)));
+            }
         }
+        return newest;
     }
 
-    std::wstring m_logFile;
-    size_t m_maxSizeBytes;
-    std::mutex m_mutex;
-};
+    // Called with m_mutex held
+    void OpenSegment()
+    {
+        m_file = OpenLogFile(SegmentPath(m_segment), L"ab");
+        m_segmentWritten = 0;
+        if (m_file && fseek(m_file, 0, SEEK_END) == 0)
+        {
+            long size = ftell(m_file);
+            m_segmentWritten = size > 0 ? static_cast<size_t>(size) : 0;
+        }
 
-// Helper function to convert char* to wstring
-inline std::wstring ToWString(const char* str)
-{
-    if (!str)
+        // Binary segments carry one process's site table, so never append to one
+        if (m_binary && m_segmentWritten > 0)
+        {
+            RollSegment();
+            return;
+        }
+
+        if (m_binary && m_file)
+        {
+            uint8_t header[BINLOG_HEADER_SIZE];
+            m_lastTimestampUs = CurrentTimestampUs();
+            WriteBinaryLogHeader(header, m_lastTimestampUs);
+            WriteBytes(header, sizeof(header));
+            m_siteIds.clear();
+        }
+    }
+
+    // Closes the full segment, starts the next one and deletes the one that
+    // falls out of the window. Never reads log content. Called with m_mutex held.
+    void RollSegment()
     {
-        return L"";
+        if (m_file)
+        {
+            fclose(m_file);
+            m_file = nullptr;
+        }
+
+        m_segment++;
+        if (m_segment > m_maxSegments)
+        {
+            std::error_code ec;
+            std::filesystem::remove(std::filesystem::path(SegmentPath(m_segment - m_maxSegments)), ec);
+        }
+        OpenSegment();
     }
 
-    size_t size = strlen(str) + 1;
-    std::wstring wstr(size, L'\0');
-    mbstowcs(&wstr[0], str, size);
-    return wstr;
-}
+    std::vector<LogSessionEntry> ReadSessionIndex() const
+    {
+        std::vector<LogSessionEntry> sessions;
+        std::ifstream index{std::filesystem::path(SessionIndexPath())};
+        LogSessionEntry entry;
+        long long started;
+        while (index >> entry.segment >> entry.offset >> started)
+        {
+            entry.started = static_cast<time_t>(started);
+            sessions.push_back(entry);
+        }
+        return sessions;
+    }
+
+    // Records where a session starts, dropping entries for deleted segments.
+    // Called with m_mutex held, once per Initialize.
+    void AppendSessionIndex(uint32_t segment, uint64_t offset)
+    {
+        std::vector<LogSessionEntry> sessions = ReadSessionIndex();
+        sessions.push_back({segment, offset, time(nullptr)});
+
+        std::ofstream index{std::filesystem::path(SessionIndexPath()), std::ios::trunc};
+        for (const LogSessionEntry &entry : sessions)
+        {
+            if (IsLiveSegment(entry.segment))
+            {
+                index << entry.segment << ' ' << entry.offset << ' ' << static_cast<long long>(entry.started) << '\n';
+            }
+        }
+    }
+
+    std::wstring m_logFile;  // Base path, segments are derived from it
+    size_t m_segmentBytes;
+    size_t m_maxSegments;
+    uint32_t m_segment;          // Index of the segment being written
+    size_t m_segmentWritten;     // Bytes in the current segment
+    std::mutex m_mutex;  // Guards the file
+    FILE *m_file;
+    bool m_async;
+    bool m_binary;
+    LogOverflowPolicy m_overflowPolicy;
+    std::unordered_map<const LogSite *, uint32_t> m_siteIds;  // Binary sink, per segment
+    int64_t m_lastTimestampUs;                                // Binary sink, delta base
+
+    LogRing m_ring;
+    std::atomic<bool> m_accepting;
+    std::atomic<int> m_activeProducers;
+    std::thread m_writer;
+    std::atomic<bool> m_stopWriter;
+    std::atomic<bool> m_writerSleeping;
+    std::mutex m_wakeMutex;
+    std::condition_variable m_wake;
+    std::atomic<uint64_t> m_enqueued;
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_dropped;
+    uint64_t m_reportedDrops;  // Writer thread only
+
+    static inline std::atomic<int> s_runtimeLevel{MIN_LOG_LEVEL};
+};
+
+// Defines a static LogSite named name for the current source location.
+// File name and function name are widened at compile time.
+#define LOG_SITE(name)                                                                                  \
+    static constexpr WideLiteral<sizeof(__FILE__)> name##File(__FILE__, BaseNameOffset(__FILE__));       \
+    static constexpr WideLiteral<sizeof(__FUNCTION__)> name##Function(__FUNCTION__);                    \
+    static constexpr LogSite name = {name##File.text, name##Function.text, __LINE__}
+
+// Logging macro. Levels below MIN_LOG_LEVEL compile to nothing, including the
+// message expression; enabled levels cost one relaxed load when filtered at runtime.
+// Each call site is rate limited (LOG_RATE_LIMITS); a suppressed line is
+// counted without evaluating the message.
+#define LOG(level, message)                                          \
+    do                                                               \
+    {                                                                \
+        if constexpr ((level) >= MIN_LOG_LEVEL)                      \
+        {                                                            \
+            if (Logger::IsEnabled(level))                            \
+            {                                                        \
+                LOG_SITE(logSite);                                   \
+                static LogRateLimiter logLimiter;                    \
+                if (logLimiter.Admit(level, logSite))                \
+                {                                                    \
+                    Logger::Instance().Log(level, message, logSite); \
+                }                                                    \
+            }                                                        \
+        }                                                            \
+    } while (0)
 
-// Function entry/exit macros
-#define FUNCTION_START \
-    Logger::Instance().Log(INF, L"Started", ToWString(__FILE__).c_str(), __LINE__, ToWString(__FUNCTION__).c_str())
+// Formatted logging for hot paths: the message is formatted with swprintf
+// into a stack buffer the size of a record, so no string is allocated.
+// The format is a wide literal; use %ls for wide strings.
+#define LOGF(level, format, ...)                                                                    \
+    do                                                                                              \
+    {                                                                                               \
+        if constexpr ((level) >= MIN_LOG_LEVEL)                                                     \
+        {                                                                                           \
+            if (Logger::IsEnabled(level))                                                           \
+            {                                                                                       \
+                LOG_SITE(logSite);                                                                  \
+                static LogRateLimiter logLimiter;                                                   \
+                if (logLimiter.Admit(level, logSite))                                               \
+                {                                                                                   \
+                    wchar_t logText[sizeof(LogRecord::text)];                                       \
+                    swprintf(logText, sizeof(logText) / sizeof(logText[0]), format, __VA_ARGS__);   \
+                    logText[sizeof(logText) / sizeof(logText[0]) - 1] = L'\0';                      \
+                    Logger::Instance().Log(level, static_cast<const wchar_t *>(logText), logSite);  \
+                }                                                                                   \
+            }                                                                                       \
+        }                                                                                           \
+    } while (0)
 
-#define FUNCTION_END \
-    Logger::Instance().Log(INF, L"Ended", ToWString(__FILE__).c_str(), __LINE__, ToWString(__FUNCTION__).c_str())
+// Function timing: FUNCTION_START opens a span that closes when the function
+// returns, however it returns. FUNCTION_END is kept for older call sites and
+// does nothing.
+#define FUNCTION_START TRACE_SPAN("function")
 
-// Logging macro
-#define LOG(level, message) \
-    Logger::Instance().Log(level, message, ToWString(__FILE__).c_str(), __LINE__, ToWString(__FUNCTION__).c_str())
+#define FUNCTION_END static_cast<void>(0)
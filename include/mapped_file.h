@@ -0,0 +1,45 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+
+// Rounds an offset up to the 4-byte alignment the mapped file formats keep
+// every section at, so their arrays can be read in place
+inline size_t AlignTo4(size_t offset)
+{
+    return (offset + 3) & ~static_cast<size_t>(3);
+}
+
+// Read-only view of a whole file mapped into memory.
+// Pages are loaded on first touch, so opening a large file is cheap.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Maps the file, closing any file mapped before. An empty file opens
+    // with no data.
+    bool Open(const std::filesystem::path &path);
+    void Close();
+
+    // Hints that the file will be read front to back, so the OS reads ahead
+    void AdviseSequential() const;
+
+    bool IsOpen() const { return m_open; }
+    const uint8_t *Data() const { return m_data; }
+    size_t Size() const { return m_size; }
+
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+    bool m_open;
+#ifdef _WIN32
+    void *m_file;
+    void *m_mapping;
+#endif
+};
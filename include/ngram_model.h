@@ -0,0 +1,121 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+
+// Character trigram models, one per language, used to tell which layout a
+// word was meant for.
+//
+// File layout (little-endian, every section 4-byte aligned so a mapped file
+// is used in place):
+//   NgramModelHeader
+//   NgramLanguageEntry[languageCount]
+//   per language: uint16 alphabet[symbolCount], then
+//                 uint16 cost[symbolCount^3] indexed by (prev2, prev1, symbol)
+// A cost is -log2 P(symbol | prev2, prev1), already smoothed by the builder,
+// so scoring a character is a single table read.
+
+#define NGRAM_MODEL_EXTENSION L".kbng"
+#define DEFAULT_NGRAM_MODEL_PATH L"keyboard_checker.kbng"
+
+const uint16_t NGRAM_MODEL_VERSION = 1;
+
+// Symbol 0 is the word boundary and 1 any character outside the alphabet
+const uint8_t NGRAM_SYMBOL_BOUNDARY = 0;
+const uint8_t NGRAM_SYMBOL_OTHER = 1;
+const uint32_t NGRAM_MAX_SYMBOLS = 64;
+
+// Costs are in thousandths of a bit
+const uint32_t NGRAM_COST_SCALE = 1000;
+
+struct NgramModelHeader
+{
+    char magic[4];  // "KBNG"
+    uint16_t version;
+    uint16_t languageCount;
+};
+
+struct NgramLanguageEntry
+{
+    uint16_t langId;  // Primary language ID, as in LayoutTable::LanguageId
+    uint16_t symbolCount;
+    uint32_t alphabetOffset;
+    uint32_t costOffset;
+};
+
+// Models only tell letter case apart where the script has it
+inline wchar_t NgramFoldCase(wchar_t ch)
+{
+    return (ch >= L'A' && ch <= L'Z') ? static_cast<wchar_t>(ch - L'A' + L'a') : ch;
+}
+
+inline bool NgramIsBoundary(wchar_t ch)
+{
+    return ch == L' ' || ch == L'\t' || ch == L'\r' || ch == L'\n';
+}
+
+// One language's model, pointing into the loaded file
+class NgramLanguageModel
+{
+public:
+    NgramLanguageModel(uint16_t langId, uint32_t symbolCount, const uint16_t *alphabet, const uint16_t *costs)
+        : m_langId(langId), m_symbolCount(symbolCount), m_alphabet(alphabet), m_costs(costs)
+    {
+    }
+
+    uint16_t LanguageId() const { return m_langId; }
+    uint32_t SymbolCount() const { return m_symbolCount; }
+
+    // Symbol for a character, NGRAM_SYMBOL_OTHER if it is not in the alphabet
+    uint8_t SymbolFor(wchar_t ch) const;
+
+    uint16_t Cost(uint8_t prev2, uint8_t prev1, uint8_t symbol) const
+    {
+        return m_costs[(static_cast<size_t>(prev2) * m_symbolCount + prev1) * m_symbolCount + symbol];
+    }
+
+private:
+    uint16_t m_langId;
+    uint32_t m_symbolCount;
+    const uint16_t *m_alphabet;  // Sorted after the two reserved symbols
+    const uint16_t *m_costs;
+};
+
+class NgramModel
+{
+public:
+    NgramModel() = default;
+    NgramModel(const NgramModel &) = delete;
+    NgramModel &operator=(const NgramModel &) = delete;
+
+    // Maps a model file. Returns false if it is missing or malformed.
+    bool Load(const std::filesystem::path &path);
+
+    // Uses a model already in memory; data must stay valid and 4-byte aligned
+    bool LoadFromMemory(const uint8_t *data, size_t size);
+
+    bool IsLoaded() const { return !m_languages.empty(); }
+    const NgramLanguageModel *FindLanguage(uint16_t langId) const;
+
+private:
+    MappedFile m_file;
+    std::vector<NgramLanguageModel> m_languages;
+};
+
+// Builds a model file from sample text
+class NgramModelBuilder
+{
+public:
+    void AddText(uint16_t langId, const std::wstring &text);
+
+    // Serialized model covering every language given text
+    std::vector<uint8_t> Build() const;
+
+private:
+    std::map<uint16_t, std::wstring> m_text;
+};
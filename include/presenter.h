@@ -0,0 +1,134 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "detection_engine.h"
+
+// Shortest time between two flushes, one display frame at 60 Hz
+const int64_t DEFAULT_PRESENTER_FRAME_US = 16667;
+
+// Quiet time before a change is shown; 0 shows it at the next frame
+const int64_t DEFAULT_PRESENTER_IDLE_US = 0;
+
+struct PresenterPolicy
+{
+    int64_t frameUs;
+    int64_t idleUs;  // Since the last update
+
+    explicit PresenterPolicy(int64_t frame = DEFAULT_PRESENTER_FRAME_US, int64_t idle = DEFAULT_PRESENTER_IDLE_US)
+        : frameUs(frame), idleUs(idle)
+    {
+    }
+};
+
+// A reported word as it reads in another layout
+struct PresenterConversion
+{
+    std::wstring layoutName;
+    std::wstring text;
+};
+
+// What the suggestion UI shows: the text typed so far, or a wrong-layout
+// word with its readings in the other layouts. Buffers only grow, so
+// reusing a view allocates nothing once it has held the longest text.
+struct PresenterView
+{
+    std::wstring text;
+    std::vector<PresenterConversion> conversions;  // The first conversionCount are in use
+    size_t conversionCount;
+
+    PresenterView() : conversionCount(0) {}
+
+    void Assign(const PresenterView &other);
+    bool operator==(const PresenterView &other) const;
+    bool operator!=(const PresenterView &other) const { return !(*this == other); }
+};
+
+// Where flushed views go. Called on the presenting thread only.
+class PresenterBackend
+{
+public:
+    virtual ~PresenterBackend() = default;
+    virtual void Present(const PresenterView &view, int64_t nowUs) = 0;
+};
+
+// Keeps the latest view and shows it at most once per frame. Updates
+// replace the pending view, so intermediate states are never shown, and a
+// flush is skipped when the view matches what is already on screen.
+//
+// One thread updates (the key worker); one presenting thread calls Tick,
+// first when an update asks to be woken and then whenever the delay Tick
+// returns runs out. Times default to KeyEventClockUs(); the replay tool
+// passes recorded time instead.
+class Presenter
+{
+public:
+    explicit Presenter(PresenterBackend &backend, const PresenterPolicy &policy = PresenterPolicy());
+
+    Presenter(const Presenter &) = delete;
+    Presenter &operator=(const Presenter &) = delete;
+
+    // Producer side. Both return true when the view changed while nothing
+    // was pending: the presenting thread should call Tick.
+    bool SetText(std::wstring_view text, int64_t nowUs = 0);
+    bool SetReport(const WrongLayoutReport &report, const DetectionEngine &engine, int64_t nowUs = 0);
+
+    // Presenting side. Flushes the pending view if it is due. Returns the
+    // microseconds until the pending view is due, or -1 if none is pending.
+    int64_t Tick(int64_t nowUs = 0);
+
+    const PresenterPolicy &Policy() const { return m_policy; }
+    const PresenterView &Shown() const { return m_shown; }  // Presenting thread only
+
+    uint64_t Updates() const { return m_updates.load(std::memory_order_relaxed); }
+    uint64_t Superseded() const { return m_superseded.load(std::memory_order_relaxed); }  // Replaced before shown
+    uint64_t Unchanged() const { return m_unchanged.load(std::memory_order_relaxed); }    // Matched the view already there
+    uint64_t Flushes() const { return m_flushes.load(std::memory_order_relaxed); }
+
+private:
+    bool Publish(int64_t nowUs);
+
+    PresenterBackend &m_backend;
+    PresenterPolicy m_policy;
+
+    PresenterView m_update;       // Producer only, built before it replaces m_pending
+
+    std::mutex m_mutex;           // Guards the members up to m_lastUpdateUs
+    PresenterView m_pending;      // Latest view, shown or not
+    bool m_dirty;                 // m_pending has not been flushed
+    int64_t m_pendingSinceUs;     // First update since the last flush
+    int64_t m_lastUpdateUs;
+
+    PresenterView m_shown;        // Presenting thread only
+    PresenterView m_flushing;
+    int64_t m_lastFlushUs;
+
+    std::atomic<uint64_t> m_updates;
+    std::atomic<uint64_t> m_superseded;
+    std::atomic<uint64_t> m_unchanged;
+    std::atomic<uint64_t> m_flushes;
+};
+
+// Keeps every flushed view, for counting UI updates on machines without one
+class RecordingPresenterBackend : public PresenterBackend
+{
+public:
+    struct Frame
+    {
+        int64_t timeUs;
+        PresenterView view;
+    };
+
+    void Present(const PresenterView &view, int64_t nowUs) override;
+
+    const std::vector<Frame> &Frames() const { return m_frames; }
+    void Clear() { m_frames.clear(); }
+
+private:
+    std::vector<Frame> m_frames;
+};
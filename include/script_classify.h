@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+// Script classes of a code unit, as bits so several can be allowed at once
+enum ScriptClass
+{
+    SCRIPT_CLASS_WHITESPACE = 1 << 0,  // Space, tab, CR, LF
+    SCRIPT_CLASS_ASCII = 1 << 1,       // Any other code unit below 0x80
+    SCRIPT_CLASS_HEBREW = 1 << 2,      // Hebrew block, U+0590..U+05FF
+    SCRIPT_CLASS_OTHER = 1 << 3
+};
+
+const uint32_t HEBREW_BLOCK_FIRST = 0x0590;
+const uint32_t HEBREW_BLOCK_LAST = 0x05FF;
+
+// Implementations of the classifier, fastest last
+enum ScriptKernel
+{
+    SCRIPT_KERNEL_SCALAR,
+    SCRIPT_KERNEL_SSE2,
+    SCRIPT_KERNEL_AVX2,
+    SCRIPT_KERNEL_COUNT
+};
+
+inline ScriptClass ClassifyCodeUnit(uint32_t unit)
+{
+    if (unit == 0x20 || unit == 0x09 || unit == 0x0A || unit == 0x0D)
+    {
+        return SCRIPT_CLASS_WHITESPACE;
+    }
+    if (unit < 0x80)
+    {
+        return SCRIPT_CLASS_ASCII;
+    }
+    if (unit >= HEBREW_BLOCK_FIRST && unit <= HEBREW_BLOCK_LAST)
+    {
+        return SCRIPT_CLASS_HEBREW;
+    }
+    return SCRIPT_CLASS_OTHER;
+}
+
+inline bool IsHebrewChar(wchar_t ch)
+{
+    return ClassifyCodeUnit(static_cast<uint32_t>(ch)) == SCRIPT_CLASS_HEBREW;
+}
+
+// Offset of the first code unit whose class is not in allowedClasses, or
+// length if every unit is allowed. Works on wchar_t units, UTF-16 on Windows.
+// Uses the fastest kernel the CPU supports.
+size_t FindFirstOutsideClasses(const wchar_t *text, size_t length, unsigned allowedClasses);
+
+// Same, with a given kernel, which must be supported
+size_t FindFirstOutsideClasses(const wchar_t *text, size_t length, unsigned allowedClasses, ScriptKernel kernel);
+
+bool IsScriptKernelSupported(ScriptKernel kernel);
+ScriptKernel ActiveScriptKernel();
+const char *ScriptKernelName(ScriptKernel kernel);
@@ -0,0 +1,138 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+// Wire format of kbserve, the batch detection service. Frames go both ways
+// over a stream socket: a ServeFrameHeader, whose size counts the bytes
+// after its own size field, then itemCount items. All fields are
+// little-endian, as on every platform this builds for, and packed with no
+// padding; text is UTF-16.
+//
+// Request item:  ServeItemHeader, then length 16-bit units of text or keys
+// Response item: ServeResultHeader, then length 16-bit units of text
+//
+// Clients may send any number of requests without waiting for answers.
+// Responses carry the request's id and can arrive in another order than
+// the requests did.
+
+#define DEFAULT_SERVE_SOCKET_PATH "/tmp/keyboard_checker.sock"
+
+// Largest frame either side accepts; a larger one closes the connection
+const uint32_t SERVE_MAX_FRAME = 1 << 20;
+
+// Longest item in units; longer items get SERVE_ITEM_TOO_LONG
+const uint16_t SERVE_MAX_ITEM_UNITS = 256;
+
+// Requests a connection may have unanswered before the service stops
+// reading from it; clients should keep fewer in flight
+const size_t SERVE_MAX_IN_FLIGHT = 256;
+
+enum ServeItemKind : uint8_t
+{
+    SERVE_ITEM_TEXT = 1,  // One word as text; the layout it was typed in is worked out
+    SERVE_ITEM_KEYS = 2   // One word as key presses in the item's layout
+};
+
+// A key press unit: the virtual-key code in the low byte, plus modifiers
+const uint16_t SERVE_KEY_SHIFT = 0x100;
+const uint16_t SERVE_KEY_ALTGR = 0x200;
+
+// Frame and item status
+enum ServeStatus : uint8_t
+{
+    SERVE_OK = 0,
+    SERVE_NO_LAYOUT = 1,          // No layout types the text, or the item's layout does not exist
+    SERVE_ITEM_TOO_LONG = 2,
+    SERVE_BAD_ITEM = 3,           // Unknown kind
+    SERVE_BAD_REQUEST = 4         // Frame status: the items do not fill the frame; none are answered
+};
+
+struct ServeFrameHeader
+{
+    uint32_t size;       // Bytes after this field
+    uint32_t requestId;  // Chosen by the client, echoed in the response
+    uint16_t itemCount;
+    uint16_t status;     // ServeStatus in responses, 0 in requests
+};
+
+struct ServeItemHeader
+{
+    uint8_t kind;    // ServeItemKind
+    uint8_t layout;  // Layout the keys were typed in; ignored for text
+    uint16_t length; // Units after the header
+};
+
+struct ServeResultHeader
+{
+    uint8_t status;       // ServeStatus
+    int8_t typedLayout;   // Layout index, -1 if none
+    int8_t bestLayout;    // Layout the word was meant for; typedLayout if it fits there
+    uint8_t wrongLayout;  // 1 if bestLayout differs from typedLayout
+    float margin;         // Bits per key by which the likeliest other layout reads better than
+                          // typedLayout, negative if it reads worse; 0 without a model
+    uint16_t length;      // Units of the word as it reads in bestLayout
+    uint16_t reserved;
+};
+
+static_assert(sizeof(ServeFrameHeader) == 12, "ServeFrameHeader must stay packed");
+static_assert(sizeof(ServeItemHeader) == 4, "ServeItemHeader must stay packed");
+static_assert(sizeof(ServeResultHeader) == 12, "ServeResultHeader must stay packed");
+
+// Byte size of a frame with its header, or 0 if data does not hold a whole one yet
+inline size_t ServeFrameBytes(const uint8_t *data, size_t size)
+{
+    uint32_t frameSize;
+    if (size < sizeof(frameSize))
+    {
+        return 0;
+    }
+    memcpy(&frameSize, data, sizeof(frameSize));
+    size_t total = sizeof(frameSize) + static_cast<size_t>(frameSize);
+    return size >= total ? total : 0;
+}
+
+// Builds one frame in a reused buffer: Begin, one Add per item, End
+class ServeFrameWriter
+{
+public:
+    explicit ServeFrameWriter(std::string &out) : m_out(out), m_start(0), m_items(0) {}
+
+    void Begin(uint32_t requestId, uint16_t status = SERVE_OK)
+    {
+        m_start = m_out.size();
+        m_items = 0;
+        ServeFrameHeader header = {0, requestId, 0, status};
+        Append(&header, sizeof(header));
+    }
+
+    // A ServeItemHeader in requests, a ServeResultHeader in responses
+    template <typename ItemHeader>
+    void Add(const ItemHeader &header, const uint16_t *units)
+    {
+        Append(&header, sizeof(header));
+        Append(units, header.length * sizeof(uint16_t));
+        m_items++;
+    }
+
+    // Fills in the size and item count
+    void End()
+    {
+        uint32_t size = static_cast<uint32_t>(m_out.size() - m_start - sizeof(uint32_t));
+        uint16_t items = static_cast<uint16_t>(m_items);
+        memcpy(&m_out[m_start], &size, sizeof(size));
+        memcpy(&m_out[m_start + offsetof(ServeFrameHeader, itemCount)], &items, sizeof(items));
+    }
+
+private:
+    void Append(const void *data, size_t size)
+    {
+        m_out.append(static_cast<const char *>(data), size);
+    }
+
+    std::string &m_out;
+    size_t m_start;
+    size_t m_items;
+};
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+// Most readers registered with one cell at a time
+const size_t SNAPSHOT_MAX_READERS = 32;
+
+// Holds the current version of an immutable object. Readers get it with two
+// atomic stores and a load, never a lock; writers replace it and free old
+// versions once no reader can still hold them (epoch-based reclamation).
+//
+// A reader publishes the global epoch in its slot before loading the
+// pointer and clears the slot when done. A replaced version is tagged with
+// the epoch current when it was unlinked, and is freed once every busy slot
+// shows a later epoch: those readers loaded the pointer after the swap.
+template <typename T>
+class SnapshotCell
+{
+    struct alignas(64) Slot
+    {
+        std::atomic<uint64_t> epoch;  // Epoch the reader entered at, 0 when not reading
+        std::atomic<bool> used;
+    };
+
+public:
+    // A registered reader; use each one from a single thread at a time
+    class Reader
+    {
+    public:
+        explicit Reader(SnapshotCell &cell)
+            : m_cell(cell), m_slot(cell.ClaimSlot())
+        {
+        }
+
+        ~Reader()
+        {
+            if (m_slot)
+            {
+                m_slot->epoch.store(0, std::memory_order_release);
+                m_slot->used.store(false, std::memory_order_release);
+            }
+        }
+
+        Reader(const Reader &) = delete;
+        Reader &operator=(const Reader &) = delete;
+
+        // False if every slot was taken; Acquire then returns nullptr
+        bool IsRegistered() const { return m_slot != nullptr; }
+
+        // The current version, valid until Release. Not reentrant.
+        const T *Acquire()
+        {
+            if (!m_slot)
+            {
+                return nullptr;
+            }
+            m_slot->epoch.store(m_cell.m_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            return m_cell.m_current.load(std::memory_order_seq_cst);
+        }
+
+        void Release()
+        {
+            if (m_slot)
+            {
+                m_slot->epoch.store(0, std::memory_order_release);
+            }
+        }
+
+    private:
+        SnapshotCell &m_cell;
+        Slot *m_slot;
+    };
+
+    // Holds the current version for one scope
+    class ReadLock
+    {
+    public:
+        explicit ReadLock(Reader &reader)
+            : m_reader(reader), m_value(reader.Acquire())
+        {
+        }
+
+        ~ReadLock() { m_reader.Release(); }
+
+        ReadLock(const ReadLock &) = delete;
+        ReadLock &operator=(const ReadLock &) = delete;
+
+        const T *Get() const { return m_value; }
+        const T *operator->() const { return m_value; }
+        explicit operator bool() const { return m_value != nullptr; }
+
+    private:
+        Reader &m_reader;
+        const T *m_value;
+    };
+
+    SnapshotCell()
+        : m_current(nullptr), m_epoch(1), m_reclaimed(0)
+    {
+        for (Slot &slot : m_slots)
+        {
+            slot.epoch.store(0, std::memory_order_relaxed);
+            slot.used.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    // No reader may be left
+    ~SnapshotCell()
+    {
+        delete m_current.load(std::memory_order_acquire);
+    }
+
+    SnapshotCell(const SnapshotCell &) = delete;
+    SnapshotCell &operator=(const SnapshotCell &) = delete;
+
+    // Makes value the current version. Writers are serialized; readers are not blocked.
+    void Publish(std::unique_ptr<T> value)
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        T *previous = m_current.exchange(value.release(), std::memory_order_seq_cst);
+        uint64_t unlinkedAt = m_epoch.fetch_add(1, std::memory_order_seq_cst);
+        if (previous)
+        {
+            m_retired.emplace_back(unlinkedAt, std::unique_ptr<T>(previous));
+        }
+        ReclaimLocked();
+    }
+
+    // Frees replaced versions no reader can still hold; returns how many.
+    // Publish does this too, but a version held by a slow reader waits
+    // until the next call.
+    size_t Reclaim()
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        return ReclaimLocked();
+    }
+
+    // Replaced versions not yet freed
+    size_t RetiredCount() const
+    {
+        std::lock_guard<std::mutex> lock(m_writeMutex);
+        return m_retired.size();
+    }
+
+    uint64_t ReclaimedCount() const { return m_reclaimed.load(std::memory_order_relaxed); }
+
+private:
+    Slot *ClaimSlot()
+    {
+        for (Slot &slot : m_slots)
+        {
+            bool expected = false;
+            if (slot.used.compare_exchange_strong(expected, true, std::memory_order_acq_rel))
+            {
+                return &slot;
+            }
+        }
+        return nullptr;
+    }
+
+    size_t ReclaimLocked()
+    {
+        // Oldest epoch any reader may still be using
+        uint64_t oldest = UINT64_MAX;
+        for (const Slot &slot : m_slots)
+        {
+            uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < oldest)
+            {
+                oldest = epoch;
+            }
+        }
+
+        size_t freed = 0;
+        for (size_t i = 0; i < m_retired.size();)
+        {
+            if (m_retired[i].first < oldest)
+            {
+                m_retired[i] = std::move(m_retired.back());
+                m_retired.pop_back();
+                freed++;
+            }
+            else
+            {
+                i++;
+            }
+        }
+        m_reclaimed.fetch_add(freed, std::memory_order_relaxed);
+        return freed;
+    }
+
+    std::atomic<T *> m_current;
+    alignas(64) std::atomic<uint64_t> m_epoch;
+    Slot m_slots[SNAPSHOT_MAX_READERS];
+    mutable std::mutex m_writeMutex;
+    std::vector<std::pair<uint64_t, std::unique_ptr<T>>> m_retired;  // Unlink epoch, version
+    std::atomic<uint64_t> m_reclaimed;
+};
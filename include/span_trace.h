@@ -0,0 +1,190 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "latency_histogram.h"
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define SPAN_CLOCK_TSC 1
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define SPAN_CLOCK_TSC 1
+#else
+#define SPAN_CLOCK_TSC 0
+#endif
+
+// Scoped timing spans for timeline views. A span records its start and end
+// in the calling thread's buffer when it closes, so spans nest, and early
+// returns and exceptions still close them. Timelines export as Chrome
+// trace-event JSON, which chrome://tracing and ui.perfetto.dev open.
+//
+// While tracing is off a span costs one relaxed load and a branch. Building
+// with SPAN_TRACE_COMPILED 0 removes spans altogether.
+
+#ifndef SPAN_TRACE_COMPILED
+#define SPAN_TRACE_COMPILED 1
+#endif
+
+// Spans kept per thread; later ones are counted as dropped
+const size_t SPAN_BUFFER_EVENTS = 1 << 16;
+
+#define DEFAULT_TIMELINE_PATH L"logs/timeline.json"
+
+struct SpanSite
+{
+    const char *name;
+    const char *category;
+};
+
+struct SpanEvent
+{
+    const SpanSite *site;
+    uint64_t beginTicks;
+    uint64_t endTicks;
+    uint32_t depth;  // Spans open around this one on its thread
+};
+
+// Span clock: the TSC where there is one, steady_clock nanoseconds elsewhere.
+// Ticks are converted to time when a timeline is exported.
+inline uint64_t SpanClockTicks()
+{
+#if SPAN_CLOCK_TSC
+    return __rdtsc();
+#else
+    return LatencyClockNs();
+#endif
+}
+
+// One thread's spans. Only the owning thread adds; published events never
+// change, so an export can read them while the thread keeps recording.
+class SpanBuffer
+{
+public:
+    SpanBuffer(uint32_t threadIndex, const char *threadName);
+
+    void Add(const SpanSite *site, uint64_t beginTicks, uint64_t endTicks, uint32_t depth)
+    {
+        size_t count = m_count.load(std::memory_order_relaxed);
+        if (count >= SPAN_BUFFER_EVENTS)
+        {
+            m_dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        m_events[count] = {site, beginTicks, endTicks, depth};
+        m_count.store(count + 1, std::memory_order_release);
+    }
+
+    size_t Count() const { return m_count.load(std::memory_order_acquire); }
+    const SpanEvent &Event(size_t index) const { return m_events[index]; }
+    uint64_t Dropped() const { return m_dropped.load(std::memory_order_relaxed); }
+    uint32_t ThreadIndex() const { return m_threadIndex; }
+    const char *ThreadName() const { return m_threadName; }
+
+    void Clear()
+    {
+        m_count.store(0, std::memory_order_relaxed);
+        m_dropped.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<SpanEvent[]> m_events;
+    std::atomic<size_t> m_count;
+    std::atomic<uint64_t> m_dropped;
+    uint32_t m_threadIndex;
+    const char *m_threadName;
+};
+
+class SpanTrace
+{
+public:
+    static SpanTrace &Instance()
+    {
+        static SpanTrace instance;
+        return instance;
+    }
+
+    static bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    void Enable();
+    void Disable() { s_enabled.store(false, std::memory_order_relaxed); }
+
+    // Names the calling thread in timelines; name must be a literal.
+    // Call before the thread's first span.
+    static void SetThreadName(const char *name);
+
+    // The calling thread's buffer, created on its first span
+    SpanBuffer &ThreadBuffer();
+
+    uint64_t EventCount() const;
+    uint64_t DroppedCount() const;
+
+    // Empties every buffer. Only while no other thread records spans.
+    void Clear();
+
+    std::string ToChromeJson() const;
+    bool WriteChromeJson(const std::filesystem::path &path) const;
+
+private:
+    SpanTrace();
+
+    static std::atomic<bool> s_enabled;
+
+    mutable std::mutex m_mutex;  // Guards m_buffers, not the events in them
+    std::vector<std::unique_ptr<SpanBuffer>> m_buffers;
+    uint64_t m_startTicks;
+    uint64_t m_startNs;
+};
+
+// Records the time from construction to destruction as a span
+class ScopedSpan
+{
+public:
+    explicit ScopedSpan(const SpanSite &site)
+        : m_site(nullptr)
+    {
+        if (SpanTrace::IsEnabled())
+        {
+            Begin(site);
+        }
+    }
+
+    ~ScopedSpan()
+    {
+        if (m_site)
+        {
+            End();
+        }
+    }
+
+    ScopedSpan(const ScopedSpan &) = delete;
+    ScopedSpan &operator=(const ScopedSpan &) = delete;
+
+private:
+    void Begin(const SpanSite &site);
+    void End();
+
+    const SpanSite *m_site;
+    uint64_t m_beginTicks;
+};
+
+#define SPAN_CONCAT_INNER(a, b) a##b
+#define SPAN_CONCAT(a, b) SPAN_CONCAT_INNER(a, b)
+
+#if SPAN_TRACE_COMPILED
+// Times the rest of the enclosing scope under an explicit name
+#define TRACE_SPAN_NAMED(name, category)                                                 \
+    static constexpr SpanSite SPAN_CONCAT(spanSite, __LINE__) = {name, category};        \
+    ScopedSpan SPAN_CONCAT(span, __LINE__)(SPAN_CONCAT(spanSite, __LINE__))
+#else
+#define TRACE_SPAN_NAMED(name, category) static_cast<void>(0)
+#endif
+
+// Times the rest of the enclosing scope, named after the function
+#define TRACE_SPAN(category) TRACE_SPAN_NAMED(__FUNCTION__, category)
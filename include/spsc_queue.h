@@ -0,0 +1,104 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+
+// Bounded wait-free single-producer/single-consumer ring.
+// Each side keeps a cached copy of the other side's index and only reads the
+// shared one when the cache says the ring is full (producer) or empty
+// (consumer), so the common case touches no contended cache line.
+template <typename T>
+class SpscQueue
+{
+    static_assert(std::is_trivially_copyable<T>::value, "SpscQueue items are copied as plain data");
+
+public:
+    explicit SpscQueue(size_t capacity)
+        : m_capacity(RoundUpToPowerOfTwo(capacity)),
+          m_mask(m_capacity - 1),
+          m_items(new T[m_capacity]),
+          m_tail(0),
+          m_cachedHead(0),
+          m_head(0),
+          m_cachedTail(0)
+    {
+    }
+
+    SpscQueue(const SpscQueue &) = delete;
+    SpscQueue &operator=(const SpscQueue &) = delete;
+
+    // Producer side only. Returns false if the ring is full.
+    bool TryPush(const T &item)
+    {
+        size_t tail = m_tail.load(std::memory_order_relaxed);
+        if (tail - m_cachedHead == m_capacity)
+        {
+            m_cachedHead = m_head.load(std::memory_order_acquire);
+            if (tail - m_cachedHead == m_capacity)
+            {
+                return false;
+            }
+        }
+        m_items[tail & m_mask] = item;
+        m_tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side only. Moves up to maxCount items into out and returns
+    // how many were moved.
+    size_t PopBatch(T *out, size_t maxCount)
+    {
+        size_t head = m_head.load(std::memory_order_relaxed);
+        if (m_cachedTail == head)
+        {
+            m_cachedTail = m_tail.load(std::memory_order_acquire);
+            if (m_cachedTail == head)
+            {
+                return 0;
+            }
+        }
+
+        size_t count = std::min(m_cachedTail - head, maxCount);
+        size_t first = std::min(count, m_capacity - (head & m_mask));
+        std::copy(m_items.get() + (head & m_mask), m_items.get() + (head & m_mask) + first, out);
+        std::copy(m_items.get(), m_items.get() + (count - first), out + first);
+        m_head.store(head + count, std::memory_order_release);
+        return count;
+    }
+
+    // Consumer side only. Returns false if the ring is empty.
+    bool TryPop(T &item)
+    {
+        return PopBatch(&item, 1) == 1;
+    }
+
+    // Consumer side only
+    bool Empty() const
+    {
+        return m_tail.load(std::memory_order_acquire) == m_head.load(std::memory_order_relaxed);
+    }
+
+    size_t Capacity() const { return m_capacity; }
+
+private:
+    static size_t RoundUpToPowerOfTwo(size_t value)
+    {
+        size_t result = 2;
+        while (result < value)
+        {
+            result <<= 1;
+        }
+        return result;
+    }
+
+    const size_t m_capacity;
+    const size_t m_mask;
+    std::unique_ptr<T[]> m_items;
+    alignas(64) std::atomic<size_t> m_tail;  // Written by the producer
+    size_t m_cachedHead;
+    alignas(64) std::atomic<size_t> m_head;  // Written by the consumer
+    size_t m_cachedTail;
+};
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "key_event.h"
+#include "layout_table.h"
+
+// Default number of keystrokes kept per rendering
+const size_t DEFAULT_COMPOSE_WINDOW = 64;
+
+// Most layouts a composer can render at once
+const size_t MAX_COMPOSE_LAYOUTS = 32;
+
+// Keeps the text typed so far rendered in every configured layout.
+// Each keystroke is translated once per layout and appended to that layout's
+// lane, so a key costs O(layouts) no matter how much text has been typed.
+class TextComposer
+{
+public:
+    explicit TextComposer(size_t window = DEFAULT_COMPOSE_WINDOW);
+
+    // Layouts must outlive the composer. Clears the current text.
+    void SetLayouts(const std::vector<const LayoutTable *> &layouts);
+    size_t LayoutCount() const { return m_layouts.size(); }
+
+    // When set (the default), space/enter/tab clear the text so only the
+    // word being typed is kept. Otherwise space is kept as text.
+    void SetResetOnWordBoundary(bool reset) { m_resetOnWordBoundary = reset; }
+
+    // Feeds one key press. Handles backspace and word boundaries.
+    // Returns true if any rendering changed.
+    bool OnKey(const KeyPressInfo &key);
+
+    void Reset();
+
+    // Current rendering in a layout, at most window characters
+    std::wstring_view Text(size_t layoutIndex) const
+    {
+        const Lane &lane = m_laneState[layoutIndex];
+        return std::wstring_view(LaneBuffer(layoutIndex) + lane.start, lane.length);
+    }
+
+    // Keystrokes currently represented in the renderings
+    size_t KeyCount() const { return m_keyCount; }
+
+    static bool IsWordBoundaryKey(uint32_t vkCode)
+    {
+        return vkCode == KC_SPACE || vkCode == KC_RETURN || vkCode == KC_TAB;
+    }
+
+private:
+    struct Lane
+    {
+        size_t start;
+        size_t length;
+        wchar_t pendingDead;  // Dead key waiting for its base character
+    };
+
+    wchar_t *LaneBuffer(size_t layoutIndex) { return m_buffer.data() + layoutIndex * 2 * m_window; }
+    const wchar_t *LaneBuffer(size_t layoutIndex) const { return m_buffer.data() + layoutIndex * 2 * m_window; }
+
+    void Append(size_t layoutIndex, wchar_t ch);
+    void DropOldestKey();
+    bool RemoveLastKey();
+
+    std::vector<const LayoutTable *> m_layouts;
+    std::vector<wchar_t> m_buffer;      // One 2 * window lane per layout, contiguous
+    std::vector<Lane> m_laneState;
+    std::vector<uint32_t> m_keyLanes;   // Ring: per key, bit i set if it added a char to lane i
+    size_t m_window;
+    size_t m_keyHead;                   // Index of the oldest key in m_keyLanes
+    size_t m_keyCount;
+    bool m_resetOnWordBoundary;
+};
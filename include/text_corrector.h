@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+#include "detection_engine.h"
+#include "key_event.h"
+#include "layout_table.h"
+
+// Characters a reverse map covers: the BMP, which is all the tables hold
+const size_t REVERSE_LAYOUT_CHARS = 0x10000;
+
+// Which key types each character in one layout, the inverse of LayoutTable.
+// A character on several keys maps to the one with the fewest modifiers.
+// Dead keys and their combinations are left out.
+class ReverseLayoutMap
+{
+public:
+    explicit ReverseLayoutMap(const LayoutTable &layout);
+
+    // False if the layout cannot type ch with one key
+    bool Find(wchar_t ch, KeyPressInfo &key) const;
+
+private:
+    static const uint16_t NO_KEY = 0xFFFF;
+
+    std::vector<uint16_t> m_keys;  // Per character: vkCode * LSS_COUNT + shift state, or NO_KEY
+};
+
+// What the engine makes of one word
+struct WordVerdict
+{
+    int typedLayout;         // Layout the word was typed in, or -1 if no layout types it
+    int bestLayout;          // Layout it was meant for; typedLayout when it fits there
+    double margin;           // Bits per key, see LayoutScorer::ConfidenceMargin; 0 without a model
+    std::wstring_view text;  // The word in bestLayout
+};
+
+// Fixes text typed in the wrong layout, a word at a time. Each word is taken
+// back to the keys that typed it in the layout that types it most plainly,
+// then checked by the engine as if it had just been typed there. Not thread
+// safe; give each thread its own engine and corrector.
+class TextCorrector
+{
+public:
+    // The engine supplies layouts, model and dictionary, and must outlive
+    // the corrector. Set its layouts first.
+    explicit TextCorrector(DetectionEngine &engine);
+
+    // Checks a word given as text. False if no layout can type it. The
+    // verdict's text is valid until the next check.
+    bool CheckWord(std::wstring_view word, WordVerdict &verdict);
+
+    // Checks a word given as the keys that typed it in typedLayout
+    bool CheckKeys(const KeyPressInfo *keys, size_t count, size_t typedLayout, WordVerdict &verdict);
+
+    // The word as it reads in the layout it was meant for, or an empty view
+    // if it is right as it is or no layout can type it. Valid until the
+    // next call.
+    std::wstring_view CorrectWord(std::wstring_view word);
+
+    uint64_t WordsCorrected() const { return m_wordsCorrected; }
+
+private:
+    DetectionEngine &m_engine;
+    std::vector<ReverseLayoutMap> m_maps;
+    std::vector<KeyPressInfo> m_keys;
+    std::vector<KeyPressInfo> m_bestKeys;
+    uint64_t m_wordsCorrected;
+};
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <windows.h>
+#include "input_source.h"
+
+// Captures keys system-wide with a WH_KEYBOARD_LL hook. The hook runs on the
+// thread that called Start, which must pump messages.
+class Win32HookSource : public InputSource
+{
+public:
+    Win32HookSource();
+    ~Win32HookSource() override;
+
+    bool Start(KeyEventWorker &worker) override;
+    void Stop() override;
+    const wchar_t *Name() const override { return L"Win32 low-level hook"; }
+
+private:
+    static LRESULT CALLBACK LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam);
+
+    static Win32HookSource *s_active;  // Hook procedures get no user pointer
+    HHOOK m_hook;
+    KeyEventWorker *m_worker;
+};
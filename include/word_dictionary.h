@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "mapped_file.h"
+
+// Word lists compiled into minimized DAWGs (directed acyclic word graphs),
+// one per language, used to tell whether a word typed in one layout is a real
+// word in another.
+//
+// File layout (little-endian, every section 4-byte aligned so a mapped file
+// is used in place):
+//   WordDictionaryHeader
+//   WordDictionaryEntry[languageCount]
+//   per language: uint16 alphabet[symbolCount] (sorted), padded to 4 bytes,
+//                 then uint32 edges[edgeCount]
+// A node is a run of edges sorted by symbol, the last one flagged. An edge is
+// (symbol << 24) | flags | child, where child is the index of the first edge
+// of the node it leads to, or 0 if that node has no edges; edge 0 is unused.
+
+#define WORD_DICTIONARY_EXTENSION L".kbdw"
+#define DEFAULT_WORD_DICTIONARY_PATH L"keyboard_checker.kbdw"
+
+const uint16_t WORD_DICTIONARY_VERSION = 1;
+
+const uint32_t DAWG_CHILD_MASK = 0x003FFFFF;
+const uint32_t DAWG_EDGE_LAST = 0x00400000;   // Last edge of its node
+const uint32_t DAWG_EDGE_FINAL = 0x00800000;  // A word ends after this edge
+const unsigned DAWG_SYMBOL_SHIFT = 24;
+const uint32_t DAWG_MAX_EDGES = DAWG_CHILD_MASK + 1;
+const uint32_t DAWG_MAX_SYMBOLS = 256;
+
+// Longest word the builder accepts
+const size_t DAWG_MAX_WORD_LENGTH = 64;
+
+struct WordDictionaryHeader
+{
+    char magic[4];  // "KBDW"
+    uint16_t version;
+    uint16_t languageCount;
+};
+
+struct WordDictionaryEntry
+{
+    uint16_t langId;  // Primary language ID, as in LayoutTable::LanguageId
+    uint16_t symbolCount;
+    uint32_t alphabetOffset;
+    uint32_t edgeOffset;
+    uint32_t edgeCount;
+    uint32_t rootEdge;
+    uint32_t wordCount;
+};
+
+// One language's dictionary, pointing into the loaded file
+class WordDictionaryLanguage
+{
+public:
+    WordDictionaryLanguage(const WordDictionaryEntry &entry, const uint16_t *alphabet, const uint32_t *edges)
+        : m_langId(entry.langId), m_symbolCount(entry.symbolCount), m_rootEdge(entry.rootEdge),
+          m_edgeCount(entry.edgeCount), m_wordCount(entry.wordCount), m_alphabet(alphabet), m_edges(edges)
+    {
+    }
+
+    uint16_t LanguageId() const { return m_langId; }
+    uint32_t WordCount() const { return m_wordCount; }
+
+    // Case-insensitive for ASCII letters, like the n-gram models
+    bool Contains(std::wstring_view word) const;
+
+    // Whether the character appears in any word
+    bool InAlphabet(wchar_t ch) const { return SymbolFor(ch) >= 0; }
+
+private:
+    int SymbolFor(wchar_t ch) const;
+
+    uint16_t m_langId;
+    uint32_t m_symbolCount;
+    uint32_t m_rootEdge;
+    uint32_t m_edgeCount;
+    uint32_t m_wordCount;
+    const uint16_t *m_alphabet;
+    const uint32_t *m_edges;
+};
+
+class WordDictionary
+{
+public:
+    WordDictionary() = default;
+    WordDictionary(const WordDictionary &) = delete;
+    WordDictionary &operator=(const WordDictionary &) = delete;
+
+    // Maps a dictionary file. Returns false if it is missing or malformed.
+    bool Load(const std::filesystem::path &path);
+
+    // Uses a dictionary already in memory; data must stay valid and 4-byte aligned
+    bool LoadFromMemory(const uint8_t *data, size_t size);
+
+    bool IsLoaded() const { return !m_languages.empty(); }
+    const WordDictionaryLanguage *FindLanguage(uint16_t langId) const;
+
+private:
+    MappedFile m_file;
+    std::vector<WordDictionaryLanguage> m_languages;
+};
+
+// Builds a dictionary file from word lists
+class WordDictionaryBuilder
+{
+public:
+    // Words are case-folded; empty and overlong words are skipped
+    void AddWord(uint16_t langId, std::wstring_view word);
+
+    // Serialized dictionary covering every language given words. Returns an
+    // empty vector if a language needs more than DAWG_MAX_EDGES edges.
+    std::vector<uint8_t> Build() const;
+
+private:
+    std::map<uint16_t, std::vector<std::wstring>> m_words;
+};
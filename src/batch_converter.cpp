@@ -0,0 +1,66 @@
+#include "batch_converter.h"
+
+BatchConverter::BatchConverter()
+    : m_stride(0)
+{
+}
+
+void BatchConverter::SetLayouts(const std::vector<const LayoutTable *> &layouts)
+{
+    m_layouts = layouts;
+    m_lengths.assign(m_layouts.size(), 0);
+    m_pendingDead.assign(m_layouts.size(), 0);
+    m_lanes.assign(m_layouts.size() * m_stride, 0);
+}
+
+void BatchConverter::Convert(const KeyPressInfo *keys, size_t count)
+{
+    const size_t layoutCount = m_layouts.size();
+
+    // Every key adds at most one character per lane
+    if (count > m_stride)
+    {
+        m_stride = count + count / 2;
+        m_lanes.assign(layoutCount * m_stride, 0);
+    }
+
+    for (size_t i = 0; i < layoutCount; i++)
+    {
+        m_lengths[i] = 0;
+        m_pendingDead[i] = 0;
+    }
+
+    wchar_t *lanes = m_lanes.data();
+    for (size_t k = 0; k < count; k++)
+    {
+        const KeyPressInfo &key = keys[k];
+        if (key.vkCode >= LayoutTable::KEY_COUNT)
+        {
+            continue;
+        }
+        LayoutShiftState state = LayoutTable::ShiftStateFor(key.modifiers);
+
+        for (size_t i = 0; i < layoutCount; i++)
+        {
+            const LayoutEntry &entry = m_layouts[i]->Entry(key.vkCode, state);
+            if (entry.flags & LAYOUT_ENTRY_DEAD)
+            {
+                m_pendingDead[i] = entry.ch;
+                continue;
+            }
+            if (entry.ch == 0)
+            {
+                continue;
+            }
+
+            wchar_t ch = entry.ch;
+            if (m_pendingDead[i] != 0)
+            {
+                wchar_t composed = m_layouts[i]->Compose(m_pendingDead[i], ch);
+                ch = composed != 0 ? composed : ch;
+                m_pendingDead[i] = 0;
+            }
+            lanes[i * m_stride + m_lengths[i]++] = ch;
+        }
+    }
+}
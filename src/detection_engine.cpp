@@ -0,0 +1,448 @@
+#include "detection_engine.h"
+#include <algorithm>
+#include "latency_histogram.h"
+#include "logger.h"
+#include "script_classify.h"
+
+DetectionEngine::DetectionEngine()
+    : m_minTextLength(DEFAULT_MIN_TEXT_LENGTH),
+      m_trace(nullptr),
+      m_keysProcessed(0),
+      m_wordsChecked(0),
+      m_wrongLayoutCount(0),
+      m_dictionaryHits(0)
+{
+}
+
+void DetectionEngine::SetLayouts(const std::vector<LayoutTable> &layouts)
+{
+    m_layouts = layouts;
+
+    std::vector<const LayoutTable *> tables;
+    for (const LayoutTable &layout : m_layouts)
+    {
+        tables.push_back(&layout);
+    }
+    m_composer.SetLayouts(tables);
+    m_converter.SetLayouts(tables);
+    m_scorer.SetLayouts(tables, m_model);
+    m_scheduler.SetLayouts(tables);
+    m_wordKeys.clear();
+}
+
+int DetectionEngine::FindLayoutByLanguage(uint16_t langId) const
+{
+    for (size_t i = 0; i < m_layouts.size(); i++)
+    {
+        if (m_layouts[i].LanguageId() == langId)
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+bool DetectionEngine::LoadModel(const std::filesystem::path &path)
+{
+    bool loaded = m_model.Load(path);
+    if (loaded)
+    {
+        LOG(INF, L"Loaded n-gram model " + path.wstring());
+    }
+    else
+    {
+        LOG(WRN, L"No n-gram model at " + path.wstring() + L", using character ranges only");
+    }
+
+    std::vector<const LayoutTable *> tables;
+    for (const LayoutTable &layout : m_layouts)
+    {
+        tables.push_back(&layout);
+    }
+    m_scorer.SetLayouts(tables, m_model);
+    return loaded;
+}
+
+bool DetectionEngine::LoadDictionary(const std::filesystem::path &path)
+{
+    bool loaded = m_dictionary.Load(path);
+    if (loaded)
+    {
+        LOG(INF, L"Loaded word dictionary " + path.wstring());
+    }
+    else
+    {
+        LOG(WRN, L"No word dictionary at " + path.wstring());
+    }
+    return loaded;
+}
+
+void DetectionEngine::ProcessEvents(const KeyEvent *events, size_t count)
+{
+    TRACE_SPAN("engine");
+    for (size_t i = 0; i < count; i++)
+    {
+        if (m_trace)
+        {
+            RecordEvent(events[i]);
+        }
+
+        if (events[i].flags & KEY_EVENT_UP)
+        {
+            OnKeyUp(events[i].vkCode);
+        }
+        else
+        {
+            OnKeyDown(events[i].vkCode, events[i].timestampUs);
+        }
+
+        // From capture, so the time queued for the worker is included
+        int64_t nowUs = KeyEventClockUs();
+        if (events[i].timestampUs > 0 && nowUs >= events[i].timestampUs)
+        {
+            LatencyStats::Instance().Record(LATENCY_DETECTION,
+                                            static_cast<uint64_t>(nowUs - events[i].timestampUs) * 1000);
+        }
+    }
+
+    if (m_trace)
+    {
+        m_trace->Flush();
+    }
+}
+
+void DetectionEngine::RecordEvent(const KeyEvent &event)
+{
+    int layoutIndex = ActiveLayout();
+    KeyTraceRecord record;
+    record.timestampUs = event.timestampUs;
+    record.vkCode = event.vkCode;
+    record.flags = event.flags;
+    record.langId = (layoutIndex >= 0 && static_cast<size_t>(layoutIndex) < m_layouts.size())
+                        ? m_layouts[layoutIndex].LanguageId()
+                        : KEY_TRACE_NO_LAYOUT;
+    record.modifiers = KeyTraceModifiers(m_modifiers);
+    record.reserved = 0;
+    m_trace->Append(record);
+}
+
+void DetectionEngine::OnKeyDown(uint32_t vkCode, int64_t timestampUs)
+{
+    TRACE_SPAN("engine");
+    LOGF(DBG, L"Key down: 0x%x", vkCode);
+    m_keysProcessed++;
+    m_arena.Reset();
+    m_scheduler.OnKeyEvent();
+    if (timestampUs == 0)
+    {
+        timestampUs = KeyEventClockUs();
+    }
+
+    // A check that fell due before this key is for the word as it was then
+    OnIdle(timestampUs);
+
+    if (IsModifierKey(vkCode))
+    {
+        m_modifiers.UpdateFromKey(vkCode, true);
+        return;
+    }
+
+    // Ignore auto-repeat of a key that is already held
+    if (std::find(m_pressedKeys.begin(), m_pressedKeys.end(), vkCode) != m_pressedKeys.end())
+    {
+        return;
+    }
+    m_pressedKeys.push_back(vkCode);
+
+    KeyPressInfo newKey(vkCode, m_modifiers);
+    KeyClass keyClass = m_scheduler.Classify(vkCode, m_modifiers);
+    bool check = m_scheduler.OnKey(keyClass, timestampUs);
+    bool reported = false;
+    switch (keyClass)
+    {
+    case KEY_CLASS_WORD:
+        if (m_wordKeys.size() < DEFAULT_COMPOSE_WINDOW)
+        {
+            m_wordKeys.push_back(newKey);
+        }
+        break;
+    case KEY_CLASS_EDIT:
+        if (!m_wordKeys.empty())
+        {
+            m_wordKeys.pop_back();
+        }
+        break;
+    case KEY_CLASS_BOUNDARY:
+        if (check)
+        {
+            reported = CheckWord();
+        }
+        m_wordKeys.clear();
+        break;
+    case KEY_CLASS_MOVE:
+        m_wordKeys.clear();
+        break;
+    default:
+        break;
+    }
+
+    // The scorer follows the same words as the checks
+    if (keyClass == KEY_CLASS_BOUNDARY || keyClass == KEY_CLASS_MOVE)
+    {
+        m_scorer.Reset();
+    }
+    else
+    {
+        m_scorer.OnKey(newKey);
+    }
+
+    // Only the new key is translated; earlier keys are already in the composer
+    if (m_composer.OnKey(newKey) && !reported && m_textHandler)
+    {
+        int layoutIndex = ActiveLayout();
+        if (layoutIndex >= 0)
+        {
+            m_textHandler(m_composer.Text(layoutIndex));
+        }
+    }
+}
+
+void DetectionEngine::OnKeyUp(uint32_t vkCode)
+{
+    LOGF(DBG, L"Key up: 0x%x", vkCode);
+    m_scheduler.OnKeyEvent();
+
+    if (IsModifierKey(vkCode))
+    {
+        m_modifiers.UpdateFromKey(vkCode, false);
+        return;
+    }
+
+    // Remove the key from pressed keys, whatever modifiers it was pressed with
+    auto it = std::find(m_pressedKeys.begin(), m_pressedKeys.end(), vkCode);
+    if (it != m_pressedKeys.end())
+    {
+        m_pressedKeys.erase(it);
+    }
+}
+
+void DetectionEngine::OnIdle(int64_t nowUs)
+{
+    if (!m_scheduler.HasPending())
+    {
+        return;
+    }
+    if (m_scheduler.OnIdle(nowUs != 0 ? nowUs : KeyEventClockUs()))
+    {
+        TRACE_SPAN("engine");
+        m_arena.Reset();
+        CheckWord();
+    }
+}
+
+bool DetectionEngine::CheckWord()
+{
+    TRACE_SPAN("detection");
+    if (m_wordKeys.size() < m_minTextLength)
+    {
+        return false;
+    }
+    int current = ActiveLayout();
+    if (current < 0 || static_cast<size_t>(current) >= m_layouts.size())
+    {
+        return false;
+    }
+    m_wordsChecked++;
+
+    // One pass renders the word in every layout; the scorer has already seen its keys
+    m_converter.Convert(m_wordKeys);
+    size_t alternative = static_cast<size_t>(current);
+    double margin = 0.0;
+    if (!IsWrongLayout(current, alternative, margin))
+    {
+        return false;
+    }
+
+    m_wrongLayoutCount++;
+    if (!m_wrongLayoutHandler)
+    {
+        return false;
+    }
+
+    // The lanes stay put until the next Convert, so the report only points at them
+    std::wstring_view *conversions = m_arena.Allocate<std::wstring_view>(m_layouts.size());
+    if (!conversions)
+    {
+        LOGF(ERR, L"No room to report %zu layouts", m_layouts.size());
+        return false;
+    }
+    for (size_t i = 0; i < m_layouts.size(); i++)
+    {
+        conversions[i] = m_converter.Lane(i);
+    }
+
+    WrongLayoutReport report;
+    report.currentLayout = static_cast<size_t>(current);
+    report.currentText = m_converter.Lane(current);
+    report.conversions = conversions;
+    report.layoutCount = m_layouts.size();
+    report.bestAlternative = alternative;
+    report.margin = margin;
+    m_wrongLayoutHandler(report);
+    return true;
+}
+
+int DetectionEngine::CheckKeys(const KeyPressInfo *keys, size_t count, size_t current, double *margin)
+{
+    if (margin)
+    {
+        *margin = 0.0;
+    }
+    if (current >= m_layouts.size())
+    {
+        return -1;
+    }
+    m_converter.Convert(keys, count);
+    if (count < m_minTextLength)
+    {
+        return -1;
+    }
+    m_wordsChecked++;
+
+    m_scorer.Reset();
+    for (size_t i = 0; i < count; i++)
+    {
+        m_scorer.OnKey(keys[i]);
+    }
+    size_t alternative = current;
+    double wordMargin = 0.0;
+    bool wrongLayout = IsWrongLayout(current, alternative, wordMargin);
+    if (margin)
+    {
+        *margin = wordMargin;
+    }
+    if (!wrongLayout)
+    {
+        return -1;
+    }
+
+    // Only the character ranges ruled the word out; take the first layout they allow
+    for (size_t i = 0; alternative == current && i < m_layouts.size(); i++)
+    {
+        if (i != current && !m_converter.Lane(i).empty() && IsValidInLayout(m_converter.Lane(i), i))
+        {
+            alternative = i;
+        }
+    }
+    if (alternative == current)
+    {
+        return -1;
+    }
+    m_wrongLayoutCount++;
+    return static_cast<int>(alternative);
+}
+
+bool DetectionEngine::IsWrongLayout(size_t current, size_t &alternative, double &margin)
+{
+    bool wrongLayout = false;
+    if (m_model.IsLoaded())
+    {
+        margin = m_scorer.ConfidenceMargin(current, &alternative);
+        wrongLayout = margin > NGRAM_WRONG_LAYOUT_MARGIN;
+        LOGF(DBG, L"Layout margin %.2f bits/key, best alternative %ls", margin, m_layouts[alternative].Name().c_str());
+    }
+
+    // A real word where it was typed is never reported. One that is only a
+    // word in another layout is, preferring the model's alternative.
+    std::wstring_view currentText = m_converter.Lane(current);
+    if (m_dictionary.IsLoaded())
+    {
+        if (IsDictionaryWord(currentText, current))
+        {
+            m_dictionaryHits++;
+            return false;
+        }
+        if (alternative != current && IsDictionaryWord(m_converter.Lane(alternative), alternative))
+        {
+            m_dictionaryHits++;
+            wrongLayout = true;
+        }
+        else
+        {
+            for (size_t i = 0; i < m_layouts.size(); i++)
+            {
+                if (i != current && IsDictionaryWord(m_converter.Lane(i), i))
+                {
+                    m_dictionaryHits++;
+                    alternative = i;
+                    wrongLayout = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    return wrongLayout || !IsValidInLayout(currentText, current);
+}
+
+bool DetectionEngine::IsValidInLayout(std::wstring_view text, size_t layoutIndex) const
+{
+    // Hebrew layouts also type ASCII; other layouts are checked as English
+    unsigned allowed = SCRIPT_CLASS_WHITESPACE | SCRIPT_CLASS_ASCII;
+    if (m_layouts[layoutIndex].LanguageId() == LAYOUT_LANG_HEBREW)
+    {
+        allowed |= SCRIPT_CLASS_HEBREW;
+    }
+
+    size_t offset = FindFirstOutsideClasses(text.data(), text.size(), allowed);
+    if (offset < text.size())
+    {
+        LOGF(WRN, L"Character '%lc' (0x%x) at offset %zu is not valid in layout %ls",
+             static_cast<wint_t>(text[offset]), static_cast<uint32_t>(text[offset]), offset,
+             m_layouts[layoutIndex].Name().c_str());
+        return false;
+    }
+    return true;
+}
+
+bool DetectionEngine::IsDictionaryWord(std::wstring_view text, size_t layoutIndex) const
+{
+    const WordDictionaryLanguage *language = m_dictionary.FindLanguage(m_layouts[layoutIndex].LanguageId());
+    if (!language)
+    {
+        return false;
+    }
+
+    size_t start = 0;
+    size_t end = text.size();
+    while (start < end && !language->InAlphabet(text[start]))
+    {
+        start++;
+    }
+    while (end > start && !language->InAlphabet(text[end - 1]))
+    {
+        end--;
+    }
+    return language->Contains(text.substr(start, end - start));
+}
+
+bool DetectionEngine::IsModifierKey(uint32_t vkCode)
+{
+    switch (vkCode)
+    {
+    case KC_SHIFT:
+    case KC_LSHIFT:
+    case KC_RSHIFT:
+    case KC_CONTROL:
+    case KC_LCONTROL:
+    case KC_RCONTROL:
+    case KC_MENU:
+    case KC_LMENU:
+    case KC_RMENU:
+    case KC_LWIN:
+    case KC_RWIN:
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,142 @@
+#include "detection_scheduler.h"
+
+DetectionScheduler::DetectionScheduler()
+    : m_idleDelayUs(DEFAULT_IDLE_CHECK_US),
+      m_deadlineUs(0),
+      m_wordChanged(false),
+      m_keyEvents(0),
+      m_boundaryChecks(0),
+      m_idleChecks(0),
+      m_cancelledChecks(0)
+{
+    SetLayouts({});
+}
+
+bool DetectionScheduler::IsWordChar(wchar_t ch)
+{
+    // Apostrophes, quotes and hyphens occur inside words (don't, צה"ל, e-mail)
+    if (ch >= 0x80 || ch == L'\'' || ch == L'"' || ch == L'-')
+    {
+        return true;
+    }
+    return (ch >= L'0' && ch <= L'9') || (ch >= L'a' && ch <= L'z') || (ch >= L'A' && ch <= L'Z');
+}
+
+void DetectionScheduler::SetLayouts(const std::vector<const LayoutTable *> &layouts)
+{
+    for (size_t vkCode = 0; vkCode < LayoutTable::KEY_COUNT; vkCode++)
+    {
+        for (int state = 0; state < LSS_COUNT; state++)
+        {
+            bool text = false;
+            bool punctuation = !layouts.empty();
+            for (const LayoutTable *layout : layouts)
+            {
+                const LayoutEntry &entry = layout->Entry(static_cast<uint32_t>(vkCode),
+                                                         static_cast<LayoutShiftState>(state));
+                bool produces = entry.ch != 0;
+                text = text || produces;
+                if (!produces || (entry.flags & LAYOUT_ENTRY_DEAD) || IsWordChar(entry.ch))
+                {
+                    punctuation = false;
+                }
+            }
+            m_classes[vkCode][state] = static_cast<uint8_t>(punctuation ? KEY_CLASS_BOUNDARY
+                                                            : text      ? KEY_CLASS_WORD
+                                                                        : KEY_CLASS_OTHER);
+        }
+    }
+
+    // Keys that mean the same in every layout
+    for (int state = 0; state < LSS_COUNT; state++)
+    {
+        m_classes[KC_SPACE][state] = KEY_CLASS_BOUNDARY;
+        m_classes[KC_RETURN][state] = KEY_CLASS_BOUNDARY;
+        m_classes[KC_TAB][state] = KEY_CLASS_BOUNDARY;
+        m_classes[KC_BACK][state] = KEY_CLASS_EDIT;
+        m_classes[KC_DELETE][state] = KEY_CLASS_MOVE;
+        m_classes[KC_HOME][state] = KEY_CLASS_MOVE;
+        m_classes[KC_END][state] = KEY_CLASS_MOVE;
+        m_classes[KC_LEFT][state] = KEY_CLASS_MOVE;
+        m_classes[KC_RIGHT][state] = KEY_CLASS_MOVE;
+        m_classes[KC_UP][state] = KEY_CLASS_MOVE;
+        m_classes[KC_DOWN][state] = KEY_CLASS_MOVE;
+    }
+}
+
+KeyClass DetectionScheduler::Classify(uint32_t vkCode, const ModifierFlags &modifiers) const
+{
+    // Ctrl or Alt alone are shortcuts, not text
+    if (vkCode >= LayoutTable::KEY_COUNT || modifiers.ctrl != modifiers.alt)
+    {
+        return KEY_CLASS_OTHER;
+    }
+    return static_cast<KeyClass>(m_classes[vkCode][LayoutTable::ShiftStateFor(modifiers)]);
+}
+
+bool DetectionScheduler::OnKey(KeyClass keyClass, int64_t timestampUs)
+{
+    switch (keyClass)
+    {
+    case KEY_CLASS_WORD:
+    case KEY_CLASS_EDIT:
+        m_wordChanged = true;
+        Schedule(timestampUs);
+        return false;
+
+    case KEY_CLASS_BOUNDARY:
+    {
+        // A word already checked while idle, and unchanged since, is not checked again
+        Cancel();
+        bool check = m_wordChanged;
+        m_wordChanged = false;
+        if (check)
+        {
+            m_boundaryChecks++;
+        }
+        return check;
+    }
+
+    case KEY_CLASS_MOVE:
+        Cancel();
+        m_wordChanged = false;
+        return false;
+
+    default:
+        return false;
+    }
+}
+
+bool DetectionScheduler::OnIdle(int64_t nowUs)
+{
+    if (m_deadlineUs == 0 || nowUs < m_deadlineUs)
+    {
+        return false;
+    }
+    m_deadlineUs = 0;
+    if (!m_wordChanged)
+    {
+        return false;
+    }
+    m_wordChanged = false;
+    m_idleChecks++;
+    return true;
+}
+
+void DetectionScheduler::Schedule(int64_t timestampUs)
+{
+    Cancel();
+    if (m_idleDelayUs > 0)
+    {
+        m_deadlineUs = timestampUs + m_idleDelayUs;
+    }
+}
+
+void DetectionScheduler::Cancel()
+{
+    if (m_deadlineUs != 0)
+    {
+        m_deadlineUs = 0;
+        m_cancelledChecks++;
+    }
+}
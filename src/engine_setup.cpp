@@ -0,0 +1,52 @@
+#include "engine_setup.h"
+#include <cstdio>
+#include <filesystem>
+#include "layout_pack.h"
+
+bool LoadLayouts(const std::string &packPath, std::vector<LayoutTable> &layouts)
+{
+    layouts.clear();
+    if (packPath.empty())
+    {
+        layouts = {LayoutTable::UsQwerty(), LayoutTable::HebrewSi1452()};
+        return true;
+    }
+
+    LayoutPack pack;
+    if (!pack.Load(packPath))
+    {
+        fprintf(stderr, "%s is not a valid layout pack\n", packPath.c_str());
+        return false;
+    }
+    for (size_t i = 0; i < pack.LayoutCount(); i++)
+    {
+        layouts.push_back(pack.Layout(i));
+    }
+    return true;
+}
+
+bool ConfigureEngine(DetectionEngine &engine, const std::vector<LayoutTable> &layouts, const std::string &modelPath,
+                     const std::string &dictionaryPath, size_t minLength, bool report)
+{
+    engine.SetLayouts(layouts);
+    engine.SetMinTextLength(minLength);
+    bool hasModel = engine.LoadModel(modelPath.empty() ? std::filesystem::path(DEFAULT_NGRAM_MODEL_PATH)
+                                                       : std::filesystem::path(modelPath));
+    bool hasDictionary = engine.LoadDictionary(dictionaryPath.empty()
+                                                   ? std::filesystem::path(DEFAULT_WORD_DICTIONARY_PATH)
+                                                   : std::filesystem::path(dictionaryPath));
+    if ((!modelPath.empty() && !hasModel) || (!dictionaryPath.empty() && !hasDictionary))
+    {
+        if (report)
+        {
+            fprintf(stderr, "Cannot read %s\n", !modelPath.empty() && !hasModel ? modelPath.c_str()
+                                                                                : dictionaryPath.c_str());
+        }
+        return false;
+    }
+    if (report && !hasModel && !hasDictionary)
+    {
+        fprintf(stderr, "No model or dictionary; only words with characters outside their layout are caught\n");
+    }
+    return true;
+}
@@ -0,0 +1,348 @@
+#include "evdev_source.h"
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "latency_histogram.h"
+#include "logger.h"
+
+// epoll events handled per wakeup
+const int EVDEV_MAX_READY = 16;
+
+static std::wstring WidenPath(const std::string &path)
+{
+    return std::wstring(path.begin(), path.end());
+}
+
+static bool HasKey(const unsigned long *bits, int key)
+{
+    const int BITS = 8 * sizeof(unsigned long);
+    return (bits[key / BITS] >> (key % BITS)) & 1;
+}
+
+EvdevSource::EvdevSource(std::vector<std::string> devicePaths)
+    : m_devicePaths(std::move(devicePaths)),
+      m_epoll(-1),
+      m_stopEvent(-1),
+      m_worker(nullptr)
+{
+}
+
+EvdevSource::~EvdevSource()
+{
+    Stop();
+}
+
+std::vector<std::string> EvdevSource::FindKeyboards()
+{
+    std::vector<std::string> keyboards;
+    DIR *dir = opendir("/dev/input");
+    if (!dir)
+    {
+        return keyboards;
+    }
+
+    while (dirent *entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, "event", 5) != 0)
+        {
+            continue;
+        }
+        std::string path = std::string("/dev/input/") + entry->d_name;
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            continue;
+        }
+
+        unsigned long keyBits[KEY_MAX / (8 * sizeof(unsigned long)) + 1] = {};
+        if (ioctl(fd, EVIOCGBIT(EV_KEY, sizeof(keyBits)), keyBits) >= 0 &&
+            HasKey(keyBits, KEY_A) && HasKey(keyBits, KEY_Z) && HasKey(keyBits, KEY_SPACE))
+        {
+            keyboards.push_back(path);
+        }
+        close(fd);
+    }
+    closedir(dir);
+    return keyboards;
+}
+
+uint16_t EvdevSource::VirtualKeyFor(uint16_t linuxKeyCode)
+{
+    switch (linuxKeyCode)
+    {
+    case KEY_BACKSPACE: return KC_BACK;
+    case KEY_TAB: return KC_TAB;
+    case KEY_ENTER: return KC_RETURN;
+    case KEY_KPENTER: return KC_RETURN;
+    case KEY_ESC: return KC_ESCAPE;
+    case KEY_SPACE: return KC_SPACE;
+    case KEY_DELETE: return KC_DELETE;
+    case KEY_HOME: return KC_HOME;
+    case KEY_END: return KC_END;
+    case KEY_LEFT: return KC_LEFT;
+    case KEY_UP: return KC_UP;
+    case KEY_RIGHT: return KC_RIGHT;
+    case KEY_DOWN: return KC_DOWN;
+    case KEY_LEFTSHIFT: return KC_LSHIFT;
+    case KEY_RIGHTSHIFT: return KC_RSHIFT;
+    case KEY_LEFTCTRL: return KC_LCONTROL;
+    case KEY_RIGHTCTRL: return KC_RCONTROL;
+    case KEY_LEFTALT: return KC_LMENU;
+    case KEY_RIGHTALT: return KC_RMENU;
+    case KEY_LEFTMETA: return KC_LWIN;
+    case KEY_RIGHTMETA: return KC_RWIN;
+    case KEY_SEMICOLON: return KC_OEM_1;
+    case KEY_EQUAL: return KC_OEM_PLUS;
+    case KEY_COMMA: return KC_OEM_COMMA;
+    case KEY_MINUS: return KC_OEM_MINUS;
+    case KEY_DOT: return KC_OEM_PERIOD;
+    case KEY_SLASH: return KC_OEM_2;
+    case KEY_GRAVE: return KC_OEM_3;
+    case KEY_LEFTBRACE: return KC_OEM_4;
+    case KEY_BACKSLASH: return KC_OEM_5;
+    case KEY_RIGHTBRACE: return KC_OEM_6;
+    case KEY_APOSTROPHE: return KC_OEM_7;
+    case KEY_102ND: return KC_OEM_102;
+    case KEY_KPASTERISK: return KC_MULTIPLY;
+    case KEY_KPPLUS: return KC_ADD;
+    case KEY_KPMINUS: return KC_SUBTRACT;
+    case KEY_KPDOT: return KC_DECIMAL;
+    case KEY_KPSLASH: return KC_DIVIDE;
+    case KEY_0: return '0';
+    case KEY_KP0: return KC_NUMPAD0;
+    default:
+        break;
+    }
+
+    // Rows of the main block are contiguous in evdev but not in VK order
+    if (linuxKeyCode >= KEY_1 && linuxKeyCode <= KEY_9)
+    {
+        return static_cast<uint16_t>('1' + linuxKeyCode - KEY_1);
+    }
+    if (linuxKeyCode >= KEY_Q && linuxKeyCode <= KEY_P)
+    {
+        return static_cast<uint16_t>("QWERTYUIOP"[linuxKeyCode - KEY_Q]);
+    }
+    if (linuxKeyCode >= KEY_A && linuxKeyCode <= KEY_L)
+    {
+        return static_cast<uint16_t>("ASDFGHJKL"[linuxKeyCode - KEY_A]);
+    }
+    if (linuxKeyCode >= KEY_Z && linuxKeyCode <= KEY_M)
+    {
+        return static_cast<uint16_t>("ZXCVBNM"[linuxKeyCode - KEY_Z]);
+    }
+    if (linuxKeyCode >= KEY_F1 && linuxKeyCode <= KEY_F10)
+    {
+        return static_cast<uint16_t>(KC_F1 + linuxKeyCode - KEY_F1);
+    }
+    if (linuxKeyCode == KEY_F11 || linuxKeyCode == KEY_F12)
+    {
+        return static_cast<uint16_t>(KC_F1 + 10 + linuxKeyCode - KEY_F11);
+    }
+
+    // Keypad digits are laid out as 7 8 9 - 4 5 6 + 1 2 3
+    switch (linuxKeyCode)
+    {
+    case KEY_KP1: return KC_NUMPAD0 + 1;
+    case KEY_KP2: return KC_NUMPAD0 + 2;
+    case KEY_KP3: return KC_NUMPAD0 + 3;
+    case KEY_KP4: return KC_NUMPAD0 + 4;
+    case KEY_KP5: return KC_NUMPAD0 + 5;
+    case KEY_KP6: return KC_NUMPAD0 + 6;
+    case KEY_KP7: return KC_NUMPAD0 + 7;
+    case KEY_KP8: return KC_NUMPAD0 + 8;
+    case KEY_KP9: return KC_NUMPAD0 + 9;
+    default:
+        return 0;
+    }
+}
+
+bool EvdevSource::OpenDevice(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        LOG(ERR, L"Cannot open " + WidenPath(path) + L": " + std::to_wstring(errno));
+        return false;
+    }
+
+    // Timestamps on the same clock as KeyEventClockUs
+    int clock = CLOCK_MONOTONIC;
+    ioctl(fd, EVIOCSCLOCKID, &clock);
+
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (epoll_ctl(m_epoll, EPOLL_CTL_ADD, fd, &event) != 0)
+    {
+        LOG(ERR, L"Cannot watch " + WidenPath(path) + L": " + std::to_wstring(errno));
+        close(fd);
+        return false;
+    }
+
+    m_devices.push_back(fd);
+    LOG(INF, L"Reading keys from " + WidenPath(path));
+    return true;
+}
+
+bool EvdevSource::Start(KeyEventWorker &worker)
+{
+    if (m_reader.joinable())
+    {
+        return true;
+    }
+
+    std::vector<std::string> paths = m_devicePaths.empty() ? FindKeyboards() : m_devicePaths;
+    if (paths.empty())
+    {
+        LOG(ERR, L"No readable keyboard devices under /dev/input");
+        return false;
+    }
+
+    m_epoll = epoll_create1(EPOLL_CLOEXEC);
+    m_stopEvent = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (m_epoll < 0 || m_stopEvent < 0)
+    {
+        LOG(ERR, L"Cannot create epoll or eventfd: " + std::to_wstring(errno));
+        CloseAll();
+        return false;
+    }
+
+    epoll_event stop = {};
+    stop.events = EPOLLIN;
+    stop.data.fd = m_stopEvent;
+    epoll_ctl(m_epoll, EPOLL_CTL_ADD, m_stopEvent, &stop);
+
+    for (const std::string &path : paths)
+    {
+        OpenDevice(path);
+    }
+    if (m_devices.empty())
+    {
+        CloseAll();
+        return false;
+    }
+
+    m_worker = &worker;
+    m_reader = std::thread(&EvdevSource::Run, this);
+    return true;
+}
+
+void EvdevSource::Stop()
+{
+    if (m_reader.joinable())
+    {
+        uint64_t one = 1;
+        if (write(m_stopEvent, &one, sizeof(one)) != sizeof(one))
+        {
+            LOG(ERR, L"Cannot wake the evdev reader: " + std::to_wstring(errno));
+        }
+        m_reader.join();
+    }
+    CloseAll();
+    m_worker = nullptr;
+}
+
+void EvdevSource::CloseAll()
+{
+    for (int fd : m_devices)
+    {
+        close(fd);
+    }
+    m_devices.clear();
+    if (m_epoll >= 0)
+    {
+        close(m_epoll);
+        m_epoll = -1;
+    }
+    if (m_stopEvent >= 0)
+    {
+        close(m_stopEvent);
+        m_stopEvent = -1;
+    }
+}
+
+void EvdevSource::Run()
+{
+    epoll_event ready[EVDEV_MAX_READY];
+    input_event records[EVDEV_READ_BATCH];
+    SpanTrace::SetThreadName("evdev reader");
+
+    for (;;)
+    {
+        int count = epoll_wait(m_epoll, ready, EVDEV_MAX_READY, -1);
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            LOG(ERR, L"epoll_wait failed: " + std::to_wstring(errno));
+            return;
+        }
+
+        for (int i = 0; i < count; i++)
+        {
+            int fd = ready[i].data.fd;
+            if (fd == m_stopEvent)
+            {
+                return;
+            }
+
+            // Drain the device; each read returns up to a full batch
+            for (;;)
+            {
+                ssize_t bytes = read(fd, records, sizeof(records));
+                if (bytes <= 0)
+                {
+                    if (bytes < 0 && errno != EAGAIN && errno != EINTR)
+                    {
+                        // Unplugged: stop watching, the descriptor is closed on Stop
+                        LOG(WRN, L"Keyboard device lost: " + std::to_wstring(errno));
+                        epoll_ctl(m_epoll, EPOLL_CTL_DEL, fd, nullptr);
+                    }
+                    break;
+                }
+
+                TRACE_SPAN_NAMED("EvdevSource::Read", "input");
+                size_t recordCount = static_cast<size_t>(bytes) / sizeof(input_event);
+                for (size_t r = 0; r < recordCount; r++)
+                {
+                    uint64_t entryNs = LatencyClockNs();
+                    const input_event &record = records[r];
+                    if (record.type != EV_KEY)
+                    {
+                        continue;
+                    }
+                    uint16_t vkCode = VirtualKeyFor(record.code);
+                    if (vkCode == 0)
+                    {
+                        continue;
+                    }
+
+                    // value is 0 for release, 1 for press and 2 for auto-repeat
+                    KeyEvent event;
+                    event.vkCode = vkCode;
+                    event.scanCode = record.code;
+                    event.flags = record.value == 0 ? KEY_EVENT_UP : 0;
+                    event.reserved = 0;
+                    event.timestampUs = static_cast<int64_t>(record.input_event_sec) * 1000000 + record.input_event_usec;
+                    m_worker->Post(event);
+                    LatencyStats::Instance().Record(LATENCY_HOOK, LatencyClockNs() - entryNs);
+                }
+
+                if (recordCount < EVDEV_READ_BATCH)
+                {
+                    break;
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,250 @@
+// keyboard_checker_headless: wrong-layout detection on Linux without a desktop,
+// reading keyboards through evdev and printing reports to stdout
+#include <algorithm>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include "detection_engine.h"
+#include "engine_setup.h"
+#include "evdev_source.h"
+#include "key_event_worker.h"
+#include "latency_histogram.h"
+#include "logger.h"
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: keyboard_checker_headless [--device <path>]... [--layout en|he] [--layouts <pack.kblp>]\n"
+                    "                                 [--model <model.kbng>] [--dict <words.kbdw>] [--idle-ms <n>] [--log <file>] [--record-trace <file.kbtrace>] [--stats <file.json>]\n"
+                    "                                 [--timeline <file.json>]\n"
+                    "  --device  event device to read, repeatable; default is every keyboard under /dev/input\n"
+                    "  --layout  layout the keyboard is set to (there is no OS layout to query); default en\n"
+                    "  --layouts layout pack to translate keys with instead of the built-in en and he tables\n"
+                    "  --idle-ms pause after which an unfinished word is checked; 0 waits for the word to end\n"
+                    "  --record-trace  appends every key event to a trace for kbtrace-replay\n"
+                    "  --stats   where SIGUSR1 writes latency histograms as JSON; default logs/latency_stats.json\n"
+                    "  --timeline  records spans, written as Chrome trace-event JSON on SIGUSR1 and at exit\n");
+}
+
+// Writes text as UTF-8 a chunk at a time, without allocating
+static void PrintUtf8(FILE *out, std::wstring_view text)
+{
+    wchar_t chunk[256];
+    char buffer[sizeof(chunk) / sizeof(chunk[0]) * 4];
+    while (!text.empty())
+    {
+        size_t count = std::min(text.size(), sizeof(chunk) / sizeof(chunk[0]) - 1);
+        text.copy(chunk, count);
+        chunk[count] = L'\0';
+        fwrite(buffer, 1, AppendUtf8(buffer, 0, sizeof(buffer), chunk), out);
+        text.remove_prefix(count);
+    }
+}
+
+static void WriteTimeline(const std::filesystem::path &path)
+{
+    if (path.empty())
+    {
+        return;
+    }
+    if (SpanTrace::Instance().WriteChromeJson(path))
+    {
+        fprintf(stderr, "Timeline written to %s (%llu spans, %llu dropped)\n", path.string().c_str(),
+                static_cast<unsigned long long>(SpanTrace::Instance().EventCount()),
+                static_cast<unsigned long long>(SpanTrace::Instance().DroppedCount()));
+    }
+    else
+    {
+        fprintf(stderr, "Cannot write timeline to %s\n", path.string().c_str());
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<std::string> devices;
+    uint16_t activeLang = LAYOUT_LANG_ENGLISH;
+    std::string packPath;
+    std::string modelPath;
+    std::string dictionaryPath;
+    std::string logPath;
+    int64_t idleCheckUs = DEFAULT_IDLE_CHECK_US;
+    std::string tracePath;
+    std::filesystem::path statsPath = DEFAULT_LATENCY_STATS_PATH;
+    std::filesystem::path timelinePath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--device") == 0 && i + 1 < argc)
+        {
+            devices.push_back(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--layout") == 0 && i + 1 < argc)
+        {
+            std::string layout = argv[++i];
+            if (layout == "en")
+            {
+                activeLang = LAYOUT_LANG_ENGLISH;
+            }
+            else if (layout == "he")
+            {
+                activeLang = LAYOUT_LANG_HEBREW;
+            }
+            else
+            {
+                PrintUsage();
+                return 2;
+            }
+        }
+        else if (strcmp(argv[i], "--layouts") == 0 && i + 1 < argc)
+        {
+            packPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            modelPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dict") == 0 && i + 1 < argc)
+        {
+            dictionaryPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--idle-ms") == 0 && i + 1 < argc)
+        {
+            idleCheckUs = static_cast<int64_t>(atoi(argv[++i])) * 1000;
+        }
+        else if (strcmp(argv[i], "--log") == 0 && i + 1 < argc)
+        {
+            logPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--record-trace") == 0 && i + 1 < argc)
+        {
+            tracePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--stats") == 0 && i + 1 < argc)
+        {
+            statsPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+        {
+            timelinePath = argv[++i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    if (!logPath.empty())
+    {
+        Logger::Instance().Initialize(std::wstring(logPath.begin(), logPath.end()));
+    }
+
+    // Block the handled signals before any thread starts so only sigwait sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    sigaddset(&signals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    if (!timelinePath.empty())
+    {
+        SpanTrace::Instance().Enable();
+    }
+
+    std::vector<LayoutTable> layouts;
+    DetectionEngine engine;
+    if (!LoadLayouts(packPath, layouts) ||
+        !ConfigureEngine(engine, layouts, modelPath, dictionaryPath, DEFAULT_MIN_TEXT_LENGTH, true))
+    {
+        return 1;
+    }
+    engine.SetIdleCheckDelay(idleCheckUs);
+
+    int activeLayout = engine.FindLayoutByLanguage(activeLang);
+    engine.SetActiveLayoutFunction([activeLayout]() { return activeLayout; });
+    engine.SetWrongLayoutHandler([&engine](const WrongLayoutReport &report)
+    {
+        uint64_t startNs = LatencyClockNs();
+        TRACE_SPAN_NAMED("PrintReport", "ui");
+        PrintUtf8(stdout, L"Wrong layout: \"");
+        PrintUtf8(stdout, report.currentText);
+        PrintUtf8(stdout, L"\" in ");
+        PrintUtf8(stdout, engine.Layout(report.currentLayout).Name());
+        for (size_t i = 0; i < report.layoutCount; i++)
+        {
+            if (i != report.currentLayout)
+            {
+                PrintUtf8(stdout, L", ");
+                PrintUtf8(stdout, engine.Layout(i).Name());
+                PrintUtf8(stdout, L": \"");
+                PrintUtf8(stdout, report.conversions[i]);
+                PrintUtf8(stdout, L"\"");
+            }
+        }
+        fputc('\n', stdout);
+        fflush(stdout);
+        LatencyStats::Instance().Record(LATENCY_UI, LatencyClockNs() - startNs);
+    });
+
+    KeyTraceWriter trace;
+    if (!tracePath.empty())
+    {
+        if (!trace.Open(tracePath))
+        {
+            fprintf(stderr, "Cannot record key trace to %s\n", tracePath.c_str());
+            return 1;
+        }
+        engine.SetTraceWriter(&trace);
+    }
+
+    KeyEventWorker worker;
+    worker.Start([&engine](const KeyEvent *events, size_t count) { engine.ProcessEvents(events, count); },
+                 [&engine]() { engine.OnIdle(); });
+
+    EvdevSource source(devices);
+    if (!source.Start(worker))
+    {
+        fprintf(stderr, "No keyboard could be opened; check --device and read access to /dev/input\n");
+        worker.Stop();
+        Logger::Instance().Shutdown();
+        return 1;
+    }
+
+    // SIGUSR1 dumps the latency histograms and keeps running
+    int signal = 0;
+    while (sigwait(&signals, &signal) == 0 && signal == SIGUSR1)
+    {
+        if (LatencyStats::Instance().WriteJson(statsPath))
+        {
+            fprintf(stderr, "Latency stats written to %s\n", statsPath.string().c_str());
+        }
+        else
+        {
+            fprintf(stderr, "Cannot write latency stats to %s\n", statsPath.string().c_str());
+        }
+        WriteTimeline(timelinePath);
+    }
+
+    source.Stop();
+    worker.Stop();
+    fprintf(stderr, "%llu keys, %llu words checked, %llu wrong layout, %llu events dropped\n",
+            static_cast<unsigned long long>(engine.KeysProcessed()),
+            static_cast<unsigned long long>(engine.WordsChecked()),
+            static_cast<unsigned long long>(engine.WrongLayoutCount()),
+            static_cast<unsigned long long>(worker.DroppedCount()));
+    const DetectionScheduler &scheduler = engine.Scheduler();
+    fprintf(stderr, "%llu checks (%llu at word end, %llu when idle), %llu avoided, %llu superseded\n",
+            static_cast<unsigned long long>(scheduler.Evaluations()),
+            static_cast<unsigned long long>(scheduler.BoundaryChecks()),
+            static_cast<unsigned long long>(scheduler.IdleChecks()),
+            static_cast<unsigned long long>(scheduler.EvaluationsAvoided()),
+            static_cast<unsigned long long>(scheduler.CancelledChecks()));
+    std::wstring latency = LatencyStats::Instance().Summary();
+    PrintUtf8(stderr, latency);
+    WriteTimeline(timelinePath);
+    Logger::Instance().Shutdown();
+    return 0;
+}
@@ -0,0 +1,120 @@
+#include "key_event_worker.h"
+#include "span_trace.h"
+
+KeyEventWorker::KeyEventWorker(size_t capacity)
+    : m_queue(capacity),
+      m_stop(false),
+      m_sleeping(false),
+      m_dropped(0),
+      m_processed(0)
+{
+}
+
+KeyEventWorker::~KeyEventWorker()
+{
+    Stop();
+}
+
+void KeyEventWorker::Start(BatchHandler handler, IdleHandler idleHandler)
+{
+    if (m_thread.joinable())
+    {
+        return;
+    }
+    m_handler = std::move(handler);
+    m_idleHandler = std::move(idleHandler);
+    m_stop.store(false, std::memory_order_release);
+    m_thread = std::thread(&KeyEventWorker::Run, this);
+}
+
+void KeyEventWorker::Stop()
+{
+    if (!m_thread.joinable())
+    {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_wakeMutex);
+        m_stop.store(true, std::memory_order_release);
+    }
+    m_wake.notify_one();
+    m_thread.join();
+}
+
+bool KeyEventWorker::Post(const KeyEvent &event)
+{
+    if (!m_queue.TryPush(event))
+    {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+
+    // Pairs with the fence in Run: either the worker sees the event before
+    // sleeping, or we see it asleep. Only then is the lock taken, for as long
+    // as the worker needs to get into its wait.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_sleeping.load(std::memory_order_relaxed))
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_wakeMutex);
+        }
+        m_wake.notify_one();
+    }
+    return true;
+}
+
+bool KeyEventWorker::DrainBatch(KeyEvent *batch)
+{
+    size_t count = m_queue.PopBatch(batch, KEY_WORKER_BATCH);
+    if (count == 0)
+    {
+        return false;
+    }
+    m_handler(batch, count);
+    m_processed.fetch_add(count, std::memory_order_relaxed);
+    return true;
+}
+
+void KeyEventWorker::Run()
+{
+    SpanTrace::SetThreadName("key worker");
+    KeyEvent batch[KEY_WORKER_BATCH];
+    int idleSpins = 0;
+    for (;;)
+    {
+        if (DrainBatch(batch))
+        {
+            idleSpins = 0;
+            continue;
+        }
+        if (m_stop.load(std::memory_order_acquire))
+        {
+            // Events posted before Stop are handled before returning
+            while (DrainBatch(batch))
+            {
+            }
+            return;
+        }
+
+        // Bursts (held keys, pasted text) usually continue within microseconds
+        if (idleSpins++ < KEY_WORKER_SPINS)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+        idleSpins = 0;
+        if (m_idleHandler)
+        {
+            m_idleHandler();
+        }
+
+        std::unique_lock<std::mutex> lock(m_wakeMutex);
+        m_sleeping.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (m_queue.Empty() && !m_stop.load(std::memory_order_acquire))
+        {
+            m_wake.wait_for(lock, std::chrono::milliseconds(KEY_WORKER_IDLE_MS));
+        }
+        m_sleeping.store(false, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,151 @@
+#include "key_trace.h"
+#include <cstring>
+#include <system_error>
+#include "logger.h"
+
+// stdio buffer for the trace file; a batch of records is usually one write
+const size_t KEY_TRACE_BUFFER_SIZE = 64 * 1024;
+
+static KeyTraceHeader MakeHeader()
+{
+    KeyTraceHeader header;
+    memcpy(header.magic, "KBTR", 4);
+    header.version = KEY_TRACE_VERSION;
+    header.recordSize = sizeof(KeyTraceRecord);
+    return header;
+}
+
+static bool IsValidHeader(const KeyTraceHeader &header)
+{
+    return memcmp(header.magic, "KBTR", 4) == 0 && header.version == KEY_TRACE_VERSION &&
+           header.recordSize == sizeof(KeyTraceRecord);
+}
+
+KeyTraceWriter::KeyTraceWriter()
+    : m_file(nullptr),
+      m_records(0)
+{
+}
+
+KeyTraceWriter::~KeyTraceWriter()
+{
+    Close();
+}
+
+bool KeyTraceWriter::Open(const std::filesystem::path &path)
+{
+    Close();
+
+    std::error_code ec;
+    uintmax_t size = std::filesystem::exists(path, ec) ? std::filesystem::file_size(path, ec) : 0;
+    if (ec)
+    {
+        return false;
+    }
+
+    // A file too short to hold a header has no records worth keeping
+    if (size >= sizeof(KeyTraceHeader))
+    {
+        // Only continue a trace in this format
+        FILE *existing = OpenLogFile(path.wstring(), L"rb");
+        KeyTraceHeader header;
+        bool valid = existing && fread(&header, sizeof(header), 1, existing) == 1 && IsValidHeader(header);
+        if (existing)
+        {
+            fclose(existing);
+        }
+        if (!valid)
+        {
+            LOG(ERR, L"Not a key trace, not appending: " + path.wstring());
+            return false;
+        }
+
+        uintmax_t whole = sizeof(KeyTraceHeader) +
+                          (size - sizeof(KeyTraceHeader)) / sizeof(KeyTraceRecord) * sizeof(KeyTraceRecord);
+        if (whole != size)
+        {
+            std::filesystem::resize_file(path, whole, ec);
+            if (ec)
+            {
+                return false;
+            }
+        }
+        m_file = OpenLogFile(path.wstring(), L"ab");
+        if (!m_file)
+        {
+            return false;
+        }
+        setvbuf(m_file, nullptr, _IOFBF, KEY_TRACE_BUFFER_SIZE);
+    }
+    else
+    {
+        m_file = OpenLogFile(path.wstring(), L"wb");
+        if (!m_file)
+        {
+            return false;
+        }
+
+        // The buffer can only be set before the first write
+        setvbuf(m_file, nullptr, _IOFBF, KEY_TRACE_BUFFER_SIZE);
+        KeyTraceHeader header = MakeHeader();
+        if (fwrite(&header, sizeof(header), 1, m_file) != 1)
+        {
+            Close();
+            return false;
+        }
+    }
+    m_records = 0;
+    return true;
+}
+
+void KeyTraceWriter::Close()
+{
+    if (m_file)
+    {
+        fclose(m_file);
+        m_file = nullptr;
+    }
+}
+
+void KeyTraceWriter::Append(const KeyTraceRecord &record)
+{
+    if (m_file && fwrite(&record, sizeof(record), 1, m_file) == 1)
+    {
+        m_records++;
+    }
+}
+
+void KeyTraceWriter::Flush()
+{
+    if (m_file)
+    {
+        fflush(m_file);
+    }
+}
+
+bool KeyTraceReader::Open(const std::filesystem::path &path)
+{
+    Close();
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+
+    KeyTraceHeader header;
+    if (m_file.Size() < sizeof(header))
+    {
+        m_file.Close();
+        return false;
+    }
+    memcpy(&header, m_file.Data(), sizeof(header));
+    if (!IsValidHeader(header))
+    {
+        m_file.Close();
+        return false;
+    }
+
+    // The mapping is page aligned, so records after the 8-byte header are aligned too
+    m_records = reinterpret_cast<const KeyTraceRecord *>(m_file.Data() + sizeof(KeyTraceHeader));
+    m_count = (m_file.Size() - sizeof(KeyTraceHeader)) / sizeof(KeyTraceRecord);
+    return true;
+}
@@ -6,8 +6,9 @@
 #include <windows.h>
 #include <string>
 #include <vector>
-#include <unordered_map>
+#include "layout_pack.h"
 #include "logger.h"
+#include "win32_hook_source.h"
 
 // Static helper function for string conversion
 static std::wstring ToWString(const std::string &str)
@@ -24,12 +25,6 @@ static std::wstring ToWString(const std::string &str)
     return result;
 }
 
-// Helper function to check if a character is Hebrew
-static bool IsHebrewChar(wchar_t ch)
-{
-    return (ch >= 0x0590 && ch <= 0x05FF);  // Hebrew Unicode range
-}
-
 // Helper function to get layout primary language ID
 static WORD GetLayoutPrimaryLangID(HKL layout)
 {
@@ -45,19 +40,27 @@ static bool IsHebrewLayout(HKL layout)
 KeyboardChecker *KeyboardChecker::s_instance = nullptr;
 
 KeyboardChecker::KeyboardChecker()
-    : m_keyboardHook(NULL),
-      m_hwnd(NULL),
+    : m_hwnd(NULL),
       m_textWindow(NULL),
-      m_minTextLength(3),
-      m_isShiftPressed(false),
-      m_isCtrlPressed(false),
-      m_isAltPressed(false),
-      m_isRunning(false)
+      m_popup(NULL),
+      m_uiLayoutReader(m_layouts),
+      m_workerLayoutReader(m_layouts),
+      m_activeLayout(0),
+      m_engineLayoutVersion(0),
+      m_rebuildingLayouts(false),
+      m_isRunning(false),
+      m_presenter(*this),
+      m_inputSource(new Win32HookSource())
 {
     LOG(INF, L"Initializing KeyboardChecker");
     ZeroMemory(&m_notifyIconData, sizeof(m_notifyIconData));
     s_instance = this;
     InitializeLayouts();
+
+    // The engine runs on the key worker and reports back through the window
+    m_engine.SetActiveLayoutFunction([this]() { return FindLayoutIndex(m_activeLayout.load(std::memory_order_relaxed)); });
+    m_engine.SetTextHandler([this](std::wstring_view text) { UpdateText(text); });
+    m_engine.SetWrongLayoutHandler([this](const WrongLayoutReport &report) { UpdatePopup(report); });
 }
 
 KeyboardChecker::~KeyboardChecker()
@@ -85,42 +88,137 @@ void KeyboardChecker::DeleteInstance()
     }
 }
 
+std::unique_ptr<LayoutSnapshot> KeyboardChecker::BuildLayoutSnapshot(uint64_t version)
+{
+    std::unique_ptr<LayoutSnapshot> snapshot(new LayoutSnapshot());
+    snapshot->version = version;
+
+    // Get the number of keyboard layouts
+    int layoutCount = GetKeyboardLayoutList(0, NULL);
+    if (layoutCount <= 0)
+    {
+        LOG(ERR, L"No keyboard layouts found");
+        return snapshot;
+    }
+
+    // Get all layouts
+    std::vector<HKL> layouts(layoutCount);
+    layoutCount = GetKeyboardLayoutList(layoutCount, layouts.data());
+    layouts.resize(layoutCount > 0 ? layoutCount : 0);
+
+    for (HKL layout : layouts)
+    {
+        snapshot->systemIds.push_back(reinterpret_cast<uintptr_t>(layout));
+    }
+
+    // The pack saved last time is used as long as the same languages are installed
+    LayoutPack pack;
+    if (pack.Load(DEFAULT_LAYOUT_PACK_PATH) && pack.Matches(snapshot->systemIds))
+    {
+        for (size_t i = 0; i < pack.LayoutCount(); i++)
+        {
+            snapshot->layouts.push_back(pack.Layout(i));
+        }
+        LOG(INF, L"Loaded " + std::to_wstring(snapshot->layouts.size()) + L" layouts from the layout pack");
+        return snapshot;
+    }
+
+    LayoutPackBuilder builder;
+    for (HKL layout : layouts)
+    {
+        std::wstring langName = GetLayoutName(layout);
+        snapshot->layouts.push_back(LayoutTable::FromSystemLayout(layout, langName));
+        builder.Add(snapshot->layouts.back(), reinterpret_cast<uintptr_t>(layout));
+        LOG(DBG, L"Found keyboard layout: " + langName +
+            L" (0x" + std::to_wstring((DWORD_PTR)layout) + L")" +
+            L" Primary Lang ID: 0x" + std::to_wstring(GetLayoutPrimaryLangID(layout)));
+
+        if (IsHebrewLayout(layout))
+        {
+            LOG(INF, L"Hebrew layout detected");
+        }
+    }
+
+    pack.Close();
+    if (!builder.Write(DEFAULT_LAYOUT_PACK_PATH))
+    {
+        LOG(WRN, L"Failed to save the layout pack");
+    }
+    return snapshot;
+}
+
 void KeyboardChecker::InitializeLayouts()
 {
     LOG(INF, L"Initializing keyboard layouts");
-    
-    // Get the number of keyboard layouts
+    m_layouts.Publish(BuildLayoutSnapshot(1));
+    RefreshActiveLayout();
+
+    m_engine.LoadModel(DEFAULT_NGRAM_MODEL_PATH);
+    m_engine.LoadDictionary(DEFAULT_WORD_DICTIONARY_PATH);
+}
+
+void KeyboardChecker::RefreshActiveLayout()
+{
+    m_activeLayout.store(reinterpret_cast<uintptr_t>(GetActiveLayout()), std::memory_order_relaxed);
+}
+
+void KeyboardChecker::CheckLayoutList()
+{
+    // Previous snapshots are freed here too, once the worker has moved on
+    m_layouts.Reclaim();
+    if (m_rebuildingLayouts.load(std::memory_order_acquire))
+    {
+        return;
+    }
+
     int layoutCount = GetKeyboardLayoutList(0, NULL);
-    if (layoutCount > 0)
+    std::vector<HKL> layouts(layoutCount > 0 ? layoutCount : 0);
+    layoutCount = GetKeyboardLayoutList(layoutCount, layouts.data());
+    layouts.resize(layoutCount > 0 ? layoutCount : 0);
+
+    uint64_t version;
     {
-        // Get all layouts
-        std::vector<HKL> layouts(layoutCount);
-        GetKeyboardLayoutList(layoutCount, layouts.data());
-        
-        for (HKL layout : layouts)
+        LayoutSnapshotCell::ReadLock snapshot(m_uiLayoutReader);
+        bool same = snapshot && snapshot->systemIds.size() == layouts.size();
+        for (size_t i = 0; same && i < layouts.size(); i++)
+        {
+            same = snapshot->systemIds[i] == reinterpret_cast<uintptr_t>(layouts[i]);
+        }
+        if (same)
         {
-            // Get layout info
-            wchar_t layoutName[KL_NAMELENGTH];
-            if (GetKeyboardLayoutName(layoutName))
-            {
-                m_availableLayouts.push_back(layout);
-                
-                std::wstring langName = GetLayoutName(layout);
-                LOG(DBG, L"Found keyboard layout: " + langName + 
-                    L" (0x" + std::to_wstring((DWORD_PTR)layout) + L")" +
-                    L" Primary Lang ID: 0x" + std::to_wstring(GetLayoutPrimaryLangID(layout)));
-                
-                if (IsHebrewLayout(layout))
-                {
-                    LOG(INF, L"Hebrew layout detected");
-                }
-            }
+            return;
         }
+        version = snapshot ? snapshot->version + 1 : 1;
     }
-    else
+
+    // Reading the tables takes a while, so it is done off the UI thread. Keys
+    // go on using the old snapshot until the new one is published.
+    LOG(INF, L"Input languages changed, rebuilding layouts (" + std::to_wstring(layouts.size()) + L" installed)");
+    if (m_layoutBuilder.joinable())
     {
-        LOG(ERR, L"No keyboard layouts found");
+        m_layoutBuilder.join();
+    }
+    m_rebuildingLayouts.store(true, std::memory_order_release);
+    m_layoutBuilder = std::thread([this, version]()
+    {
+        m_layouts.Publish(BuildLayoutSnapshot(version));
+        m_rebuildingLayouts.store(false, std::memory_order_release);
+    });
+}
+
+void KeyboardChecker::SyncEngineLayouts()
+{
+    // One atomic load per batch unless the snapshot changed
+    LayoutSnapshotCell::ReadLock snapshot(m_workerLayoutReader);
+    if (!snapshot || snapshot->version == m_engineLayoutVersion)
+    {
+        return;
     }
+    m_engine.SetLayouts(snapshot->layouts);
+    m_engineLayoutIds = snapshot->systemIds;
+    m_engineLayoutVersion = snapshot->version;
+    LOG(INF, L"Using layout snapshot " + std::to_wstring(snapshot->version) + L" with " +
+        std::to_wstring(snapshot->layouts.size()) + L" layouts");
 }
 
 bool KeyboardChecker::InitializeWindow()
@@ -187,65 +285,51 @@ bool KeyboardChecker::InitializeWindow()
     return true;
 }
 
-void KeyboardChecker::UpdateText(const std::wstring &text)
+void KeyboardChecker::UpdateText(std::wstring_view text)
 {
-    LOG(DBG, L"Updating text: " + text);
+    TRACE_SPAN("ui");
+    LOGF(DBG, L"Updating text: %.*ls", static_cast<int>(text.size()), text.data());
 
-    // Get current layout name
-    wchar_t layoutName[KL_NAMELENGTH];
-    if (!GetKeyboardLayoutNameW(layoutName))
+    // Runs on the key worker; the window is only touched on its own thread.
+    // Only the first change after a flush wakes it, not every key of a burst.
+    if (m_presenter.SetText(text) && m_hwnd)
     {
-        LOG(ERR, L"Failed to get keyboard layout name");
-        return;
+        PostMessage(m_hwnd, WM_KEYCHECKER_TEXT, 0, 0);
     }
-    LOG(DBG, L"Current keyboard layout: " + std::wstring(layoutName));
+}
 
-    try
+void KeyboardChecker::PresentPending()
+{
+    // The frame timer runs only while a view waits for its frame
+    int64_t delayUs = m_presenter.Tick();
+    if (delayUs >= 0)
     {
-        std::vector<std::wstring> conversions;
-        HKL currentLayout = GetKeyboardLayout(0);
-
-        if (text.empty())
-        {
-            return;
-        }
+        SetTimer(m_hwnd, ID_TIMER_PRESENT, static_cast<UINT>(std::max<int64_t>(1, (delayUs + 999) / 1000)), NULL);
+    }
+    else
+    {
+        KillTimer(m_hwnd, ID_TIMER_PRESENT);
+    }
+}
 
-        LOG(DBG, L"Inside the if statement");
-        for (const auto &key : m_pressedKeys)
-        {
-            wchar_t converted = GetCharForKey(key.vkCode, currentLayout);
-            if (converted != 0)
-            {
-                std::wstring convertedStr(1, converted);
-                LOG(DBG, L"Converted key 0x" + std::to_wstring(key.vkCode) + L" to: " + convertedStr);
-                conversions.push_back(convertedStr);
-            }
-        }
+void KeyboardChecker::Present(const PresenterView &view, int64_t)
+{
+    if (!m_textWindow || !IsWindow(m_textWindow))
+    {
+        return;
+    }
 
-        LOG(DBG, L"Found " + std::to_wstring(conversions.size()) + L" conversions");
-        if (!conversions.empty())
-        {
-            std::wstring convertedText;
-            for (const auto &conv : conversions)
-            {
-                convertedText += conv;
-            }
-            LOG(DBG, L"Setting text to: " + convertedText);
-
-            // Use UTF-16 for text display
-            if (m_textWindow && IsWindow(m_textWindow))
-            {
-                if (!SetWindowTextW(m_textWindow, convertedText.c_str()))
-                {
-                    DWORD error = GetLastError();
-                    LOG(ERR, L"Failed to set window text. Error: " + std::to_wstring(error));
-                }
-            }
-        }
+    // List the word as it would read in every other layout. The buffer is
+    // reused, so once grown this allocates nothing.
+    TRACE_SPAN_NAMED("SetWindowText", "ui");
+    m_windowText.assign(view.text);
+    for (size_t i = 0; i < view.conversionCount; i++)
+    {
+        m_windowText.append(L"\r\n").append(view.conversions[i].layoutName).append(L": ").append(view.conversions[i].text);
     }
-    catch (const std::exception &e)
+    if (!SetWindowTextW(m_textWindow, m_windowText.c_str()))
     {
-        LOG(ERR, L"Exception during conversion: " + ToWString(e.what()));
+        LOG(ERR, L"Failed to set window text. Error: " + std::to_wstring(GetLastError()));
     }
 }
 
@@ -267,15 +351,23 @@ bool KeyboardChecker::Start()
         LOG(ERR, L"Failed to initialize window");
         return false;
     }
+    SetTimer(m_hwnd, ID_TIMER_ACTIVE_LAYOUT, ACTIVE_LAYOUT_POLL_MS, NULL);
+    SetTimer(m_hwnd, ID_TIMER_LAYOUT_LIST, LAYOUT_LIST_POLL_MS, NULL);
 
-    // Set up keyboard hook
-    m_keyboardHook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, NULL, 0);
-    if (!m_keyboardHook)
+    // Keys are analysed on the worker so the input source returns immediately
+    m_keyWorker.Start([this](const KeyEvent *events, size_t count)
+                      {
+                          SyncEngineLayouts();
+                          m_engine.ProcessEvents(events, count);
+                      },
+                      [this]() { m_engine.OnIdle(); });
+
+    if (!m_inputSource->Start(m_keyWorker))
     {
-        LOG(ERR, L"Failed to set keyboard hook. Error: " + std::to_wstring(GetLastError()));
+        LOG(ERR, std::wstring(L"Failed to start input source ") + m_inputSource->Name());
+        m_keyWorker.Stop();
         return false;
     }
-    LOG(INF, L"Keyboard hook set successfully");
 
     m_isRunning = true;
     LOG(INF, L"Started successfully");
@@ -288,6 +380,9 @@ bool KeyboardChecker::Start()
         DispatchMessage(&msg);
     }
 
+    StopInput();
+    LOG(INF, L"Latency:\n" + LatencyStats::Instance().Summary());
+
     m_isRunning = false;
     LOG(INF, L"Message loop ended");
     return true;
@@ -302,7 +397,7 @@ void KeyboardChecker::Stop()
         return;
     }
 
-    CleanupKeyboardHook();
+    StopInput();
 
     if (m_hwnd)
     {
@@ -319,121 +414,37 @@ void KeyboardChecker::Stop()
     m_isRunning = false;
 }
 
-void KeyboardChecker::CleanupKeyboardHook()
-{
-    LOG(DBG, L"Cleaning up keyboard hook");
-    if (m_keyboardHook)
-    {
-        if (UnhookWindowsHookEx(m_keyboardHook))
-        {
-            LOG(INF, L"Keyboard hook removed successfully");
-        }
-        else
-        {
-            LOG(ERR, L"Failed to remove keyboard hook. Error: " + std::to_wstring(GetLastError()));
-        }
-        m_keyboardHook = NULL;
-    }
-}
-
-std::wstring KeyboardChecker::GetTextFromKeys(const std::vector<KeyPressInfo> &keys, HKL layout)
-{
-    LOG(DBG, L"Getting text from keys");
-    std::wstring text;
-    for (const auto &key : keys)
-    {
-        wchar_t ch = GetCharForKey(key.vkCode, layout);
-        if (ch != 0)
-        {
-            text += ch;
-        }
-    }
-    LOG(DBG, L"Generated text: " + text);
-    return text;
-}
-
-bool KeyboardChecker::IsValidInLayout(const std::wstring &text, HKL layout)
+bool KeyboardChecker::RecordTrace(const std::wstring &path)
 {
-    if (text.empty())
+    if (!m_traceWriter.Open(path))
     {
-        LOG(DBG, L"Text is empty");
-        return true;
-    }
-
-    LOG(DBG, L"Checking if text '" + text + L"' is valid in layout 0x" + 
-        std::to_wstring((DWORD_PTR)layout) + L" (Primary: 0x" + 
-        std::to_wstring(GetLayoutPrimaryLangID(layout)) + L")");
-
-    bool isHebrewLayout = IsHebrewLayout(layout);
-    if (isHebrewLayout)
-    {
-        LOG(DBG, L"Checking Hebrew layout");
-        // For Hebrew layout, we accept both Hebrew and ASCII characters
-        for (wchar_t ch : text)
-        {
-            if (!IsHebrewChar(ch) && ch > 0x7F && ch != L' ')  // Allow spaces and ASCII
-            {
-                LOG(WRN, L"Character '" + std::wstring(1, ch) + 
-                    L"' (0x" + std::to_wstring(ch) + L") is not valid in Hebrew layout");
-                return false;
-            }
-        }
-    }
-    else
-    {
-        LOG(DBG, L"Checking English layout");
-        // For English layout, we only accept ASCII characters
-        for (wchar_t ch : text)
-        {
-            if (ch > 0x7F && ch != L' ')  // Allow spaces
-            {
-                LOG(WRN, L"Character '" + std::wstring(1, ch) + 
-                    L"' (0x" + std::to_wstring(ch) + L") is not valid in English layout");
-                return false;
-            }
-        }
+        LOG(ERR, L"Failed to open key trace " + path);
+        return false;
     }
-
-    LOG(DBG, L"All characters are valid in layout");
+    LOG(INF, L"Recording key trace to " + path);
+    m_engine.SetTraceWriter(&m_traceWriter);
     return true;
 }
 
-LRESULT CALLBACK KeyboardChecker::LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
+void KeyboardChecker::StopInput()
 {
-    LOG(DBG, L"Low-level keyboard hook");
-    if (nCode < 0)
-    {
-        return CallNextHookEx(NULL, nCode, wParam, lParam);
-    }
-
-    KeyboardChecker *instance = KeyboardChecker::GetInstance();
-    if (!instance)
+    // Source first: the worker drains what it already posted
+    m_inputSource->Stop();
+    m_keyWorker.Stop();
+    if (m_hwnd)
     {
-        LOG(ERR, L"KeyboardChecker instance is null");
-        return CallNextHookEx(NULL, nCode, wParam, lParam);
+        KillTimer(m_hwnd, ID_TIMER_ACTIVE_LAYOUT);
+        KillTimer(m_hwnd, ID_TIMER_LAYOUT_LIST);
+        KillTimer(m_hwnd, ID_TIMER_PRESENT);
     }
-
-    KBDLLHOOKSTRUCT *hookStruct = (KBDLLHOOKSTRUCT *)lParam;
-    if (!hookStruct)
+    if (m_layoutBuilder.joinable())
     {
-        LOG(ERR, L"Hook struct is null");
-        return CallNextHookEx(NULL, nCode, wParam, lParam);
+        m_layoutBuilder.join();
     }
-
-    switch (wParam)
+    if (m_keyWorker.DroppedCount() > 0)
     {
-    case WM_KEYDOWN:
-    case WM_SYSKEYDOWN:
-        instance->OnKeyDown(hookStruct->vkCode);
-        break;
-
-    case WM_KEYUP:
-    case WM_SYSKEYUP:
-        instance->OnKeyUp(hookStruct->vkCode);
-        break;
+        LOG(WRN, L"Key events dropped: " + std::to_wstring(m_keyWorker.DroppedCount()));
     }
-
-    return CallNextHookEx(NULL, nCode, wParam, lParam);
 }
 
 LRESULT CALLBACK KeyboardChecker::WndProc(HWND hwnd, UINT message, WPARAM wParam, LPARAM lParam)
@@ -455,11 +466,34 @@ LRESULT CALLBACK KeyboardChecker::WndProc(HWND hwnd, UINT message, WPARAM wParam
         }
         break;
 
+    case WM_TIMER:
+        if (wParam == ID_TIMER_ACTIVE_LAYOUT)
+        {
+            instance->RefreshActiveLayout();
+        }
+        else if (wParam == ID_TIMER_LAYOUT_LIST)
+        {
+            instance->CheckLayoutList();
+        }
+        else if (wParam == ID_TIMER_PRESENT)
+        {
+            instance->PresentPending();
+        }
+        break;
+
+    case WM_KEYCHECKER_TEXT:
+        instance->PresentPending();
+        break;
+
     case WM_COMMAND:
         if (LOWORD(wParam) == ID_TRAYMENU_EXIT)
         {
             PostQuitMessage(0);
         }
+        else if (LOWORD(wParam) == ID_TRAYMENU_STATS)
+        {
+            instance->ShowLatencyStats();
+        }
         break;
 
     case WM_DESTROY:
@@ -473,73 +507,30 @@ LRESULT CALLBACK KeyboardChecker::WndProc(HWND hwnd, UINT message, WPARAM wParam
     return 0;
 }
 
-void KeyboardChecker::UpdateModifierState(DWORD vkCode, bool keyDown)
+HKL KeyboardChecker::GetActiveLayout() const
 {
-    LOG(DBG, L"Updating modifier state");
-    m_currentModifiers.UpdateFromKey(vkCode, keyDown);
+    // Polled on the UI thread, whose own layout says nothing about where the
+    // user is typing
+    HWND foreground = GetForegroundWindow();
+    DWORD threadId = foreground ? GetWindowThreadProcessId(foreground, NULL) : 0;
+    return GetKeyboardLayout(threadId);
 }
 
-void KeyboardChecker::OnKeyDown(DWORD vkCode)
+int KeyboardChecker::FindLayoutIndex(uintptr_t layout) const
 {
-    LOG(DBG, L"Key down: 0x" + std::to_wstring(vkCode));
-
-    if (IsModifierKey(vkCode))
-    {
-        UpdateModifierState(vkCode, true);
-        return;
-    }
-
-    // Add the key to pressed keys if not already present
-    KeyPressInfo newKey(vkCode, m_currentModifiers);
-    auto it = std::find(m_pressedKeys.begin(), m_pressedKeys.end(), newKey);
-    if (it == m_pressedKeys.end())
-    {
-        m_pressedKeys.push_back(newKey);
-        std::wstring newText = GetTextFromKeys(m_pressedKeys, GetKeyboardLayout(0));
-        UpdateText(newText);
-    }
+    auto it = std::find(m_engineLayoutIds.begin(), m_engineLayoutIds.end(), layout);
+    return it != m_engineLayoutIds.end() ? static_cast<int>(it - m_engineLayoutIds.begin()) : -1;
 }
 
-void KeyboardChecker::OnKeyUp(DWORD vkCode)
+void KeyboardChecker::UpdatePopup(const WrongLayoutReport &report)
 {
-    LOG(DBG, L"Key up: 0x" + std::to_wstring(vkCode));
-
-    if (IsModifierKey(vkCode))
-    {
-        UpdateModifierState(vkCode, false);
-        return;
-    }
+    TRACE_SPAN("ui");
+    LOGF(INF, L"Text '%.*ls' does not fit the current layout", static_cast<int>(report.currentText.size()),
+         report.currentText.data());
 
-    // Remove the key from pressed keys
-    KeyPressInfo keyToRemove(vkCode, m_currentModifiers);
-    auto it = std::find(m_pressedKeys.begin(), m_pressedKeys.end(), keyToRemove);
-    if (it != m_pressedKeys.end())
+    if (m_presenter.SetReport(report, m_engine) && m_hwnd)
     {
-        m_pressedKeys.erase(it);
-        std::wstring newText = GetTextFromKeys(m_pressedKeys, GetKeyboardLayout(0));
-        UpdateText(newText);
-    }
-}
-
-bool KeyboardChecker::IsModifierKey(DWORD vkCode)
-{
-    LOG(DBG, L"Checking if key is modifier");
-    switch (vkCode)
-    {
-    case VK_SHIFT:
-    case VK_LSHIFT:
-    case VK_RSHIFT:
-    case VK_CONTROL:
-    case VK_LCONTROL:
-    case VK_RCONTROL:
-    case VK_MENU:
-    case VK_LMENU:
-    case VK_RMENU:
-    case VK_LWIN:
-    case VK_RWIN:
-        return true;
-    default:
-        return false;
+        PostMessage(m_hwnd, WM_KEYCHECKER_TEXT, 0, 0);
     }
 }
 
@@ -568,89 +559,6 @@ std::wstring KeyboardChecker::GetLayoutName(HKL layout)
     return result;
 }
 
-wchar_t KeyboardChecker::GetCharForKey(DWORD vkCode, HKL layout)
-{
-    LOG(DBG, L"Getting char for VK: 0x" + std::to_wstring(vkCode) + 
-        L" in layout: 0x" + std::to_wstring((DWORD_PTR)layout) +
-        L" Primary Lang ID: 0x" + std::to_wstring(GetLayoutPrimaryLangID(layout)));
-
-    // Handle special keys
-    if (vkCode == VK_SPACE)
-    {
-        LOG(DBG, L"Space key detected");
-        return L' ';
-    }
-
-    // Skip processing for control keys
-    if (vkCode == VK_RETURN || vkCode == VK_TAB || vkCode == VK_BACK ||
-        vkCode == VK_DELETE || vkCode == VK_ESCAPE ||
-        (vkCode >= VK_F1 && vkCode <= VK_F24))
-    {
-        LOG(DBG, L"Control key detected");
-        return 0;
-    }
-
-    // Check for invalid virtual key code
-    if (vkCode > 0xFF && vkCode != VK_OEM_COMMA && vkCode != VK_OEM_PERIOD && vkCode != VK_OEM_MINUS)
-    {
-        LOG(ERR, L"Invalid virtual key code: 0x" + std::to_wstring(vkCode));
-        return 0;
-    }
-
-    // Get keyboard state
-    BYTE keyboardState[256] = {};
-    if (!GetKeyboardState(keyboardState))
-    {
-        LOG(ERR, L"Failed to get keyboard state");
-        return 0;
-    }
-
-    // Set shift state based on our modifier tracking
-    if (m_currentModifiers.shift)
-    {
-        keyboardState[VK_SHIFT] = 0x80;
-    }
-
-    // Get scan code
-    UINT scanCode = MapVirtualKeyEx(vkCode & 0xFF, MAPVK_VK_TO_VSC, layout);
-    if (scanCode == 0)
-    {
-        LOG(ERR, L"Failed to map virtual key to scan code");
-        return 0;
-    }
-
-    LOG(DBG, L"Mapped to scan code: 0x" + std::to_wstring(scanCode));
-
-    // Create buffer for the result
-    wchar_t result[32] = {};
-
-    int ret = ToUnicodeEx(vkCode & 0xFF, scanCode, keyboardState, result, 32, 0, layout);
-    LOG(DBG, L"ToUnicodeEx returned: " + std::to_wstring(ret));
-
-    if (ret > 0)
-    {
-        // Check if we got a Hebrew character
-        if (IsHebrewChar(result[0]))
-        {
-            LOG(DBG, L"Hebrew character detected: " + std::wstring(1, result[0]));
-        }
-        
-        std::wstring converted(result, ret);
-        LOG(DBG, L"Converted to character(s): " + converted);
-        
-        return result[0];
-    }
-    else if (ret == -1)
-    {
-        // Clear dead key state
-        wchar_t deadKeyResult[32] = {};
-        ToUnicodeEx(vkCode & 0xFF, scanCode, keyboardState, deadKeyResult, 32, 0, layout);
-    }
-
-    LOG(ERR, L"Failed to convert key to character");
-    return 0;
-}
-
 void KeyboardChecker::ShowTrayMenu()
 {
     LOG(DBG, L"Showing tray menu");
@@ -658,6 +566,7 @@ void KeyboardChecker::ShowTrayMenu()
     GetCursorPos(&pt);
 
     HMENU menu = CreatePopupMenu();
+    AppendMenu(menu, MF_STRING, ID_TRAYMENU_STATS, L"Latency stats");
     AppendMenu(menu, MF_STRING, ID_TRAYMENU_EXIT, L"Exit");
 
     // Required to make the menu disappear when clicking outside
@@ -669,3 +578,22 @@ void KeyboardChecker::ShowTrayMenu()
     PostMessage(m_hwnd, WM_NULL, 0, 0);
     DestroyMenu(menu);
 }
+
+void KeyboardChecker::ShowLatencyStats()
+{
+    // The JSON copy is for comparing runs; the box is for a quick look
+    std::wstring summary = LatencyStats::Instance().Summary();
+    summary += L"\nText window: " + std::to_wstring(m_presenter.Flushes()) + L" updates for " +
+               std::to_wstring(m_presenter.Updates()) + L" changes, " + std::to_wstring(m_presenter.Superseded()) +
+               L" superseded, " + std::to_wstring(m_presenter.Unchanged()) + L" unchanged";
+    if (LatencyStats::Instance().WriteJson(DEFAULT_LATENCY_STATS_PATH))
+    {
+        summary += L"\nSaved to " + std::wstring(DEFAULT_LATENCY_STATS_PATH);
+    }
+    else
+    {
+        LOG(ERR, L"Failed to write " + std::wstring(DEFAULT_LATENCY_STATS_PATH));
+    }
+    LOG(INF, L"Latency:\n" + summary);
+    MessageBoxW(m_hwnd, summary.c_str(), L"Keyboard Checker latency", MB_OK | MB_ICONINFORMATION);
+}
@@ -0,0 +1,162 @@
+#include "latency_histogram.h"
+#include <cstdio>
+#include <system_error>
+#include "logger.h"
+
+static std::atomic<size_t> s_nextThreadSlot(0);
+
+LatencyHistogram::LatencyHistogram()
+{
+    for (Shard &shard : m_shards)
+    {
+        for (std::atomic<uint64_t> &count : shard.counts)
+        {
+            count.store(0, std::memory_order_relaxed);
+        }
+        shard.sumNs.store(0, std::memory_order_relaxed);
+        shard.maxNs.store(0, std::memory_order_relaxed);
+    }
+}
+
+size_t LatencyHistogram::ThreadSlot()
+{
+    // Same slot for a thread in every histogram
+    static thread_local size_t slot = s_nextThreadSlot.fetch_add(1, std::memory_order_relaxed);
+    return slot < LATENCY_MAX_THREADS ? slot : LATENCY_MAX_THREADS - 1;
+}
+
+uint64_t LatencyHistogram::BucketHighest(size_t index)
+{
+    if (index < 2 * LATENCY_SUB_BUCKET_HALF)
+    {
+        return index;
+    }
+    size_t shift = index / LATENCY_SUB_BUCKET_HALF - 1;
+    uint64_t subBucket = index - shift * LATENCY_SUB_BUCKET_HALF;
+    return ((subBucket + 1) << shift) - 1;
+}
+
+LatencySnapshot LatencyHistogram::Snapshot() const
+{
+    LatencySnapshot snapshot = {};
+    uint64_t sum = 0;
+
+    // Counts are read while recording goes on, so the total is taken from
+    // the same reads the percentiles are computed from
+    uint64_t merged[LATENCY_BUCKET_COUNT] = {};
+    for (const Shard &shard : m_shards)
+    {
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+        {
+            merged[i] += shard.counts[i].load(std::memory_order_relaxed);
+        }
+        sum += shard.sumNs.load(std::memory_order_relaxed);
+        uint64_t max = shard.maxNs.load(std::memory_order_relaxed);
+        snapshot.maxNs = max > snapshot.maxNs ? max : snapshot.maxNs;
+    }
+
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+    {
+        snapshot.count += merged[i];
+    }
+    if (snapshot.count == 0)
+    {
+        return snapshot;
+    }
+    snapshot.meanNs = sum / snapshot.count;
+
+    // A percentile is reached once ceil(fraction * count) values are seen
+    const double fractions[] = {0.50, 0.99, 0.999};
+    uint64_t *results[] = {&snapshot.p50Ns, &snapshot.p99Ns, &snapshot.p999Ns};
+    size_t next = 0;
+    uint64_t seen = 0;
+    for (size_t i = 0; i < LATENCY_BUCKET_COUNT && next < 3; i++)
+    {
+        seen += merged[i];
+        while (next < 3 && seen > 0 && seen >= static_cast<uint64_t>(fractions[next] * snapshot.count + 0.999999))
+        {
+            uint64_t highest = BucketHighest(i);
+            *results[next] = highest < snapshot.maxNs ? highest : snapshot.maxNs;
+            next++;
+        }
+    }
+    return snapshot;
+}
+
+LatencyStats::LatencyStats()
+    : m_startNs(LatencyClockNs())
+{
+}
+
+const wchar_t *LatencyStats::MetricName(LatencyMetric metric)
+{
+    switch (metric)
+    {
+    case LATENCY_HOOK:
+        return L"hook";
+    case LATENCY_DETECTION:
+        return L"detection";
+    case LATENCY_UI:
+        return L"ui";
+    default:
+        return L"unknown";
+    }
+}
+
+std::wstring LatencyStats::Summary() const
+{
+    std::wstring summary;
+    for (int metric = 0; metric < LATENCY_METRIC_COUNT; metric++)
+    {
+        LatencySnapshot snapshot = Snapshot(static_cast<LatencyMetric>(metric));
+        wchar_t line[256];
+        swprintf(line, sizeof(line) / sizeof(line[0]),
+                 L"%-10ls n=%llu  p50 %.1f us  p99 %.1f us  p99.9 %.1f us  max %.1f us\n",
+                 MetricName(static_cast<LatencyMetric>(metric)), static_cast<unsigned long long>(snapshot.count),
+                 snapshot.p50Ns / 1000.0, snapshot.p99Ns / 1000.0, snapshot.p999Ns / 1000.0,
+                 snapshot.maxNs / 1000.0);
+        summary += line;
+    }
+    return summary;
+}
+
+std::string LatencyStats::ToJson() const
+{
+    std::string json = "{\n  \"uptime_s\": " + std::to_string((LatencyClockNs() - m_startNs) / 1000000000) +
+                       ",\n  \"metrics\": {\n";
+    for (int metric = 0; metric < LATENCY_METRIC_COUNT; metric++)
+    {
+        LatencySnapshot snapshot = Snapshot(static_cast<LatencyMetric>(metric));
+        char line[256];
+        char name[32];
+        name[AppendUtf8(name, 0, sizeof(name) - 1, MetricName(static_cast<LatencyMetric>(metric)))] = '\0';
+        snprintf(line, sizeof(line),
+                 "    \"%s\": {\"count\": %llu, \"mean_ns\": %llu, \"p50_ns\": %llu, \"p99_ns\": %llu, "
+                 "\"p999_ns\": %llu, \"max_ns\": %llu}%s\n",
+                 name, static_cast<unsigned long long>(snapshot.count),
+                 static_cast<unsigned long long>(snapshot.meanNs), static_cast<unsigned long long>(snapshot.p50Ns),
+                 static_cast<unsigned long long>(snapshot.p99Ns), static_cast<unsigned long long>(snapshot.p999Ns),
+                 static_cast<unsigned long long>(snapshot.maxNs), metric + 1 < LATENCY_METRIC_COUNT ? "," : "");
+        json += line;
+    }
+    json += "  }\n}\n";
+    return json;
+}
+
+bool LatencyStats::WriteJson(const std::filesystem::path &path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    FILE *file = OpenLogFile(path.wstring(), L"wb");
+    if (!file)
+    {
+        return false;
+    }
+    std::string json = ToJson();
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    return fclose(file) == 0 && written;
+}
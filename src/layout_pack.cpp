@@ -0,0 +1,232 @@
+#include "layout_pack.h"
+#include <cstring>
+#include "logger.h"
+
+static uint32_t Fnv1a(const uint8_t *data, size_t size)
+{
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++)
+    {
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+
+bool LayoutPack::Load(const std::filesystem::path &path)
+{
+    m_entries.clear();
+    m_data = nullptr;
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+    if (!LoadFromMemory(m_file.Data(), m_file.Size()))
+    {
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool LayoutPack::LoadFromMemory(const uint8_t *data, size_t size)
+{
+    m_entries.clear();
+    m_data = nullptr;
+    if (!data || size < sizeof(LayoutPackHeader))
+    {
+        return false;
+    }
+
+    LayoutPackHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "KBLP", 4) != 0 || header.version != LAYOUT_PACK_VERSION ||
+        header.payloadSize != size - sizeof(LayoutPackHeader) ||
+        header.checksum != Fnv1a(data + sizeof(LayoutPackHeader), header.payloadSize))
+    {
+        return false;
+    }
+    if (sizeof(LayoutPackHeader) + header.layoutCount * sizeof(LayoutPackEntry) > size)
+    {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < header.layoutCount; i++)
+    {
+        LayoutPackEntry entry;
+        memcpy(&entry, data + sizeof(LayoutPackHeader) + i * sizeof(LayoutPackEntry), sizeof(entry));
+
+        size_t nameEnd = static_cast<size_t>(entry.nameOffset) + entry.nameLength * sizeof(uint16_t);
+        size_t keyEnd = static_cast<size_t>(entry.keyOffset) +
+                        LayoutTable::KEY_COUNT * LSS_COUNT * sizeof(LayoutPackKey);
+        size_t comboEnd = static_cast<size_t>(entry.comboOffset) +
+                          static_cast<size_t>(entry.comboCount) * sizeof(LayoutPackCombo);
+        if (entry.nameLength > LAYOUT_PACK_MAX_NAME || nameEnd > size || keyEnd > size || comboEnd > size ||
+            entry.nameOffset % 2 != 0 || entry.keyOffset % 4 != 0 || entry.comboOffset % 4 != 0)
+        {
+            m_entries.clear();
+            return false;
+        }
+        m_entries.push_back(entry);
+    }
+
+    m_data = data;
+    return true;
+}
+
+void LayoutPack::Close()
+{
+    m_entries.clear();
+    m_data = nullptr;
+    m_file.Close();
+}
+
+bool LayoutPack::Matches(const std::vector<uintptr_t> &systemIds) const
+{
+    if (!IsLoaded() || systemIds.size() != m_entries.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < systemIds.size(); i++)
+    {
+        if (m_entries[i].systemId != static_cast<uint64_t>(systemIds[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+LayoutTable LayoutPack::Layout(size_t index) const
+{
+    const LayoutPackEntry &entry = m_entries[index];
+
+    const uint16_t *nameUnits = reinterpret_cast<const uint16_t *>(m_data + entry.nameOffset);
+    std::wstring name(nameUnits, nameUnits + entry.nameLength);
+    LayoutTable table(entry.langId, name);
+
+    const LayoutPackKey *keys = reinterpret_cast<const LayoutPackKey *>(m_data + entry.keyOffset);
+    for (uint32_t i = 0; i < LayoutTable::KEY_COUNT * LSS_COUNT; i++)
+    {
+        if (keys[i].ch != 0 || keys[i].flags != 0)
+        {
+            table.Set(i / LSS_COUNT, static_cast<LayoutShiftState>(i % LSS_COUNT), keys[i].ch, keys[i].flags);
+        }
+    }
+
+    // Stored sorted, so every combo goes on the end
+    const LayoutPackCombo *combos = reinterpret_cast<const LayoutPackCombo *>(m_data + entry.comboOffset);
+    for (uint32_t i = 0; i < entry.comboCount; i++)
+    {
+        table.AddDeadKeyCombo(combos[i].dead, combos[i].base, combos[i].result);
+    }
+    return table;
+}
+
+void LayoutPackBuilder::Add(const LayoutTable &table, uintptr_t systemId)
+{
+    m_tables.push_back(table);
+    m_systemIds.push_back(systemId);
+}
+
+std::vector<uint8_t> LayoutPackBuilder::Build() const
+{
+    std::vector<uint8_t> file(sizeof(LayoutPackHeader) + m_tables.size() * sizeof(LayoutPackEntry), 0);
+
+    for (size_t i = 0; i < m_tables.size(); i++)
+    {
+        const LayoutTable &table = m_tables[i];
+        LayoutPackEntry entry = {};
+        entry.systemId = static_cast<uint64_t>(m_systemIds[i]);
+        entry.langId = table.LanguageId();
+
+        // Names are display only, so anything that does not fit is replaced
+        std::vector<uint16_t> name;
+        for (wchar_t ch : table.Name())
+        {
+            if (name.size() == LAYOUT_PACK_MAX_NAME)
+            {
+                break;
+            }
+            name.push_back(static_cast<uint32_t>(ch) > 0xFFFF ? static_cast<uint16_t>(L'?') : static_cast<uint16_t>(ch));
+        }
+        entry.nameLength = static_cast<uint16_t>(name.size());
+        entry.nameOffset = static_cast<uint32_t>(file.size());
+        file.resize(AlignTo4(file.size() + name.size() * sizeof(uint16_t)), 0);
+        if (!name.empty())
+        {
+            memcpy(file.data() + entry.nameOffset, name.data(), name.size() * sizeof(uint16_t));
+        }
+
+        std::vector<LayoutPackKey> keys(LayoutTable::KEY_COUNT * LSS_COUNT);
+        for (uint32_t k = 0; k < keys.size(); k++)
+        {
+            const LayoutEntry &key = table.Entry(k / LSS_COUNT, static_cast<LayoutShiftState>(k % LSS_COUNT));
+            if (static_cast<uint32_t>(key.ch) > 0xFFFF)
+            {
+                return std::vector<uint8_t>();
+            }
+            keys[k].ch = static_cast<uint16_t>(key.ch);
+            keys[k].flags = key.flags;
+        }
+        entry.keyOffset = static_cast<uint32_t>(file.size());
+        file.resize(file.size() + keys.size() * sizeof(LayoutPackKey), 0);
+        memcpy(file.data() + entry.keyOffset, keys.data(), keys.size() * sizeof(LayoutPackKey));
+
+        std::vector<LayoutPackCombo> combos;
+        for (const DeadKeyCombo &combo : table.DeadKeyCombos())
+        {
+            if (static_cast<uint32_t>(combo.dead) > 0xFFFF || static_cast<uint32_t>(combo.base) > 0xFFFF ||
+                static_cast<uint32_t>(combo.result) > 0xFFFF)
+            {
+                return std::vector<uint8_t>();
+            }
+            combos.push_back({static_cast<uint16_t>(combo.dead), static_cast<uint16_t>(combo.base),
+                              static_cast<uint16_t>(combo.result), 0});
+        }
+        entry.comboCount = static_cast<uint32_t>(combos.size());
+        entry.comboOffset = static_cast<uint32_t>(file.size());
+        file.resize(file.size() + combos.size() * sizeof(LayoutPackCombo), 0);
+        if (!combos.empty())
+        {
+            memcpy(file.data() + entry.comboOffset, combos.data(), combos.size() * sizeof(LayoutPackCombo));
+        }
+
+        memcpy(file.data() + sizeof(LayoutPackHeader) + i * sizeof(LayoutPackEntry), &entry, sizeof(entry));
+    }
+
+    LayoutPackHeader header = {};
+    memcpy(header.magic, "KBLP", 4);
+    header.version = LAYOUT_PACK_VERSION;
+    header.layoutCount = static_cast<uint16_t>(m_tables.size());
+    header.payloadSize = static_cast<uint32_t>(file.size() - sizeof(LayoutPackHeader));
+    header.checksum = Fnv1a(file.data() + sizeof(LayoutPackHeader), header.payloadSize);
+    memcpy(file.data(), &header, sizeof(header));
+    return file;
+}
+
+bool LayoutPackBuilder::Write(const std::filesystem::path &path) const
+{
+    std::vector<uint8_t> pack = Build();
+    if (pack.empty())
+    {
+        return false;
+    }
+
+    // Written aside and renamed over the old pack, so a reader never maps half a file
+    std::filesystem::path temporary = path;
+    temporary += L".tmp";
+    FILE *file = OpenLogFile(temporary.wstring(), L"wb");
+    if (!file)
+    {
+        return false;
+    }
+    bool written = fwrite(pack.data(), 1, pack.size(), file) == pack.size();
+    std::error_code ec;
+    if (fclose(file) != 0 || !written)
+    {
+        std::filesystem::remove(temporary, ec);
+        return false;
+    }
+    std::filesystem::rename(temporary, path, ec);
+    return !ec;
+}
@@ -0,0 +1,178 @@
+#include "layout_scorer.h"
+#include "text_composer.h"
+
+LayoutScorer::LayoutScorer(size_t window)
+    : m_window(window > 0 ? window : 1),
+      m_keyHead(0),
+      m_keyCount(0)
+{
+}
+
+void LayoutScorer::SetLayouts(const std::vector<const LayoutTable *> &layouts, const NgramModel &model)
+{
+    const size_t layoutCount = layouts.size();
+    m_models.assign(layoutCount, nullptr);
+    m_keySymbols.assign(layoutCount * KEY_STRIDE, SYMBOL_NONE);
+
+    for (size_t i = 0; i < layoutCount; i++)
+    {
+        const NgramLanguageModel *language = model.FindLanguage(layouts[i]->LanguageId());
+        m_models[i] = language;
+
+        uint8_t *symbols = m_keySymbols.data() + i * KEY_STRIDE;
+        for (uint32_t vk = 0; vk < LayoutTable::KEY_COUNT; vk++)
+        {
+            for (int state = 0; state < LSS_COUNT; state++)
+            {
+                const LayoutEntry &entry = layouts[i]->Entry(vk, static_cast<LayoutShiftState>(state));
+                if (entry.ch == 0)
+                {
+                    continue;
+                }
+                bool known = language && !(entry.flags & LAYOUT_ENTRY_DEAD);
+                symbols[vk * LSS_COUNT + state] = known ? language->SymbolFor(entry.ch) : NGRAM_SYMBOL_OTHER;
+            }
+        }
+    }
+
+    m_costs.resize(layoutCount);
+    m_prev1.resize(layoutCount);
+    m_prev2.resize(layoutCount);
+    m_historyCost.assign(m_window * layoutCount, 0);
+    m_historySymbol.assign(m_window * layoutCount, 0);
+    Reset();
+}
+
+void LayoutScorer::Reset()
+{
+    for (size_t i = 0; i < m_models.size(); i++)
+    {
+        m_costs[i] = 0;
+        m_prev1[i] = NGRAM_SYMBOL_BOUNDARY;
+        m_prev2[i] = NGRAM_SYMBOL_BOUNDARY;
+    }
+    m_keyHead = 0;
+    m_keyCount = 0;
+}
+
+void LayoutScorer::OnKey(const KeyPressInfo &key)
+{
+    if (key.vkCode == KC_BACK)
+    {
+        RemoveLastKey();
+        return;
+    }
+    if (TextComposer::IsWordBoundaryKey(key.vkCode))
+    {
+        Reset();
+        return;
+    }
+
+    // Ctrl or Alt alone are shortcuts, not text
+    if (key.modifiers.ctrl != key.modifiers.alt || key.vkCode >= LayoutTable::KEY_COUNT)
+    {
+        return;
+    }
+
+    const size_t layoutCount = m_models.size();
+    const size_t keyIndex = key.vkCode * LSS_COUNT + LayoutTable::ShiftStateFor(key.modifiers);
+    bool isText = false;
+    for (size_t i = 0; i < layoutCount && !isText; i++)
+    {
+        isText = m_keySymbols[i * KEY_STRIDE + keyIndex] != SYMBOL_NONE;
+    }
+    if (!isText)
+    {
+        return;
+    }
+
+    if (m_keyCount == m_window)
+    {
+        DropOldestKey();
+    }
+
+    const size_t slot = Slot(m_keyCount) * layoutCount;
+    for (size_t i = 0; i < layoutCount; i++)
+    {
+        uint8_t symbol = m_keySymbols[i * KEY_STRIDE + keyIndex];
+        if (symbol == SYMBOL_NONE)
+        {
+            symbol = NGRAM_SYMBOL_OTHER;
+        }
+
+        uint16_t cost = m_models[i] ? m_models[i]->Cost(m_prev2[i], m_prev1[i], symbol)
+                                    : static_cast<uint16_t>(NGRAM_NO_MODEL_COST);
+        m_costs[i] += cost;
+        m_historyCost[slot + i] = cost;
+        m_historySymbol[slot + i] = symbol;
+        m_prev2[i] = m_prev1[i];
+        m_prev1[i] = symbol;
+    }
+    m_keyCount++;
+}
+
+void LayoutScorer::DropOldestKey()
+{
+    const size_t layoutCount = m_models.size();
+    const size_t slot = m_keyHead * layoutCount;
+    for (size_t i = 0; i < layoutCount; i++)
+    {
+        m_costs[i] -= m_historyCost[slot + i];
+    }
+    m_keyHead = (m_keyHead + 1) % m_window;
+    m_keyCount--;
+}
+
+void LayoutScorer::RemoveLastKey()
+{
+    if (m_keyCount == 0)
+    {
+        return;
+    }
+
+    const size_t layoutCount = m_models.size();
+    m_keyCount--;
+    const size_t slot = Slot(m_keyCount) * layoutCount;
+    for (size_t i = 0; i < layoutCount; i++)
+    {
+        m_costs[i] -= m_historyCost[slot + i];
+
+        // Context falls back to a boundary once keys left the window
+        m_prev1[i] = m_keyCount >= 1 ? m_historySymbol[Slot(m_keyCount - 1) * layoutCount + i] : NGRAM_SYMBOL_BOUNDARY;
+        m_prev2[i] = m_keyCount >= 2 ? m_historySymbol[Slot(m_keyCount - 2) * layoutCount + i] : NGRAM_SYMBOL_BOUNDARY;
+    }
+}
+
+size_t LayoutScorer::BestLayout() const
+{
+    size_t best = 0;
+    for (size_t i = 1; i < m_costs.size(); i++)
+    {
+        if (m_costs[i] < m_costs[best])
+        {
+            best = i;
+        }
+    }
+    return best;
+}
+
+double LayoutScorer::ConfidenceMargin(size_t current, size_t *bestAlternative) const
+{
+    size_t best = current;
+    for (size_t i = 0; i < m_costs.size(); i++)
+    {
+        if (i != current && (best == current || m_costs[i] < m_costs[best]))
+        {
+            best = i;
+        }
+    }
+    if (bestAlternative)
+    {
+        *bestAlternative = best;
+    }
+    if (best == current || m_keyCount == 0)
+    {
+        return 0.0;
+    }
+    return static_cast<double>(m_costs[current] - m_costs[best]) / NGRAM_COST_SCALE / static_cast<double>(m_keyCount);
+}
@@ -0,0 +1,270 @@
+#include "layout_table.h"
+#include <algorithm>
+#include <cstring>
+
+// Sets the unshifted and shifted character of a key
+static void SetPair(LayoutTable &table, uint32_t vkCode, wchar_t base, wchar_t shifted)
+{
+    table.Set(vkCode, LSS_BASE, base);
+    table.Set(vkCode, LSS_SHIFT, shifted);
+}
+
+// Keys that are identical on every built-in layout: space, digits row and numpad
+static void SetCommonKeys(LayoutTable &table)
+{
+    SetPair(table, KC_SPACE, L' ', L' ');
+
+    const wchar_t *digitShifted = L")!@#$%^&*(";
+    for (uint32_t i = 0; i < 10; i++)
+    {
+        SetPair(table, '0' + i, static_cast<wchar_t>(L'0' + i), digitShifted[i]);
+        SetPair(table, KC_NUMPAD0 + i, static_cast<wchar_t>(L'0' + i), static_cast<wchar_t>(L'0' + i));
+    }
+
+    SetPair(table, KC_MULTIPLY, L'*', L'*');
+    SetPair(table, KC_ADD, L'+', L'+');
+    SetPair(table, KC_SUBTRACT, L'-', L'-');
+    SetPair(table, KC_DECIMAL, L'.', L'.');
+    SetPair(table, KC_DIVIDE, L'/', L'/');
+    SetPair(table, KC_OEM_MINUS, L'-', L'_');
+    SetPair(table, KC_OEM_PLUS, L'=', L'+');
+    SetPair(table, KC_OEM_5, L'\\', L'|');
+}
+
+LayoutTable::LayoutTable()
+    : m_langId(0)
+{
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+LayoutTable::LayoutTable(uint16_t langId, const std::wstring &name)
+    : m_langId(langId),
+      m_name(name)
+{
+    memset(m_entries, 0, sizeof(m_entries));
+}
+
+LayoutTable LayoutTable::UsQwerty()
+{
+    LayoutTable table(LAYOUT_LANG_ENGLISH, L"en-US");
+    SetCommonKeys(table);
+
+    for (uint32_t vk = 'A'; vk <= 'Z'; vk++)
+    {
+        SetPair(table, vk, static_cast<wchar_t>(L'a' + (vk - 'A')), static_cast<wchar_t>(vk));
+    }
+
+    SetPair(table, KC_OEM_1, L';', L':');
+    SetPair(table, KC_OEM_COMMA, L',', L'<');
+    SetPair(table, KC_OEM_PERIOD, L'.', L'>');
+    SetPair(table, KC_OEM_2, L'/', L'?');
+    SetPair(table, KC_OEM_3, L'`', L'~');
+    SetPair(table, KC_OEM_4, L'[', L'{');
+    SetPair(table, KC_OEM_6, L']', L'}');
+    SetPair(table, KC_OEM_7, L'\'', L'"');
+    return table;
+}
+
+LayoutTable LayoutTable::HebrewSi1452()
+{
+    LayoutTable table(LAYOUT_LANG_HEBREW, L"he-IL");
+    SetCommonKeys(table);
+
+    // Letter keys: Hebrew unshifted, Latin capitals with shift
+    static const struct
+    {
+        uint32_t vkCode;
+        wchar_t ch;
+    } letters[] = {
+        {'Q', L'/'}, {'W', L'\''}, {'E', 0x05E7}, {'R', 0x05E8}, {'T', 0x05D0},
+        {'Y', 0x05D8}, {'U', 0x05D5}, {'I', 0x05DF}, {'O', 0x05DD}, {'P', 0x05E4},
+        {'A', 0x05E9}, {'S', 0x05D3}, {'D', 0x05D2}, {'F', 0x05DB}, {'G', 0x05E2},
+        {'H', 0x05D9}, {'J', 0x05D7}, {'K', 0x05DC}, {'L', 0x05DA}, {'Z', 0x05D6},
+        {'X', 0x05E1}, {'C', 0x05D1}, {'V', 0x05D4}, {'B', 0x05E0}, {'N', 0x05DE},
+        {'M', 0x05E6},
+    };
+    for (const auto &letter : letters)
+    {
+        SetPair(table, letter.vkCode, letter.ch, static_cast<wchar_t>(letter.vkCode));
+    }
+
+    // Parentheses and brackets are mirrored on the Hebrew layout
+    table.Set('9', LSS_SHIFT, L')');
+    table.Set('0', LSS_SHIFT, L'(');
+    SetPair(table, KC_OEM_1, 0x05E3, L':');
+    SetPair(table, KC_OEM_COMMA, 0x05EA, L'>');
+    SetPair(table, KC_OEM_PERIOD, 0x05E5, L'<');
+    SetPair(table, KC_OEM_2, L'.', L'?');
+    SetPair(table, KC_OEM_3, L';', L'~');
+    SetPair(table, KC_OEM_4, L']', L'}');
+    SetPair(table, KC_OEM_6, L'[', L'{');
+    SetPair(table, KC_OEM_7, L',', L'"');
+
+    // AltGr additions
+    table.Set('4', LSS_ALTGR, 0x20AA);            // New shekel sign
+    table.Set('E', LSS_ALTGR, 0x20AC);            // Euro sign
+    table.Set(KC_OEM_MINUS, LSS_ALTGR, 0x05BE);   // Maqaf
+    return table;
+}
+
+void LayoutTable::Set(uint32_t vkCode, LayoutShiftState state, wchar_t ch, uint8_t flags)
+{
+    if (vkCode >= KEY_COUNT || state >= LSS_COUNT)
+    {
+        return;
+    }
+    LayoutEntry &entry = m_entries[vkCode * LSS_COUNT + state];
+    entry.ch = ch;
+    entry.flags = flags;
+}
+
+static bool ComboLess(const DeadKeyCombo &a, const DeadKeyCombo &b)
+{
+    return a.dead != b.dead ? a.dead < b.dead : a.base < b.base;
+}
+
+void LayoutTable::AddDeadKeyCombo(wchar_t dead, wchar_t base, wchar_t result)
+{
+    DeadKeyCombo combo = {dead, base, result};
+    auto it = std::lower_bound(m_deadKeyCombos.begin(), m_deadKeyCombos.end(), combo, ComboLess);
+    if (it != m_deadKeyCombos.end() && it->dead == dead && it->base == base)
+    {
+        it->result = result;
+        return;
+    }
+    m_deadKeyCombos.insert(it, combo);
+}
+
+wchar_t LayoutTable::Compose(wchar_t dead, wchar_t base) const
+{
+    DeadKeyCombo key = {dead, base, 0};
+    auto it = std::lower_bound(m_deadKeyCombos.begin(), m_deadKeyCombos.end(), key, ComboLess);
+    if (it != m_deadKeyCombos.end() && it->dead == dead && it->base == base)
+    {
+        return it->result;
+    }
+    return 0;
+}
+
+#ifdef _WIN32
+
+// Keys that never produce text, whatever the layout
+static bool IsNonTextKey(uint32_t vkCode)
+{
+    return vkCode == KC_RETURN || vkCode == KC_TAB || vkCode == KC_BACK ||
+           vkCode == KC_DELETE || vkCode == KC_ESCAPE ||
+           (vkCode >= KC_F1 && vkCode <= KC_F24);
+}
+
+// Builds the keyboard state array for a shift state
+static void FillKeyboardState(BYTE keyboardState[256], LayoutShiftState state)
+{
+    memset(keyboardState, 0, 256);
+    if (state & LSS_SHIFT)
+    {
+        keyboardState[VK_SHIFT] = 0x80;
+    }
+    if (state & LSS_ALTGR)
+    {
+        keyboardState[VK_CONTROL] = 0x80;
+        keyboardState[VK_MENU] = 0x80;
+    }
+}
+
+// Space presses that ClearDeadKeyState tries. One clears a dead key on any
+// sane layout; the cap keeps a layout whose space is itself dead from hanging.
+const int DEAD_KEY_FLUSH_ATTEMPTS = 4;
+
+// Flushes a pending dead key out of the thread's keyboard state
+static void ClearDeadKeyState(HKL layout)
+{
+    BYTE keyboardState[256] = {};
+    wchar_t result[8];
+    UINT scanCode = MapVirtualKeyEx(VK_SPACE, MAPVK_VK_TO_VSC, layout);
+    for (int attempt = 0; attempt < DEAD_KEY_FLUSH_ATTEMPTS; attempt++)
+    {
+        if (ToUnicodeEx(VK_SPACE, scanCode, keyboardState, result, 8, 0, layout) >= 0)
+        {
+            return;
+        }
+    }
+}
+
+LayoutTable LayoutTable::FromSystemLayout(HKL layout, const std::wstring &name)
+{
+    LayoutTable table(PRIMARYLANGID(LOWORD(layout)), name);
+    BYTE keyboardState[256];
+    wchar_t result[8];
+
+    for (uint8_t s = 0; s < LSS_COUNT; s++)
+    {
+        LayoutShiftState state = static_cast<LayoutShiftState>(s);
+        FillKeyboardState(keyboardState, state);
+
+        for (uint32_t vk = 1; vk < KEY_COUNT; vk++)
+        {
+            if (IsNonTextKey(vk))
+            {
+                continue;
+            }
+
+            UINT scanCode = MapVirtualKeyEx(vk, MAPVK_VK_TO_VSC, layout);
+            if (scanCode == 0)
+            {
+                continue;
+            }
+
+            int ret = ToUnicodeEx(vk, scanCode, keyboardState, result, 8, 0, layout);
+            if (ret > 0)
+            {
+                table.Set(vk, state, result[0]);
+            }
+            else if (ret < 0)
+            {
+                table.Set(vk, state, result[0], LAYOUT_ENTRY_DEAD);
+                ClearDeadKeyState(layout);
+            }
+        }
+    }
+
+    // Record what every dead key produces with every plain character key
+    for (uint32_t deadIndex = 0; deadIndex < KEY_COUNT * LSS_COUNT; deadIndex++)
+    {
+        const LayoutEntry &dead = table.m_entries[deadIndex];
+        if (!(dead.flags & LAYOUT_ENTRY_DEAD))
+        {
+            continue;
+        }
+        uint32_t deadVk = deadIndex / LSS_COUNT;
+        BYTE deadState[256];
+        FillKeyboardState(deadState, static_cast<LayoutShiftState>(deadIndex % LSS_COUNT));
+        UINT deadScan = MapVirtualKeyEx(deadVk, MAPVK_VK_TO_VSC, layout);
+
+        for (uint32_t baseIndex = 0; baseIndex < KEY_COUNT * LSS_COUNT; baseIndex++)
+        {
+            const LayoutEntry &base = table.m_entries[baseIndex];
+            if (base.ch == 0 || (base.flags & LAYOUT_ENTRY_DEAD))
+            {
+                continue;
+            }
+            uint32_t baseVk = baseIndex / LSS_COUNT;
+            FillKeyboardState(keyboardState, static_cast<LayoutShiftState>(baseIndex % LSS_COUNT));
+            UINT baseScan = MapVirtualKeyEx(baseVk, MAPVK_VK_TO_VSC, layout);
+
+            ToUnicodeEx(deadVk, deadScan, deadState, result, 8, 0, layout);
+            int ret = ToUnicodeEx(baseVk, baseScan, keyboardState, result, 8, 0, layout);
+            if (ret == 1 && result[0] != base.ch)
+            {
+                table.AddDeadKeyCombo(dead.ch, base.ch, result[0]);
+            }
+            else if (ret < 0)
+            {
+                ClearDeadKeyState(layout);
+            }
+        }
+    }
+
+    return table;
+}
+
+#endif
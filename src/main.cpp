@@ -4,6 +4,8 @@
 #include <logger.h>
 #include "keyboard_checker.h"
 #include <windows.h>
+#include <shellapi.h>
+#include <string>
 
 int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine, int nCmdShow)
 {
@@ -14,6 +16,29 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
         return 1;
     }
 
+    // --record-trace <file> records every key event for kbtrace-replay;
+    // --timeline <file.json> records spans and writes them on exit
+    std::wstring timelinePath;
+    int argc = 0;
+    LPWSTR *argv = CommandLineToArgvW(GetCommandLineW(), &argc);
+    for (int i = 1; argv && i + 1 < argc; i++)
+    {
+        if (std::wstring(argv[i]) == L"--record-trace")
+        {
+            checker->RecordTrace(argv[i + 1]);
+        }
+        else if (std::wstring(argv[i]) == L"--timeline")
+        {
+            timelinePath = argv[i + 1];
+        }
+    }
+    LocalFree(argv);
+    if (!timelinePath.empty())
+    {
+        SpanTrace::SetThreadName("ui");
+        SpanTrace::Instance().Enable();
+    }
+
     if (!checker->Start())
     {
         LOG(ERR, L"keyboard checker ended in failure");
@@ -28,5 +53,10 @@ int WINAPI WinMain(HINSTANCE hInstance, HINSTANCE hPrevInstance, LPSTR lpCmdLine
     }
 
     KeyboardChecker::DeleteInstance();
+    if (!timelinePath.empty() && !SpanTrace::Instance().WriteChromeJson(timelinePath))
+    {
+        LOG(ERR, L"Failed to write timeline to " + timelinePath);
+    }
+    Logger::Instance().Shutdown();
     return (int)msg.wParam;
 }
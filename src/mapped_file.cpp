@@ -0,0 +1,153 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+    : m_data(nullptr),
+      m_size(0),
+      m_open(false)
+#ifdef _WIN32
+      ,
+      m_file(INVALID_HANDLE_VALUE),
+      m_mapping(NULL)
+#endif
+{
+}
+
+MappedFile::~MappedFile()
+{
+    Close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::Open(const std::filesystem::path &path)
+{
+    Close();
+
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL,
+                         OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size))
+    {
+        Close();
+        return false;
+    }
+
+    if (size.QuadPart > 0)
+    {
+        m_mapping = CreateFileMappingW(m_file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (!m_mapping)
+        {
+            Close();
+            return false;
+        }
+        m_data = static_cast<const uint8_t *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+        if (!m_data)
+        {
+            Close();
+            return false;
+        }
+    }
+
+    m_size = static_cast<size_t>(size.QuadPart);
+    m_open = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+    {
+        UnmapViewOfFile(m_data);
+    }
+    if (m_mapping)
+    {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE)
+    {
+        CloseHandle(m_file);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+    m_mapping = NULL;
+    m_file = INVALID_HANDLE_VALUE;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    // Windows reads ahead on sequential faults by itself
+}
+
+#else
+
+bool MappedFile::Open(const std::filesystem::path &path)
+{
+    Close();
+
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        close(fd);
+        return false;
+    }
+
+    if (info.st_size > 0)
+    {
+        void *data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED)
+        {
+            close(fd);
+            return false;
+        }
+        m_data = static_cast<const uint8_t *>(data);
+    }
+
+    // The mapping stays valid after the descriptor is closed
+    close(fd);
+    m_size = static_cast<size_t>(info.st_size);
+    m_open = true;
+    return true;
+}
+
+void MappedFile::Close()
+{
+    if (m_data)
+    {
+        munmap(const_cast<uint8_t *>(m_data), m_size);
+    }
+    m_data = nullptr;
+    m_size = 0;
+    m_open = false;
+}
+
+void MappedFile::AdviseSequential() const
+{
+    if (m_data)
+    {
+        madvise(const_cast<uint8_t *>(m_data), m_size, MADV_SEQUENTIAL);
+        madvise(const_cast<uint8_t *>(m_data), m_size, MADV_WILLNEED);
+    }
+}
+
+#endif
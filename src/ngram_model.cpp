@@ -0,0 +1,242 @@
+#include "ngram_model.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <unordered_map>
+
+// Interpolation weights for the trigram, bigram and unigram estimates
+const double NGRAM_TRIGRAM_WEIGHT = 0.6;
+const double NGRAM_BIGRAM_WEIGHT = 0.3;
+const double NGRAM_UNIGRAM_WEIGHT = 0.1;
+
+uint8_t NgramLanguageModel::SymbolFor(wchar_t ch) const
+{
+    ch = NgramFoldCase(ch);
+    if (NgramIsBoundary(ch))
+    {
+        return NGRAM_SYMBOL_BOUNDARY;
+    }
+    if (static_cast<uint32_t>(ch) > 0xFFFF)
+    {
+        return NGRAM_SYMBOL_OTHER;
+    }
+
+    const uint16_t *begin = m_alphabet + 2;
+    const uint16_t *end = m_alphabet + m_symbolCount;
+    const uint16_t *it = std::lower_bound(begin, end, static_cast<uint16_t>(ch));
+    if (it == end || *it != static_cast<uint16_t>(ch))
+    {
+        return NGRAM_SYMBOL_OTHER;
+    }
+    return static_cast<uint8_t>(it - m_alphabet);
+}
+
+bool NgramModel::Load(const std::filesystem::path &path)
+{
+    m_languages.clear();
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+    if (!LoadFromMemory(m_file.Data(), m_file.Size()))
+    {
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool NgramModel::LoadFromMemory(const uint8_t *data, size_t size)
+{
+    m_languages.clear();
+    if (!data || size < sizeof(NgramModelHeader))
+    {
+        return false;
+    }
+
+    NgramModelHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "KBNG", 4) != 0 || header.version != NGRAM_MODEL_VERSION)
+    {
+        return false;
+    }
+    if (sizeof(NgramModelHeader) + header.languageCount * sizeof(NgramLanguageEntry) > size)
+    {
+        return false;
+    }
+
+    for (uint16_t i = 0; i < header.languageCount; i++)
+    {
+        NgramLanguageEntry entry;
+        memcpy(&entry, data + sizeof(NgramModelHeader) + i * sizeof(NgramLanguageEntry), sizeof(entry));
+
+        size_t symbols = entry.symbolCount;
+        size_t alphabetEnd = static_cast<size_t>(entry.alphabetOffset) + symbols * sizeof(uint16_t);
+        size_t costEnd = static_cast<size_t>(entry.costOffset) + symbols * symbols * symbols * sizeof(uint16_t);
+        if (symbols < 2 || symbols > NGRAM_MAX_SYMBOLS ||
+            entry.alphabetOffset % 4 != 0 || entry.costOffset % 4 != 0 ||
+            alphabetEnd > size || costEnd > size)
+        {
+            m_languages.clear();
+            return false;
+        }
+
+        m_languages.emplace_back(entry.langId, entry.symbolCount,
+                                 reinterpret_cast<const uint16_t *>(data + entry.alphabetOffset),
+                                 reinterpret_cast<const uint16_t *>(data + entry.costOffset));
+    }
+    return !m_languages.empty();
+}
+
+const NgramLanguageModel *NgramModel::FindLanguage(uint16_t langId) const
+{
+    for (const NgramLanguageModel &language : m_languages)
+    {
+        if (language.LanguageId() == langId)
+        {
+            return &language;
+        }
+    }
+    return nullptr;
+}
+
+void NgramModelBuilder::AddText(uint16_t langId, const std::wstring &text)
+{
+    std::wstring &sample = m_text[langId];
+    sample += text;
+    sample += L' ';
+}
+
+// Alphabet of the most frequent characters, reserved symbols first and the
+// rest sorted so lookups can binary search
+static std::vector<uint16_t> BuildAlphabet(const std::wstring &text)
+{
+    std::unordered_map<wchar_t, uint64_t> counts;
+    for (wchar_t ch : text)
+    {
+        ch = NgramFoldCase(ch);
+        if (!NgramIsBoundary(ch) && static_cast<uint32_t>(ch) <= 0xFFFF)
+        {
+            counts[ch]++;
+        }
+    }
+
+    std::vector<std::pair<wchar_t, uint64_t>> ranked(counts.begin(), counts.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b)
+              { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+    if (ranked.size() > NGRAM_MAX_SYMBOLS - 2)
+    {
+        ranked.resize(NGRAM_MAX_SYMBOLS - 2);
+    }
+
+    std::vector<uint16_t> alphabet(2, 0);
+    for (const auto &entry : ranked)
+    {
+        alphabet.push_back(static_cast<uint16_t>(entry.first));
+    }
+    std::sort(alphabet.begin() + 2, alphabet.end());
+    return alphabet;
+}
+
+// Smoothed trigram costs for one language
+static std::vector<uint16_t> BuildCosts(const std::wstring &text, const NgramLanguageModel &model)
+{
+    const size_t s = model.SymbolCount();
+    std::vector<uint64_t> trigrams(s * s * s, 0);
+    std::vector<uint64_t> bigrams(s * s, 0);
+    std::vector<uint64_t> unigrams(s, 0);
+    uint64_t total = 0;
+
+    // Every word starts from a boundary context and ends with a boundary
+    uint8_t prev2 = NGRAM_SYMBOL_BOUNDARY;
+    uint8_t prev1 = NGRAM_SYMBOL_BOUNDARY;
+    for (wchar_t ch : text)
+    {
+        uint8_t symbol = model.SymbolFor(ch);
+        if (symbol == NGRAM_SYMBOL_BOUNDARY && prev1 == NGRAM_SYMBOL_BOUNDARY)
+        {
+            continue;
+        }
+
+        trigrams[(prev2 * s + prev1) * s + symbol]++;
+        bigrams[prev1 * s + symbol]++;
+        unigrams[symbol]++;
+        total++;
+
+        prev2 = symbol == NGRAM_SYMBOL_BOUNDARY ? NGRAM_SYMBOL_BOUNDARY : prev1;
+        prev1 = symbol;
+    }
+
+    std::vector<uint64_t> trigramContexts(s * s, 0);
+    std::vector<uint64_t> bigramContexts(s, 0);
+    for (size_t context = 0; context < s * s; context++)
+    {
+        for (size_t symbol = 0; symbol < s; symbol++)
+        {
+            trigramContexts[context] += trigrams[context * s + symbol];
+        }
+        bigramContexts[context / s] += bigrams[context];
+    }
+
+    std::vector<uint16_t> costs(s * s * s);
+    for (size_t prev2Symbol = 0; prev2Symbol < s; prev2Symbol++)
+    {
+        for (size_t prev1Symbol = 0; prev1Symbol < s; prev1Symbol++)
+        {
+            size_t context = prev2Symbol * s + prev1Symbol;
+            double trigramWeight = trigramContexts[context] > 0 ? NGRAM_TRIGRAM_WEIGHT : 0.0;
+            double bigramWeight = bigramContexts[prev1Symbol] > 0 ? NGRAM_BIGRAM_WEIGHT : 0.0;
+            double weightSum = trigramWeight + bigramWeight + NGRAM_UNIGRAM_WEIGHT;
+
+            for (size_t symbol = 0; symbol < s; symbol++)
+            {
+                double p = NGRAM_UNIGRAM_WEIGHT * (unigrams[symbol] + 1.0) / (total + static_cast<double>(s));
+                if (trigramWeight > 0.0)
+                {
+                    p += trigramWeight * trigrams[context * s + symbol] / static_cast<double>(trigramContexts[context]);
+                }
+                if (bigramWeight > 0.0)
+                {
+                    p += bigramWeight * bigrams[prev1Symbol * s + symbol] / static_cast<double>(bigramContexts[prev1Symbol]);
+                }
+                double cost = -std::log2(p / weightSum) * NGRAM_COST_SCALE;
+                costs[context * s + symbol] = static_cast<uint16_t>(std::min(65535.0, std::round(cost)));
+            }
+        }
+    }
+    return costs;
+}
+
+std::vector<uint8_t> NgramModelBuilder::Build() const
+{
+    std::vector<uint8_t> file(sizeof(NgramModelHeader) + m_text.size() * sizeof(NgramLanguageEntry), 0);
+
+    NgramModelHeader header;
+    memcpy(header.magic, "KBNG", 4);
+    header.version = NGRAM_MODEL_VERSION;
+    header.languageCount = static_cast<uint16_t>(m_text.size());
+    memcpy(file.data(), &header, sizeof(header));
+
+    size_t index = 0;
+    for (const auto &language : m_text)
+    {
+        std::vector<uint16_t> alphabet = BuildAlphabet(language.second);
+        NgramLanguageModel model(language.first, static_cast<uint32_t>(alphabet.size()), alphabet.data(), nullptr);
+        std::vector<uint16_t> costs = BuildCosts(language.second, model);
+
+        NgramLanguageEntry entry;
+        entry.langId = language.first;
+        entry.symbolCount = static_cast<uint16_t>(alphabet.size());
+        entry.alphabetOffset = static_cast<uint32_t>(file.size());
+        file.resize(AlignTo4(file.size() + alphabet.size() * sizeof(uint16_t)), 0);
+        memcpy(file.data() + entry.alphabetOffset, alphabet.data(), alphabet.size() * sizeof(uint16_t));
+
+        entry.costOffset = static_cast<uint32_t>(file.size());
+        file.resize(AlignTo4(file.size() + costs.size() * sizeof(uint16_t)), 0);
+        memcpy(file.data() + entry.costOffset, costs.data(), costs.size() * sizeof(uint16_t));
+
+        memcpy(file.data() + sizeof(NgramModelHeader) + index * sizeof(NgramLanguageEntry), &entry, sizeof(entry));
+        index++;
+    }
+    return file;
+}
@@ -0,0 +1,154 @@
+#include "presenter.h"
+#include <algorithm>
+#include <limits>
+#include "key_event.h"
+#include "latency_histogram.h"
+#include "span_trace.h"
+
+void PresenterView::Assign(const PresenterView &other)
+{
+    text.assign(other.text);
+    if (conversions.size() < other.conversionCount)
+    {
+        conversions.resize(other.conversionCount);
+    }
+    for (size_t i = 0; i < other.conversionCount; i++)
+    {
+        conversions[i].layoutName.assign(other.conversions[i].layoutName);
+        conversions[i].text.assign(other.conversions[i].text);
+    }
+    conversionCount = other.conversionCount;
+}
+
+bool PresenterView::operator==(const PresenterView &other) const
+{
+    if (conversionCount != other.conversionCount || text != other.text)
+    {
+        return false;
+    }
+    for (size_t i = 0; i < conversionCount; i++)
+    {
+        if (conversions[i].layoutName != other.conversions[i].layoutName ||
+            conversions[i].text != other.conversions[i].text)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+Presenter::Presenter(PresenterBackend &backend, const PresenterPolicy &policy)
+    : m_backend(backend),
+      m_policy(policy),
+      m_dirty(false),
+      m_pendingSinceUs(0),
+      m_lastUpdateUs(0),
+      m_lastFlushUs(std::numeric_limits<int64_t>::min() / 2),
+      m_updates(0),
+      m_superseded(0),
+      m_unchanged(0),
+      m_flushes(0)
+{
+}
+
+bool Presenter::SetText(std::wstring_view text, int64_t nowUs)
+{
+    m_update.text.assign(text);
+    m_update.conversionCount = 0;
+    return Publish(nowUs);
+}
+
+bool Presenter::SetReport(const WrongLayoutReport &report, const DetectionEngine &engine, int64_t nowUs)
+{
+    // Other layouts in layout order, skipping those the word has no reading in
+    m_update.text.assign(report.currentText);
+    m_update.conversionCount = 0;
+    for (size_t i = 0; i < report.layoutCount; i++)
+    {
+        if (i == report.currentLayout || report.conversions[i].empty())
+        {
+            continue;
+        }
+        if (m_update.conversions.size() <= m_update.conversionCount)
+        {
+            m_update.conversions.resize(m_update.conversionCount + 1);
+        }
+        PresenterConversion &conversion = m_update.conversions[m_update.conversionCount++];
+        conversion.layoutName.assign(engine.Layout(i).Name());
+        conversion.text.assign(report.conversions[i]);
+    }
+    return Publish(nowUs);
+}
+
+bool Presenter::Publish(int64_t nowUs)
+{
+    if (nowUs == 0)
+    {
+        nowUs = KeyEventClockUs();
+    }
+    m_updates.fetch_add(1, std::memory_order_relaxed);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_update == m_pending)
+    {
+        m_unchanged.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_pending.Assign(m_update);
+    m_lastUpdateUs = nowUs;
+    if (m_dirty)
+    {
+        m_superseded.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    m_dirty = true;
+    m_pendingSinceUs = nowUs;
+    return true;
+}
+
+int64_t Presenter::Tick(int64_t nowUs)
+{
+    if (nowUs == 0)
+    {
+        nowUs = KeyEventClockUs();
+    }
+
+    int64_t sinceUs;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (!m_dirty)
+        {
+            return -1;
+        }
+        int64_t dueUs = std::max(m_lastFlushUs + m_policy.frameUs, m_lastUpdateUs + m_policy.idleUs);
+        if (nowUs < dueUs)
+        {
+            return dueUs - nowUs;
+        }
+        m_flushing.Assign(m_pending);
+        m_dirty = false;
+        sinceUs = m_pendingSinceUs;
+    }
+
+    // Typed and deleted again within a frame: the screen is already right
+    if (m_flushing == m_shown)
+    {
+        m_unchanged.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    TRACE_SPAN("ui");
+    std::swap(m_shown, m_flushing);
+    m_backend.Present(m_shown, nowUs);
+    m_lastFlushUs = nowUs;
+    m_flushes.fetch_add(1, std::memory_order_relaxed);
+    LatencyStats::Instance().Record(LATENCY_UI, static_cast<uint64_t>(nowUs - sinceUs) * 1000);
+    return -1;
+}
+
+void RecordingPresenterBackend::Present(const PresenterView &view, int64_t nowUs)
+{
+    m_frames.push_back(Frame());
+    m_frames.back().timeUs = nowUs;
+    m_frames.back().view.Assign(view);
+}
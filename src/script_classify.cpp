@@ -0,0 +1,167 @@
+#include "script_classify.h"
+#include <type_traits>
+#include "script_classify_kernels.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define SCRIPT_CLASSIFY_X64 1
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+
+// wchar_t is UTF-16 on Windows and UTF-32 elsewhere
+typedef std::conditional<sizeof(wchar_t) == 2, uint16_t, uint32_t>::type WideUnit;
+
+#ifdef SCRIPT_CLASSIFY_X64
+
+struct Sse2Ops16
+{
+    typedef __m128i Vector;
+    static constexpr size_t VECTORS_PER_STEP = 2;
+    static constexpr uint32_t FULL_MASK = 0xFFFF;
+
+    static Vector Load(const void *p) { return _mm_loadu_si128(static_cast<const __m128i *>(p)); }
+    static Vector Set(uint32_t value) { return _mm_set1_epi16(static_cast<short>(value)); }
+    static Vector Equal(Vector a, Vector b) { return _mm_cmpeq_epi16(a, b); }
+    static Vector Less(Vector a, Vector b) { return _mm_cmplt_epi16(a, b); }
+    static Vector Sub(Vector a, Vector b) { return _mm_sub_epi16(a, b); }
+    static Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+    static Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+    static Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+    static Vector AndNot(Vector a, Vector b) { return _mm_andnot_si128(a, b); }
+    static uint32_t MoveMask(Vector v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+};
+
+struct Sse2Ops32
+{
+    typedef __m128i Vector;
+    static constexpr size_t VECTORS_PER_STEP = 4;
+    static constexpr uint32_t FULL_MASK = 0xFFFF;
+
+    static Vector Load(const void *p) { return _mm_loadu_si128(static_cast<const __m128i *>(p)); }
+    static Vector Set(uint32_t value) { return _mm_set1_epi32(static_cast<int>(value)); }
+    static Vector Equal(Vector a, Vector b) { return _mm_cmpeq_epi32(a, b); }
+    static Vector Less(Vector a, Vector b) { return _mm_cmplt_epi32(a, b); }
+    static Vector Sub(Vector a, Vector b) { return _mm_sub_epi32(a, b); }
+    static Vector Xor(Vector a, Vector b) { return _mm_xor_si128(a, b); }
+    static Vector And(Vector a, Vector b) { return _mm_and_si128(a, b); }
+    static Vector Or(Vector a, Vector b) { return _mm_or_si128(a, b); }
+    static Vector AndNot(Vector a, Vector b) { return _mm_andnot_si128(a, b); }
+    static uint32_t MoveMask(Vector v) { return static_cast<uint32_t>(_mm_movemask_epi8(v)); }
+};
+
+typedef std::conditional<sizeof(wchar_t) == 2, Sse2Ops16, Sse2Ops32>::type Sse2Ops;
+
+bool CpuSupportsAvx2()
+{
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7)
+    {
+        return false;
+    }
+    // AVX2 also needs the OS to save the YMM registers
+    __cpuid(info, 1);
+    bool osxsave = (info[2] & (1 << 27)) != 0;
+    bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 0x6) != 0x6)
+    {
+        return false;
+    }
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+ScriptKernel DetectScriptKernel()
+{
+    for (int kernel = SCRIPT_KERNEL_COUNT - 1; kernel > SCRIPT_KERNEL_SCALAR; kernel--)
+    {
+        if (IsScriptKernelSupported(static_cast<ScriptKernel>(kernel)))
+        {
+            return static_cast<ScriptKernel>(kernel);
+        }
+    }
+    return SCRIPT_KERNEL_SCALAR;
+}
+
+} // namespace
+
+bool IsScriptKernelSupported(ScriptKernel kernel)
+{
+    switch (kernel)
+    {
+    case SCRIPT_KERNEL_SCALAR:
+        return true;
+#ifdef SCRIPT_CLASSIFY_X64
+    case SCRIPT_KERNEL_SSE2:
+        return true;  // Part of x86-64
+    case SCRIPT_KERNEL_AVX2:
+    {
+        static const bool supported = Avx2KernelCompiled() && CpuSupportsAvx2();
+        return supported;
+    }
+#endif
+    default:
+        return false;
+    }
+}
+
+ScriptKernel ActiveScriptKernel()
+{
+    static const ScriptKernel kernel = DetectScriptKernel();
+    return kernel;
+}
+
+const char *ScriptKernelName(ScriptKernel kernel)
+{
+    switch (kernel)
+    {
+    case SCRIPT_KERNEL_SCALAR:
+        return "scalar";
+    case SCRIPT_KERNEL_SSE2:
+        return "sse2";
+    case SCRIPT_KERNEL_AVX2:
+        return "avx2";
+    default:
+        return "unknown";
+    }
+}
+
+size_t FindFirstOutsideClasses(const wchar_t *text, size_t length, unsigned allowedClasses)
+{
+    return FindFirstOutsideClasses(text, length, allowedClasses, ActiveScriptKernel());
+}
+
+size_t FindFirstOutsideClasses(const wchar_t *text, size_t length, unsigned allowedClasses, ScriptKernel kernel)
+{
+    const WideUnit *units = reinterpret_cast<const WideUnit *>(text);
+    size_t covered = 0;
+    size_t offset = 0;
+
+    switch (kernel)
+    {
+#ifdef SCRIPT_CLASSIFY_X64
+    case SCRIPT_KERNEL_SSE2:
+        offset = FindFirstOutsideVector<Sse2Ops>(units, length, allowedClasses, &covered);
+        break;
+    case SCRIPT_KERNEL_AVX2:
+        offset = FindFirstOutsideAvx2(text, length, allowedClasses, &covered);
+        break;
+#endif
+    default:
+        break;
+    }
+
+    if (offset < covered)
+    {
+        return offset;
+    }
+    return covered + FindFirstOutsideScalar(units + covered, length - covered, allowedClasses);
+}
@@ -0,0 +1,80 @@
+// AVX2 classifier kernel. Built with AVX2 code generation where the compiler
+// needs it, and only called after CPU detection confirms support.
+#include "script_classify_kernels.h"
+#include <type_traits>
+
+#if defined(__AVX2__) || (defined(_MSC_VER) && defined(_M_X64))
+#define SCRIPT_CLASSIFY_AVX2 1
+#include <immintrin.h>
+#endif
+
+#ifdef SCRIPT_CLASSIFY_AVX2
+
+namespace
+{
+
+struct Avx2Ops16
+{
+    typedef __m256i Vector;
+    static constexpr size_t VECTORS_PER_STEP = 2;
+    static constexpr uint32_t FULL_MASK = 0xFFFFFFFF;
+
+    static Vector Load(const void *p) { return _mm256_loadu_si256(static_cast<const __m256i *>(p)); }
+    static Vector Set(uint32_t value) { return _mm256_set1_epi16(static_cast<short>(value)); }
+    static Vector Equal(Vector a, Vector b) { return _mm256_cmpeq_epi16(a, b); }
+    static Vector Less(Vector a, Vector b) { return _mm256_cmpgt_epi16(b, a); }
+    static Vector Sub(Vector a, Vector b) { return _mm256_sub_epi16(a, b); }
+    static Vector Xor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+    static Vector And(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+    static Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+    static Vector AndNot(Vector a, Vector b) { return _mm256_andnot_si256(a, b); }
+    static uint32_t MoveMask(Vector v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+};
+
+struct Avx2Ops32
+{
+    typedef __m256i Vector;
+    static constexpr size_t VECTORS_PER_STEP = 4;
+    static constexpr uint32_t FULL_MASK = 0xFFFFFFFF;
+
+    static Vector Load(const void *p) { return _mm256_loadu_si256(static_cast<const __m256i *>(p)); }
+    static Vector Set(uint32_t value) { return _mm256_set1_epi32(static_cast<int>(value)); }
+    static Vector Equal(Vector a, Vector b) { return _mm256_cmpeq_epi32(a, b); }
+    static Vector Less(Vector a, Vector b) { return _mm256_cmpgt_epi32(b, a); }
+    static Vector Sub(Vector a, Vector b) { return _mm256_sub_epi32(a, b); }
+    static Vector Xor(Vector a, Vector b) { return _mm256_xor_si256(a, b); }
+    static Vector And(Vector a, Vector b) { return _mm256_and_si256(a, b); }
+    static Vector Or(Vector a, Vector b) { return _mm256_or_si256(a, b); }
+    static Vector AndNot(Vector a, Vector b) { return _mm256_andnot_si256(a, b); }
+    static uint32_t MoveMask(Vector v) { return static_cast<uint32_t>(_mm256_movemask_epi8(v)); }
+};
+
+typedef std::conditional<sizeof(wchar_t) == 2, Avx2Ops16, Avx2Ops32>::type Avx2Ops;
+typedef std::conditional<sizeof(wchar_t) == 2, uint16_t, uint32_t>::type WideUnit;
+
+} // namespace
+
+bool Avx2KernelCompiled()
+{
+    return true;
+}
+
+size_t FindFirstOutsideAvx2(const wchar_t *text, size_t length, unsigned allowedClasses, size_t *covered)
+{
+    return FindFirstOutsideVector<Avx2Ops>(reinterpret_cast<const WideUnit *>(text), length, allowedClasses, covered);
+}
+
+#else
+
+bool Avx2KernelCompiled()
+{
+    return false;
+}
+
+size_t FindFirstOutsideAvx2(const wchar_t *, size_t, unsigned, size_t *covered)
+{
+    *covered = 0;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,114 @@
+#pragma once
+
+// Classifier kernels shared by script_classify.cpp and script_classify_avx2.cpp.
+// Everything here has internal linkage: the AVX2 file is built with AVX2
+// enabled, and no copy of its code may be picked for the other file.
+
+#include <cstddef>
+#include <cstdint>
+#include "script_classify.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace
+{
+
+template <typename Unit>
+size_t FindFirstOutsideScalar(const Unit *text, size_t length, unsigned allowedClasses)
+{
+    for (size_t i = 0; i < length; i++)
+    {
+        if (!(ClassifyCodeUnit(static_cast<uint32_t>(text[i])) & allowedClasses))
+        {
+            return i;
+        }
+    }
+    return length;
+}
+
+inline unsigned CountTrailingZeros(uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned>(index);
+#else
+    return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+}
+
+// Vector kernel over any register width and unit size. Scans whole steps
+// only and sets covered to the units scanned; returns the first offending
+// offset, or covered if there is none. Callers finish the tail with the
+// scalar kernel, which keeps shared inline code out of the AVX2 file.
+// Ops provides the intrinsics for one instruction set and unit size: Vector,
+// Load, Set, Equal, Less (signed), Sub, Xor, And, Or, AndNot and MoveMask
+// (one bit per byte). Unsigned range checks flip the sign bit so signed
+// compares can do them.
+template <typename Ops, typename Unit>
+size_t FindFirstOutsideVector(const Unit *text, size_t length, unsigned allowedClasses, size_t *covered)
+{
+    typedef typename Ops::Vector Vector;
+    const size_t UNITS = sizeof(Vector) / sizeof(Unit);
+    const size_t STEP = Ops::VECTORS_PER_STEP * UNITS;
+    const uint32_t SIGN = 1u << (8 * sizeof(Unit) - 1);
+
+    const Vector space = Ops::Set(0x20);
+    const Vector tab = Ops::Set(0x09);
+    const Vector lineFeed = Ops::Set(0x0A);
+    const Vector carriageReturn = Ops::Set(0x0D);
+    const Vector sign = Ops::Set(SIGN);
+    const Vector asciiLimit = Ops::Set(SIGN + 0x80);
+    const Vector hebrewFirst = Ops::Set(HEBREW_BLOCK_FIRST);
+    const Vector hebrewLimit = Ops::Set(SIGN + HEBREW_BLOCK_LAST - HEBREW_BLOCK_FIRST + 1);
+    const Vector allowWhitespace = Ops::Set((allowedClasses & SCRIPT_CLASS_WHITESPACE) ? ~0u : 0u);
+    const Vector allowAscii = Ops::Set((allowedClasses & SCRIPT_CLASS_ASCII) ? ~0u : 0u);
+    const Vector allowHebrew = Ops::Set((allowedClasses & SCRIPT_CLASS_HEBREW) ? ~0u : 0u);
+    const Vector allowOther = Ops::Set((allowedClasses & SCRIPT_CLASS_OTHER) ? ~0u : 0u);
+
+    size_t i = 0;
+    for (; i + STEP <= length; i += STEP)
+    {
+        uint32_t masks[Ops::VECTORS_PER_STEP];
+        uint32_t any = 0;
+        for (size_t v = 0; v < Ops::VECTORS_PER_STEP; v++)
+        {
+            Vector units = Ops::Load(text + i + v * UNITS);
+            Vector whitespace = Ops::Or(Ops::Or(Ops::Equal(units, space), Ops::Equal(units, tab)),
+                                        Ops::Or(Ops::Equal(units, lineFeed), Ops::Equal(units, carriageReturn)));
+            Vector ascii = Ops::Less(Ops::Xor(units, sign), asciiLimit);
+            Vector hebrew = Ops::Less(Ops::Xor(Ops::Sub(units, hebrewFirst), sign), hebrewLimit);
+            Vector other = Ops::AndNot(Ops::Or(ascii, hebrew), Ops::Set(~0u));
+
+            Vector allowed = Ops::Or(Ops::Or(Ops::And(whitespace, allowWhitespace),
+                                             Ops::And(Ops::AndNot(whitespace, ascii), allowAscii)),
+                                     Ops::Or(Ops::And(hebrew, allowHebrew), Ops::And(other, allowOther)));
+            masks[v] = ~Ops::MoveMask(allowed) & Ops::FULL_MASK;
+            any |= masks[v];
+        }
+
+        if (any)
+        {
+            for (size_t v = 0; v < Ops::VECTORS_PER_STEP; v++)
+            {
+                if (masks[v])
+                {
+                    *covered = i + STEP;
+                    return i + v * UNITS + CountTrailingZeros(masks[v]) / sizeof(Unit);
+                }
+            }
+        }
+    }
+
+    *covered = i;
+    return i;
+}
+
+} // namespace
+
+// AVX2 kernel from script_classify_avx2.cpp, same contract as
+// FindFirstOutsideVector. Only callable when Avx2KernelCompiled().
+bool Avx2KernelCompiled();
+size_t FindFirstOutsideAvx2(const wchar_t *text, size_t length, unsigned allowedClasses, size_t *covered);
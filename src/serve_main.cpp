@@ -0,0 +1,679 @@
+// kbserve: answers wrong-layout checks for other programs over a Unix domain
+// socket, so editor plugins and bridges need not embed the engine. The wire
+// format is in serve_protocol.h.
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <csignal>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <pthread.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "detection_engine.h"
+#include "engine_setup.h"
+#include "layout_pack.h"
+#include "logger.h"
+#include "serve_protocol.h"
+#include "text_corrector.h"
+
+// Most items a worker answers in one batch, from as many queued requests as
+// fit; a single larger request is still taken whole
+const size_t DEFAULT_SERVE_BATCH_ITEMS = 256;
+
+// Unsent responses a connection may have before the service stops reading
+// from it, for clients that send without reading
+const size_t SERVE_MAX_PENDING_OUTPUT = 1 << 20;
+
+// Bytes read from a connection per wakeup, so one busy client cannot starve the rest
+const size_t SERVE_READ_BYTES = 64 * 1024;
+
+// epoll tags below the first connection id
+const uint64_t SERVE_TAG_LISTEN = 0;
+const uint64_t SERVE_TAG_COMPLETIONS = 1;
+const uint64_t SERVE_TAG_SIGNALS = 2;
+const uint64_t SERVE_FIRST_CONNECTION = 16;
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbserve [--socket <path>] [--threads <n>] [--batch <items>] [--layouts <pack.kblp>]\n"
+                    "               [--model <model.kbng>] [--dict <words.kbdw>] [--min-length <n>]\n"
+                    "  --socket  where to listen; default " DEFAULT_SERVE_SOCKET_PATH "\n"
+                    "  --threads worker threads; default is one per CPU\n"
+                    "  --batch   most items a worker takes from the queue at once, across clients; default 256\n"
+                    "  --layouts layout pack to use instead of the built-in en and he tables\n"
+                    "  --min-length  shortest word checked against the model, in characters; default 3\n");
+}
+
+// One request from its arrival to its response being queued for sending
+struct ServeJob
+{
+    uint64_t connection;
+    std::string request;   // Whole frame, size field included
+    std::string response;  // Whole frame, built by the worker
+    size_t items;
+};
+
+// A worker's engine and scratch space
+struct ServeWorker
+{
+    DetectionEngine engine;
+    std::unique_ptr<TextCorrector> corrector;
+    std::wstring word;
+    std::vector<KeyPressInfo> keys;
+    std::vector<uint16_t> units;
+    uint64_t batches = 0;
+    uint64_t items = 0;
+};
+
+// Requests wait here for workers; answered ones go back to the IO thread
+// through the completion list and a wake of its eventfd
+class ServeQueue
+{
+public:
+    explicit ServeQueue(int wakeFd) : m_wakeFd(wakeFd), m_stopping(false) {}
+
+    void Push(ServeJob *job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending.push_back(job);
+        }
+        m_ready.notify_one();
+    }
+
+    // Waits for work, then takes queued requests up to maxItems items (at
+    // least one request). False when stopping.
+    bool PopBatch(size_t maxItems, std::vector<ServeJob *> &batch)
+    {
+        batch.clear();
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_ready.wait(lock, [this]() { return m_stopping || !m_pending.empty(); });
+        if (m_stopping)
+        {
+            return false;
+        }
+        size_t items = 0;
+        while (!m_pending.empty() && (batch.empty() || items + m_pending.front()->items <= maxItems))
+        {
+            items += m_pending.front()->items;
+            batch.push_back(m_pending.front());
+            m_pending.pop_front();
+        }
+        return true;
+    }
+
+    void Complete(const std::vector<ServeJob *> &batch)
+    {
+        bool wake;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            wake = m_completed.empty();
+            m_completed.insert(m_completed.end(), batch.begin(), batch.end());
+        }
+        if (wake)
+        {
+            uint64_t one = 1;
+            ssize_t written = write(m_wakeFd, &one, sizeof(one));
+            (void)written;
+        }
+    }
+
+    void TakeCompleted(std::vector<ServeJob *> &completed)
+    {
+        uint64_t count;
+        ssize_t readBytes = read(m_wakeFd, &count, sizeof(count));
+        (void)readBytes;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        completed.swap(m_completed);
+    }
+
+    void Stop()
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stopping = true;
+        }
+        m_ready.notify_all();
+    }
+
+private:
+    int m_wakeFd;
+    std::mutex m_mutex;
+    std::condition_variable m_ready;
+    std::deque<ServeJob *> m_pending;
+    std::vector<ServeJob *> m_completed;
+    bool m_stopping;
+};
+
+static void AddResult(ServeFrameWriter &writer, ServeWorker &worker, uint8_t status, const WordVerdict &verdict)
+{
+    worker.units.clear();
+    for (wchar_t ch : verdict.text)
+    {
+        worker.units.push_back(static_cast<uint16_t>(ch));
+    }
+    ServeResultHeader result = {};
+    result.status = status;
+    result.typedLayout = static_cast<int8_t>(verdict.typedLayout);
+    result.bestLayout = static_cast<int8_t>(verdict.bestLayout);
+    result.wrongLayout = verdict.bestLayout != verdict.typedLayout;
+    result.margin = static_cast<float>(verdict.margin);
+    result.length = static_cast<uint16_t>(worker.units.size());
+    writer.Add(result, worker.units.data());
+}
+
+// Answers every item of a request, or none if the items cannot be read
+static void AnswerRequest(ServeJob &job, ServeWorker &worker)
+{
+    const uint8_t *data = reinterpret_cast<const uint8_t *>(job.request.data());
+    const uint8_t *end = data + job.request.size();
+    ServeFrameHeader header;
+    memcpy(&header, data, sizeof(header));
+    const uint8_t *pos = data + sizeof(header);
+
+    job.response.clear();
+    ServeFrameWriter writer(job.response);
+    writer.Begin(header.requestId);
+    WordVerdict none = {-1, -1, 0.0, std::wstring_view()};
+    bool readable = true;
+    for (uint16_t i = 0; i < header.itemCount; i++)
+    {
+        ServeItemHeader item;
+        readable = static_cast<size_t>(end - pos) >= sizeof(item);
+        if (!readable)
+        {
+            break;
+        }
+        memcpy(&item, pos, sizeof(item));
+        pos += sizeof(item);
+        size_t bytes = item.length * sizeof(uint16_t);
+        readable = static_cast<size_t>(end - pos) >= bytes;
+        if (!readable)
+        {
+            break;
+        }
+        const uint8_t *units = pos;
+        pos += bytes;
+
+        WordVerdict verdict = none;
+        uint8_t status = SERVE_OK;
+        if (item.length > SERVE_MAX_ITEM_UNITS)
+        {
+            status = SERVE_ITEM_TOO_LONG;
+        }
+        else if (item.kind == SERVE_ITEM_TEXT)
+        {
+            worker.word.clear();
+            for (size_t k = 0; k < item.length; k++)
+            {
+                uint16_t unit;
+                memcpy(&unit, units + k * sizeof(unit), sizeof(unit));
+                worker.word.push_back(static_cast<wchar_t>(unit));
+            }
+            if (!worker.corrector->CheckWord(worker.word, verdict))
+            {
+                status = SERVE_NO_LAYOUT;
+            }
+        }
+        else if (item.kind == SERVE_ITEM_KEYS)
+        {
+            worker.keys.clear();
+            for (size_t k = 0; k < item.length; k++)
+            {
+                uint16_t unit;
+                memcpy(&unit, units + k * sizeof(unit), sizeof(unit));
+                ModifierFlags modifiers;
+                modifiers.shift = (unit & SERVE_KEY_SHIFT) != 0;
+                modifiers.ctrl = modifiers.alt = (unit & SERVE_KEY_ALTGR) != 0;
+                worker.keys.emplace_back(unit & 0xFF, modifiers);
+            }
+            if (!worker.corrector->CheckKeys(worker.keys.data(), worker.keys.size(), item.layout, verdict))
+            {
+                status = SERVE_NO_LAYOUT;
+            }
+        }
+        else
+        {
+            status = SERVE_BAD_ITEM;
+        }
+        AddResult(writer, worker, status, verdict);
+    }
+    writer.End();
+
+    // Items that do not fill the frame exactly mean it was not built the
+    // way the client thinks; answering part of it would hide that
+    if (!readable || pos != end)
+    {
+        job.response.clear();
+        writer.Begin(header.requestId, SERVE_BAD_REQUEST);
+        writer.End();
+        return;
+    }
+    worker.items += header.itemCount;
+}
+
+// A client as the IO thread sees it
+struct ServeConnection
+{
+    int fd;
+    std::string input;
+    size_t inputUsed;
+    std::string output;
+    size_t outputSent;
+    size_t inFlight;
+    uint32_t events;  // What epoll watches for; 0 when it is not watched at all
+    bool closing;     // Nothing more is read; closed once every answer is sent
+    bool broken;      // Answers can no longer be sent and are dropped
+};
+
+int main(int argc, char **argv)
+{
+    std::string socketPath = DEFAULT_SERVE_SOCKET_PATH;
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t batchItems = DEFAULT_SERVE_BATCH_ITEMS;
+    size_t minLength = DEFAULT_MIN_TEXT_LENGTH;
+    std::string packPath;
+    std::string modelPath;
+    std::string dictionaryPath;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+        {
+            socketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--batch") == 0 && i + 1 < argc)
+        {
+            batchItems = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--min-length") == 0 && i + 1 < argc)
+        {
+            minLength = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--layouts") == 0 && i + 1 < argc)
+        {
+            packPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            modelPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dict") == 0 && i + 1 < argc)
+        {
+            dictionaryPath = argv[++i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    std::vector<LayoutTable> layouts;
+    if (!LoadLayouts(packPath, layouts))
+    {
+        return 1;
+    }
+
+    // One engine per worker, so workers never wait on each other
+    std::vector<std::unique_ptr<ServeWorker>> workers;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back(new ServeWorker());
+        if (!ConfigureEngine(workers.back()->engine, layouts, modelPath, dictionaryPath, minLength, t == 0))
+        {
+            return 1;
+        }
+        workers.back()->corrector.reset(new TextCorrector(workers.back()->engine));
+    }
+
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(address.sun_path))
+    {
+        fprintf(stderr, "Socket path %s is too long\n", socketPath.c_str());
+        return 1;
+    }
+    memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // A socket left by a run that did not exit cleanly is replaced; anything
+    // else at the path is not
+    struct stat existing;
+    if (lstat(socketPath.c_str(), &existing) == 0)
+    {
+        if (!S_ISSOCK(existing.st_mode))
+        {
+            fprintf(stderr, "%s exists and is not a socket\n", socketPath.c_str());
+            return 1;
+        }
+        unlink(socketPath.c_str());
+    }
+
+    int listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (listenFd < 0 || bind(listenFd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 ||
+        chmod(socketPath.c_str(), 0600) != 0 || listen(listenFd, SOMAXCONN) != 0)
+    {
+        fprintf(stderr, "Cannot listen on %s: %s\n", socketPath.c_str(), strerror(errno));
+        return 1;
+    }
+
+    // Signals arrive through a descriptor so the IO loop sees them in turn;
+    // they are blocked before any worker starts
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+    signal(SIGPIPE, SIG_IGN);
+    int signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+    int wakeFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    int epollFd = epoll_create1(EPOLL_CLOEXEC);
+    if (signalFd < 0 || wakeFd < 0 || epollFd < 0)
+    {
+        fprintf(stderr, "Cannot set up the event loop: %s\n", strerror(errno));
+        return 1;
+    }
+    auto watch = [epollFd](int op, int fd, uint32_t events, uint64_t tag)
+    {
+        epoll_event event = {};
+        event.events = events;
+        event.data.u64 = tag;
+        epoll_ctl(epollFd, op, fd, &event);
+    };
+    watch(EPOLL_CTL_ADD, listenFd, EPOLLIN, SERVE_TAG_LISTEN);
+    watch(EPOLL_CTL_ADD, wakeFd, EPOLLIN, SERVE_TAG_COMPLETIONS);
+    watch(EPOLL_CTL_ADD, signalFd, EPOLLIN, SERVE_TAG_SIGNALS);
+
+    ServeQueue queue(wakeFd);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&queue, &worker = *workers[t], batchItems]()
+        {
+            std::vector<ServeJob *> batch;
+            while (queue.PopBatch(batchItems, batch))
+            {
+                for (ServeJob *job : batch)
+                {
+                    AnswerRequest(*job, worker);
+                }
+                worker.batches++;
+                queue.Complete(batch);
+            }
+        });
+    }
+
+    fprintf(stderr, "Listening on %s with %zu workers; layouts", socketPath.c_str(), threadCount);
+    for (size_t i = 0; i < layouts.size(); i++)
+    {
+        char name[LAYOUT_PACK_MAX_NAME * 4 + 1];
+        name[AppendUtf8(name, 0, sizeof(name) - 1, layouts[i].Name().c_str())] = '\0';
+        fprintf(stderr, "%s %zu %s", i == 0 ? "" : ",", i, name);
+    }
+    fprintf(stderr, "\n");
+
+    std::unordered_map<uint64_t, ServeConnection> connections;
+    std::vector<ServeJob *> freeJobs;
+    std::vector<ServeJob *> completed;
+    uint64_t nextConnection = SERVE_FIRST_CONNECTION;
+    uint64_t connectionsServed = 0;
+    uint64_t requests = 0;
+    uint64_t badFrames = 0;
+
+    // Reads while the connection has room for more work, writes while it
+    // has output, and closes it once it is done. A connection with neither
+    // is left out of epoll, where a hung-up peer would keep waking the loop.
+    auto updateEvents = [&](uint64_t id, ServeConnection &connection)
+    {
+        if (connection.closing && connection.inFlight == 0 && connection.output.empty())
+        {
+            epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+            close(connection.fd);
+            connections.erase(id);
+            return;
+        }
+        uint32_t events = 0;
+        if (!connection.closing && connection.inFlight < SERVE_MAX_IN_FLIGHT &&
+            connection.output.size() - connection.outputSent < SERVE_MAX_PENDING_OUTPUT)
+        {
+            events |= EPOLLIN;
+        }
+        if (connection.outputSent < connection.output.size())
+        {
+            events |= EPOLLOUT;
+        }
+        if (events != connection.events)
+        {
+            if (events == 0)
+            {
+                epoll_ctl(epollFd, EPOLL_CTL_DEL, connection.fd, nullptr);
+            }
+            else
+            {
+                watch(connection.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, connection.fd, events, id);
+            }
+            connection.events = events;
+        }
+    };
+    auto flush = [](ServeConnection &connection)
+    {
+        while (connection.outputSent < connection.output.size())
+        {
+            ssize_t sent = send(connection.fd, connection.output.data() + connection.outputSent,
+                                connection.output.size() - connection.outputSent, MSG_NOSIGNAL);
+            if (sent < 0)
+            {
+                if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                {
+                    // Nobody is left to read the answers
+                    connection.closing = connection.broken = true;
+                    connection.output.clear();
+                    connection.outputSent = 0;
+                }
+                if (errno != EINTR)
+                {
+                    break;
+                }
+                continue;
+            }
+            connection.outputSent += static_cast<size_t>(sent);
+        }
+        if (connection.outputSent == connection.output.size())
+        {
+            connection.output.clear();
+            connection.outputSent = 0;
+        }
+    };
+
+    // Queues every whole frame in the input; a frame too large to accept
+    // closes the connection
+    auto takeFrames = [&](uint64_t id, ServeConnection &connection)
+    {
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(connection.input.data());
+        size_t offset = 0;
+        for (;;)
+        {
+            size_t available = connection.inputUsed - offset;
+            uint32_t declared = 0;
+            if (available >= sizeof(declared))
+            {
+                memcpy(&declared, data + offset, sizeof(declared));
+                if (declared > SERVE_MAX_FRAME || declared < sizeof(ServeFrameHeader) - sizeof(declared))
+                {
+                    badFrames++;
+                    connection.closing = true;
+                    break;
+                }
+            }
+            size_t frameBytes = ServeFrameBytes(data + offset, available);
+            if (frameBytes == 0)
+            {
+                break;
+            }
+            ServeJob *job;
+            if (freeJobs.empty())
+            {
+                job = new ServeJob();
+            }
+            else
+            {
+                job = freeJobs.back();
+                freeJobs.pop_back();
+            }
+            ServeFrameHeader header;
+            memcpy(&header, data + offset, sizeof(header));
+            job->connection = id;
+            job->request.assign(reinterpret_cast<const char *>(data + offset), frameBytes);
+            job->items = std::max<size_t>(header.itemCount, 1);
+            connection.inFlight++;
+            requests++;
+            queue.Push(job);
+            offset += frameBytes;
+        }
+        connection.inputUsed -= offset;
+        memmove(&connection.input[0], data + offset, connection.inputUsed);
+    };
+
+    auto started = std::chrono::steady_clock::now();
+    bool running = true;
+    std::vector<epoll_event> events(64);
+    while (running)
+    {
+        int ready = epoll_wait(epollFd, events.data(), static_cast<int>(events.size()), -1);
+        if (ready < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            fprintf(stderr, "Event loop failed: %s\n", strerror(errno));
+            break;
+        }
+        for (int e = 0; e < ready; e++)
+        {
+            uint64_t tag = events[e].data.u64;
+            if (tag == SERVE_TAG_SIGNALS)
+            {
+                running = false;
+            }
+            else if (tag == SERVE_TAG_LISTEN)
+            {
+                int fd;
+                while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0)
+                {
+                    uint64_t id = nextConnection++;
+                    ServeConnection &connection = connections[id];
+                    connection = {fd, std::string(), 0, std::string(), 0, 0, EPOLLIN, false, false};
+                    watch(EPOLL_CTL_ADD, fd, EPOLLIN, id);
+                    connectionsServed++;
+                }
+            }
+            else if (tag == SERVE_TAG_COMPLETIONS)
+            {
+                queue.TakeCompleted(completed);
+                for (ServeJob *job : completed)
+                {
+                    auto found = connections.find(job->connection);
+                    if (found != connections.end())
+                    {
+                        ServeConnection &connection = found->second;
+                        connection.inFlight--;
+                        if (!connection.broken)
+                        {
+                            connection.output += job->response;
+                        }
+                        flush(connection);
+                        updateEvents(found->first, connection);
+                    }
+                    freeJobs.push_back(job);
+                }
+                completed.clear();
+            }
+            else
+            {
+                auto found = connections.find(tag);
+                if (found == connections.end())
+                {
+                    continue;
+                }
+                ServeConnection &connection = found->second;
+                if (events[e].events & EPOLLOUT)
+                {
+                    flush(connection);
+                }
+                if ((events[e].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) && !connection.closing)
+                {
+                    if (connection.input.size() < connection.inputUsed + SERVE_READ_BYTES)
+                    {
+                        connection.input.resize(connection.inputUsed + SERVE_READ_BYTES);
+                    }
+                    ssize_t received = recv(connection.fd, &connection.input[connection.inputUsed], SERVE_READ_BYTES, 0);
+                    if (received > 0)
+                    {
+                        connection.inputUsed += static_cast<size_t>(received);
+                        takeFrames(tag, connection);
+                    }
+                    else if (received == 0)
+                    {
+                        // The client is done sending; it still gets its answers
+                        connection.closing = true;
+                    }
+                    else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                    {
+                        connection.closing = connection.broken = true;
+                        connection.output.clear();
+                        connection.outputSent = 0;
+                    }
+                }
+                updateEvents(tag, connection);
+            }
+        }
+    }
+
+    queue.Stop();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    for (auto &entry : connections)
+    {
+        close(entry.second.fd);
+    }
+    close(listenFd);
+    unlink(socketPath.c_str());
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    uint64_t items = 0;
+    uint64_t batches = 0;
+    for (const auto &worker : workers)
+    {
+        items += worker->items;
+        batches += worker->batches;
+    }
+    fprintf(stderr, "%llu connections, %llu requests, %llu items in %llu batches (%.1f items per batch), "
+                    "%llu bad frames, %.1f s\n",
+            static_cast<unsigned long long>(connectionsServed), static_cast<unsigned long long>(requests),
+            static_cast<unsigned long long>(items), static_cast<unsigned long long>(batches),
+            batches > 0 ? static_cast<double>(items) / static_cast<double>(batches) : 0.0,
+            static_cast<unsigned long long>(badFrames), elapsed);
+    return 0;
+}
@@ -0,0 +1,190 @@
+#include "span_trace.h"
+#include <algorithm>
+#include <cstdio>
+#include "logger.h"
+
+std::atomic<bool> SpanTrace::s_enabled(false);
+
+static thread_local SpanBuffer *s_threadBuffer = nullptr;
+static thread_local const char *s_threadName = nullptr;
+static thread_local uint32_t s_spanDepth = 0;
+
+// Writes text as a JSON string literal
+static void AppendJsonString(std::string &json, const char *text)
+{
+    json += '"';
+    for (; *text; text++)
+    {
+        unsigned char ch = static_cast<unsigned char>(*text);
+        if (ch == '"' || ch == '\\')
+        {
+            json += '\\';
+            json += static_cast<char>(ch);
+        }
+        else if (ch < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", ch);
+            json += escaped;
+        }
+        else
+        {
+            json += static_cast<char>(ch);
+        }
+    }
+    json += '"';
+}
+
+SpanBuffer::SpanBuffer(uint32_t threadIndex, const char *threadName)
+    : m_events(new SpanEvent[SPAN_BUFFER_EVENTS]),
+      m_count(0),
+      m_dropped(0),
+      m_threadIndex(threadIndex),
+      m_threadName(threadName)
+{
+}
+
+SpanTrace::SpanTrace()
+    : m_startTicks(0),
+      m_startNs(0)
+{
+}
+
+void SpanTrace::Enable()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_startNs == 0)
+        {
+            m_startTicks = SpanClockTicks();
+            m_startNs = LatencyClockNs();
+        }
+    }
+    s_enabled.store(true, std::memory_order_release);
+}
+
+void SpanTrace::SetThreadName(const char *name)
+{
+    s_threadName = name;
+}
+
+SpanBuffer &SpanTrace::ThreadBuffer()
+{
+    if (!s_threadBuffer)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t index = static_cast<uint32_t>(m_buffers.size()) + 1;
+        m_buffers.emplace_back(new SpanBuffer(index, s_threadName));
+        s_threadBuffer = m_buffers.back().get();
+    }
+    return *s_threadBuffer;
+}
+
+uint64_t SpanTrace::EventCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t count = 0;
+    for (const auto &buffer : m_buffers)
+    {
+        count += buffer->Count();
+    }
+    return count;
+}
+
+uint64_t SpanTrace::DroppedCount() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint64_t dropped = 0;
+    for (const auto &buffer : m_buffers)
+    {
+        dropped += buffer->Dropped();
+    }
+    return dropped;
+}
+
+void SpanTrace::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    for (const auto &buffer : m_buffers)
+    {
+        buffer->Clear();
+    }
+}
+
+std::string SpanTrace::ToChromeJson() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // The clock rate is measured over the whole trace, so the TSC needs no
+    // separate calibration
+    uint64_t nowTicks = SpanClockTicks();
+    uint64_t nowNs = LatencyClockNs();
+    double nsPerTick = nowTicks > m_startTicks && nowNs > m_startNs
+        ? static_cast<double>(nowNs - m_startNs) / static_cast<double>(nowTicks - m_startTicks)
+        : 1.0;
+
+    std::string json = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n";
+    bool first = true;
+    char line[160];
+    for (const auto &buffer : m_buffers)
+    {
+        char name[32];
+        snprintf(name, sizeof(name), "thread %u", buffer->ThreadIndex());
+        json += first ? "" : ",\n";
+        first = false;
+        snprintf(line, sizeof(line), "{\"ph\":\"M\",\"name\":\"thread_name\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":",
+                 buffer->ThreadIndex());
+        json += line;
+        AppendJsonString(json, buffer->ThreadName() ? buffer->ThreadName() : name);
+        json += "}}";
+
+        size_t count = buffer->Count();
+        for (size_t i = 0; i < count; i++)
+        {
+            const SpanEvent &event = buffer->Event(i);
+            double beginUs = static_cast<double>(event.beginTicks - m_startTicks) * nsPerTick / 1000.0;
+            double durationUs = static_cast<double>(event.endTicks - event.beginTicks) * nsPerTick / 1000.0;
+            json += ",\n{\"ph\":\"X\",\"name\":";
+            AppendJsonString(json, event.site->name);
+            json += ",\"cat\":";
+            AppendJsonString(json, event.site->category);
+            snprintf(line, sizeof(line), ",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u,\"args\":{\"depth\":%u}}",
+                     beginUs, durationUs, buffer->ThreadIndex(), event.depth);
+            json += line;
+        }
+    }
+    json += "\n]}\n";
+    return json;
+}
+
+bool SpanTrace::WriteChromeJson(const std::filesystem::path &path) const
+{
+    std::error_code ec;
+    if (path.has_parent_path())
+    {
+        std::filesystem::create_directories(path.parent_path(), ec);
+    }
+
+    FILE *file = OpenLogFile(path.wstring(), L"wb");
+    if (!file)
+    {
+        return false;
+    }
+    std::string json = ToChromeJson();
+    bool written = fwrite(json.data(), 1, json.size(), file) == json.size();
+    return fclose(file) == 0 && written;
+}
+
+void ScopedSpan::Begin(const SpanSite &site)
+{
+    m_site = &site;
+    s_spanDepth++;
+    m_beginTicks = SpanClockTicks();
+}
+
+void ScopedSpan::End()
+{
+    uint64_t endTicks = SpanClockTicks();
+    s_spanDepth--;
+    SpanTrace::Instance().ThreadBuffer().Add(m_site, m_beginTicks, endTicks, s_spanDepth);
+}
@@ -0,0 +1,165 @@
+#include "text_composer.h"
+#include <algorithm>
+#include <cstring>
+
+TextComposer::TextComposer(size_t window)
+    : m_window(window > 0 ? window : 1),
+      m_keyHead(0),
+      m_keyCount(0),
+      m_resetOnWordBoundary(true)
+{
+    m_keyLanes.resize(m_window);
+}
+
+void TextComposer::SetLayouts(const std::vector<const LayoutTable *> &layouts)
+{
+    m_layouts.assign(layouts.begin(), layouts.begin() + std::min(layouts.size(), MAX_COMPOSE_LAYOUTS));
+    m_buffer.assign(m_layouts.size() * 2 * m_window, 0);
+    m_laneState.resize(m_layouts.size());
+    Reset();
+}
+
+void TextComposer::Reset()
+{
+    for (Lane &lane : m_laneState)
+    {
+        lane.start = 0;
+        lane.length = 0;
+        lane.pendingDead = 0;
+    }
+    m_keyHead = 0;
+    m_keyCount = 0;
+}
+
+bool TextComposer::OnKey(const KeyPressInfo &key)
+{
+    if (key.vkCode == KC_BACK)
+    {
+        return RemoveLastKey();
+    }
+
+    if (IsWordBoundaryKey(key.vkCode) && (m_resetOnWordBoundary || key.vkCode != KC_SPACE))
+    {
+        bool changed = m_keyCount > 0;
+        Reset();
+        return changed;
+    }
+
+    // Ctrl or Alt alone are shortcuts, not text
+    if (key.modifiers.ctrl != key.modifiers.alt)
+    {
+        return false;
+    }
+
+    LayoutShiftState state = LayoutTable::ShiftStateFor(key.modifiers);
+    uint32_t lanes = 0;
+    bool consumed = false;
+    bool composed = false;    // Some lane combined a pending dead key with this key
+    bool uncomposed = false;  // Some lane had a dead key that does not combine with it
+    for (size_t i = 0; i < m_layouts.size(); i++)
+    {
+        if (key.vkCode >= LayoutTable::KEY_COUNT)
+        {
+            break;
+        }
+
+        const LayoutEntry &entry = m_layouts[i]->Entry(key.vkCode, state);
+        Lane &lane = m_laneState[i];
+        if (entry.flags & LAYOUT_ENTRY_DEAD)
+        {
+            lane.pendingDead = entry.ch;
+            consumed = true;
+            continue;
+        }
+        if (entry.ch == 0)
+        {
+            continue;
+        }
+
+        wchar_t ch = entry.ch;
+        if (lane.pendingDead != 0)
+        {
+            wchar_t combined = m_layouts[i]->Compose(lane.pendingDead, ch);
+            composed |= combined != 0;
+            uncomposed |= combined == 0;
+            ch = combined != 0 ? combined : ch;
+            lane.pendingDead = 0;
+        }
+        Append(i, ch);
+        lanes |= 1u << i;
+    }
+
+    if (lanes == 0 && !consumed)
+    {
+        return false;
+    }
+
+    // A dead key that gave no text anywhere and is now composed shows as one
+    // character with this key, so the two are one key to backspace over
+    size_t last = (m_keyHead + m_keyCount + m_window - 1) % m_window;
+    if (composed && !uncomposed && m_keyCount > 0 && m_keyLanes[last] == 0)
+    {
+        m_keyLanes[last] = lanes;
+        return lanes != 0;
+    }
+
+    // Lanes have room for one key past the window until the oldest is dropped
+    if (m_keyCount == m_window)
+    {
+        DropOldestKey();
+    }
+    m_keyLanes[(m_keyHead + m_keyCount) % m_window] = lanes;
+    m_keyCount++;
+    return lanes != 0;
+}
+
+void TextComposer::Append(size_t layoutIndex, wchar_t ch)
+{
+    Lane &lane = m_laneState[layoutIndex];
+    wchar_t *buffer = LaneBuffer(layoutIndex);
+
+    // Slide the text back to the front once the lane runs out of room.
+    // Happens at most once every window appends, so appends are amortized O(1).
+    if (lane.start + lane.length == 2 * m_window)
+    {
+        memmove(buffer, buffer + lane.start, lane.length * sizeof(wchar_t));
+        lane.start = 0;
+    }
+    buffer[lane.start + lane.length] = ch;
+    lane.length++;
+}
+
+void TextComposer::DropOldestKey()
+{
+    uint32_t lanes = m_keyLanes[m_keyHead];
+    for (size_t i = 0; i < m_layouts.size(); i++)
+    {
+        if (lanes & (1u << i))
+        {
+            m_laneState[i].start++;
+            m_laneState[i].length--;
+        }
+    }
+    m_keyHead = (m_keyHead + 1) % m_window;
+    m_keyCount--;
+}
+
+bool TextComposer::RemoveLastKey()
+{
+    if (m_keyCount == 0)
+    {
+        return false;
+    }
+
+    m_keyCount--;
+    uint32_t lanes = m_keyLanes[(m_keyHead + m_keyCount) % m_window];
+    for (size_t i = 0; i < m_layouts.size(); i++)
+    {
+        m_laneState[i].pendingDead = 0;
+        if (lanes & (1u << i))
+        {
+            m_laneState[i].length--;
+        }
+    }
+    return lanes != 0;
+}
@@ -0,0 +1,120 @@
+#include "text_corrector.h"
+
+// Numpad keys type the same in every layout, so they say nothing about
+// what the other layouts would have typed
+static bool IsNumpadKey(uint32_t vkCode)
+{
+    return vkCode >= KC_NUMPAD0 && vkCode <= KC_DIVIDE;
+}
+
+ReverseLayoutMap::ReverseLayoutMap(const LayoutTable &layout)
+    : m_keys(REVERSE_LAYOUT_CHARS, NO_KEY)
+{
+    // States run from no modifiers to most, and the main keys come before
+    // the numpad, so the first key found is kept
+    for (uint8_t state = 0; state < LSS_COUNT; state++)
+    {
+        for (int numpad = 0; numpad < 2; numpad++)
+        {
+            for (uint32_t vk = 0; vk < LayoutTable::KEY_COUNT; vk++)
+            {
+                wchar_t ch = layout.Lookup(vk, static_cast<LayoutShiftState>(state));
+                if (ch != 0 && IsNumpadKey(vk) == (numpad != 0) && static_cast<uint32_t>(ch) < REVERSE_LAYOUT_CHARS &&
+                    m_keys[ch] == NO_KEY)
+                {
+                    m_keys[ch] = static_cast<uint16_t>(vk * LSS_COUNT + state);
+                }
+            }
+        }
+    }
+}
+
+bool ReverseLayoutMap::Find(wchar_t ch, KeyPressInfo &key) const
+{
+    if (static_cast<uint32_t>(ch) >= REVERSE_LAYOUT_CHARS || m_keys[ch] == NO_KEY)
+    {
+        return false;
+    }
+    uint16_t entry = m_keys[ch];
+    uint8_t state = entry % LSS_COUNT;
+    key.vkCode = entry / LSS_COUNT;
+    key.modifiers = ModifierFlags();
+    key.modifiers.shift = (state & LSS_SHIFT) != 0;
+    key.modifiers.ctrl = key.modifiers.alt = (state & LSS_ALTGR) != 0;
+    return true;
+}
+
+TextCorrector::TextCorrector(DetectionEngine &engine)
+    : m_engine(engine),
+      m_wordsCorrected(0)
+{
+    m_maps.reserve(engine.LayoutCount());
+    for (size_t i = 0; i < engine.LayoutCount(); i++)
+    {
+        m_maps.emplace_back(engine.Layout(i));
+    }
+}
+
+bool TextCorrector::CheckWord(std::wstring_view word, WordVerdict &verdict)
+{
+    // The word was most likely typed in the layout that needs the fewest
+    // modifiers for it, the first such layout on a tie
+    int source = -1;
+    size_t bestModified = 0;
+    KeyPressInfo key(0, ModifierFlags());
+    for (size_t layout = 0; layout < m_maps.size(); layout++)
+    {
+        m_keys.clear();
+        size_t modified = 0;
+        for (wchar_t ch : word)
+        {
+            if (!m_maps[layout].Find(ch, key))
+            {
+                break;
+            }
+            modified += key.modifiers.shift || key.modifiers.alt;
+            m_keys.push_back(key);
+        }
+        if (m_keys.size() == word.size() && (source < 0 || modified < bestModified))
+        {
+            source = static_cast<int>(layout);
+            bestModified = modified;
+            m_bestKeys.swap(m_keys);
+        }
+    }
+    if (source < 0)
+    {
+        verdict.typedLayout = verdict.bestLayout = -1;
+        verdict.margin = 0.0;
+        verdict.text = word;
+        return false;
+    }
+    return CheckKeys(m_bestKeys.data(), m_bestKeys.size(), static_cast<size_t>(source), verdict);
+}
+
+bool TextCorrector::CheckKeys(const KeyPressInfo *keys, size_t count, size_t typedLayout, WordVerdict &verdict)
+{
+    if (typedLayout >= m_maps.size())
+    {
+        verdict.typedLayout = verdict.bestLayout = -1;
+        verdict.margin = 0.0;
+        verdict.text = std::wstring_view();
+        return false;
+    }
+    int target = m_engine.CheckKeys(keys, count, typedLayout, &verdict.margin);
+    verdict.typedLayout = static_cast<int>(typedLayout);
+    verdict.bestLayout = target >= 0 ? target : verdict.typedLayout;
+    verdict.text = m_engine.WordInLayout(static_cast<size_t>(verdict.bestLayout));
+    return true;
+}
+
+std::wstring_view TextCorrector::CorrectWord(std::wstring_view word)
+{
+    WordVerdict verdict;
+    if (!CheckWord(word, verdict) || verdict.bestLayout == verdict.typedLayout)
+    {
+        return std::wstring_view();
+    }
+    m_wordsCorrected++;
+    return verdict.text;
+}
@@ -0,0 +1,104 @@
+#define UNICODE
+#define _UNICODE
+#include "win32_hook_source.h"
+#include <string>
+#include "latency_histogram.h"
+#include "logger.h"
+
+Win32HookSource *Win32HookSource::s_active = nullptr;
+
+Win32HookSource::Win32HookSource()
+    : m_hook(NULL),
+      m_worker(nullptr)
+{
+}
+
+Win32HookSource::~Win32HookSource()
+{
+    Stop();
+}
+
+bool Win32HookSource::Start(KeyEventWorker &worker)
+{
+    if (m_hook)
+    {
+        return true;
+    }
+    if (s_active)
+    {
+        LOG(ERR, L"Another keyboard hook source is already running");
+        return false;
+    }
+
+    m_worker = &worker;
+    s_active = this;
+    m_hook = SetWindowsHookEx(WH_KEYBOARD_LL, LowLevelKeyboardProc, NULL, 0);
+    if (!m_hook)
+    {
+        LOG(ERR, L"Failed to set keyboard hook. Error: " + std::to_wstring(GetLastError()));
+        s_active = nullptr;
+        m_worker = nullptr;
+        return false;
+    }
+    LOG(INF, L"Keyboard hook set successfully");
+    return true;
+}
+
+void Win32HookSource::Stop()
+{
+    if (!m_hook)
+    {
+        return;
+    }
+    if (UnhookWindowsHookEx(m_hook))
+    {
+        LOG(INF, L"Keyboard hook removed successfully");
+    }
+    else
+    {
+        LOG(ERR, L"Failed to remove keyboard hook. Error: " + std::to_wstring(GetLastError()));
+    }
+    m_hook = NULL;
+    s_active = nullptr;
+    m_worker = nullptr;
+}
+
+LRESULT CALLBACK Win32HookSource::LowLevelKeyboardProc(int nCode, WPARAM wParam, LPARAM lParam)
+{
+    // Runs inside every application's input path: capture the event and return
+    uint64_t entryNs = LatencyClockNs();
+    TRACE_SPAN("input");
+    Win32HookSource *source = s_active;
+    if (nCode < 0 || !source || !lParam)
+    {
+        return CallNextHookEx(NULL, nCode, wParam, lParam);
+    }
+
+    const KBDLLHOOKSTRUCT *hookStruct = (const KBDLLHOOKSTRUCT *)lParam;
+    KeyEvent event;
+    event.vkCode = static_cast<uint16_t>(hookStruct->vkCode);
+    event.scanCode = static_cast<uint16_t>(hookStruct->scanCode);
+    event.flags = 0;
+    event.reserved = 0;
+    event.timestampUs = KeyEventClockUs();
+    if (wParam == WM_KEYUP || wParam == WM_SYSKEYUP)
+    {
+        event.flags |= KEY_EVENT_UP;
+    }
+    if (hookStruct->flags & LLKHF_EXTENDED)
+    {
+        event.flags |= KEY_EVENT_EXTENDED;
+    }
+    if (hookStruct->flags & LLKHF_INJECTED)
+    {
+        event.flags |= KEY_EVENT_INJECTED;
+    }
+    if (hookStruct->flags & LLKHF_ALTDOWN)
+    {
+        event.flags |= KEY_EVENT_ALT_DOWN;
+    }
+    source->m_worker->Post(event);
+
+    LatencyStats::Instance().Record(LATENCY_HOOK, LatencyClockNs() - entryNs);
+    return CallNextHookEx(NULL, nCode, wParam, lParam);
+}
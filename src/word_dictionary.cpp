@@ -0,0 +1,406 @@
+#include "word_dictionary.h"
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+#include "ngram_model.h"
+
+int WordDictionaryLanguage::SymbolFor(wchar_t ch) const
+{
+    ch = NgramFoldCase(ch);
+    if (static_cast<uint32_t>(ch) > 0xFFFF)
+    {
+        return -1;
+    }
+
+    const uint16_t *end = m_alphabet + m_symbolCount;
+    const uint16_t *it = std::lower_bound(m_alphabet, end, static_cast<uint16_t>(ch));
+    if (it == end || *it != static_cast<uint16_t>(ch))
+    {
+        return -1;
+    }
+    return static_cast<int>(it - m_alphabet);
+}
+
+bool WordDictionaryLanguage::Contains(std::wstring_view word) const
+{
+    if (word.empty())
+    {
+        return false;
+    }
+
+    uint32_t node = m_rootEdge;
+    for (size_t i = 0; i < word.size(); i++)
+    {
+        int symbol = SymbolFor(word[i]);
+        if (symbol < 0 || node == 0)
+        {
+            return false;
+        }
+
+        // Edges are sorted by symbol, so stop at the first one past it
+        uint32_t edge;
+        for (uint32_t index = node;; index++)
+        {
+            if (index >= m_edgeCount)
+            {
+                return false;
+            }
+            edge = m_edges[index];
+            int edgeSymbol = static_cast<int>(edge >> DAWG_SYMBOL_SHIFT);
+            if (edgeSymbol == symbol)
+            {
+                break;
+            }
+            if (edgeSymbol > symbol || (edge & DAWG_EDGE_LAST))
+            {
+                return false;
+            }
+        }
+
+        if (i + 1 == word.size())
+        {
+            return (edge & DAWG_EDGE_FINAL) != 0;
+        }
+        node = edge & DAWG_CHILD_MASK;
+    }
+    return false;
+}
+
+bool WordDictionary::Load(const std::filesystem::path &path)
+{
+    m_languages.clear();
+    if (!m_file.Open(path))
+    {
+        return false;
+    }
+    if (!LoadFromMemory(m_file.Data(), m_file.Size()))
+    {
+        m_file.Close();
+        return false;
+    }
+    return true;
+}
+
+bool WordDictionary::LoadFromMemory(const uint8_t *data, size_t size)
+{
+    m_languages.clear();
+    if (!data || size < sizeof(WordDictionaryHeader))
+    {
+        return false;
+    }
+
+    WordDictionaryHeader header;
+    memcpy(&header, data, sizeof(header));
+    if (memcmp(header.magic, "KBDW", 4) != 0 || header.version != WORD_DICTIONARY_VERSION)
+    {
+        return false;
+    }
+    if (sizeof(WordDictionaryHeader) + header.languageCount * sizeof(WordDictionaryEntry) > size)
+    {
+        return false;
+    }
+
+    // Only the table of contents is checked; lookups bound-check edge indexes
+    // themselves, so the edges are not touched until used
+    for (uint16_t i = 0; i < header.languageCount; i++)
+    {
+        WordDictionaryEntry entry;
+        memcpy(&entry, data + sizeof(WordDictionaryHeader) + i * sizeof(WordDictionaryEntry), sizeof(entry));
+
+        size_t alphabetEnd = static_cast<size_t>(entry.alphabetOffset) + entry.symbolCount * sizeof(uint16_t);
+        size_t edgeEnd = static_cast<size_t>(entry.edgeOffset) + static_cast<size_t>(entry.edgeCount) * sizeof(uint32_t);
+        if (entry.symbolCount > DAWG_MAX_SYMBOLS || entry.edgeCount > DAWG_MAX_EDGES || alphabetEnd > size ||
+            edgeEnd > size || entry.alphabetOffset % 2 != 0 || entry.edgeOffset % 4 != 0)
+        {
+            m_languages.clear();
+            return false;
+        }
+
+        m_languages.emplace_back(entry, reinterpret_cast<const uint16_t *>(data + entry.alphabetOffset),
+                                 reinterpret_cast<const uint32_t *>(data + entry.edgeOffset));
+    }
+    return !m_languages.empty();
+}
+
+const WordDictionaryLanguage *WordDictionary::FindLanguage(uint16_t langId) const
+{
+    for (const WordDictionaryLanguage &language : m_languages)
+    {
+        if (language.LanguageId() == langId)
+        {
+            return &language;
+        }
+    }
+    return nullptr;
+}
+
+void WordDictionaryBuilder::AddWord(uint16_t langId, std::wstring_view word)
+{
+    if (word.empty() || word.size() > DAWG_MAX_WORD_LENGTH)
+    {
+        return;
+    }
+
+    std::wstring folded(word);
+    for (wchar_t &ch : folded)
+    {
+        ch = NgramFoldCase(ch);
+        if (static_cast<uint32_t>(ch) > 0xFFFF)
+        {
+            return;
+        }
+    }
+    m_words[langId].push_back(std::move(folded));
+}
+
+// The DAWG_MAX_SYMBOLS most frequent characters, sorted
+static std::vector<uint16_t> BuildAlphabet(const std::vector<std::wstring> &words)
+{
+    std::unordered_map<wchar_t, uint64_t> counts;
+    for (const std::wstring &word : words)
+    {
+        for (wchar_t ch : word)
+        {
+            counts[ch]++;
+        }
+    }
+
+    std::vector<std::pair<wchar_t, uint64_t>> ranked(counts.begin(), counts.end());
+    std::sort(ranked.begin(), ranked.end(), [](const auto &a, const auto &b)
+              { return a.second != b.second ? a.second > b.second : a.first < b.first; });
+    if (ranked.size() > DAWG_MAX_SYMBOLS)
+    {
+        ranked.resize(DAWG_MAX_SYMBOLS);
+    }
+
+    std::vector<uint16_t> alphabet;
+    for (const auto &entry : ranked)
+    {
+        alphabet.push_back(static_cast<uint16_t>(entry.first));
+    }
+    std::sort(alphabet.begin(), alphabet.end());
+    return alphabet;
+}
+
+namespace
+{
+    struct DawgNode
+    {
+        std::vector<std::pair<uint8_t, uint32_t>> edges;  // (symbol, child node), sorted by symbol
+        bool final = false;
+    };
+
+    // Minimal acyclic automaton built from sorted words in one pass
+    // (Daciuk et al. 2000): once a word is added, the nodes of the previous
+    // word past the shared prefix can no longer change, so each is replaced
+    // by an equivalent registered node or registered itself.
+    class DawgMinimizer
+    {
+    public:
+        DawgMinimizer() : m_nodes(1) { m_path.push_back(0); }
+
+        void Add(const std::vector<uint8_t> &symbols)
+        {
+            size_t prefix = 0;
+            while (prefix < symbols.size() && prefix < m_previous.size() && symbols[prefix] == m_previous[prefix])
+            {
+                prefix++;
+            }
+            Minimize(prefix);
+
+            for (size_t i = prefix; i < symbols.size(); i++)
+            {
+                uint32_t child = NewNode();
+                m_nodes[m_path.back()].edges.emplace_back(symbols[i], child);
+                m_path.push_back(child);
+            }
+            m_nodes[m_path.back()].final = true;
+            m_previous = symbols;
+        }
+
+        // Root of the finished automaton
+        uint32_t Finish()
+        {
+            Minimize(0);
+            return 0;
+        }
+
+        const DawgNode &Node(uint32_t index) const { return m_nodes[index]; }
+
+    private:
+        uint32_t NewNode()
+        {
+            if (!m_free.empty())
+            {
+                uint32_t index = m_free.back();
+                m_free.pop_back();
+                m_nodes[index] = DawgNode();
+                return index;
+            }
+            m_nodes.emplace_back();
+            return static_cast<uint32_t>(m_nodes.size() - 1);
+        }
+
+        // Freezes the path below depth, deepest node first
+        void Minimize(size_t depth)
+        {
+            while (m_path.size() > depth + 1)
+            {
+                uint32_t child = m_path.back();
+                m_path.pop_back();
+
+                std::string key = Signature(m_nodes[child]);
+                auto found = m_register.find(key);
+                if (found != m_register.end())
+                {
+                    m_nodes[m_path.back()].edges.back().second = found->second;
+                    m_nodes[child].edges.clear();
+                    m_free.push_back(child);
+                }
+                else
+                {
+                    m_register.emplace(std::move(key), child);
+                }
+            }
+        }
+
+        static std::string Signature(const DawgNode &node)
+        {
+            std::string key(1, node.final ? '1' : '0');
+            for (const auto &edge : node.edges)
+            {
+                key.push_back(static_cast<char>(edge.first));
+                key.append(reinterpret_cast<const char *>(&edge.second), sizeof(edge.second));
+            }
+            return key;
+        }
+
+        std::vector<DawgNode> m_nodes;
+        std::vector<uint32_t> m_free;
+        std::vector<uint32_t> m_path;  // Nodes along the previous word, root first
+        std::vector<uint8_t> m_previous;
+        std::unordered_map<std::string, uint32_t> m_register;
+    };
+}
+
+// Lays the automaton out as edge runs, root first. Returns false if it needs
+// more edges than a child index can address.
+static bool SerializeDawg(const DawgMinimizer &dawg, uint32_t root, std::vector<uint32_t> &edges, uint32_t &rootEdge)
+{
+    edges.assign(1, 0);
+    std::unordered_map<uint32_t, uint32_t> positions;  // Node -> first edge, for nodes with edges
+    std::vector<uint32_t> order;
+
+    // Breadth-first so the top of the graph, which every lookup touches, is contiguous
+    auto place = [&](uint32_t node)
+    {
+        const DawgNode &data = dawg.Node(node);
+        if (data.edges.empty() || positions.count(node))
+        {
+            return;
+        }
+        positions.emplace(node, static_cast<uint32_t>(edges.size()));
+        edges.resize(edges.size() + data.edges.size(), 0);
+        order.push_back(node);
+    };
+
+    place(root);
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        for (const auto &edge : dawg.Node(order[i]).edges)
+        {
+            place(edge.second);
+        }
+        if (edges.size() > DAWG_MAX_EDGES)
+        {
+            return false;
+        }
+    }
+
+    for (uint32_t node : order)
+    {
+        const DawgNode &data = dawg.Node(node);
+        uint32_t position = positions[node];
+        for (size_t i = 0; i < data.edges.size(); i++)
+        {
+            const DawgNode &child = dawg.Node(data.edges[i].second);
+            auto childPosition = positions.find(data.edges[i].second);
+            uint32_t edge = static_cast<uint32_t>(data.edges[i].first) << DAWG_SYMBOL_SHIFT;
+            edge |= childPosition != positions.end() ? childPosition->second : 0;
+            edge |= child.final ? DAWG_EDGE_FINAL : 0;
+            edge |= i + 1 == data.edges.size() ? DAWG_EDGE_LAST : 0;
+            edges[position + i] = edge;
+        }
+    }
+
+    rootEdge = order.empty() ? 0 : positions[root];
+    return true;
+}
+
+std::vector<uint8_t> WordDictionaryBuilder::Build() const
+{
+    std::vector<uint8_t> file(sizeof(WordDictionaryHeader) + m_words.size() * sizeof(WordDictionaryEntry), 0);
+
+    WordDictionaryHeader header;
+    memcpy(header.magic, "KBDW", 4);
+    header.version = WORD_DICTIONARY_VERSION;
+    header.languageCount = static_cast<uint16_t>(m_words.size());
+    memcpy(file.data(), &header, sizeof(header));
+
+    size_t index = 0;
+    for (const auto &language : m_words)
+    {
+        std::vector<std::wstring> words = language.second;
+        std::sort(words.begin(), words.end());
+        words.erase(std::unique(words.begin(), words.end()), words.end());
+
+        // Words with characters outside the alphabet cannot be looked up anyway
+        std::vector<uint16_t> alphabet = BuildAlphabet(words);
+        DawgMinimizer dawg;
+        uint32_t wordCount = 0;
+        std::vector<uint8_t> symbols;
+        for (const std::wstring &word : words)
+        {
+            symbols.clear();
+            for (wchar_t ch : word)
+            {
+                auto it = std::lower_bound(alphabet.begin(), alphabet.end(), static_cast<uint16_t>(ch));
+                if (it == alphabet.end() || *it != static_cast<uint16_t>(ch))
+                {
+                    break;
+                }
+                symbols.push_back(static_cast<uint8_t>(it - alphabet.begin()));
+            }
+            if (symbols.size() == word.size())
+            {
+                dawg.Add(symbols);
+                wordCount++;
+            }
+        }
+
+        std::vector<uint32_t> edges;
+        WordDictionaryEntry entry = {};
+        if (!SerializeDawg(dawg, dawg.Finish(), edges, entry.rootEdge))
+        {
+            return std::vector<uint8_t>();
+        }
+
+        entry.langId = language.first;
+        entry.symbolCount = static_cast<uint16_t>(alphabet.size());
+        entry.edgeCount = static_cast<uint32_t>(edges.size());
+        entry.wordCount = wordCount;
+
+        entry.alphabetOffset = static_cast<uint32_t>(file.size());
+        file.resize(AlignTo4(file.size() + alphabet.size() * sizeof(uint16_t)), 0);
+        memcpy(file.data() + entry.alphabetOffset, alphabet.data(), alphabet.size() * sizeof(uint16_t));
+
+        entry.edgeOffset = static_cast<uint32_t>(file.size());
+        file.resize(file.size() + edges.size() * sizeof(uint32_t), 0);
+        memcpy(file.data() + entry.edgeOffset, edges.data(), edges.size() * sizeof(uint32_t));
+
+        memcpy(file.data() + sizeof(WordDictionaryHeader) + index * sizeof(WordDictionaryEntry), &entry,
+               sizeof(entry));
+        index++;
+    }
+    return file;
+}
@@ -0,0 +1,140 @@
+// Checks model loading and wrong-layout scoring against a small model built
+// from the sample text below
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "layout_scorer.h"
+#include "ngram_model.h"
+
+static int s_failures = 0;
+
+#define CHECK(condition)                                                   \
+    do                                                                     \
+    {                                                                      \
+        if (!(condition))                                                  \
+        {                                                                  \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+            s_failures++;                                                  \
+        }                                                                  \
+    } while (0)
+
+static const wchar_t ENGLISH_SAMPLE[] =
+    L"the quick brown fox jumps over the lazy dog while people keep typing words on their keyboards "
+    L"hello world this is a short text written in english so that the model learns which letters "
+    L"usually follow each other when we write sentences about work school friends and the weather "
+    L"she said that the meeting was moved to tomorrow morning because everyone wanted more time "
+    L"please send me the report before lunch and thank you for your help with the question";
+
+static const wchar_t HEBREW_SAMPLE[] =
+    L"שלום עולם זהו טקסט לדוגמה בעברית שנועד לבנות מודל של אותיות אנחנו כותבים משפטים רבים "
+    L"כדי שהמודל ילמד אילו צירופי אותיות נפוצים בשפה העברית הילדים הלכו לבית הספר בבוקר "
+    L"והמורה סיפרה להם על ההיסטוריה של העיר ירושלים אחר כך הם שיחקו בחצר ואכלו ארוחת צהריים "
+    L"יחד עם החברים שלהם המחשב הזה עובד מהר מאוד אבל לפעמים המקלדת מוגדרת לשפה הלא נכונה "
+    L"תודה רבה על העזרה נתראה מחר בפגישה בבוקר";
+
+static std::vector<uint8_t> BuildSampleModel()
+{
+    NgramModelBuilder builder;
+    builder.AddText(LAYOUT_LANG_ENGLISH, ENGLISH_SAMPLE);
+    builder.AddText(LAYOUT_LANG_HEBREW, HEBREW_SAMPLE);
+    return builder.Build();
+}
+
+// Loads a copy, since LoadFromMemory wants 4-byte aligned data that outlives the model
+static bool LoadCopy(const std::vector<uint8_t> &data, size_t size)
+{
+    std::vector<uint32_t> aligned((size + 3) / 4);
+    memcpy(aligned.data(), data.data(), size);
+    NgramModel model;
+    return model.LoadFromMemory(reinterpret_cast<const uint8_t *>(aligned.data()), size);
+}
+
+static void TestLoadRejectsMalformedModels(const std::vector<uint8_t> &data)
+{
+    CHECK(LoadCopy(data, data.size()));
+
+    std::vector<uint8_t> badMagic = data;
+    badMagic[0] = 'X';
+    CHECK(!LoadCopy(badMagic, badMagic.size()));
+
+    // The last language's cost cube ends the file
+    CHECK(!LoadCopy(data, data.size() - 4));
+
+    std::vector<uint8_t> tooManySymbols = data;
+    NgramLanguageEntry entry;
+    memcpy(&entry, tooManySymbols.data() + sizeof(NgramModelHeader), sizeof(entry));
+    entry.symbolCount = NGRAM_MAX_SYMBOLS + 1;
+    memcpy(tooManySymbols.data() + sizeof(NgramModelHeader), &entry, sizeof(entry));
+    CHECK(!LoadCopy(tooManySymbols, tooManySymbols.size()));
+}
+
+// Margin of the keys that type word in layout typed over the other layout
+static double MarginOf(const NgramModel &model, const std::wstring &word, const LayoutTable &typed,
+                       const LayoutTable &other)
+{
+    LayoutScorer scorer;
+    scorer.SetLayouts({&typed, &other}, model);
+    for (wchar_t ch : word)
+    {
+        // Both built-in tables type these words without modifiers
+        bool found = false;
+        for (uint32_t vk = 0; vk < LayoutTable::KEY_COUNT && !found; vk++)
+        {
+            if (typed.Lookup(vk, LSS_BASE) == ch)
+            {
+                scorer.OnKey(KeyPressInfo(vk, ModifierFlags()));
+                found = true;
+            }
+        }
+        CHECK(found);
+    }
+    return scorer.ConfidenceMargin(0);
+}
+
+static void TestScoring(const NgramModel &model)
+{
+    LayoutTable us = LayoutTable::UsQwerty();
+    LayoutTable hebrew = LayoutTable::HebrewSi1452();
+
+    // "שלום" typed with the US layout active
+    CHECK(MarginOf(model, L"akuo", us, hebrew) > NGRAM_WRONG_LAYOUT_MARGIN);
+
+    const wchar_t *english[] = {L"hello", L"world", L"meeting", L"tomorrow", L"please", L"keyboard"};
+    for (const wchar_t *word : english)
+    {
+        CHECK(MarginOf(model, word, us, hebrew) < NGRAM_WRONG_LAYOUT_MARGIN);
+    }
+    const wchar_t *hebrewWords[] = {L"שלום", L"תודה", L"מחר", L"בבוקר", L"המקלדת", L"עברית"};
+    for (const wchar_t *word : hebrewWords)
+    {
+        CHECK(MarginOf(model, word, hebrew, us) < NGRAM_WRONG_LAYOUT_MARGIN);
+    }
+}
+
+static void TestNoModel()
+{
+    LayoutTable us = LayoutTable::UsQwerty();
+    LayoutTable hebrew = LayoutTable::HebrewSi1452();
+    NgramModel empty;
+    CHECK(!empty.IsLoaded());
+    CHECK(MarginOf(empty, L"akuo", us, hebrew) == 0.0);
+}
+
+int main()
+{
+    std::vector<uint8_t> data = BuildSampleModel();
+    TestLoadRejectsMalformedModels(data);
+
+    NgramModel model;
+    CHECK(model.LoadFromMemory(data.data(), data.size()));
+    TestScoring(model);
+    TestNoModel();
+
+    if (s_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,164 @@
+// Checks every vector kernel the CPU supports against the scalar kernel
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "script_classify.h"
+
+static int s_failures = 0;
+
+// Long enough for several AVX2 steps plus a tail, with UTF-16 and UTF-32 units
+static const size_t MAX_LENGTH = 80;
+static const int RANDOM_BUFFERS = 20000;
+
+// Units at the edges of each class, including ones whose low bits look like
+// another class when wchar_t is wider than 16 bits
+static std::vector<wchar_t> SampleUnits()
+{
+    std::vector<uint32_t> units = {0x20,  0x09,  0x0A,  0x0D,  0x00,  0x08,  0x0B,  0x0C,   0x0E,   0x1F,
+                                   0x21,  0x41,  0x7F,  0x80,  0xFF,  0x100, 0x58F, 0x590,  0x5D0,  0x5FF,
+                                   0x600, 0x7FF, 0x800, 0x2020, 0x8000, 0x8020, 0xFFFF};
+    if (sizeof(wchar_t) == 4)
+    {
+        const uint32_t wide[] = {0x10000, 0x10020, 0x10041, 0x10590, 0x7FFFFFFF, 0x80000000, 0x80000020, 0xFFFFFFFF};
+        units.insert(units.end(), wide, wide + sizeof(wide) / sizeof(wide[0]));
+    }
+
+    std::vector<wchar_t> samples;
+    for (uint32_t unit : units)
+    {
+        samples.push_back(static_cast<wchar_t>(unit));
+    }
+    return samples;
+}
+
+static unsigned ClassOf(wchar_t unit)
+{
+    return ClassifyCodeUnit(static_cast<uint32_t>(unit));
+}
+
+static void ExpectSame(ScriptKernel kernel, const wchar_t *text, size_t length, unsigned allowedClasses)
+{
+    size_t expected = FindFirstOutsideClasses(text, length, allowedClasses, SCRIPT_KERNEL_SCALAR);
+    size_t actual = FindFirstOutsideClasses(text, length, allowedClasses, kernel);
+    if (actual != expected)
+    {
+        // Only the first few, a broken kernel fails almost every case
+        if (s_failures < 20)
+        {
+            fprintf(stderr, "%s: length %zu, allowed 0x%x: got %zu, scalar %zu\n", ScriptKernelName(kernel), length,
+                    allowedClasses, actual, expected);
+        }
+        s_failures++;
+    }
+}
+
+// One unit outside the allowed classes planted at every offset of every
+// length, so the hit lands in each lane, each vector of a step and the tail
+static void TestPlanted(ScriptKernel kernel, const std::vector<wchar_t> &samples)
+{
+    // One spare unit in front so the buffer also starts unaligned
+    std::vector<wchar_t> buffer(MAX_LENGTH + 1);
+    for (unsigned allowed = 0; allowed < (1u << 4); allowed++)
+    {
+        std::vector<wchar_t> inside;
+        std::vector<wchar_t> outside;
+        for (wchar_t unit : samples)
+        {
+            (ClassOf(unit) & allowed ? inside : outside).push_back(unit);
+        }
+
+        for (size_t shift = 0; shift < 2; shift++)
+        {
+            wchar_t *text = buffer.data() + shift;
+            for (size_t length = 0; length <= MAX_LENGTH; length++)
+            {
+                if (inside.empty())
+                {
+                    for (size_t i = 0; i < length; i++)
+                    {
+                        text[i] = outside[i % outside.size()];
+                    }
+                    ExpectSame(kernel, text, length, allowed);
+                    continue;
+                }
+
+                for (size_t i = 0; i < length; i++)
+                {
+                    text[i] = inside[i % inside.size()];
+                }
+                ExpectSame(kernel, text, length, allowed);
+
+                for (size_t offset = 0; offset < length; offset++)
+                {
+                    for (wchar_t unit : outside)
+                    {
+                        wchar_t saved = text[offset];
+                        text[offset] = unit;
+                        ExpectSame(kernel, text, length, allowed);
+                        text[offset] = saved;
+                    }
+                }
+            }
+        }
+    }
+}
+
+// Mixed buffers drawn mostly from allowed units, with a fixed seed so a
+// failure can be reproduced
+static void TestRandom(ScriptKernel kernel, const std::vector<wchar_t> &samples)
+{
+    std::mt19937 random(12345);
+    std::vector<wchar_t> buffer(MAX_LENGTH);
+    for (int round = 0; round < RANDOM_BUFFERS; round++)
+    {
+        unsigned allowed = random() % (1u << 4);
+        size_t length = random() % (MAX_LENGTH + 1);
+        for (size_t i = 0; i < length; i++)
+        {
+            // Rarely a raw random unit, otherwise a sample that is usually allowed
+            if (random() % 16 == 0)
+            {
+                buffer[i] = static_cast<wchar_t>(random());
+                continue;
+            }
+            wchar_t unit = samples[random() % samples.size()];
+            for (int tries = 0; tries < 8 && !(ClassOf(unit) & allowed); tries++)
+            {
+                unit = samples[random() % samples.size()];
+            }
+            buffer[i] = unit;
+        }
+        ExpectSame(kernel, buffer.data(), length, allowed);
+    }
+}
+
+int main()
+{
+    std::vector<wchar_t> samples = SampleUnits();
+    int tested = 0;
+    for (int kernel = SCRIPT_KERNEL_SCALAR + 1; kernel < SCRIPT_KERNEL_COUNT; kernel++)
+    {
+        ScriptKernel current = static_cast<ScriptKernel>(kernel);
+        if (!IsScriptKernelSupported(current))
+        {
+            printf("%s: not supported, skipped\n", ScriptKernelName(current));
+            continue;
+        }
+        TestPlanted(current, samples);
+        TestRandom(current, samples);
+        printf("%s: compared with scalar\n", ScriptKernelName(current));
+        tested++;
+    }
+
+    if (tested == 0)
+    {
+        printf("No vector kernel on this CPU; nothing to compare\n");
+    }
+    if (s_failures != 0)
+    {
+        fprintf(stderr, "%d checks failed\n", s_failures);
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,508 @@
+// kbconvert: fixes text files where words were typed in the wrong keyboard
+// layout, checking every word the way the detection engine checks a typed one
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detection_engine.h"
+#include "engine_setup.h"
+#include "mapped_file.h"
+#include "text_corrector.h"
+
+// Input is converted in pieces of about this size, split after whitespace
+const size_t DEFAULT_CONVERT_CHUNK_MB = 4;
+
+// How far past the chunk size a split looks for whitespace before cutting
+// between two characters instead
+const size_t CONVERT_SPLIT_SCAN_BYTES = 1 << 20;
+
+// Longer runs without whitespace (URLs, encoded data) pass through unchecked
+const size_t CONVERT_MAX_WORD = DEFAULT_COMPOSE_WINDOW;
+
+enum TextEncoding
+{
+    TEXT_UTF8,
+    TEXT_UTF16LE,
+    TEXT_UTF16BE
+};
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbconvert [--layouts <pack.kblp>] [--model <model.kbng>] [--dict <words.kbdw>]\n"
+                    "                 [--min-length <n>] [--threads <n>] [--chunk-mb <n>] [-o <output>] <input>\n"
+                    "  input is UTF-8, or UTF-16 with a byte order mark; the output keeps its encoding\n"
+                    "  --layouts   layout pack to use instead of the built-in en and he tables\n"
+                    "  --min-length  shortest word checked, in characters; default 3, as when typing\n"
+                    "  --threads   converter threads; default is one per CPU\n"
+                    "  --chunk-mb  size of the pieces threads take, default 4; memory use is about 3 pieces per thread\n"
+                    "  -o          output file; default is stdout\n");
+}
+
+static bool IsWhitespaceUnit(uint32_t unit)
+{
+    return unit == ' ' || unit == '\t' || unit == '\n' || unit == '\r';
+}
+
+// Reads text in its encoding one code unit at a time
+class UnitReader
+{
+public:
+    UnitReader(const uint8_t *data, TextEncoding encoding)
+        : m_data(data), m_encoding(encoding), m_unitSize(encoding == TEXT_UTF8 ? 1 : 2)
+    {
+    }
+
+    size_t UnitSize() const { return m_unitSize; }
+
+    uint32_t Unit(size_t offset) const
+    {
+        switch (m_encoding)
+        {
+        case TEXT_UTF16LE:
+            return m_data[offset] | (m_data[offset + 1] << 8);
+        case TEXT_UTF16BE:
+            return (m_data[offset] << 8) | m_data[offset + 1];
+        default:
+            return m_data[offset];
+        }
+    }
+
+    // Whether a chunk may start at offset without splitting a character
+    bool IsCharacterStart(size_t offset) const
+    {
+        uint32_t unit = Unit(offset);
+        return m_encoding == TEXT_UTF8 ? (unit & 0xC0) != 0x80 : (unit < 0xDC00 || unit > 0xDFFF);
+    }
+
+private:
+    const uint8_t *m_data;
+    TextEncoding m_encoding;
+    size_t m_unitSize;
+};
+
+struct Chunk
+{
+    size_t begin;
+    size_t end;
+};
+
+// Splits [begin, size) into chunks that end just after whitespace, so no
+// word is split unless a run without whitespace is very long
+static void SplitText(const UnitReader &reader, size_t begin, size_t size, size_t chunkBytes, std::vector<Chunk> &chunks)
+{
+    size_t unit = reader.UnitSize();
+    size_t usable = begin + (size - begin) / unit * unit;
+    while (begin < usable)
+    {
+        size_t split = begin + std::min(chunkBytes / unit * unit, usable - begin);
+        if (split < usable)
+        {
+            size_t limit = std::min(usable, split + CONVERT_SPLIT_SCAN_BYTES);
+            size_t scan = split;
+            while (scan < limit && !IsWhitespaceUnit(reader.Unit(scan)))
+            {
+                scan += unit;
+            }
+            if (scan < limit)
+            {
+                split = scan + unit;
+            }
+            else
+            {
+                while (split < usable && !reader.IsCharacterStart(split))
+                {
+                    split += unit;
+                }
+            }
+        }
+        chunks.push_back({begin, split});
+        begin = split;
+    }
+
+    // An odd trailing byte of UTF-16 is kept as it is
+    if (usable < size)
+    {
+        chunks.push_back({usable, size});
+    }
+}
+
+// Decodes one word; false if it has characters no layout table holds
+static bool DecodeWord(const uint8_t *data, size_t length, TextEncoding encoding, std::wstring &word)
+{
+    word.clear();
+    if (encoding != TEXT_UTF8)
+    {
+        UnitReader reader(data, encoding);
+        for (size_t i = 0; i + 1 < length; i += 2)
+        {
+            uint32_t unit = reader.Unit(i);
+            if (unit >= 0xD800 && unit <= 0xDFFF)
+            {
+                return false;
+            }
+            word.push_back(static_cast<wchar_t>(unit));
+        }
+        return length % 2 == 0;
+    }
+
+    // Tables only hold the BMP, so longer sequences and malformed ones end the check
+    size_t i = 0;
+    while (i < length)
+    {
+        uint8_t lead = data[i];
+        uint32_t cp;
+        size_t count;
+        if (lead < 0x80)
+        {
+            cp = lead;
+            count = 1;
+        }
+        else if ((lead & 0xE0) == 0xC0)
+        {
+            cp = lead & 0x1F;
+            count = 2;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            cp = lead & 0x0F;
+            count = 3;
+        }
+        else
+        {
+            return false;
+        }
+        if (i + count > length)
+        {
+            return false;
+        }
+        for (size_t k = 1; k < count; k++)
+        {
+            if ((data[i + k] & 0xC0) != 0x80)
+            {
+                return false;
+            }
+            cp = (cp << 6) | (data[i + k] & 0x3F);
+        }
+        if (cp >= 0xD800 && cp <= 0xDFFF)
+        {
+            return false;
+        }
+        word.push_back(static_cast<wchar_t>(cp));
+        i += count;
+    }
+    return true;
+}
+
+static void EncodeWord(std::wstring_view word, TextEncoding encoding, std::string &out)
+{
+    for (wchar_t ch : word)
+    {
+        uint32_t cp = static_cast<uint32_t>(ch);
+        if (encoding == TEXT_UTF16LE)
+        {
+            out.push_back(static_cast<char>(cp & 0xFF));
+            out.push_back(static_cast<char>(cp >> 8));
+        }
+        else if (encoding == TEXT_UTF16BE)
+        {
+            out.push_back(static_cast<char>(cp >> 8));
+            out.push_back(static_cast<char>(cp & 0xFF));
+        }
+        else if (cp < 0x80)
+        {
+            out.push_back(static_cast<char>(cp));
+        }
+        else if (cp < 0x800)
+        {
+            out.push_back(static_cast<char>(0xC0 | (cp >> 6)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+        else
+        {
+            out.push_back(static_cast<char>(0xE0 | (cp >> 12)));
+            out.push_back(static_cast<char>(0x80 | ((cp >> 6) & 0x3F)));
+            out.push_back(static_cast<char>(0x80 | (cp & 0x3F)));
+        }
+    }
+}
+
+// One converter thread's engine and buffers
+struct ConvertWorker
+{
+    DetectionEngine engine;
+    std::unique_ptr<TextCorrector> corrector;
+    std::wstring word;
+    std::string output;
+    uint64_t words = 0;
+};
+
+// Converts a chunk into worker.output. Text is copied through untouched
+// except for the words that are corrected.
+static void ConvertChunk(const uint8_t *data, const Chunk &chunk, TextEncoding encoding, ConvertWorker &worker)
+{
+    UnitReader reader(data, encoding);
+    size_t unit = reader.UnitSize();
+    std::string &out = worker.output;
+    out.clear();
+
+    size_t copied = chunk.begin;
+    size_t pos = chunk.begin;
+    size_t end = chunk.begin + (chunk.end - chunk.begin) / unit * unit;
+    while (pos < end)
+    {
+        while (pos < end && IsWhitespaceUnit(reader.Unit(pos)))
+        {
+            pos += unit;
+        }
+        size_t wordBegin = pos;
+        while (pos < end && !IsWhitespaceUnit(reader.Unit(pos)))
+        {
+            pos += unit;
+        }
+        if (pos == wordBegin)
+        {
+            break;
+        }
+        worker.words++;
+
+        if ((pos - wordBegin) / unit > CONVERT_MAX_WORD ||
+            !DecodeWord(data + wordBegin, pos - wordBegin, encoding, worker.word))
+        {
+            continue;
+        }
+        std::wstring_view corrected = worker.corrector->CorrectWord(worker.word);
+        if (corrected.empty())
+        {
+            continue;
+        }
+        out.append(reinterpret_cast<const char *>(data + copied), wordBegin - copied);
+        EncodeWord(corrected, encoding, out);
+        copied = pos;
+    }
+    out.append(reinterpret_cast<const char *>(data + copied), chunk.end - copied);
+}
+
+int main(int argc, char *argv[])
+{
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t chunkBytes = DEFAULT_CONVERT_CHUNK_MB << 20;
+    size_t minLength = DEFAULT_MIN_TEXT_LENGTH;
+    std::string packPath;
+    std::string modelPath;
+    std::string dictionaryPath;
+    const char *outputPath = nullptr;
+    const char *inputPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--chunk-mb") == 0 && i + 1 < argc)
+        {
+            chunkBytes = static_cast<size_t>(std::max(1, atoi(argv[++i]))) << 20;
+        }
+        else if (strcmp(argv[i], "--min-length") == 0 && i + 1 < argc)
+        {
+            minLength = static_cast<size_t>(std::max(1, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--layouts") == 0 && i + 1 < argc)
+        {
+            packPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            modelPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dict") == 0 && i + 1 < argc)
+        {
+            dictionaryPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (argv[i][0] != '-' && !inputPath)
+        {
+            inputPath = argv[i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!inputPath)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    std::vector<LayoutTable> layouts;
+    if (!LoadLayouts(packPath, layouts))
+    {
+        return 1;
+    }
+
+    MappedFile input;
+    if (!input.Open(inputPath))
+    {
+        fprintf(stderr, "Cannot read %s\n", inputPath);
+        return 1;
+    }
+    std::error_code ec;
+    if (outputPath && std::filesystem::equivalent(inputPath, outputPath, ec))
+    {
+        fprintf(stderr, "The output must not be the input\n");
+        return 1;
+    }
+    input.AdviseSequential();
+
+    const uint8_t *data = input.Data();
+    size_t size = input.Size();
+    TextEncoding encoding = TEXT_UTF8;
+    size_t bom = 0;
+    if (size >= 3 && data[0] == 0xEF && data[1] == 0xBB && data[2] == 0xBF)
+    {
+        bom = 3;
+    }
+    else if (size >= 2 && data[0] == 0xFF && data[1] == 0xFE)
+    {
+        encoding = TEXT_UTF16LE;
+        bom = 2;
+    }
+    else if (size >= 2 && data[0] == 0xFE && data[1] == 0xFF)
+    {
+        encoding = TEXT_UTF16BE;
+        bom = 2;
+    }
+
+    std::vector<Chunk> chunks;
+    SplitText(UnitReader(data, encoding), bom, size, chunkBytes, chunks);
+
+    // Every thread checks words with an engine of its own; the model and
+    // dictionary mappings are shared by the OS
+    threadCount = std::min(threadCount, std::max<size_t>(chunks.size(), 1));
+    std::vector<std::unique_ptr<ConvertWorker>> workers;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        workers.emplace_back(new ConvertWorker());
+        DetectionEngine &engine = workers.back()->engine;
+        if (!ConfigureEngine(engine, layouts, modelPath, dictionaryPath, minLength, t == 0))
+        {
+            return 1;
+        }
+        workers.back()->corrector.reset(new TextCorrector(engine));
+    }
+
+    FILE *out = outputPath ? fopen(outputPath, "wb") : stdout;
+    if (!out)
+    {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+
+    // The byte order mark is kept as it is
+    bool failed = fwrite(data, 1, bom, out) != bom;
+
+    // Threads take chunks in order but may finish out of order. Finished
+    // chunks wait in a window of slots for the writer, and no thread gets
+    // more than the window ahead of it, which bounds memory on any input.
+    struct Slot
+    {
+        std::string output;
+        bool ready = false;
+    };
+    size_t window = threadCount * 2;
+    std::vector<Slot> slots(window);
+    std::mutex mutex;
+    std::condition_variable changed;
+    size_t nextChunk = 0;
+    size_t written = 0;
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < threadCount; t++)
+    {
+        threads.emplace_back([&, t]()
+        {
+            ConvertWorker &worker = *workers[t];
+            for (;;)
+            {
+                size_t index;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    changed.wait(lock, [&]() { return failed || nextChunk >= chunks.size() || nextChunk < written + window; });
+                    if (failed || nextChunk >= chunks.size())
+                    {
+                        return;
+                    }
+                    index = nextChunk++;
+                }
+                ConvertChunk(data, chunks[index], encoding, worker);
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    Slot &slot = slots[index % window];
+                    slot.output.swap(worker.output);
+                    slot.ready = true;
+                }
+                changed.notify_all();
+            }
+        });
+    }
+
+    std::string pending;
+    for (size_t i = 0; i < chunks.size() && !failed; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            Slot &slot = slots[i % window];
+            changed.wait(lock, [&]() { return slot.ready; });
+            pending.swap(slot.output);
+            slot.ready = false;
+            written = i + 1;
+        }
+        changed.notify_all();
+        if (fwrite(pending.data(), 1, pending.size(), out) != pending.size())
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+        }
+    }
+    changed.notify_all();
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    if ((outputPath ? fclose(out) : fflush(out)) != 0 || failed)
+    {
+        fprintf(stderr, "Cannot write %s\n", outputPath ? outputPath : "the output");
+        return 1;
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    uint64_t words = 0;
+    uint64_t checked = 0;
+    uint64_t corrected = 0;
+    for (const auto &worker : workers)
+    {
+        words += worker->words;
+        checked += worker->engine.WordsChecked();
+        corrected += worker->corrector->WordsCorrected();
+    }
+    fprintf(stderr, "%.1f MB in %.2f s (%.1f MB/s, %zu threads), %llu words, %llu checked, %llu corrected\n",
+            static_cast<double>(size) / 1e6, elapsed, elapsed > 0 ? static_cast<double>(size) / 1e6 / elapsed : 0.0,
+            threadCount, static_cast<unsigned long long>(words), static_cast<unsigned long long>(checked),
+            static_cast<unsigned long long>(corrected));
+    return 0;
+}
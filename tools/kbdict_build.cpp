@@ -0,0 +1,134 @@
+// kbdict-build: compiles word lists into the dictionary file used to confirm wrong-layout words
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "utf8_decode.h"
+#include "word_dictionary.h"
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbdict-build -o <dictionary.kbdw> <langId>=<words.txt>...\n"
+                    "  langId is the primary language ID, e.g. 0x09 for English, 0x0D for Hebrew\n"
+                    "  word lists are UTF-8, one word per line; anything after the word on a line\n"
+                    "  (e.g. a frequency count) is ignored\n");
+}
+
+static bool IsSpace(wchar_t ch)
+{
+    return ch == L' ' || ch == L'\t' || ch == L'\r' || ch == L'\n';
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+    WordDictionaryBuilder builder;
+    int listCount = 0;
+    auto started = std::chrono::steady_clock::now();
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+            continue;
+        }
+
+        const char *separator = strchr(argv[i], '=');
+        if (!separator)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        char *end = nullptr;
+        unsigned long langId = strtoul(argv[i], &end, 0);
+        if (end != separator || langId == 0 || langId > 0x3FF)
+        {
+            fprintf(stderr, "Invalid language ID in '%s'\n", argv[i]);
+            return 1;
+        }
+
+        MappedFile list;
+        if (!list.Open(separator + 1))
+        {
+            fprintf(stderr, "Cannot read %s\n", separator + 1);
+            return 1;
+        }
+        std::wstring text = DecodeUtf8(list.Data(), list.Size());
+
+        size_t words = 0;
+        size_t pos = 0;
+        while (pos < text.size())
+        {
+            size_t lineEnd = text.find(L'\n', pos);
+            if (lineEnd == std::wstring::npos)
+            {
+                lineEnd = text.size();
+            }
+            size_t start = pos;
+            while (start < lineEnd && IsSpace(text[start]))
+            {
+                start++;
+            }
+            size_t stop = start;
+            while (stop < lineEnd && !IsSpace(text[stop]))
+            {
+                stop++;
+            }
+            if (stop > start)
+            {
+                builder.AddWord(static_cast<uint16_t>(langId), std::wstring_view(text).substr(start, stop - start));
+                words++;
+            }
+            pos = lineEnd + 1;
+        }
+        printf("0x%02lx: %s, %zu words\n", langId, separator + 1, words);
+        listCount++;
+    }
+
+    if (!outputPath || listCount == 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<uint8_t> dictionary = builder.Build();
+    if (dictionary.empty())
+    {
+        fprintf(stderr, "Word lists too large: a language needs more than %u DAWG edges\n", DAWG_MAX_EDGES);
+        return 1;
+    }
+
+    FILE *out = fopen(outputPath, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+    size_t written = fwrite(dictionary.data(), 1, dictionary.size(), out);
+    fclose(out);
+    if (written != dictionary.size())
+    {
+        fprintf(stderr, "Failed writing %s\n", outputPath);
+        return 1;
+    }
+
+    // Report what each language compiled to
+    WordDictionaryHeader header;
+    memcpy(&header, dictionary.data(), sizeof(header));
+    for (uint16_t i = 0; i < header.languageCount; i++)
+    {
+        WordDictionaryEntry entry;
+        memcpy(&entry, dictionary.data() + sizeof(header) + i * sizeof(entry), sizeof(entry));
+        printf("0x%02x: %u words, %u symbols, %u edges (%zu bytes)\n", entry.langId, entry.wordCount,
+               entry.symbolCount, entry.edgeCount, static_cast<size_t>(entry.edgeCount) * sizeof(uint32_t));
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+    printf("Wrote %s (%zu bytes) in %.2f s\n", outputPath, dictionary.size(), seconds);
+    return 0;
+}
@@ -0,0 +1,105 @@
+// kblayout-pack: writes the built-in layouts to a layout pack, or lists a pack
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "layout_pack.h"
+#include "logger.h"
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kblayout-pack -o <layouts.kblp> [en] [he]\n"
+                    "       kblayout-pack --list <layouts.kblp>\n"
+                    "  -o      packs the named built-in layouts, by default all of them\n"
+                    "  --list  checks a pack and prints its layouts and load time\n");
+}
+
+static int ListPack(const char *path)
+{
+    auto started = std::chrono::steady_clock::now();
+    LayoutPack pack;
+    if (!pack.Load(path))
+    {
+        fprintf(stderr, "%s is not a valid layout pack\n", path);
+        return 1;
+    }
+    std::vector<LayoutTable> layouts;
+    for (size_t i = 0; i < pack.LayoutCount(); i++)
+    {
+        layouts.push_back(pack.Layout(i));
+    }
+    double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - started).count();
+
+    for (size_t i = 0; i < layouts.size(); i++)
+    {
+        const LayoutTable &table = layouts[i];
+        size_t keys = 0;
+        size_t deadKeys = 0;
+        for (uint32_t vk = 0; vk < LayoutTable::KEY_COUNT; vk++)
+        {
+            for (uint8_t s = 0; s < LSS_COUNT; s++)
+            {
+                const LayoutEntry &entry = table.Entry(vk, static_cast<LayoutShiftState>(s));
+                keys += entry.ch != 0 ? 1 : 0;
+                deadKeys += (entry.flags & LAYOUT_ENTRY_DEAD) ? 1 : 0;
+            }
+        }
+        char name[LAYOUT_PACK_MAX_NAME * 4 + 1];
+        name[AppendUtf8(name, 0, sizeof(name) - 1, table.Name().c_str())] = '\0';
+        printf("%zu: %s (lang 0x%02x, id 0x%llx): %zu keys, %zu dead keys, %zu combos\n", i, name,
+               table.LanguageId(), static_cast<unsigned long long>(pack.SystemId(i)), keys, deadKeys,
+               table.DeadKeyCombos().size());
+    }
+    printf("Loaded %zu layouts in %.1f us\n", layouts.size(), micros);
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && strcmp(argv[1], "--list") == 0)
+    {
+        return ListPack(argv[2]);
+    }
+
+    const char *outputPath = nullptr;
+    std::vector<std::string> names;
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "en") == 0 || strcmp(argv[i], "he") == 0)
+        {
+            names.push_back(argv[i]);
+        }
+        else
+        {
+            PrintUsage();
+            return 1;
+        }
+    }
+    if (!outputPath)
+    {
+        PrintUsage();
+        return 1;
+    }
+    if (names.empty())
+    {
+        names = {"en", "he"};
+    }
+
+    LayoutPackBuilder builder;
+    for (const std::string &name : names)
+    {
+        builder.Add(name == "en" ? LayoutTable::UsQwerty() : LayoutTable::HebrewSi1452());
+    }
+    if (!builder.Write(outputPath))
+    {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+    printf("Wrote %zu layouts to %s\n", names.size(), outputPath);
+    return 0;
+}
@@ -0,0 +1,226 @@
+// kblog-decode: converts binary logs back to the text log format, CSV or JSON lines
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "logger.h"
+#include "log_binary.h"
+
+enum OutputFormat
+{
+    OUTPUT_TEXT,
+    OUTPUT_CSV,
+    OUTPUT_JSON
+};
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kblog-decode [--format text|csv|json] <file.kblog>...\n");
+}
+
+static bool ReadFile(const char *path, std::vector<uint8_t> &data)
+{
+    std::ifstream file(path, std::ios::binary);
+    if (!file)
+    {
+        return false;
+    }
+    data.assign((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+    return true;
+}
+
+// Writes text as a quoted CSV field
+static void WriteCsvField(FILE *out, const char *text, size_t length)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++)
+    {
+        if (text[i] == '"')
+        {
+            fputc('"', out);
+        }
+        fputc(text[i], out);
+    }
+    fputc('"', out);
+}
+
+// Writes text as a JSON string literal
+static void WriteJsonString(FILE *out, const char *text, size_t length)
+{
+    fputc('"', out);
+    for (size_t i = 0; i < length; i++)
+    {
+        unsigned char ch = static_cast<unsigned char>(text[i]);
+        switch (ch)
+        {
+        case '"':
+            fputs("\\\"", out);
+            break;
+        case '\\':
+            fputs("\\\\", out);
+            break;
+        case '\n':
+            fputs("\\n", out);
+            break;
+        case '\r':
+            fputs("\\r", out);
+            break;
+        case '\t':
+            fputs("\\t", out);
+            break;
+        default:
+            if (ch < 0x20)
+            {
+                fprintf(out, "\\u%04x", ch);
+            }
+            else
+            {
+                fputc(ch, out);
+            }
+        }
+    }
+    fputc('"', out);
+}
+
+static void WriteEvent(FILE *out, OutputFormat format, const BinaryLogEvent &event)
+{
+    char time[64];
+    FormatLogTime(time, sizeof(time), event.timestampUs);
+    bool isSession = event.tag == BINLOG_TAG_SESSION;
+    const char *level = isSession ? "" : LogLevelToString(static_cast<LogLevel>(event.level));
+
+    switch (format)
+    {
+    case OUTPUT_TEXT:
+        if (isSession)
+        {
+            fputs(LOG_SESSION_SEPARATOR, out);
+        }
+        else
+        {
+            fprintf(out, "%s [%s] [%.*s:%.*s] [%u] %.*s" LOG_LINE_END, time, level,
+                    static_cast<int>(event.site->fileLength), event.site->file,
+                    static_cast<int>(event.site->functionLength), event.site->function,
+                    event.site->line,
+                    static_cast<int>(event.messageLength), event.message);
+        }
+        break;
+
+    case OUTPUT_CSV:
+        fprintf(out, "%s,%lld,%s,%s,", isSession ? "session" : "log",
+                static_cast<long long>(event.timestampUs), time, level);
+        if (!isSession)
+        {
+            WriteCsvField(out, event.site->file, event.site->fileLength);
+            fputc(',', out);
+            WriteCsvField(out, event.site->function, event.site->functionLength);
+            fprintf(out, ",%u,", event.site->line);
+            WriteCsvField(out, event.message, event.messageLength);
+        }
+        else
+        {
+            fputs(",,,", out);
+        }
+        fputc('\n', out);
+        break;
+
+    case OUTPUT_JSON:
+        fprintf(out, "{\"event\":\"%s\",\"timestamp_us\":%lld,\"time\":\"%s\"",
+                isSession ? "session" : "log", static_cast<long long>(event.timestampUs), time);
+        if (!isSession)
+        {
+            fprintf(out, ",\"level\":\"%s\",\"file\":", level);
+            WriteJsonString(out, event.site->file, event.site->fileLength);
+            fputs(",\"function\":", out);
+            WriteJsonString(out, event.site->function, event.site->functionLength);
+            fprintf(out, ",\"line\":%u,\"message\":", event.site->line);
+            WriteJsonString(out, event.message, event.messageLength);
+        }
+        fputs("}\n", out);
+        break;
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    OutputFormat format = OUTPUT_TEXT;
+    std::vector<const char *> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--format") == 0 && i + 1 < argc)
+        {
+            const char *name = argv[++i];
+            if (strcmp(name, "text") == 0)
+            {
+                format = OUTPUT_TEXT;
+            }
+            else if (strcmp(name, "csv") == 0)
+            {
+                format = OUTPUT_CSV;
+            }
+            else if (strcmp(name, "json") == 0)
+            {
+                format = OUTPUT_JSON;
+            }
+            else
+            {
+                PrintUsage();
+                return 1;
+            }
+        }
+        else if (argv[i][0] == '-')
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            files.push_back(argv[i]);
+        }
+    }
+
+    if (files.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    if (format == OUTPUT_CSV)
+    {
+        printf("event,timestamp_us,time,level,file,function,line,message\n");
+    }
+
+    int result = 0;
+    std::vector<uint8_t> data;
+    for (const char *path : files)
+    {
+        if (!ReadFile(path, data))
+        {
+            fprintf(stderr, "kblog-decode: cannot read %s\n", path);
+            result = 1;
+            continue;
+        }
+
+        BinaryLogReader reader(data.data(), data.size());
+        if (!reader.IsValid())
+        {
+            fprintf(stderr, "kblog-decode: %s is not a binary log\n", path);
+            result = 1;
+            continue;
+        }
+
+        BinaryLogEvent event;
+        while (reader.Next(event))
+        {
+            WriteEvent(stdout, format, event);
+        }
+        if (!reader.IsValid())
+        {
+            fprintf(stderr, "kblog-decode: %s is truncated or corrupt\n", path);
+            result = 1;
+        }
+    }
+    return result;
+}
@@ -0,0 +1,556 @@
+// kblog-stats: summarizes text logs per session and per function
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "latency_histogram.h"
+#include "logger.h"
+#include "mapped_file.h"
+
+// Files are parsed in pieces of about this size, split at line boundaries
+const size_t LOG_STATS_CHUNK_BYTES = 16 << 20;
+
+// "YYYY-mm-dd HH:MM:SS.mmm"
+const size_t LOG_TIME_LENGTH = 23;
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kblog-stats [--threads <n>] [--top <n>] [--by-session] <keyboard_checker.log>...\n"
+                    "  files are read as one log, in the order given, so pass rotated segments oldest first\n"
+                    "  --threads   parser threads; default is one per CPU\n"
+                    "  --top       functions listed, by line count; default 20, 0 lists all\n"
+                    "  --by-session  lists functions for every session as well as for the whole log\n");
+}
+
+// Started/Ended durations in milliseconds, bucketed like LatencyHistogram
+// but without its per-thread shards, which would be far too large per function
+struct DurationStats
+{
+    uint64_t count = 0;
+    uint64_t sumMs = 0;
+    uint64_t maxMs = 0;
+    std::vector<uint64_t> buckets;
+
+    void Record(uint64_t ms)
+    {
+        if (buckets.empty())
+        {
+            buckets.resize(LATENCY_BUCKET_COUNT);
+        }
+        buckets[LatencyHistogram::BucketIndex(ms)]++;
+        count++;
+        sumMs += ms;
+        maxMs = std::max(maxMs, ms);
+    }
+
+    void Merge(const DurationStats &other)
+    {
+        if (other.count == 0)
+        {
+            return;
+        }
+        if (buckets.empty())
+        {
+            buckets.resize(LATENCY_BUCKET_COUNT);
+        }
+        for (size_t i = 0; i < LATENCY_BUCKET_COUNT; i++)
+        {
+            buckets[i] += other.buckets[i];
+        }
+        count += other.count;
+        sumMs += other.sumMs;
+        maxMs = std::max(maxMs, other.maxMs);
+    }
+
+    uint64_t Percentile(double fraction) const
+    {
+        uint64_t target = static_cast<uint64_t>(fraction * static_cast<double>(count));
+        uint64_t seen = 0;
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            seen += buckets[i];
+            if (seen > target)
+            {
+                return std::min(LatencyHistogram::BucketHighest(i), maxMs);
+            }
+        }
+        return maxMs;
+    }
+};
+
+struct FunctionStats
+{
+    uint64_t lines = 0;
+    uint64_t warnings = 0;
+    uint64_t errors = 0;
+    uint64_t starts = 0;
+    DurationStats durations;
+    std::vector<int64_t> openStarts;  // Started with no Ended yet, innermost last
+    std::vector<int64_t> orphanEnds;  // Ended before any Started in this piece
+
+    void Started(int64_t ms)
+    {
+        starts++;
+        openStarts.push_back(ms);
+    }
+
+    void Ended(int64_t ms)
+    {
+        if (openStarts.empty())
+        {
+            orphanEnds.push_back(ms);
+            return;
+        }
+        durations.Record(static_cast<uint64_t>(std::max<int64_t>(ms - openStarts.back(), 0)));
+        openStarts.pop_back();
+    }
+
+    // Appends the stats of the piece of log that follows this one in the
+    // same session, pairing its early Ended lines with Started lines here
+    void Append(const FunctionStats &next)
+    {
+        AddCounts(next);
+        for (int64_t end : next.orphanEnds)
+        {
+            Ended(end);
+        }
+        openStarts.insert(openStarts.end(), next.openStarts.begin(), next.openStarts.end());
+    }
+
+    // Adds the stats of another session; nothing pairs across sessions
+    void Add(const FunctionStats &other)
+    {
+        AddCounts(other);
+        openStarts.insert(openStarts.end(), other.openStarts.begin(), other.openStarts.end());
+        orphanEnds.insert(orphanEnds.end(), other.orphanEnds.begin(), other.orphanEnds.end());
+    }
+
+private:
+    void AddCounts(const FunctionStats &other)
+    {
+        lines += other.lines;
+        warnings += other.warnings;
+        errors += other.errors;
+        starts += other.starts;
+        durations.Merge(other.durations);
+    }
+};
+
+typedef std::unordered_map<std::string_view, FunctionStats> FunctionMap;
+
+// One session, or the part of one that a chunk saw
+struct SessionStats
+{
+    std::string_view startTime;  // Time text of the first line
+    int64_t firstMs = 0;
+    int64_t lastMs = 0;
+    uint64_t lines = 0;
+    uint64_t warnings = 0;
+    uint64_t errors = 0;
+    FunctionMap functions;
+
+    void Append(const SessionStats &next)
+    {
+        if (next.lines == 0)
+        {
+            return;
+        }
+        if (lines == 0)
+        {
+            startTime = next.startTime;
+            firstMs = next.firstMs;
+        }
+        lastMs = next.lastMs;
+        lines += next.lines;
+        warnings += next.warnings;
+        errors += next.errors;
+        for (const auto &function : next.functions)
+        {
+            functions[function.first].Append(function.second);
+        }
+    }
+
+    double Seconds() const { return static_cast<double>(lastMs - firstMs) / 1000.0; }
+};
+
+struct Chunk
+{
+    const char *begin;
+    const char *end;
+};
+
+// What one chunk contributed: the first session continues whatever came
+// before the chunk, every later one starts at a session marker
+struct ChunkResult
+{
+    std::vector<SessionStats> sessions;
+    uint64_t unparsed = 0;
+};
+
+static bool ParseNumber(const char *text, size_t digits, int64_t &value)
+{
+    value = 0;
+    for (size_t i = 0; i < digits; i++)
+    {
+        if (text[i] < '0' || text[i] > '9')
+        {
+            return false;
+        }
+        value = value * 10 + (text[i] - '0');
+    }
+    return true;
+}
+
+// Days since 1970-01-01 in the proleptic Gregorian calendar
+static int64_t DaysFromCivil(int64_t year, int64_t month, int64_t day)
+{
+    year -= month <= 2 ? 1 : 0;
+    int64_t era = (year >= 0 ? year : year - 399) / 400;
+    int64_t yearOfEra = year - era * 400;
+    int64_t dayOfYear = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+    int64_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + dayOfEra - 719468;
+}
+
+// Log times are local, which is fine for differences within one log
+static bool ParseLogTime(const char *text, int64_t &ms)
+{
+    int64_t year, month, day, hour, minute, second, millis;
+    if (!ParseNumber(text, 4, year) || text[4] != '-' || !ParseNumber(text + 5, 2, month) || text[7] != '-' ||
+        !ParseNumber(text + 8, 2, day) || text[10] != ' ' || !ParseNumber(text + 11, 2, hour) || text[13] != ':' ||
+        !ParseNumber(text + 14, 2, minute) || text[16] != ':' || !ParseNumber(text + 17, 2, second) ||
+        text[19] != '.' || !ParseNumber(text + 20, 3, millis))
+    {
+        return false;
+    }
+    ms = ((DaysFromCivil(year, month, day) * 24 + hour) * 60 + minute) * 60000 + second * 1000 + millis;
+    return true;
+}
+
+static bool IsSessionMarker(const char *line, const char *end)
+{
+    static const char marker[] = LOG_SESSION_MARKER;
+    size_t length = static_cast<size_t>(end - line);
+    return length >= sizeof(marker) - 1 && memcmp(line, marker, sizeof(marker) - 1) == 0;
+}
+
+static bool IsBlankOrRule(const char *line, const char *end)
+{
+    for (; line < end; line++)
+    {
+        if (*line != '=' && *line != '\r')
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Parses "<time> [LVL] [file:function] [line] message" lines into session
+// pieces. Functions are keyed by views into the mapped file, so a line costs
+// no allocation unless it names a function the chunk has not seen.
+static void ParseChunk(const Chunk &chunk, ChunkResult &result)
+{
+    result.sessions.emplace_back();
+    SessionStats *session = &result.sessions.back();
+    std::string_view lastSite;
+    FunctionStats *lastFunction = nullptr;
+
+    const char *line = chunk.begin;
+    while (line < chunk.end)
+    {
+        const char *lineEnd = static_cast<const char *>(memchr(line, '\n', static_cast<size_t>(chunk.end - line)));
+        const char *next = lineEnd ? lineEnd + 1 : chunk.end;
+        if (!lineEnd)
+        {
+            lineEnd = chunk.end;
+        }
+        const char *end = (lineEnd > line && lineEnd[-1] == '\r') ? lineEnd - 1 : lineEnd;
+
+        int64_t ms;
+        size_t length = static_cast<size_t>(end - line);
+        if (length < LOG_TIME_LENGTH + 8 || line[LOG_TIME_LENGTH] != ' ' || line[LOG_TIME_LENGTH + 1] != '[' ||
+            line[LOG_TIME_LENGTH + 5] != ']' || line[LOG_TIME_LENGTH + 7] != '[' || !ParseLogTime(line, ms))
+        {
+            if (IsSessionMarker(line, end))
+            {
+                result.sessions.emplace_back();
+                session = &result.sessions.back();
+                lastFunction = nullptr;
+            }
+            else if (!IsBlankOrRule(line, end))
+            {
+                result.unparsed++;
+            }
+            line = next;
+            continue;
+        }
+
+        // "[file:function] [line] message"; function names may contain "::"
+        const char *site = line + LOG_TIME_LENGTH + 8;
+        const char *siteEnd = site;
+        while (siteEnd + 2 < end && !(siteEnd[0] == ']' && siteEnd[1] == ' ' && siteEnd[2] == '['))
+        {
+            siteEnd++;
+        }
+        const char *lineNumberEnd = siteEnd + 2 < end
+            ? static_cast<const char *>(memchr(siteEnd + 3, ']', static_cast<size_t>(end - siteEnd - 3)))
+            : nullptr;
+        if (!lineNumberEnd)
+        {
+            result.unparsed++;
+            line = next;
+            continue;
+        }
+        std::string_view message(lineNumberEnd + 1, static_cast<size_t>(end - lineNumberEnd - 1));
+        if (!message.empty() && message[0] == ' ')
+        {
+            message.remove_prefix(1);
+        }
+
+        std::string_view siteText(site, static_cast<size_t>(siteEnd - site));
+        if (!lastFunction || siteText != lastSite)
+        {
+            lastFunction = &session->functions[siteText];
+            lastSite = siteText;
+        }
+
+        if (session->lines == 0)
+        {
+            session->startTime = std::string_view(line, LOG_TIME_LENGTH);
+            session->firstMs = ms;
+        }
+        session->lastMs = ms;
+        session->lines++;
+        lastFunction->lines++;
+
+        const char *level = line + LOG_TIME_LENGTH + 2;
+        if (memcmp(level, "WRN", 3) == 0)
+        {
+            session->warnings++;
+            lastFunction->warnings++;
+        }
+        else if (memcmp(level, "ERR", 3) == 0)
+        {
+            session->errors++;
+            lastFunction->errors++;
+        }
+
+        if (message == "Started")
+        {
+            lastFunction->Started(ms);
+        }
+        else if (message == "Ended")
+        {
+            lastFunction->Ended(ms);
+        }
+        line = next;
+    }
+}
+
+// Splits a file into chunks that each start at the beginning of a line
+static void SplitFile(const MappedFile &file, std::vector<Chunk> &chunks)
+{
+    const char *data = reinterpret_cast<const char *>(file.Data());
+    const char *end = data + file.Size();
+    const char *begin = data;
+    while (begin < end)
+    {
+        const char *split = begin + std::min<size_t>(LOG_STATS_CHUNK_BYTES, static_cast<size_t>(end - begin));
+        if (split < end)
+        {
+            const char *newline = static_cast<const char *>(memchr(split, '\n', static_cast<size_t>(end - split)));
+            split = newline ? newline + 1 : end;
+        }
+        chunks.push_back({begin, split});
+        begin = split;
+    }
+}
+
+static void PrintFunctions(const FunctionMap &functions, double seconds, size_t top)
+{
+    std::vector<std::pair<std::string_view, const FunctionStats *>> sorted;
+    for (const auto &function : functions)
+    {
+        sorted.emplace_back(function.first, &function.second);
+    }
+    std::sort(sorted.begin(), sorted.end(), [](const auto &a, const auto &b)
+    {
+        return a.second->lines != b.second->lines ? a.second->lines > b.second->lines : a.first < b.first;
+    });
+    if (top != 0 && sorted.size() > top)
+    {
+        sorted.resize(top);
+    }
+
+    printf("  %-48s %10s %9s %7s %7s %8s %8s %8s %8s %8s %6s\n", "function", "lines", "lines/s", "warn", "err",
+           "pairs", "mean ms", "p50 ms", "p99 ms", "max ms", "open");
+    for (const auto &entry : sorted)
+    {
+        const FunctionStats &stats = *entry.second;
+        const DurationStats &durations = stats.durations;
+        printf("  %-48.*s %10llu %9.2f %7llu %7llu %8llu", static_cast<int>(entry.first.size()), entry.first.data(),
+               static_cast<unsigned long long>(stats.lines),
+               seconds > 0 ? static_cast<double>(stats.lines) / seconds : 0.0,
+               static_cast<unsigned long long>(stats.warnings), static_cast<unsigned long long>(stats.errors),
+               static_cast<unsigned long long>(durations.count));
+        if (durations.count > 0)
+        {
+            printf(" %8.1f %8llu %8llu %8llu", static_cast<double>(durations.sumMs) / static_cast<double>(durations.count),
+                   static_cast<unsigned long long>(durations.Percentile(0.5)),
+                   static_cast<unsigned long long>(durations.Percentile(0.99)),
+                   static_cast<unsigned long long>(durations.maxMs));
+        }
+        else
+        {
+            printf(" %8s %8s %8s %8s", "-", "-", "-", "-");
+        }
+        printf(" %6zu\n", stats.openStarts.size());
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    size_t threadCount = std::max(1u, std::thread::hardware_concurrency());
+    size_t top = 20;
+    bool bySession = false;
+    std::vector<const char *> paths;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc)
+        {
+            threadCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--top") == 0 && i + 1 < argc)
+        {
+            top = static_cast<size_t>(std::max(0, atoi(argv[++i])));
+        }
+        else if (strcmp(argv[i], "--by-session") == 0)
+        {
+            bySession = true;
+        }
+        else if (argv[i][0] == '-')
+        {
+            PrintUsage();
+            return 1;
+        }
+        else
+        {
+            paths.push_back(argv[i]);
+        }
+    }
+    if (paths.empty())
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    std::vector<std::unique_ptr<MappedFile>> files;
+    std::vector<Chunk> chunks;
+    uint64_t totalBytes = 0;
+    for (const char *path : paths)
+    {
+        files.emplace_back(new MappedFile());
+        if (!files.back()->Open(path))
+        {
+            fprintf(stderr, "Cannot read %s\n", path);
+            return 1;
+        }
+        files.back()->AdviseSequential();
+        SplitFile(*files.back(), chunks);
+        totalBytes += files.back()->Size();
+    }
+
+    // Threads take chunks in order, so the pages being read stay close together
+    std::vector<ChunkResult> results(chunks.size());
+    std::atomic<size_t> nextChunk(0);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < std::min(threadCount, std::max<size_t>(chunks.size(), 1)); t++)
+    {
+        threads.emplace_back([&]()
+        {
+            for (size_t i = nextChunk.fetch_add(1); i < chunks.size(); i = nextChunk.fetch_add(1))
+            {
+                ParseChunk(chunks[i], results[i]);
+            }
+        });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    // Stitch the pieces back into whole sessions. Lines before the first
+    // marker make up a session of their own.
+    std::vector<SessionStats> sessions(1);
+    uint64_t unparsed = 0;
+    for (const ChunkResult &result : results)
+    {
+        sessions.back().Append(result.sessions[0]);
+        for (size_t i = 1; i < result.sessions.size(); i++)
+        {
+            sessions.push_back(result.sessions[i]);
+        }
+        unparsed += result.unparsed;
+    }
+    if (sessions.size() > 1 && sessions[0].lines == 0)
+    {
+        sessions.erase(sessions.begin());
+    }
+
+    SessionStats total;
+    uint64_t totalLines = 0;
+    double totalSeconds = 0;
+    for (const SessionStats &session : sessions)
+    {
+        for (const auto &function : session.functions)
+        {
+            total.functions[function.first].Add(function.second);
+        }
+        totalLines += session.lines;
+        totalSeconds += session.Seconds();
+    }
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+    printf("%zu files, %.1f MB, %llu lines, %llu unparsed, in %.2f s (%.0f MB/s, %zu threads)\n", paths.size(),
+           static_cast<double>(totalBytes) / 1e6, static_cast<unsigned long long>(totalLines),
+           static_cast<unsigned long long>(unparsed), elapsed, static_cast<double>(totalBytes) / 1e6 / elapsed,
+           threads.size());
+
+    printf("\nSessions\n");
+    printf("  %4s  %-23s %10s %12s %9s %9s %6s\n", "#", "start", "seconds", "lines", "warnings", "errors", "open");
+    for (size_t i = 0; i < sessions.size(); i++)
+    {
+        const SessionStats &session = sessions[i];
+        size_t open = 0;
+        for (const auto &function : session.functions)
+        {
+            open += function.second.openStarts.size();
+        }
+        printf("  %4zu  %-23.*s %10.1f %12llu %9llu %9llu %6zu\n", i + 1, static_cast<int>(session.startTime.size()),
+               session.startTime.data(), session.Seconds(), static_cast<unsigned long long>(session.lines),
+               static_cast<unsigned long long>(session.warnings), static_cast<unsigned long long>(session.errors), open);
+    }
+
+    printf("\nFunctions, all sessions (lines/s over %.1f s of logging; open = Started never Ended)\n", totalSeconds);
+    PrintFunctions(total.functions, totalSeconds, top);
+
+    if (bySession)
+    {
+        for (size_t i = 0; i < sessions.size(); i++)
+        {
+            printf("\nFunctions, session %zu\n", i + 1);
+            PrintFunctions(sessions[i].functions, sessions[i].Seconds(), top);
+        }
+    }
+    return 0;
+}
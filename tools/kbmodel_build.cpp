@@ -0,0 +1,82 @@
+// kbmodel-build: builds the n-gram model file used to detect wrong-layout typing
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "mapped_file.h"
+#include "ngram_model.h"
+#include "utf8_decode.h"
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbmodel-build -o <model.kbng> <langId>=<corpus.txt>...\n"
+                    "  langId is the primary language ID, e.g. 0x09 for English, 0x0D for Hebrew\n"
+                    "  corpus files are UTF-8 text\n");
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outputPath = nullptr;
+    NgramModelBuilder builder;
+    int corpusCount = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "-o") == 0 && i + 1 < argc)
+        {
+            outputPath = argv[++i];
+            continue;
+        }
+
+        const char *separator = strchr(argv[i], '=');
+        if (!separator)
+        {
+            PrintUsage();
+            return 1;
+        }
+
+        char *end = nullptr;
+        unsigned long langId = strtoul(argv[i], &end, 0);
+        if (end != separator || langId == 0 || langId > 0x3FF)
+        {
+            fprintf(stderr, "Invalid language ID in '%s'\n", argv[i]);
+            return 1;
+        }
+
+        MappedFile corpus;
+        if (!corpus.Open(separator + 1))
+        {
+            fprintf(stderr, "Cannot read %s\n", separator + 1);
+            return 1;
+        }
+        std::wstring text = DecodeUtf8(corpus.Data(), corpus.Size());
+        builder.AddText(static_cast<uint16_t>(langId), text);
+        printf("0x%02lx: %s, %zu characters\n", langId, separator + 1, text.size());
+        corpusCount++;
+    }
+
+    if (!outputPath || corpusCount == 0)
+    {
+        PrintUsage();
+        return 1;
+    }
+
+    std::vector<uint8_t> model = builder.Build();
+    FILE *out = fopen(outputPath, "wb");
+    if (!out)
+    {
+        fprintf(stderr, "Cannot write %s\n", outputPath);
+        return 1;
+    }
+    size_t written = fwrite(model.data(), 1, model.size(), out);
+    fclose(out);
+    if (written != model.size())
+    {
+        fprintf(stderr, "Failed writing %s\n", outputPath);
+        return 1;
+    }
+
+    printf("Wrote %s (%zu bytes)\n", outputPath, model.size());
+    return 0;
+}
@@ -0,0 +1,406 @@
+// kbserve-load: drives kbserve from several clients, each keeping a number of
+// requests in flight, and reports throughput and latency percentiles
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "layout_table.h"
+#include "serve_protocol.h"
+#include "text_corrector.h"
+#include "utf8_decode.h"
+
+// Words sent when no --text file is given, each in its own layout and as
+// typed in the other ones
+static const wchar_t *const DEFAULT_LOAD_WORDS[] = {
+    L"hello", L"world", L"keyboard", L"layout", L"checker", L"message", L"please", L"thanks",
+    L"meeting", L"tomorrow", L"question", L"between", L"because", L"something", L"Would", L"About",
+    L"שלום", L"תודה", L"בבקשה", L"מקלדת", L"עברית", L"מחר", L"פגישה", L"שאלה",
+    L"אנחנו", L"היום", L"עכשיו", L"בסדר", L"למה", L"איפה", L"כתבתי", L"חבר"};
+
+// Most distinct words read from --text
+const size_t LOAD_MAX_TEXT_WORDS = 100000;
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbserve-load [--socket <path>] [--clients <n>] [--depth <n>] [--items <n>] [--seconds <n>]\n"
+                    "                    [--keys] [--text <file>]\n"
+                    "  --clients  connections, each on its own thread; default 4\n"
+                    "  --depth    requests each client keeps in flight; default 8, at most 256\n"
+                    "  --items    words per request; default 16\n"
+                    "  --seconds  how long to send for; default 5\n"
+                    "  --keys     send words as key presses instead of text\n"
+                    "  --text     UTF-8 file whose words are sent instead of the built-in ones\n");
+}
+
+// One word as sent: its text and keys in the layout it is sent as typed in,
+// and the layout it was written for
+struct LoadSample
+{
+    std::vector<uint16_t> text;
+    std::vector<uint16_t> keys;
+    uint8_t typedLayout;
+    int8_t meantLayout;
+};
+
+// Every word as typed in its own layout and in each of the others
+static void BuildSamples(const std::vector<std::wstring> &words, const std::vector<LayoutTable> &layouts,
+                         std::vector<LoadSample> &samples)
+{
+    std::vector<ReverseLayoutMap> maps;
+    for (const LayoutTable &layout : layouts)
+    {
+        maps.emplace_back(layout);
+    }
+    std::vector<KeyPressInfo> keys;
+    for (const std::wstring &word : words)
+    {
+        size_t meant = 0;
+        for (; meant < maps.size(); meant++)
+        {
+            keys.clear();
+            KeyPressInfo key(0, ModifierFlags());
+            for (wchar_t ch : word)
+            {
+                if (!maps[meant].Find(ch, key))
+                {
+                    break;
+                }
+                keys.push_back(key);
+            }
+            if (keys.size() == word.size())
+            {
+                break;
+            }
+        }
+        if (meant == maps.size() || word.empty() || word.size() > SERVE_MAX_ITEM_UNITS)
+        {
+            continue;
+        }
+        for (size_t typed = 0; typed < layouts.size(); typed++)
+        {
+            LoadSample sample;
+            sample.typedLayout = static_cast<uint8_t>(typed);
+            sample.meantLayout = static_cast<int8_t>(meant);
+            bool typeable = true;
+            for (const KeyPressInfo &key : keys)
+            {
+                wchar_t ch = layouts[typed].Lookup(key.vkCode, key.modifiers);
+                typeable = typeable && ch != 0;
+                sample.text.push_back(static_cast<uint16_t>(ch));
+                sample.keys.push_back(static_cast<uint16_t>(key.vkCode | (key.modifiers.shift ? SERVE_KEY_SHIFT : 0) |
+                                                            (key.modifiers.alt ? SERVE_KEY_ALTGR : 0)));
+            }
+            if (typeable)
+            {
+                samples.push_back(sample);
+            }
+        }
+    }
+}
+
+// What one client saw
+struct LoadClient
+{
+    std::vector<uint32_t> latencyNs;
+    uint64_t requests = 0;
+    uint64_t items = 0;
+    uint64_t errors = 0;
+    uint64_t agreed = 0;
+    bool failed = false;
+};
+
+static int64_t LoadClockNs()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+static bool SendAll(int fd, std::string &out)
+{
+    size_t sent = 0;
+    while (sent < out.size())
+    {
+        ssize_t count = send(fd, out.data() + sent, out.size() - sent, MSG_NOSIGNAL);
+        if (count < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (count <= 0)
+        {
+            return false;
+        }
+        sent += static_cast<size_t>(count);
+    }
+    out.clear();
+    return true;
+}
+
+// Keeps depth requests in flight until the deadline, then collects the rest.
+// Request ids are seq * depth + slot, so an answer finds its slot whatever
+// order answers come in.
+static void RunClient(const char *socketPath, const std::vector<LoadSample> &samples, size_t clientIndex,
+                      size_t depth, size_t items, bool sendKeys, int64_t deadlineNs, LoadClient &client)
+{
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    strncpy(address.sun_path, socketPath, sizeof(address.sun_path) - 1);
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+    {
+        client.failed = true;
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return;
+    }
+
+    std::vector<int64_t> sentNs(depth);
+    std::vector<uint32_t> sequence(depth, 0);
+    std::vector<size_t> firstSample(depth);
+    size_t nextSample = clientIndex * items % samples.size();
+    std::string out;
+    ServeFrameWriter writer(out);
+    auto queueRequest = [&](size_t slot)
+    {
+        writer.Begin(static_cast<uint32_t>(sequence[slot] * depth + slot));
+        firstSample[slot] = nextSample;
+        for (size_t i = 0; i < items; i++)
+        {
+            const LoadSample &sample = samples[nextSample];
+            const std::vector<uint16_t> &units = sendKeys ? sample.keys : sample.text;
+            ServeItemHeader item = {static_cast<uint8_t>(sendKeys ? SERVE_ITEM_KEYS : SERVE_ITEM_TEXT),
+                                    sample.typedLayout, static_cast<uint16_t>(units.size())};
+            writer.Add(item, units.data());
+            nextSample = (nextSample + 1) % samples.size();
+        }
+        writer.End();
+        sentNs[slot] = LoadClockNs();
+    };
+
+    for (size_t slot = 0; slot < depth; slot++)
+    {
+        queueRequest(slot);
+    }
+    size_t outstanding = depth;
+    std::string in(SERVE_MAX_FRAME + sizeof(uint32_t), '\0');
+    size_t inUsed = 0;
+    while (outstanding > 0)
+    {
+        if (!out.empty() && !SendAll(fd, out))
+        {
+            client.failed = true;
+            break;
+        }
+        ssize_t received = recv(fd, &in[inUsed], in.size() - inUsed, 0);
+        if (received < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (received <= 0)
+        {
+            client.failed = true;
+            break;
+        }
+        inUsed += static_cast<size_t>(received);
+
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(in.data());
+        size_t offset = 0;
+        size_t frameBytes;
+        while ((frameBytes = ServeFrameBytes(data + offset, inUsed - offset)) != 0)
+        {
+            int64_t nowNs = LoadClockNs();
+            ServeFrameHeader header;
+            memcpy(&header, data + offset, sizeof(header));
+            size_t slot = header.requestId % depth;
+            client.latencyNs.push_back(static_cast<uint32_t>(std::min<int64_t>(nowNs - sentNs[slot], UINT32_MAX)));
+            client.requests++;
+            if (header.status != SERVE_OK || header.itemCount != items)
+            {
+                client.errors++;
+            }
+            else
+            {
+                const uint8_t *pos = data + offset + sizeof(header);
+                for (size_t i = 0; i < items; i++)
+                {
+                    ServeResultHeader result;
+                    memcpy(&result, pos, sizeof(result));
+                    pos += sizeof(result) + result.length * sizeof(uint16_t);
+                    client.errors += result.status != SERVE_OK;
+                    client.agreed += result.bestLayout == samples[(firstSample[slot] + i) % samples.size()].meantLayout;
+                }
+                client.items += items;
+            }
+            offset += frameBytes;
+
+            sequence[slot]++;
+            if (nowNs < deadlineNs)
+            {
+                queueRequest(slot);
+            }
+            else
+            {
+                outstanding--;
+            }
+        }
+        inUsed -= offset;
+        memmove(&in[0], data + offset, inUsed);
+    }
+    close(fd);
+}
+
+int main(int argc, char **argv)
+{
+    const char *socketPath = DEFAULT_SERVE_SOCKET_PATH;
+    size_t clientCount = 4;
+    size_t depth = 8;
+    size_t items = 16;
+    double seconds = 5.0;
+    bool sendKeys = false;
+    const char *textPath = nullptr;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--socket") == 0 && i + 1 < argc)
+        {
+            socketPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--clients") == 0 && i + 1 < argc)
+        {
+            clientCount = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc)
+        {
+            depth = std::min<size_t>(std::max(1, atoi(argv[++i])), SERVE_MAX_IN_FLIGHT);
+        }
+        else if (strcmp(argv[i], "--items") == 0 && i + 1 < argc)
+        {
+            items = std::min(std::max(1, atoi(argv[++i])), 1024);
+        }
+        else if (strcmp(argv[i], "--seconds") == 0 && i + 1 < argc)
+        {
+            seconds = std::max(0.1, atof(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--keys") == 0)
+        {
+            sendKeys = true;
+        }
+        else if (strcmp(argv[i], "--text") == 0 && i + 1 < argc)
+        {
+            textPath = argv[++i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+
+    std::vector<std::wstring> words;
+    if (textPath)
+    {
+        std::ifstream file(textPath, std::ios::binary);
+        std::string bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        if (!file && !file.eof())
+        {
+            fprintf(stderr, "Cannot read %s\n", textPath);
+            return 1;
+        }
+        std::wstring text = DecodeUtf8(reinterpret_cast<const uint8_t *>(bytes.data()), bytes.size());
+        size_t pos = 0;
+        while (pos < text.size() && words.size() < LOAD_MAX_TEXT_WORDS)
+        {
+            size_t begin = text.find_first_not_of(L" \t\r\n", pos);
+            if (begin == std::wstring::npos)
+            {
+                break;
+            }
+            pos = std::min(text.find_first_of(L" \t\r\n", begin), text.size());
+            words.push_back(text.substr(begin, pos - begin));
+        }
+    }
+    else
+    {
+        words.assign(std::begin(DEFAULT_LOAD_WORDS), std::end(DEFAULT_LOAD_WORDS));
+    }
+
+    // The service's built-in layouts; a service started with --layouts
+    // answers for its own, and the agreement figure stops meaning much
+    std::vector<LayoutTable> layouts = {LayoutTable::UsQwerty(), LayoutTable::HebrewSi1452()};
+    std::vector<LoadSample> samples;
+    BuildSamples(words, layouts, samples);
+    if (samples.empty())
+    {
+        fprintf(stderr, "No word to send can be typed in the built-in layouts\n");
+        return 1;
+    }
+
+    std::vector<LoadClient> clients(clientCount);
+    std::vector<std::thread> threads;
+    int64_t startNs = LoadClockNs();
+    int64_t deadlineNs = startNs + static_cast<int64_t>(seconds * 1e9);
+    for (size_t c = 0; c < clientCount; c++)
+    {
+        threads.emplace_back(RunClient, socketPath, std::cref(samples), c, depth, items, sendKeys, deadlineNs,
+                             std::ref(clients[c]));
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+    double elapsed = static_cast<double>(LoadClockNs() - startNs) / 1e9;
+
+    std::vector<uint32_t> latencyNs;
+    uint64_t requests = 0;
+    uint64_t itemsAnswered = 0;
+    uint64_t errors = 0;
+    uint64_t agreed = 0;
+    size_t failed = 0;
+    for (const LoadClient &client : clients)
+    {
+        latencyNs.insert(latencyNs.end(), client.latencyNs.begin(), client.latencyNs.end());
+        requests += client.requests;
+        itemsAnswered += client.items;
+        errors += client.errors;
+        agreed += client.agreed;
+        failed += client.failed;
+    }
+    if (failed == clientCount && requests == 0)
+    {
+        fprintf(stderr, "Cannot talk to kbserve on %s\n", socketPath);
+        return 1;
+    }
+    std::sort(latencyNs.begin(), latencyNs.end());
+    auto percentileUs = [&latencyNs](double fraction)
+    {
+        if (latencyNs.empty())
+        {
+            return 0.0;
+        }
+        size_t index = std::min(latencyNs.size() - 1, static_cast<size_t>(fraction * latencyNs.size()));
+        return latencyNs[index] / 1e3;
+    };
+
+    printf("%zu clients, %zu in flight each, %zu %s items per request, %.1f s\n", clientCount, depth, items,
+           sendKeys ? "key" : "text", elapsed);
+    printf("%llu requests (%.0f/s), %llu items (%.0f/s), %llu errors, %zu clients failed\n",
+           static_cast<unsigned long long>(requests), requests / elapsed,
+           static_cast<unsigned long long>(itemsAnswered), itemsAnswered / elapsed,
+           static_cast<unsigned long long>(errors), failed);
+    printf("latency us: p50 %.1f  p90 %.1f  p99 %.1f  p99.9 %.1f  max %.1f\n", percentileUs(0.5),
+           percentileUs(0.9), percentileUs(0.99), percentileUs(0.999), percentileUs(1.0));
+    printf("%.1f%% of items were given the layout their word was written in\n",
+           itemsAnswered > 0 ? 100.0 * static_cast<double>(agreed) / static_cast<double>(itemsAnswered) : 0.0);
+    return errors != 0 || failed != 0 ? 1 : 0;
+}
@@ -0,0 +1,301 @@
+// kbtrace-replay: pushes a recorded keystroke trace through the detection engine
+// and reports throughput, per-key latency and how often the UI would redraw
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <string>
+#include <thread>
+#include <vector>
+#include "detection_engine.h"
+#include "key_trace.h"
+#include "logger.h"
+#include "presenter.h"
+#include "span_trace.h"
+
+static void PrintUsage()
+{
+    fprintf(stderr, "Usage: kbtrace-replay [--speed max|recorded] [--repeat <n>] [--model <model.kbng>]\n"
+                    "                     [--dict <words.kbdw>] [--idle-ms <n>] [--timeline <file.json>]\n"
+                    "                     [--frame-ms <n>] [--ui-idle-ms <n>] [--frames] [--expect-ui-updates <n>] <trace.kbtrace>\n"
+                    "  --speed   max replays back to back (default), recorded keeps the recorded gaps\n"
+                    "  --repeat  replays the trace n times, for steadier numbers on short traces\n"
+                    "  --idle-ms pause after which an unfinished word is checked, in recorded time\n"
+                    "  --timeline  writes the engine's spans as Chrome trace-event JSON\n"
+                    "  --frame-ms  shortest time between UI updates, in recorded time; 0 shows every change\n"
+                    "  --ui-idle-ms  pause in changes before the UI updates; default 0\n"
+                    "  --frames  prints every UI update\n"
+                    "  --expect-ui-updates  exits with 1 unless the replay makes exactly n UI updates\n");
+}
+
+static uint64_t Percentile(std::vector<uint64_t> &sorted, double fraction)
+{
+    if (sorted.empty())
+    {
+        return 0;
+    }
+    size_t index = static_cast<size_t>(fraction * (sorted.size() - 1));
+    return sorted[index];
+}
+
+int main(int argc, char **argv)
+{
+    bool recordedSpeed = false;
+    int repeat = 1;
+    std::string modelPath;
+    std::string dictionaryPath;
+    int64_t idleCheckUs = DEFAULT_IDLE_CHECK_US;
+    const char *tracePath = nullptr;
+    const char *timelinePath = nullptr;
+    PresenterPolicy policy;
+    bool printFrames = false;
+    long long expectedUiUpdates = -1;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strcmp(argv[i], "--speed") == 0 && i + 1 < argc)
+        {
+            std::string speed = argv[++i];
+            if (speed != "max" && speed != "recorded")
+            {
+                PrintUsage();
+                return 2;
+            }
+            recordedSpeed = speed == "recorded";
+        }
+        else if (strcmp(argv[i], "--repeat") == 0 && i + 1 < argc)
+        {
+            repeat = std::max(1, atoi(argv[++i]));
+        }
+        else if (strcmp(argv[i], "--model") == 0 && i + 1 < argc)
+        {
+            modelPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--dict") == 0 && i + 1 < argc)
+        {
+            dictionaryPath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--idle-ms") == 0 && i + 1 < argc)
+        {
+            idleCheckUs = static_cast<int64_t>(atoi(argv[++i])) * 1000;
+        }
+        else if (strcmp(argv[i], "--timeline") == 0 && i + 1 < argc)
+        {
+            timelinePath = argv[++i];
+        }
+        else if (strcmp(argv[i], "--frame-ms") == 0 && i + 1 < argc)
+        {
+            policy.frameUs = static_cast<int64_t>(atof(argv[++i]) * 1000);
+        }
+        else if (strcmp(argv[i], "--ui-idle-ms") == 0 && i + 1 < argc)
+        {
+            policy.idleUs = static_cast<int64_t>(atof(argv[++i]) * 1000);
+        }
+        else if (strcmp(argv[i], "--frames") == 0)
+        {
+            printFrames = true;
+        }
+        else if (strcmp(argv[i], "--expect-ui-updates") == 0 && i + 1 < argc)
+        {
+            expectedUiUpdates = atoll(argv[++i]);
+        }
+        else if (argv[i][0] != '-' && !tracePath)
+        {
+            tracePath = argv[i];
+        }
+        else
+        {
+            PrintUsage();
+            return 2;
+        }
+    }
+    if (!tracePath)
+    {
+        PrintUsage();
+        return 2;
+    }
+
+    KeyTraceReader trace;
+    if (!trace.Open(tracePath))
+    {
+        fprintf(stderr, "Cannot read key trace %s\n", tracePath);
+        return 1;
+    }
+
+    // The built-in tables stand in for the recording machine's layouts
+    DetectionEngine engine;
+    engine.SetLayouts({LayoutTable::UsQwerty(), LayoutTable::HebrewSi1452()});
+    if (!modelPath.empty() && !engine.LoadModel(modelPath))
+    {
+        fprintf(stderr, "Cannot read model %s\n", modelPath.c_str());
+        return 1;
+    }
+    if (!dictionaryPath.empty() && !engine.LoadDictionary(dictionaryPath))
+    {
+        fprintf(stderr, "Cannot read dictionary %s\n", dictionaryPath.c_str());
+        return 1;
+    }
+
+    engine.SetIdleCheckDelay(idleCheckUs);
+
+    // The UI is simulated in recorded time: a wake or the frame timer
+    // presents at presentDueUs, between key events
+    RecordingPresenterBackend frames;
+    Presenter presenter(frames, policy);
+    int64_t replayUs = 0;
+    int64_t presentDueUs = -1;
+    auto wake = [&presentDueUs, &replayUs](bool changed)
+    {
+        if (changed && (presentDueUs < 0 || presentDueUs > replayUs))
+        {
+            presentDueUs = replayUs;
+        }
+    };
+    auto presentUntil = [&presenter, &presentDueUs](int64_t nowUs)
+    {
+        while (presentDueUs >= 0 && presentDueUs <= nowUs)
+        {
+            int64_t delayUs = presenter.Tick(presentDueUs);
+            presentDueUs = delayUs >= 0 ? presentDueUs + delayUs : -1;
+        }
+    };
+
+    int activeLayout = -1;
+    uint64_t textUpdates = 0;
+    engine.SetActiveLayoutFunction([&activeLayout]() { return activeLayout; });
+    engine.SetTextHandler([&](std::wstring_view text)
+    {
+        textUpdates++;
+        wake(presenter.SetText(text, replayUs));
+    });
+    engine.SetWrongLayoutHandler([&](const WrongLayoutReport &report)
+    {
+        wake(presenter.SetReport(report, engine, replayUs));
+    });
+
+    const KeyTraceRecord *records = trace.Records();
+    size_t count = trace.Count();
+    std::vector<uint64_t> latencies;
+    latencies.reserve(count * repeat);
+
+    // Recorded time drives idle checks, running on across repeats so each
+    // pass starts after the last one's pending check fell due
+    int64_t traceSpanUs = count > 0 ? records[count - 1].timestampUs - records[0].timestampUs : 0;
+
+    if (timelinePath)
+    {
+        SpanTrace::SetThreadName("replay");
+        SpanTrace::Instance().Enable();
+    }
+
+    typedef std::chrono::steady_clock Clock;
+    Clock::time_point wallStart = Clock::now();
+    for (int pass = 0; pass < repeat; pass++)
+    {
+        Clock::time_point passStart = Clock::now();
+        int64_t passStartUs = 1 + pass * (traceSpanUs + idleCheckUs + 1);
+        for (size_t i = 0; i < count; i++)
+        {
+            const KeyTraceRecord &record = records[i];
+            if (recordedSpeed)
+            {
+                std::this_thread::sleep_until(passStart +
+                                              std::chrono::microseconds(record.timestampUs - records[0].timestampUs));
+            }
+
+            int64_t eventUs = passStartUs + (record.timestampUs - records[0].timestampUs);
+            presentUntil(eventUs);
+
+            Clock::time_point start = Clock::now();
+            activeLayout = record.langId == KEY_TRACE_NO_LAYOUT ? -1 : engine.FindLayoutByLanguage(record.langId);
+            replayUs = eventUs;
+            if (record.flags & KEY_EVENT_UP)
+            {
+                engine.OnKeyUp(record.vkCode);
+            }
+            else
+            {
+                engine.OnKeyDown(record.vkCode, replayUs);
+            }
+            latencies.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+        }
+    }
+    double wallSeconds = std::chrono::duration<double>(Clock::now() - wallStart).count();
+    replayUs += idleCheckUs;
+    engine.OnIdle(replayUs);
+    presentUntil(std::numeric_limits<int64_t>::max());
+
+    uint64_t busyNs = 0;
+    for (uint64_t latency : latencies)
+    {
+        busyNs += latency;
+    }
+    std::sort(latencies.begin(), latencies.end());
+
+    size_t events = latencies.size();
+    printf("events          %zu (%zu x %d)\n", events, count, repeat);
+    printf("wall time       %.3f s\n", wallSeconds);
+    printf("throughput      %.0f keys/s processing, %.0f keys/s wall\n",
+           busyNs > 0 ? events * 1e9 / busyNs : 0.0, wallSeconds > 0 ? events / wallSeconds : 0.0);
+    printf("latency ns      p50 %llu  p90 %llu  p99 %llu  max %llu\n",
+           static_cast<unsigned long long>(Percentile(latencies, 0.50)),
+           static_cast<unsigned long long>(Percentile(latencies, 0.90)),
+           static_cast<unsigned long long>(Percentile(latencies, 0.99)),
+           static_cast<unsigned long long>(latencies.empty() ? 0 : latencies.back()));
+    printf("words checked   %llu\n", static_cast<unsigned long long>(engine.WordsChecked()));
+    printf("wrong layout    %llu\n", static_cast<unsigned long long>(engine.WrongLayoutCount()));
+    printf("dictionary hits %llu\n", static_cast<unsigned long long>(engine.DictionaryHits()));
+    const DetectionScheduler &scheduler = engine.Scheduler();
+    printf("checks          %llu (%llu at word end, %llu when idle) for %llu key events, %llu avoided\n",
+           static_cast<unsigned long long>(scheduler.Evaluations()),
+           static_cast<unsigned long long>(scheduler.BoundaryChecks()),
+           static_cast<unsigned long long>(scheduler.IdleChecks()),
+           static_cast<unsigned long long>(scheduler.KeyEvents()),
+           static_cast<unsigned long long>(scheduler.EvaluationsAvoided()));
+    printf("superseded      %llu pending checks\n", static_cast<unsigned long long>(scheduler.CancelledChecks()));
+    printf("text updates    %llu\n", static_cast<unsigned long long>(textUpdates));
+    printf("ui updates      %llu for %llu changes (%llu superseded, %llu unchanged), frame %.1f ms\n",
+           static_cast<unsigned long long>(presenter.Flushes()), static_cast<unsigned long long>(presenter.Updates()),
+           static_cast<unsigned long long>(presenter.Superseded()),
+           static_cast<unsigned long long>(presenter.Unchanged()), policy.frameUs / 1000.0);
+    if (printFrames)
+    {
+        int64_t firstUs = frames.Frames().empty() ? 0 : frames.Frames().front().timeUs;
+        for (const RecordingPresenterBackend::Frame &frame : frames.Frames())
+        {
+            char line[1024];
+            size_t pos = AppendUtf8(line, 0, sizeof(line) - 1, frame.view.text.c_str());
+            for (size_t i = 0; i < frame.view.conversionCount; i++)
+            {
+                pos = AppendUtf8(line, pos, sizeof(line) - 1, L" | ");
+                pos = AppendUtf8(line, pos, sizeof(line) - 1, frame.view.conversions[i].layoutName.c_str());
+                pos = AppendUtf8(line, pos, sizeof(line) - 1, L": ");
+                pos = AppendUtf8(line, pos, sizeof(line) - 1, frame.view.conversions[i].text.c_str());
+            }
+            line[pos] = '\0';
+            printf("  %10.3f ms  %s\n", (frame.timeUs - firstUs) / 1000.0, line);
+        }
+    }
+
+    if (timelinePath)
+    {
+        SpanTrace &spans = SpanTrace::Instance();
+        if (!spans.WriteChromeJson(timelinePath))
+        {
+            fprintf(stderr, "Cannot write timeline %s\n", timelinePath);
+            return 1;
+        }
+        printf("timeline        %llu spans (%llu dropped) in %s\n", static_cast<unsigned long long>(spans.EventCount()),
+               static_cast<unsigned long long>(spans.DroppedCount()), timelinePath);
+    }
+
+    if (expectedUiUpdates >= 0 && presenter.Flushes() != static_cast<uint64_t>(expectedUiUpdates))
+    {
+        fprintf(stderr, "Expected %lld UI updates, got %llu\n", expectedUiUpdates,
+                static_cast<unsigned long long>(presenter.Flushes()));
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Decodes UTF-8, replacing malformed sequences with U+FFFD
+inline std::wstring DecodeUtf8(const uint8_t *data, size_t size)
+{
+    std::wstring text;
+    text.reserve(size);
+    size_t i = 0;
+    while (i < size)
+    {
+        uint8_t lead = data[i];
+        uint32_t cp;
+        size_t length;
+        if (lead < 0x80)
+        {
+            cp = lead;
+            length = 1;
+        }
+        else if ((lead & 0xE0) == 0xC0)
+        {
+            cp = lead & 0x1F;
+            length = 2;
+        }
+        else if ((lead & 0xF0) == 0xE0)
+        {
+            cp = lead & 0x0F;
+            length = 3;
+        }
+        else if ((lead & 0xF8) == 0xF0)
+        {
+            cp = lead & 0x07;
+            length = 4;
+        }
+        else
+        {
+            text += static_cast<wchar_t>(0xFFFD);
+            i++;
+            continue;
+        }
+
+        if (i + length > size)
+        {
+            text += static_cast<wchar_t>(0xFFFD);
+            break;
+        }
+        bool valid = true;
+        for (size_t k = 1; k < length; k++)
+        {
+            if ((data[i + k] & 0xC0) != 0x80)
+            {
+                valid = false;
+                break;
+            }
+            cp = (cp << 6) | (data[i + k] & 0x3F);
+        }
+        if (!valid)
+        {
+            text += static_cast<wchar_t>(0xFFFD);
+            i++;
+            continue;
+        }
+
+        // Models and dictionaries only use the BMP, so characters beyond it never match anyway
+        text += static_cast<wchar_t>(cp <= 0xFFFF ? cp : 0xFFFD);
+        i += length;
+    }
+    return text;
+}